@@ -0,0 +1,12 @@
+"""
+Ward gateway — one process between many TremorSense devices and the
+dashboards / backend.
+
+Devices (or the simulator) push their SSE stream over a plain TCP
+connection; the gateway parses it into Records and hands each record to
+the registered sinks (alerting, ...). Standard library only, asyncio.
+
+    python -m gateway --port 8200
+    python -m gateway.simulator --gateway 127.0.0.1:8200 --devices 500
+    python -m gateway.bench alerts --devices 5000
+"""
@@ -0,0 +1,129 @@
+"""
+Runs the gateway: TCP ingest on --port, alert engine, alerts printed as
+JSON lines (one per alert) and a stats line every --stats seconds.
+--record DIR also writes every session verbatim under DIR.
+--shards N runs one gateway process per core (see gateway.shard).
+--backfill DIR pulls each device's flash window log into DIR (see
+gateway.backfill).
+--align "study=left+right,..." merges each group's devices by event time
+and prints aligned windows as JSON lines (see gateway.align).
+--fanout PORT serves records and alerts to dashboards over WebSocket,
+compressed once per topic frame (see gateway.fanout).
+"""
+
+import argparse
+import asyncio
+import json
+import sys
+from dataclasses import asdict
+
+from gateway.align import POLICIES, Aligner, parse_groups
+from gateway.alerts import AlertEngine, BandSwitch, ScoreAbove, Silence
+from gateway.backfill import Backfill
+from gateway.fanout import Fanout
+from gateway.recorder import Recorder
+from gateway.server import Gateway
+from gateway.shard import ShardedGateway, alert_setup
+
+
+def main() -> None:
+    ap = argparse.ArgumentParser(description="TremorSense ward gateway")
+    ap.add_argument("--host", default="0.0.0.0")
+    ap.add_argument("--port", type=int, default=8200)
+    ap.add_argument("--score", type=float, default=7.0, help="ScoreAbove threshold")
+    ap.add_argument("--hold", type=float, default=60.0, help="ScoreAbove hold, s")
+    ap.add_argument("--silence", type=float, default=10.0, help="Silence timeout, s")
+    ap.add_argument("--stats", type=float, default=10.0)
+    ap.add_argument("--record", metavar="DIR", help="record raw sessions under DIR")
+    ap.add_argument("--shards", type=int, default=1, help="gateway processes (SO_REUSEPORT)")
+    ap.add_argument("--backfill", metavar="DIR", help="fetch device flash logs into DIR")
+    ap.add_argument("--backfill-port", type=int, default=80, help="device HTTP port")
+    ap.add_argument("--backfill-rate", type=float, default=100.0, help="records/s per device")
+    ap.add_argument("--align", metavar="GROUPS", help='e.g. "study=left+right,bed4=a+b"')
+    ap.add_argument("--late", choices=POLICIES, default="drop", help="align: late-record policy")
+    ap.add_argument("--max-delay", type=float, default=5.0, help="align: watermark lag, s")
+    ap.add_argument("--fanout", type=int, metavar="PORT", help="WebSocket fan-out to dashboards")
+    a = ap.parse_args()
+    if a.align and a.shards > 1:
+        ap.error("--align needs a single shard (group members must share a loop)")
+    if a.fanout and a.shards > 1:
+        ap.error("--fanout needs a single shard (subscribers must see every device)")
+    bf_args = a.backfill and {"root": a.backfill, "port": a.backfill_port, "rate": a.backfill_rate}
+    if a.shards > 1:
+        return run_sharded(a, bf_args)
+
+    fo = Fanout() if a.fanout else None
+
+    def on_alert(al):
+        sys.stdout.write(json.dumps(asdict(al)) + "\n")
+        if fo is not None:
+            fo.alert(asdict(al))
+
+    gw = Gateway()
+    engine = AlertEngine([ScoreAbove(a.score, a.hold), BandSwitch()], Silence(a.silence), on_alert)
+    gw.add_sink(engine, engine.sweep)
+    rec = None
+    if a.record:
+        rec = Recorder(a.record)
+        gw.add_tap(rec, rec.sweep)
+    bf = None
+    if bf_args:
+        bf = Backfill(**bf_args)
+        gw.add_tap(bf, bf.sweep)
+    al = None
+    if a.align:
+        al = Aligner(parse_groups(a.align), max_delay=a.max_delay, late=a.late,
+                     on_window=lambda w: print(json.dumps(w), flush=True))
+        gw.add_sink(al, al.sweep)
+    if fo is not None:
+        gw.add_sink(fo)
+
+    async def report():
+        while True:
+            await asyncio.sleep(a.stats)
+            st = {"connections": gw.connections, **engine.stats()}
+            if rec is not None:
+                st["record"] = rec.stats()
+            if bf is not None:
+                st["backfill"] = bf.stats()
+            if al is not None:
+                st["align"] = al.stats()
+            if fo is not None:
+                st["fanout"] = fo.stats()
+            print("[GW]", json.dumps(st), flush=True)
+
+    async def run():
+        asyncio.create_task(report())
+        if fo is not None:
+            asyncio.create_task(fo.serve(a.host, a.fanout))
+        print(f"[GW] listening on {a.host}:{a.port}", flush=True)
+        await gw.serve(a.host, a.port)
+
+    try:
+        asyncio.run(run())
+    except KeyboardInterrupt:
+        pass
+    finally:
+        if rec is not None:
+            rec.stop()
+
+
+def run_sharded(a, bf_args) -> None:
+    sg = ShardedGateway(a.shards, alert_setup(a.score, a.hold, a.silence, a.record, bf_args), a.stats)
+    sg.start(a.host, a.port)
+    print(f"[GW] {a.shards} shards listening on {a.host}:{a.port}", flush=True)
+    try:
+        while sg.pipes:
+            for m in sg.poll():
+                if m["kind"] == "alert":
+                    sys.stdout.write(json.dumps(m) + "\n")
+                elif m["shard"] == 0:
+                    print("[GW]", json.dumps(sg.totals()), flush=True)
+    except KeyboardInterrupt:
+        pass
+    finally:
+        sg.stop()
+
+
+if __name__ == "__main__":
+    main()
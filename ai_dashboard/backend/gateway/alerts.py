@@ -0,0 +1,233 @@
+"""
+Streaming alert rules over device records.
+
+Every rule keeps a fixed-size state object per device, updated in O(1)
+per record, so the cost of a ward is (devices x rules) small objects and
+one pass per record. Silence is the one rule that fires without a record:
+devices are kept in an OrderedDict by last arrival, so sweep() only looks
+at the front of it.
+
+Latency is measured from the record's arrival at the gateway to the
+moment the alert is emitted.
+
+Built-in rules:
+    ScoreAbove(7, 60)   score above 7 continuously for 60 s
+    BandSwitch(2)       dominant band changed and held for 2 windows
+    Silence(10)         no record from a device for 10 s
+"""
+
+import time
+from collections import OrderedDict
+from dataclasses import dataclass
+from typing import Callable, Dict, List, Optional
+
+from gateway.records import Record
+
+WINDOW_S = 128 / 50.0      # firmware window length
+
+
+@dataclass(slots=True)
+class Alert:
+    rule: str
+    device: str
+    t_dev: float
+    detail: dict
+    latency_ms: float = 0.0
+
+
+def dominant_band(d: dict) -> int:
+    b1, b2, b3 = d.get("b1", 0), d.get("b2", 0), d.get("b3", 0)
+    return 1 if b1 >= b2 and b1 >= b3 else 2 if b2 >= b3 else 3
+
+
+# ──────────────────────────────────────────────
+# Rules
+# ──────────────────────────────────────────────
+
+class Rule:
+    """A record-driven rule. new_state() gives the per-device state."""
+    name = "rule"
+
+    def new_state(self):
+        return None
+
+    def update(self, st, rec: Record) -> Optional[dict]:
+        raise NotImplementedError
+
+
+class _Run:
+    __slots__ = ("start", "fired")
+
+    def __init__(self):
+        self.start = None
+        self.fired = False
+
+
+class ScoreAbove(Rule):
+    """Score above `threshold` for at least `hold_s` of device time."""
+
+    def __init__(self, threshold: float = 7.0, hold_s: float = 60.0):
+        self.threshold, self.hold_s = threshold, hold_s
+        self.name = f"score>{threshold:g}/{hold_s:g}s"
+
+    def new_state(self):
+        return _Run()
+
+    def update(self, st: _Run, rec: Record) -> Optional[dict]:
+        if rec.kind != "bands":        # gated windows neither extend nor break a run
+            return None
+        if rec.data.get("score", 0) <= self.threshold:
+            st.start, st.fired = None, False
+            return None
+        if st.start is None:
+            st.start = rec.t_dev - WINDOW_S
+        if not st.fired and rec.t_dev - st.start >= self.hold_s:
+            st.fired = True
+            return {"score": rec.data.get("score"), "since": st.start}
+        return None
+
+
+class _Band:
+    __slots__ = ("band", "cand", "count")
+
+    def __init__(self):
+        self.band = 0
+        self.cand = 0
+        self.count = 0
+
+
+class BandSwitch(Rule):
+    """Dominant band moved and stayed for `hold` consecutive windows."""
+
+    def __init__(self, hold: int = 2):
+        self.hold = hold
+        self.name = "band-switch"
+
+    def new_state(self):
+        return _Band()
+
+    def update(self, st: _Band, rec: Record) -> Optional[dict]:
+        if rec.kind != "bands":
+            return None
+        b = dominant_band(rec.data)
+        if st.band == 0:
+            st.band = b
+            return None
+        if b == st.band:
+            st.cand, st.count = 0, 0
+            return None
+        if b != st.cand:
+            st.cand, st.count = b, 0
+        st.count += 1
+        if st.count >= self.hold:
+            old, st.band, st.cand, st.count = st.band, b, 0, 0
+            return {"from": old, "to": b}
+        return None
+
+
+class Silence:
+    """No record from a device for `timeout_s` (gateway clock)."""
+
+    def __init__(self, timeout_s: float = 10.0):
+        self.timeout_s = timeout_s
+        self.name = f"silent>{timeout_s:g}s"
+
+
+# ──────────────────────────────────────────────
+# Engine
+# ──────────────────────────────────────────────
+
+class LatencyHistogram:
+    """Fixed log2 buckets in microseconds; O(1) insert, no growth."""
+
+    def __init__(self, buckets: int = 32):
+        self.counts = [0] * buckets
+        self.n = 0
+        self.max_us = 0.0
+
+    def add(self, ms: float) -> None:
+        us = ms * 1000.0
+        self.counts[min(len(self.counts) - 1, max(0, int(us).bit_length()))] += 1
+        self.n += 1
+        if us > self.max_us:
+            self.max_us = us
+
+    def quantile(self, q: float) -> float:
+        """
+        Upper edge of the bucket holding quantile q, in ms, clamped to the
+        largest latency seen: the top occupied bucket's edge can be up to
+        twice that. The last bucket is open-ended, so its edge is the max.
+        """
+        if not self.n:
+            return 0.0
+        k, acc = q * self.n, 0
+        last = len(self.counts) - 1
+        for i, c in enumerate(self.counts):
+            acc += c
+            if acc >= k:
+                return (min(1 << i, self.max_us) if i < last else self.max_us) / 1000.0
+        return self.max_us / 1000.0
+
+
+class AlertEngine:
+    def __init__(self, rules: Optional[List[Rule]] = None, silence: Optional[Silence] = None,
+                 on_alert: Optional[Callable[[Alert], None]] = None):
+        self.rules = rules if rules is not None else [ScoreAbove(), BandSwitch()]
+        self.silence = silence if silence is not None else Silence()
+        self.on_alert = on_alert
+        self._state: Dict[str, list] = {}
+        self._seen: "OrderedDict[str, float]" = OrderedDict()
+        self._silent: set = set()
+        self.records = 0
+        self.alerts = 0
+        self.latency = LatencyHistogram()
+
+    def _emit(self, a: Alert, t_arr: float) -> None:
+        a.latency_ms = (time.monotonic() - t_arr) * 1000.0
+        self.latency.add(a.latency_ms)
+        self.alerts += 1
+        if self.on_alert:
+            self.on_alert(a)
+
+    def __call__(self, rec: Record) -> None:
+        self.process(rec)
+
+    def process(self, rec: Record) -> None:
+        self.records += 1
+        dev = rec.device
+        st = self._state.get(dev)
+        if st is None:
+            st = self._state[dev] = [r.new_state() for r in self.rules]
+        seen = self._seen
+        if dev in seen:
+            seen.move_to_end(dev)
+        seen[dev] = rec.t_arr
+        self._silent.discard(dev)
+        for rule, s in zip(self.rules, st):
+            d = rule.update(s, rec)
+            if d is not None:
+                self._emit(Alert(rule.name, dev, rec.t_dev, d), rec.t_arr)
+
+    def sweep(self, now: Optional[float] = None) -> None:
+        """Fires Silence for devices quiet longer than the timeout."""
+        now = time.monotonic() if now is None else now
+        limit = now - self.silence.timeout_s
+        seen = self._seen
+        while seen:
+            dev, last = next(iter(seen.items()))
+            if last > limit:
+                break
+            seen.popitem(last=False)
+            if dev not in self._silent:
+                self._silent.add(dev)
+                a = Alert(self.silence.name, dev, last, {"last_seen_s_ago": round(now - last, 3)})
+                # latency of a silence alert: how late past the deadline it fired
+                self._emit(a, last + self.silence.timeout_s)
+
+    def stats(self) -> dict:
+        return {
+            "devices": len(self._state), "records": self.records, "alerts": self.alerts,
+            "latency_ms_p50": self.latency.quantile(0.5),
+            "latency_ms_p99": self.latency.quantile(0.99),
+            "latency_ms_max": round(self.latency.max_us / 1000.0, 3),
+        }
@@ -0,0 +1,292 @@
+"""
+Multi-device stream alignment for dual-hand and multi-sensor studies.
+
+A group is a named set of devices. Records from its members are merged
+into one stream ordered by event time, and cut into aligned windows that
+carry cross-device features. A device belongs to at most one group.
+
+Event time. Device clocks start at boot, so a record's event time is
+t_dev + offset, where offset maps that device's clock onto the gateway's
+monotonic clock. The offset is the smallest t_arr - t_dev seen, which is
+the least-delayed record. It may creep up by DRIFT s/s so that a slow
+device clock cannot pin it.
+
+Watermarks. A stream's watermark is its newest event time minus
+max_delay. The group watermark is the minimum over members heard from in
+the last `idle` seconds, so one device that drops out does not stall the
+group. Records at or below the group watermark are released in order, and
+a window is emitted once the watermark passes its end.
+
+Late records have an event time already behind the watermark. The `late`
+policy decides what happens to them:
+    drop     count it and move on
+    side     hand it to on_late(record, event_time) and move on
+    revise   fold it into its window and emit that window again with
+             revision+1, if the window is still within `keep` windows;
+             otherwise drop it
+
+Memory is constant per stream. Each member has `cap` slots of reorder
+buffer, and past that its oldest record is released early and counted
+as forced. Each group keeps a ring of ceil(max_delay/window)+keep+2
+window slots.
+"""
+
+import heapq
+import math
+from typing import Callable, Dict, List, Optional
+
+from gateway.alerts import WINDOW_S, dominant_band
+from gateway.records import Record
+
+DRIFT = 1e-4                 # s/s an offset may rise (crystal drift, 100 ppm)
+POLICIES = ("drop", "side", "revise")
+
+
+class _Member:
+    __slots__ = ("device", "offset", "last_arr", "max_ev", "queued")
+
+    def __init__(self, device: str):
+        self.device = device
+        self.offset = None
+        self.last_arr = 0.0
+        self.max_ev = -math.inf
+        self.queued = 0
+
+
+class _Slot:
+    """One device's aggregate in one window."""
+    __slots__ = ("n", "score", "b1", "b2", "b3", "gated", "type")
+
+    def __init__(self):
+        self.n = self.gated = 0
+        self.score = self.b1 = self.b2 = self.b3 = 0.0
+        self.type = None
+
+    def add(self, rec: Record) -> None:
+        d = rec.data
+        if rec.kind == "gated":
+            self.gated += 1
+            return
+        self.n += 1
+        self.score += d.get("score", 0.0)
+        self.b1 += d.get("b1", 0.0)
+        self.b2 += d.get("b2", 0.0)
+        self.b3 += d.get("b3", 0.0)
+        self.type = d.get("type")
+
+    def out(self) -> Optional[dict]:
+        if not self.n and not self.gated:
+            return None
+        n = max(self.n, 1)
+        r = {"n": self.n, "gated": self.gated}
+        if self.n:
+            r.update(score=round(self.score / n, 4), b1=self.b1 / n, b2=self.b2 / n,
+                     b3=self.b3 / n, type=self.type)
+        return r
+
+
+class _Window:
+    __slots__ = ("k", "slots", "emitted", "revision")
+
+    def __init__(self, members: List[str]):
+        self.k = None
+        self.slots = {m: _Slot() for m in members}
+        self.emitted = False
+        self.revision = 0
+
+    def reset(self, k: int) -> None:
+        self.k = k
+        for s in self.slots.values():
+            s.__init__()
+        self.emitted = False
+        self.revision = 0
+
+
+class _Group:
+    def __init__(self, name: str, members: List[str], ring: int):
+        self.name = name
+        self.members = {m: _Member(m) for m in members}
+        self.heap: list = []
+        self.seq = 0
+        self.watermark = -math.inf
+        self.ring = [_Window(members) for _ in range(ring)]
+        self.next_k = None            # next window to emit
+
+
+class Aligner:
+    def __init__(self, groups: Dict[str, List[str]], window: float = WINDOW_S,
+                 max_delay: float = 5.0, idle: float = 10.0, late: str = "drop",
+                 keep: int = 4, cap: int = 64, kinds=("bands", "gated"),
+                 on_record: Optional[Callable[[str, float, Record], None]] = None,
+                 on_window: Optional[Callable[[dict], None]] = None,
+                 on_late: Optional[Callable[[Record, float], None]] = None):
+        if late not in POLICIES:
+            raise ValueError(f"late policy must be one of {POLICIES}")
+        self.window = window
+        self.max_delay = max_delay
+        self.idle = idle
+        self.late = late
+        self.keep = keep
+        self.cap = cap
+        self.kinds = set(kinds)
+        self.on_record = on_record
+        self.on_window = on_window
+        self.on_late = on_late
+        ring = math.ceil(max_delay / window) + keep + 2
+        self.groups = {g: _Group(g, ms, ring) for g, ms in groups.items()}
+        self.of: Dict[str, _Group] = {}
+        for g in self.groups.values():
+            for m in g.members:
+                if m in self.of:
+                    raise ValueError(f"device {m} is in groups {self.of[m].name} and {g.name}")
+                self.of[m] = g
+        self.records = self.released = self.late_n = self.forced = 0
+        self.windows = self.revisions = 0
+
+    # ──────────────────────────────────────────────
+    # Ingest
+    # ──────────────────────────────────────────────
+
+    def __call__(self, rec: Record) -> None:
+        self.process(rec)
+
+    def process(self, rec: Record) -> None:
+        g = self.of.get(rec.device)
+        if g is None or rec.kind not in self.kinds:
+            return
+        self.records += 1
+        m = g.members[rec.device]
+        off = rec.t_arr - rec.t_dev
+        if m.offset is None or off < m.offset:
+            m.offset = off
+        else:
+            m.offset = min(m.offset + DRIFT * (rec.t_arr - m.last_arr), off)
+        m.last_arr = rec.t_arr
+        ev = rec.t_dev + m.offset
+        if ev <= g.watermark:
+            self._late(g, rec, ev)
+            return
+        if ev > m.max_ev:
+            m.max_ev = ev
+        heapq.heappush(g.heap, (ev, g.seq, rec))
+        g.seq += 1
+        m.queued += 1
+        if m.queued > self.cap:
+            self._force(g, m)
+        self._advance(g, rec.t_arr)
+
+    def sweep(self, now: float) -> None:
+        """Lets groups move on past members that went idle."""
+        for g in self.groups.values():
+            self._advance(g, now)
+
+    def flush(self) -> None:
+        """Releases everything (end of a session or replay)."""
+        for g in self.groups.values():
+            self._release(g, math.inf)
+            for w in sorted((w for w in g.ring if w.k is not None and not w.emitted),
+                            key=lambda w: w.k):
+                self._emit_window(g, w)
+                g.next_k = w.k + 1
+            # later records are judged against what was actually seen
+            g.watermark = max(m.max_ev for m in g.members.values())
+
+    # ──────────────────────────────────────────────
+    # Watermark
+    # ──────────────────────────────────────────────
+
+    def _advance(self, g: _Group, now: float) -> None:
+        wm = math.inf
+        for m in g.members.values():
+            if m.offset is not None and now - m.last_arr <= self.idle:
+                wm = min(wm, m.max_ev - self.max_delay)
+        if wm == math.inf or wm <= g.watermark:
+            return
+        self._release(g, wm)
+
+    def _release(self, g: _Group, wm: float) -> None:
+        g.watermark = wm
+        while g.heap and g.heap[0][0] <= wm:
+            self._emit_record(g, *heapq.heappop(g.heap))
+        if g.next_k is None or wm == math.inf:
+            return
+        last = math.floor(wm / self.window)       # windows below this have closed
+        g.next_k = max(g.next_k, last - len(g.ring))
+        while g.next_k < last:
+            w = g.ring[g.next_k % len(g.ring)]
+            if w.k == g.next_k and not w.emitted:
+                self._emit_window(g, w)
+            g.next_k += 1
+
+    def _force(self, g: _Group, m: _Member) -> None:
+        """Cap hit: release the group up to this member's oldest record."""
+        oldest = min(ev for ev, _, rec in g.heap if rec.device == m.device)
+        self.forced += 1
+        self._release(g, max(g.watermark, oldest))
+
+    # ──────────────────────────────────────────────
+    # Output
+    # ──────────────────────────────────────────────
+
+    def _emit_record(self, g: _Group, ev: float, _seq: int, rec: Record) -> None:
+        g.members[rec.device].queued -= 1
+        self.released += 1
+        k = math.floor(ev / self.window)
+        if g.next_k is None:
+            g.next_k = k
+        w = g.ring[k % len(g.ring)]
+        if w.k != k:
+            if w.k is not None and not w.emitted:
+                self._emit_window(g, w)
+            w.reset(k)
+        w.slots[rec.device].add(rec)
+        if self.on_record is not None:
+            self.on_record(g.name, ev, rec)
+
+    def _emit_window(self, g: _Group, w: _Window) -> None:
+        devs = {d: s.out() for d, s in w.slots.items()}
+        present = [v for v in devs.values() if v and v["n"]]
+        feats = {"present": sum(1 for v in devs.values() if v)}
+        if len(present) >= 2:
+            sc = [v["score"] for v in present]
+            bands = {dominant_band(v) for v in present}
+            feats.update(score_spread=round(max(sc) - min(sc), 4), band_agree=len(bands) == 1)
+        out = {"group": g.name, "t0": round(w.k * self.window, 3),
+               "t1": round((w.k + 1) * self.window, 3), "devices": devs, "features": feats}
+        if w.emitted:
+            w.revision += 1
+            out["revision"] = w.revision
+            self.revisions += 1
+        else:
+            self.windows += 1
+        w.emitted = True
+        if self.on_window is not None:
+            self.on_window(out)
+
+    def _late(self, g: _Group, rec: Record, ev: float) -> None:
+        self.late_n += 1
+        if self.late == "side":
+            if self.on_late is not None:
+                self.on_late(rec, ev)
+        elif self.late == "revise":
+            k = math.floor(ev / self.window)
+            w = g.ring[k % len(g.ring)]
+            if w.k == k and g.next_k is not None and g.next_k - k <= self.keep:
+                w.slots[rec.device].add(rec)
+                if w.emitted:
+                    self._emit_window(g, w)
+
+    def stats(self) -> dict:
+        return {"groups": len(self.groups), "records": self.records, "released": self.released,
+                "late": self.late_n, "forced": self.forced, "windows": self.windows,
+                "revisions": self.revisions,
+                "queued": sum(len(g.heap) for g in self.groups.values())}
+
+
+def parse_groups(spec: str) -> Dict[str, List[str]]:
+    """"study=left+right,bed4=a+b+c" -> {"study": ["left", "right"], ...}"""
+    out = {}
+    for part in filter(None, spec.split(",")):
+        name, _, devs = part.partition("=")
+        out[name.strip()] = [d.strip() for d in devs.split("+") if d.strip()]
+    return out
@@ -0,0 +1,260 @@
+"""
+Store-and-forward backfill: pulls the window log a device keeps in flash
+(firmware include/winlog.h) so windows from offline periods reach the
+server without anyone downloading files.
+
+Protocol, over the device's own HTTP server:
+    GET /log/marks              {"epoch", "lo", "hi", "rec", "segRecs", "max", "queued", "errors"}
+    GET /log/range?from=S&n=N   up to N 32-byte records starting at seq S
+
+Per device and log epoch the output is <root>/<device>/log-<epoch>.jsonl,
+one line per window carrying its seq. That file is the cursor. On every
+sync the last complete line gives the next seq to ask for, and a torn last
+line is cut off. An interrupted transfer therefore resumes where it
+stopped and never writes a record twice. Records the device overwrote
+before they were fetched become one {"seq": lo-1, "gap": [from, lo-1]}
+line, so the loss is visible.
+
+Throttling: one request in flight per device, at most `rate` records/s per
+device, and `parallel` devices at a time. The device serves each reply
+from its web server task in small pieces, so its sampling loop never waits
+on a transfer.
+
+As a gateway tap it syncs each device when it connects and every `every`
+seconds while it stays connected.
+"""
+
+import argparse
+import asyncio
+import json
+import os
+import struct
+import time
+from typing import Dict, List, Optional, Tuple
+
+REC = struct.Struct("<IIfffffBBH")      # LogRecord
+TYPES = ("No Tremor", "Parkinsonian", "Essential", "Physiological", "Mixed/Weak",
+         "Voluntary Movement")
+LOG_GATED = 1
+
+
+def _f(x: float) -> float:
+    return float(f"{x:.6g}")
+
+
+def decode(buf: bytes) -> List[dict]:
+    out = []
+    for seq, ms, p1, p2, p3, score, conf, typ, flags, mean_mg in REC.iter_unpack(
+            buf[:len(buf) - len(buf) % REC.size]):
+        out.append({"seq": seq, "ms": ms, "p1": _f(p1), "p2": _f(p2), "p3": _f(p3),
+                    "score": _f(score), "conf": _f(conf),
+                    "type": TYPES[typ] if typ < len(TYPES) else "No Tremor",
+                    "gated": bool(flags & LOG_GATED), "meanNorm": mean_mg / 1000.0})
+    return out
+
+
+# ──────────────────────────────────────────────
+# Cursor file
+# ──────────────────────────────────────────────
+
+def resume_point(path: str) -> Optional[int]:
+    """Next seq after the last complete line; cuts a torn tail. None if empty."""
+    try:
+        f = open(path, "r+b")
+    except FileNotFoundError:
+        return None
+    with f:
+        size = f.seek(0, os.SEEK_END)
+        tail = b""
+        pos = size
+        while pos > 0 and tail.count(b"\n") < 2:
+            step = min(4096, pos)
+            pos -= step
+            f.seek(pos)
+            tail = f.read(step) + tail
+        if not tail.endswith(b"\n"):
+            cut = tail.rfind(b"\n") + 1
+            f.truncate(pos + cut)
+            tail = tail[:cut]
+        lines = tail.splitlines()
+        if not lines:
+            return None
+        return int(json.loads(lines[-1])["seq"]) + 1
+
+
+def append_lines(path: str, rows: List[dict]) -> None:
+    os.makedirs(os.path.dirname(path), exist_ok=True)
+    with open(path, "ab") as f:
+        f.write(b"".join(json.dumps(r, separators=(",", ":")).encode() + b"\n" for r in rows))
+        f.flush()
+        os.fsync(f.fileno())
+
+
+# ──────────────────────────────────────────────
+# Device HTTP
+# ──────────────────────────────────────────────
+
+async def http_get(host: str, port: int, path: str,
+                   timeout: float = 10.0) -> Tuple[int, Dict[str, str], bytes]:
+    r, w = await asyncio.wait_for(asyncio.open_connection(host, port), timeout)
+    try:
+        w.write(f"GET {path} HTTP/1.0\r\nHost: {host}\r\nConnection: close\r\n\r\n".encode())
+        head = await asyncio.wait_for(r.readuntil(b"\r\n\r\n"), timeout)
+        lines = head.decode("latin-1").split("\r\n")
+        status = int(lines[0].split()[1])
+        hdr = {}
+        for ln in lines[1:]:
+            k, _, v = ln.partition(":")
+            if k:
+                hdr[k.strip().lower()] = v.strip()
+        n = int(hdr.get("content-length", -1))
+        try:
+            body = await asyncio.wait_for(r.readexactly(n) if n >= 0 else r.read(), timeout)
+        except asyncio.IncompleteReadError as e:
+            body = e.partial             # caller keeps the whole records in it
+            hdr["x-partial"] = "1"
+        return status, hdr, body
+    finally:
+        w.close()
+
+
+class SyncError(Exception):
+    pass
+
+
+class Backfill:
+    def __init__(self, root: str, port: int = 80, rate: float = 100.0, batch: int = 256,
+                 parallel: int = 4, every: float = 300.0, timeout: float = 10.0):
+        self.root = root
+        self.port = port
+        self.rate = rate
+        self.batch = batch
+        self.every = every
+        self.timeout = timeout
+        self._sem = asyncio.Semaphore(parallel)
+        self._active = set()
+        self._tasks = set()
+        self._connected: Dict[str, Tuple[str, int]] = {}
+        self._last: Dict[str, float] = {}
+        self.records = 0
+        self.gaps = 0
+        self.syncs = 0
+        self.errors = 0
+
+    async def _marks(self, host: str, port: int) -> dict:
+        st, _, body = await http_get(host, port, "/log/marks", self.timeout)
+        if st != 200:
+            raise SyncError(f"/log/marks: HTTP {st}")
+        return json.loads(body)
+
+    async def sync(self, device: str, host: str, port: Optional[int] = None) -> dict:
+        """Fetches everything the device holds past our cursor."""
+        port = port or self.port
+        got = gaps = 0
+        async with self._sem:
+            m = await self._marks(host, port)
+            epoch = m["epoch"]
+            path = os.path.join(self.root, device.replace("/", "_"), f"log-{epoch}.jsonl")
+            nxt = await asyncio.to_thread(resume_point, path)
+            nxt = m["lo"] if nxt is None else nxt
+            hi = m["hi"]
+            batch = min(self.batch, m.get("max", self.batch))
+            while nxt < hi:
+                if nxt < m["lo"]:
+                    await asyncio.to_thread(append_lines, path, [{"seq": m["lo"] - 1,
+                                                                   "gap": [nxt, m["lo"] - 1]}])
+                    gaps += 1
+                    nxt = m["lo"]
+                    continue
+                st, hdr, body = await http_get(host, port,
+                                               f"/log/range?from={nxt}&n={min(batch, hi - nxt)}",
+                                               self.timeout)
+                if st == 200 and int(hdr.get("x-log-epoch", epoch)) != epoch:
+                    raise SyncError("device log was reformatted during the sync")
+                rows = decode(body) if st == 200 else []
+                keep = 0
+                while keep < len(rows) and rows[keep]["seq"] == nxt + keep:
+                    keep += 1
+                if not keep:
+                    # overwritten under us (416, or a torn reply): re-read marks
+                    m2 = await self._marks(host, port)
+                    if m2["epoch"] != epoch or m2["lo"] <= nxt:
+                        raise SyncError(f"/log/range from={nxt}: HTTP {st}, no usable records")
+                    m = m2
+                    continue
+                await asyncio.to_thread(append_lines, path, rows[:keep])
+                nxt += keep
+                got += keep
+                self.records += keep
+                if "x-partial" in hdr:
+                    raise SyncError(f"connection lost at seq {nxt}")
+                await asyncio.sleep(keep / self.rate)
+        self.gaps += gaps
+        self.syncs += 1
+        return {"device": device, "epoch": epoch, "records": got, "gaps": gaps, "next": nxt}
+
+    # ──────────────────────────────────────────────
+    # Gateway tap: sync on connect and periodically
+    # ──────────────────────────────────────────────
+
+    def _start(self, device: str) -> None:
+        if device in self._active or device not in self._connected:
+            return
+        self._active.add(device)
+        self._last[device] = time.monotonic()
+        host, port = self._connected[device]
+        t = asyncio.get_running_loop().create_task(self._run(device, host, port))
+        self._tasks.add(t)
+        t.add_done_callback(self._tasks.discard)
+
+    async def _run(self, device: str, host: str, port: int) -> None:
+        try:
+            await self.sync(device, host, port)
+        except (OSError, asyncio.TimeoutError, asyncio.IncompleteReadError,
+                ValueError, KeyError, SyncError):
+            self.errors += 1            # next sync resumes from the file
+        finally:
+            self._active.discard(device)
+
+    def open(self, device: str, peer=None) -> str:
+        if peer:
+            self._connected[device] = (peer[0], self.port)
+            self._start(device)
+        return device
+
+    def data(self, handle: str, chunk: bytes) -> None:
+        pass
+
+    def close(self, handle: str) -> None:
+        self._connected.pop(handle, None)
+
+    def sweep(self, now: float) -> None:
+        for d in list(self._connected):
+            if now - self._last.get(d, 0.0) >= self.every:
+                self._start(d)
+
+    def stats(self) -> dict:
+        return {"syncs": self.syncs, "records": self.records, "gaps": self.gaps,
+                "errors": self.errors, "active": len(self._active)}
+
+
+def main() -> None:
+    ap = argparse.ArgumentParser(description="One-shot backfill from a device's flash log")
+    ap.add_argument("device", help="device address, host[:port]")
+    ap.add_argument("--id", required=True, help="device id (output directory name)")
+    ap.add_argument("--root", default="backfill")
+    ap.add_argument("--rate", type=float, default=100.0, help="records/s")
+    a = ap.parse_args()
+    host, _, port = a.device.partition(":")
+
+    async def run():
+        return await Backfill(a.root, rate=a.rate).sync(a.id, host, int(port or 80))
+
+    try:
+        print(json.dumps(asyncio.run(run())))
+    except (OSError, asyncio.TimeoutError, SyncError) as e:
+        raise SystemExit(f"backfill interrupted ({e}); run again to resume")
+
+
+if __name__ == "__main__":
+    main()
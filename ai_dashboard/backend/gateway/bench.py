@@ -0,0 +1,420 @@
+"""
+Gateway benchmarks on one core, driven by the simulator.
+
+    python -m gateway.bench alerts --devices 5000 --windows 50
+        In-process: pre-encoded frames for every device are parsed and run
+        through the alert engine, interleaved by window as a ward would
+        deliver them. Reports records/s, the device count one core can
+        carry in real time, and alert latency.
+
+    python -m gateway.bench alerts-tcp --devices 2000 --speed 20
+        End to end over loopback TCP: gateway and simulator in one event
+        loop, so the figure is a lower bound for a dedicated gateway core.
+
+    python -m gateway.bench record --devices 300 --speed 10 --dir /tmp/rec
+        Session recording under raw-sample load: the simulator (--raw) runs
+        in a child process, the gateway records every byte and a ticker
+        measures event-loop lag. --inline swaps in a recorder that writes
+        from the loop, for comparison; --slow-disk MS adds that much latency
+        to every write call to stand in for a stalling disk.
+
+    python -m gateway.bench align --devices 2000 --windows 200 --late revise
+        Stream alignment in-process: devices in pairs with their own boot
+        clocks, network delay (exponential, plus rare multi-second stalls)
+        and reordering. Checks the merged stream is in event-time order per
+        group and reports late records, windows, and the largest reorder
+        buffer.
+
+    python -m gateway.bench shards --devices 10000 --shards 1,2,4 --sims 4
+        Ingest scaling: for each shard count, a sharded gateway (one process
+        per shard) takes --devices simulated connections from --sims
+        simulator processes. Run with speed high enough to saturate; on a
+        machine with fewer cores than shards + sims the figure cannot scale.
+
+    python -m gateway.bench replay --devices 500 --windows 20 --speed 100
+        Session replay: --windows-long raw sessions are written under --dir,
+        a replay server runs as a child process and --devices clients stream
+        them concurrently over loopback. Checks every client got its file
+        byte for byte and reports throughput, the server's CPU and its worst
+        schedule lag.
+
+    python -m gateway.bench fanout --devices 500 --subs 200 --speed 1
+        Downstream fan-out: --devices publish windows, and --subs WebSocket
+        subscribers in a child process follow the ward topic. It runs once
+        per channel: plain, shared permessage-deflate, shared /z stream,
+        and per-connection deflate (the usual server, for comparison).
+        Reports gateway CPU per subscriber, bytes saved, and whether every
+        subscriber decoded every line.
+"""
+
+import argparse
+import asyncio
+import heapq
+import json
+import os
+import random
+import resource
+import subprocess
+import shutil
+import sys
+import time
+import zlib
+
+from gateway.align import Aligner
+from gateway.fanout import Fanout, ws_frame, ws_size
+from gateway.alerts import AlertEngine, Silence
+from gateway.recorder import Recorder
+from gateway.records import Record, SseParser, encode_frame, to_record
+from gateway.server import Gateway
+from gateway.shard import ShardedGateway, alert_setup
+from gateway.simulator import WINDOW_S, SimDevice, run as sim_run
+
+
+def bench_alerts(devices: int, windows: int) -> dict:
+    devs = [SimDevice(f"d{i:05d}", seed=i) for i in range(devices)]
+    streams = [d.frames(windows) for d in devs]
+    parsers = [SseParser() for _ in devs]
+    engine = AlertEngine(silence=Silence(3600))
+    t0 = time.perf_counter()
+    for w in range(windows):
+        for i in range(devices):
+            now = time.monotonic()
+            for event, data in parsers[i].feed(streams[i][w]):
+                rec = to_record(devs[i].id, event, data, now)
+                if rec is not None:
+                    engine.process(rec)
+        engine.sweep()
+    dt = time.perf_counter() - t0
+    rps = engine.records / dt
+    return {"devices": devices, "records": engine.records, "seconds": round(dt, 3),
+            "records_per_s": round(rps), "realtime_devices_per_core": int(rps * WINDOW_S),
+            "us_per_record": round(dt / engine.records * 1e6, 2), **engine.stats()}
+
+
+def bench_align(devices: int, windows: int, late: str, max_delay: float = 5.0) -> dict:
+    rng = random.Random(1)
+    devs = [SimDevice(f"d{i:05d}", seed=i) for i in range(devices - devices % 2)]
+    groups = {f"g{i // 2}": [devs[i].id, devs[i + 1].id] for i in range(0, len(devs), 2)}
+    last_ev: dict = {}
+    order_errors = [0]
+    out = {"windows": 0, "both": 0}
+
+    def on_record(g, ev, rec):
+        if ev < last_ev.get(g, -1e18):
+            order_errors[0] += 1
+        last_ev[g] = ev
+
+    def on_window(w):
+        out["windows"] += 1
+        out["both"] += w["features"]["present"] == 2
+
+    al = Aligner(groups, max_delay=max_delay, late=late, on_record=on_record, on_window=on_window)
+    # arrivals: boot offset + device time + delay; a few long stalls
+    arrivals = []
+    for d in devs:
+        boot = rng.uniform(0, 30)
+        for _ in range(windows):
+            kind, data = d.next_window()
+            delay = rng.expovariate(1 / 0.2) + (rng.uniform(4, 12) if rng.random() < 0.01 else 0)
+            arrivals.append((boot + d.t + delay, d.id, kind, data))
+    heapq.heapify(arrivals)
+    recs = []
+    while arrivals:
+        t_arr, dev, kind, data = heapq.heappop(arrivals)
+        recs.append(Record(dev, kind, data, float(data["t"]), t_arr))
+    max_q = 0
+    t0 = time.perf_counter()
+    for i, r in enumerate(recs):
+        al.process(r)
+        if i % 1000 == 0:
+            al.sweep(r.t_arr)
+            max_q = max(max_q, max(len(g.heap) for g in al.groups.values()))
+    al.flush()
+    dt = time.perf_counter() - t0
+    return {"devices": len(devs), "groups": len(groups), "records": len(recs),
+            "records_per_s": round(len(recs) / dt), "order_errors": order_errors[0],
+            "max_group_queue": max_q, "both_present": round(out["both"] / max(out["windows"], 1), 3),
+            **al.stats()}
+
+
+async def _bench_tcp(devices: int, speed: float, windows: int, port: int) -> dict:
+    gw = Gateway()
+    engine = AlertEngine(silence=Silence(3600))
+    gw.add_sink(engine, engine.sweep)
+    server = asyncio.create_task(gw.serve("127.0.0.1", port))
+    await asyncio.sleep(0.2)
+    sim = await sim_run("127.0.0.1", port, devices, speed, windows)
+    await asyncio.sleep(0.5)
+    server.cancel()
+    return {"sim": sim, "gateway_records": gw.records, **engine.stats()}
+
+
+class _InlineRecorder:
+    """Baseline for the record bench: os.write() straight from the loop."""
+
+    def __init__(self, root: str, stall: float = 0.0):
+        self.root, self.fds, self.bytes_written, self.stall = root, {}, 0, stall
+
+    def open(self, device: str, peer=None) -> int:
+        d = os.path.join(self.root, device)
+        os.makedirs(d, exist_ok=True)
+        fd = os.open(os.path.join(d, "inline.sse"), os.O_WRONLY | os.O_CREAT | os.O_APPEND, 0o644)
+        self.fds[fd] = True
+        return fd
+
+    def data(self, fd: int, chunk: bytes) -> None:
+        if self.stall:
+            time.sleep(self.stall)
+        self.bytes_written += os.write(fd, chunk)
+
+    def close(self, fd: int) -> None:
+        self.fds.pop(fd, None)
+        os.close(fd)
+
+    def stop(self) -> None:
+        pass
+
+    def stats(self) -> dict:
+        return {"bytes_written": self.bytes_written, "bytes_dropped": 0}
+
+
+class _SlowRecorder(Recorder):
+    def __init__(self, root: str, stall: float):
+        self.stall = stall
+        super().__init__(root)
+
+    def _write(self, fd, bufs):
+        time.sleep(self.stall)
+        super()._write(fd, bufs)
+
+
+async def _bench_record(devices: int, speed: float, windows: int, port: int,
+                        root: str, inline: bool, stall_ms: float) -> dict:
+    shutil.rmtree(root, ignore_errors=True)
+    os.makedirs(root)
+    gw = Gateway(sweep_s=0.25)
+    stall = stall_ms / 1e3
+    rec = _InlineRecorder(root, stall) if inline else _SlowRecorder(root, stall) if stall else Recorder(root)
+    gw.add_tap(rec, None if inline else rec.sweep)
+    lag = {"max": 0.0, "sum": 0.0, "n": 0}
+
+    async def ticker(period=0.005):
+        while True:
+            t = time.perf_counter()
+            await asyncio.sleep(period)
+            late = time.perf_counter() - t - period
+            lag["max"] = max(lag["max"], late)
+            lag["sum"] += late
+            lag["n"] += 1
+
+    server = asyncio.create_task(gw.serve("127.0.0.1", port))
+    tick = asyncio.create_task(ticker())
+    await asyncio.sleep(0.2)
+    t0 = time.perf_counter()
+    sim = await asyncio.create_subprocess_exec(
+        sys.executable, "-m", "gateway.simulator", "--gateway", f"127.0.0.1:{port}",
+        "--devices", str(devices), "--speed", str(speed), "--windows", str(windows), "--raw",
+        stdout=asyncio.subprocess.PIPE)
+    out, _ = await sim.communicate()
+    await asyncio.sleep(0.5)
+    tick.cancel()
+    server.cancel()
+    rec.stop()
+    dt = time.perf_counter() - t0
+    st = rec.stats()
+    return {"sim": json.loads(out), "recorder": "inline" if inline else "threaded",
+            "gateway_bytes": gw.bytes_in, "MB_per_s": round(gw.bytes_in / dt / 1e6, 2),
+            "loop_lag_ms_max": round(lag["max"] * 1e3, 2),
+            "loop_lag_ms_mean": round(lag["sum"] / max(lag["n"], 1) * 1e3, 3), **st}
+
+
+def bench_shards(devices: int, speed: float, windows: int, port: int,
+                 shard_counts, sims: int) -> list:
+    rows = []
+    for n in shard_counts:
+        sg = ShardedGateway(n, alert_setup(silence=3600), stats_s=0.5)
+        sg.start("127.0.0.1", port)
+        time.sleep(0.5)
+        per = devices // sims
+        t0 = time.perf_counter()
+        procs = [subprocess.Popen(
+            [sys.executable, "-m", "gateway.simulator", "--gateway", f"127.0.0.1:{port}",
+             "--devices", str(per), "--speed", str(speed), "--windows", str(windows),
+             "--prefix", f"s{k}"], stdout=subprocess.PIPE) for k in range(sims)]
+        while any(p.poll() is None for p in procs):
+            sg.poll(0.2)
+        sim = [json.loads(p.stdout.read()) for p in procs]
+        frames = sum(x["frames"] for x in sim)
+        # the gateway may still be draining socket buffers: wait for it
+        seen, dt, idle = -1, time.perf_counter() - t0, time.perf_counter()
+        while sg.totals()["records"] < frames and time.perf_counter() - idle < 3.0:
+            sg.poll(0.2)
+            if sg.totals()["records"] != seen:
+                seen, dt, idle = sg.totals()["records"], time.perf_counter() - t0, time.perf_counter()
+        sg.stop()
+        tot = sg.totals()
+        recs = [sg.last[i]["records"] for i in sorted(sg.last)]
+        rows.append({"shards": n, "cpus": os.cpu_count(), "devices": per * sims, "seconds": round(dt, 2),
+                     "nominal_s": round(windows * WINDOW_S / speed, 2),
+                     "sim_frames": frames, "sim_errors": sum(x["errors"] for x in sim), "records": tot["records"],
+                     "records_per_s": round(tot["records"] / dt), "per_shard": recs,
+                     "handoffs": tot["handoffs_in"], "handoff_failed": tot["handoff_failed"]})
+    base = rows[0]["records_per_s"] / rows[0]["shards"]
+    for r in rows:
+        r["scaling"] = round(r["records_per_s"] / base / r["shards"], 2)
+    return rows
+
+
+def bench_replay(clients: int, windows: int, speed: float, port: int, root: str) -> dict:
+    shutil.rmtree(root, ignore_errors=True)
+    files = {}
+    for k in range(min(clients, 20)):
+        d = SimDevice(f"rp{k:02d}", seed=k)
+        buf = b"".join(d.samples() + encode_frame(*d.next_window()) for _ in range(windows))
+        os.makedirs(os.path.join(root, d.id))
+        with open(os.path.join(root, d.id, "0.sse"), "wb") as f:
+            f.write(buf)
+        files[f"{d.id}/0"] = buf
+    ids = sorted(files)
+    srv = subprocess.Popen([sys.executable, "-m", "gateway.replay", "--root", root,
+                            "--host", "127.0.0.1", "--port", str(port)], stdout=subprocess.PIPE)
+    srv.stdout.readline()
+
+    async def get(path: str) -> bytes:
+        r, w = await asyncio.open_connection("127.0.0.1", port)
+        w.write(f"GET {path} HTTP/1.1\r\nHost: x\r\n\r\n".encode())
+        await r.readuntil(b"\r\n\r\n")
+        body = await r.read()
+        w.close()
+        return body
+
+    async def drive():
+        t0 = time.perf_counter()
+        bodies = await asyncio.gather(*(get(f"/s/{ids[k % len(ids)]}/events?speed={speed}")
+                                        for k in range(clients)))
+        dt = time.perf_counter() - t0
+        return bodies, dt, json.loads(await get("/stats"))
+
+    bodies, dt, st = asyncio.run(drive())
+    srv.terminate()
+    srv.wait()
+    cpu = resource.getrusage(resource.RUSAGE_CHILDREN)
+    mismatched = sum(b != files[ids[k % len(ids)]] for k, b in enumerate(bodies))
+    total = sum(len(b) for b in bodies)
+    return {"clients": clients, "speed": speed, "seconds": round(dt, 2),
+            "nominal_s": round(windows * WINDOW_S / speed, 2), "mismatched": mismatched,
+            "frames_per_s": round(st["frames"] / dt), "MB_per_s": round(total / dt / 1e6, 2),
+            "server_cpu_s": round(cpu.ru_utime + cpu.ru_stime, 2),
+            "max_lag_ms": st["max_lag_ms"]}
+
+
+class _PerConnFanout(Fanout):
+    """Baseline: a deflate context per subscriber, as per-connection servers do."""
+
+    def __init__(self):
+        super().__init__()
+        self.ctx = {}
+
+    def _frame(self, t):
+        raw = b"".join(t.pending)
+        t.pending.clear()
+        self.frames += 1
+        self.raw_bytes += len(raw)
+        for s in list(t.ws):
+            c0 = time.process_time()
+            c = self.ctx.get(s) or self.ctx.setdefault(s, zlib.compressobj(6, zlib.DEFLATED, -15))
+            body = c.compress(raw) + c.flush(zlib.Z_SYNC_FLUSH)
+            self.deflate_s += time.process_time() - c0
+            self._send(t, s, ws_frame(body[:-4], rsv1=True), ws_size(len(raw)))
+
+
+def bench_fanout(devices: int, subs: int, speed: float, seconds: float, port: int) -> list:
+    rows = []
+    for mode in ("plain", "ws-deflate", "z", "per-conn"):
+        fo = _PerConnFanout() if mode == "per-conn" else Fanout()
+        path = "/z/ward" if mode == "z" else "/ws/ward"
+        cmd = [sys.executable, "-m", "gateway.fanout", f"127.0.0.1:{port}{path}",
+               "--conns", str(subs), "--seconds", str(seconds + 4)]
+        # the baseline keeps context across messages, which the client's
+        # no-context-takeover inflater can't follow: count its bytes only
+        if mode == "plain":
+            cmd.append("--plain")
+        if mode == "per-conn":
+            cmd.append("--no-decode")
+
+        async def run():
+            server = asyncio.create_task(fo.serve("127.0.0.1", port))
+            await asyncio.sleep(0.3)
+            child = await asyncio.create_subprocess_exec(*cmd, stdout=asyncio.subprocess.PIPE)
+            while fo.stats()["subscribers"] < subs:
+                await asyncio.sleep(0.05)
+            devs = [SimDevice(f"f{i:05d}", seed=i) for i in range(devices)]
+            period = WINDOW_S / speed
+            lines = 0
+            cpu0, t0 = time.process_time(), time.perf_counter()
+            while time.perf_counter() - t0 < seconds:
+                # devices staggered over the period, topped up every 10 ms
+                due = int((time.perf_counter() - t0) * devices / period)
+                while lines < due:
+                    d = devs[lines % devices]
+                    kind, data = d.next_window()
+                    fo(Record(d.id, kind, data, data["t"]))
+                    lines += 1
+                await asyncio.sleep(0.01)
+            await asyncio.sleep(fo.tick * 2)
+            cpu = time.process_time() - cpu0
+            dt = time.perf_counter() - t0
+            out, _ = await child.communicate()
+            server.cancel()
+            return lines, cpu, dt, json.loads(out)
+
+        lines, cpu, dt, got = asyncio.run(run())
+        st = fo.stats()
+        rows.append({"mode": mode, "subs": subs, "lines": lines, "seconds": round(dt, 2),
+                     "frames": st["frames"], "server_cpu_pct": round(cpu / dt * 100, 1),
+                     "cpu_us_per_sub_frame": round(cpu / dt * 1e6 / subs / (st["frames"] / dt), 2),
+                     "deflate_ms": st["deflate_ms"], "wire_MB": round(st["wire_bytes"] / 1e6, 2),
+                     "saved": st["saved"], "dropped": st["dropped"] + st["resyncs"],
+                     "decoded_ok": None if mode == "per-conn" else got["lines"] == lines * subs})
+    return rows
+
+
+def main() -> None:
+    ap = argparse.ArgumentParser(description="Gateway benchmarks")
+    ap.add_argument("what", choices=["alerts", "alerts-tcp", "record", "shards", "align", "replay", "fanout"])
+    ap.add_argument("--devices", type=int, default=2000)
+    ap.add_argument("--windows", type=int, default=50)
+    ap.add_argument("--speed", type=float, default=20.0)
+    ap.add_argument("--port", type=int, default=8299)
+    ap.add_argument("--dir", default="/tmp/tremor-rec", help="record/replay: output root (wiped)")
+    ap.add_argument("--inline", action="store_true", help="record: write from the loop")
+    ap.add_argument("--slow-disk", type=float, default=0.0, help="record: ms added per write call")
+    ap.add_argument("--shards", default="1,2,4", help="shards: comma-separated shard counts")
+    ap.add_argument("--sims", type=int, default=4, help="shards: simulator processes")
+    ap.add_argument("--late", default="drop", help="align: drop|side|revise")
+    ap.add_argument("--subs", type=int, default=200, help="fanout: subscribers")
+    ap.add_argument("--seconds", type=float, default=10.0, help="fanout: publish for this long")
+    a = ap.parse_args()
+    # one fd per simulated device on each side of loopback
+    soft, hard = resource.getrlimit(resource.RLIMIT_NOFILE)
+    resource.setrlimit(resource.RLIMIT_NOFILE, (hard, hard))
+    if a.what == "alerts":
+        r = bench_alerts(a.devices, a.windows)
+    elif a.what == "record":
+        r = asyncio.run(_bench_record(a.devices, a.speed, a.windows, a.port, a.dir, a.inline, a.slow_disk))
+    elif a.what == "align":
+        r = bench_align(a.devices, a.windows, a.late)
+    elif a.what == "fanout":
+        r = bench_fanout(a.devices, a.subs, a.speed, a.seconds, a.port)
+    elif a.what == "replay":
+        r = bench_replay(a.devices, a.windows, a.speed, a.port, a.dir)
+    elif a.what == "shards":
+        r = bench_shards(a.devices, a.speed, a.windows, a.port,
+                         [int(x) for x in a.shards.split(",")], a.sims)
+    else:
+        r = asyncio.run(_bench_tcp(a.devices, a.speed, a.windows, a.port))
+    print(json.dumps(r, indent=1))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,409 @@
+"""
+Compressed downstream fan-out: dashboards subscribe to gateway topics
+over WebSocket, and every topic frame is compressed once no matter how
+many subscribers it has.
+
+Topics
+    dev/<device>   every record of one device (samples included)
+    ward           window records (bands, gated) of all devices
+    alerts         alerts from the engine
+Messages are JSON lines ({"device","event","t","data"}; alerts as
+AlertEngine emits them). Lines published to a topic within one tick
+(default 50 ms) make one topic frame.
+
+Channels, by path
+    /ws/<topic>   WebSocket text messages, one per topic frame. If the
+                  client offers permessage-deflate (RFC 7692), the reply
+                  is "permessage-deflate; server_no_context_takeover",
+                  plus the offer's server_max_window_bits if it has one.
+                  Every frame is then deflated on its own, so the
+                  compressed message is the same bytes for every
+                  subscriber with that window size: one compressor per
+                  window size in use. An offer of 8 bits (which zlib
+                  cannot produce raw) or with unknown parameters is
+                  declined. A client without deflate gets the plain
+                  frame, also built once.
+    /z/<topic>    WebSocket binary messages carrying one raw-deflate
+                  stream per topic, kept across frames (better ratio for
+                  small JSON). A text message "sync" means "start a new
+                  inflater": a subscriber joins, or rejoins after falling
+                  behind, at a full flush that is only made when someone
+                  is waiting. Browser: new DecompressionStream("deflate-raw").
+    /topics, /stats   JSON
+
+Slow subscribers never hold up a topic. Past high_water bytes queued, a
+/ws subscriber misses frames (counted) and a /z subscriber is resynced.
+Clients only send control frames; anything over 125 bytes is closed with
+1009.
+"""
+
+import argparse
+import asyncio
+import base64
+import hashlib
+import json
+import struct
+import time
+import zlib
+from typing import Dict, Optional, Set
+
+from gateway.records import Record
+
+WS_GUID = b"258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+DEFLATE_TAIL = b"\x00\x00\xff\xff"
+OP_TEXT, OP_BINARY, OP_CLOSE, OP_PING, OP_PONG = 1, 2, 8, 9, 10
+WARD_KINDS = ("bands", "gated")
+MAX_CONTROL = 125
+CLOSE_TOO_BIG = 1009
+
+
+def deflate_offer(header: str) -> int:
+    """
+    Window bits to deflate with for a Sec-WebSocket-Extensions header:
+    the first permessage-deflate offer whose parameters this server can
+    honour, or 0 to send plain frames.
+    """
+    for offer in header.split(","):
+        parts = [p.strip() for p in offer.split(";")]
+        if parts[0].lower() != "permessage-deflate":
+            continue
+        bits, ok = 15, True
+        for p in parts[1:]:
+            k, eq, v = p.partition("=")
+            k, v = k.strip().lower(), v.strip().strip('"')
+            if k in ("server_no_context_takeover", "client_no_context_takeover") and not eq:
+                continue
+            if k == "client_max_window_bits" and (not eq or (v.isdigit() and 8 <= int(v) <= 15)):
+                continue                # we never inflate: client messages are control frames
+            if k == "server_max_window_bits" and v.isdigit() and 9 <= int(v) <= 15:
+                bits = int(v)
+                continue
+            ok = False                  # unknown, malformed, or 8 bits
+            break
+        if ok:
+            return bits
+    return 0
+
+
+def ws_frame(payload: bytes, opcode: int = OP_TEXT, rsv1: bool = False) -> bytes:
+    """A server (unmasked) frame."""
+    b0 = 0x80 | (0x40 if rsv1 else 0) | opcode
+    n = len(payload)
+    if n < 126:
+        return struct.pack("!BB", b0, n) + payload
+    if n < 65536:
+        return struct.pack("!BBH", b0, 126, n) + payload
+    return struct.pack("!BBQ", b0, 127, n) + payload
+
+
+SYNC = ws_frame(b"sync")
+
+
+def ws_size(n: int) -> int:
+    return n + (2 if n < 126 else 4 if n < 65536 else 10)
+
+
+class _Sub:
+    __slots__ = ("writer", "deflate", "dropped")
+
+    def __init__(self, writer: asyncio.StreamWriter, deflate: int):   # window bits, 0 = plain
+        self.writer = writer
+        self.deflate = deflate
+        self.dropped = 0
+
+
+class _Topic:
+    def __init__(self, name: str, level: int):
+        self.name = name
+        self.pending = []
+        self.ws: Set[_Sub] = set()
+        self.z: Set[_Sub] = set()              # receiving the stream
+        self.z_wait: Set[_Sub] = set()         # waiting for a full flush
+        self.level = level
+        self.frame_c = {}                      # window bits -> compressor, /ws
+        self.stream_c = zlib.compressobj(level, zlib.DEFLATED, -15)
+
+    def idle(self) -> bool:
+        return not (self.ws or self.z or self.z_wait)
+
+
+class Fanout:
+    def __init__(self, tick: float = 0.05, level: int = 6, high_water: int = 1 << 20):
+        self.tick = tick
+        self.level = level
+        self.high_water = high_water
+        self.topics: Dict[str, _Topic] = {}
+        self.frames = 0
+        self.raw_bytes = 0             # JSON per topic frame, before compression
+        self.wire_bytes = 0            # sent, all subscribers
+        self.plain_bytes = 0           # what the same sends would have been uncompressed
+        self.deflate_s = 0.0           # CPU spent compressing
+        self.dropped = 0
+        self.resyncs = 0
+
+    # ──────────────────────────────────────────────
+    # Publish (sink side)
+    # ──────────────────────────────────────────────
+
+    def __call__(self, rec: Record) -> None:
+        dev = self.topics.get("dev/" + rec.device)
+        ward = self.topics.get("ward") if rec.kind in WARD_KINDS else None
+        if dev is None and ward is None:
+            return                      # nobody listening: not even encoded
+        line = json.dumps({"device": rec.device, "event": rec.kind, "t": rec.t_dev,
+                           "data": rec.data}, separators=(",", ":")).encode() + b"\n"
+        if dev is not None:
+            dev.pending.append(line)
+        if ward is not None:
+            ward.pending.append(line)
+
+    def alert(self, msg: dict) -> None:
+        t = self.topics.get("alerts")
+        if t is not None:
+            t.pending.append(json.dumps(msg, separators=(",", ":")).encode() + b"\n")
+
+    # ──────────────────────────────────────────────
+    # Topic frames
+    # ──────────────────────────────────────────────
+
+    async def _flush_loop(self) -> None:
+        while True:
+            await asyncio.sleep(self.tick)
+            self.flush()
+
+    def flush(self) -> None:
+        for t in list(self.topics.values()):
+            if t.pending:
+                self._frame(t)
+
+    def _frame(self, t: _Topic) -> None:
+        raw = b"".join(t.pending)
+        t.pending.clear()
+        self.frames += 1
+        self.raw_bytes += len(raw)
+        c0 = time.process_time()
+        plain = None
+        deflated: Dict[int, bytes] = {}
+        if t.ws:
+            for bits in {s.deflate for s in t.ws if s.deflate}:
+                c = t.frame_c.get(bits)
+                if c is None:
+                    c = t.frame_c[bits] = zlib.compressobj(t.level, zlib.DEFLATED, -bits)
+                # full flush: no history carried over, any subscriber can inflate it
+                body = c.compress(raw) + c.flush(zlib.Z_FULL_FLUSH)
+                deflated[bits] = ws_frame(body[:-4] if body.endswith(DEFLATE_TAIL) else body,
+                                          OP_TEXT, rsv1=True)
+            if not all(s.deflate for s in t.ws):
+                plain = ws_frame(raw)
+        z_old = z_new = None
+        if t.z or t.z_wait:
+            head = t.stream_c.flush(zlib.Z_FULL_FLUSH) if t.z_wait else b""
+            body = t.stream_c.compress(raw) + t.stream_c.flush(zlib.Z_SYNC_FLUSH)
+            z_old = ws_frame(head + body, OP_BINARY) if t.z else None
+            z_new = ws_frame(body, OP_BINARY) if t.z_wait else None
+        self.deflate_s += time.process_time() - c0
+        n_plain = ws_size(len(raw))
+        for s in list(t.ws):
+            self._send(t, s, deflated[s.deflate] if s.deflate else plain, n_plain)
+        for s in list(t.z):
+            self._send(t, s, z_old, n_plain)
+        if z_new is not None:
+            for s in list(t.z_wait):
+                t.z_wait.discard(s)
+                t.z.add(s)
+                s.writer.write(SYNC)
+                self._send(t, s, z_new, n_plain)
+
+    def _send(self, t: _Topic, s: _Sub, frame: bytes, n_plain: int) -> None:
+        if s.writer.transport.get_write_buffer_size() > self.high_water:
+            s.dropped += 1
+            if s in t.z:
+                t.z.discard(s)             # its inflater is now out of step
+                t.z_wait.add(s)
+                self.resyncs += 1
+            else:
+                self.dropped += 1
+            return
+        s.writer.write(frame)
+        self.wire_bytes += len(frame)
+        self.plain_bytes += n_plain
+
+    # ──────────────────────────────────────────────
+    # Subscribers
+    # ──────────────────────────────────────────────
+
+    def _reply(self, w: asyncio.StreamWriter, code: int, body: bytes) -> None:
+        w.write(b"HTTP/1.1 %d %s\r\nContent-Type: application/json\r\nContent-Length: %d\r\n"
+                b"Access-Control-Allow-Origin: *\r\nConnection: close\r\n\r\n"
+                % (code, b"OK" if code == 200 else b"Error", len(body)) + body)
+
+    async def handle(self, reader: asyncio.StreamReader, writer: asyncio.StreamWriter) -> None:
+        sub = topic = None
+        try:
+            head = (await reader.readuntil(b"\r\n\r\n")).decode("latin-1").split("\r\n")
+            path = head[0].split(" ")[1].partition("?")[0]
+            hdr = {}
+            for ln in head[1:]:
+                k, _, v = ln.partition(":")
+                k, v = k.strip().lower(), v.strip()
+                hdr[k] = hdr[k] + ", " + v if k in hdr else v
+            if path == "/stats":
+                self._reply(writer, 200, json.dumps(self.stats()).encode())
+                return
+            if path == "/topics":
+                self._reply(writer, 200, json.dumps(sorted(self.topics)).encode())
+                return
+            chan, _, name = path[1:].partition("/")
+            key = hdr.get("sec-websocket-key")
+            if chan not in ("ws", "z") or not name or not key or "websocket" not in hdr.get("upgrade", "").lower():
+                self._reply(writer, 404, b'{"error":"GET /ws/<topic> or /z/<topic> with a WebSocket upgrade"}')
+                return
+            accept = base64.b64encode(hashlib.sha1(key.encode() + WS_GUID).digest())
+            deflate = deflate_offer(hdr.get("sec-websocket-extensions", "")) if chan == "ws" else 0
+            ext = b""
+            if deflate:
+                ext = b"Sec-WebSocket-Extensions: permessage-deflate; server_no_context_takeover" + \
+                      (b"; server_max_window_bits=%d" % deflate if deflate < 15 else b"") + b"\r\n"
+            writer.write(b"HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                         b"Sec-WebSocket-Accept: " + accept + b"\r\n" + ext + b"\r\n")
+            topic = self.topics.get(name)
+            if topic is None:
+                topic = self.topics[name] = _Topic(name, self.level)
+            sub = _Sub(writer, deflate)
+            (topic.ws if chan == "ws" else topic.z_wait).add(sub)
+            await self._read_client(reader, writer)
+        except (ConnectionError, asyncio.IncompleteReadError, asyncio.LimitOverrunError, IndexError):
+            pass
+        finally:
+            if sub is not None:
+                topic.ws.discard(sub)
+                topic.z.discard(sub)
+                topic.z_wait.discard(sub)
+                if topic.idle() and self.topics.get(topic.name) is topic:
+                    del self.topics[topic.name]
+            writer.close()
+
+    async def _read_client(self, reader: asyncio.StreamReader, writer: asyncio.StreamWriter) -> None:
+        """
+        Client frames are only control frames to us: answer ping and close.
+        A longer frame is not read: the connection is closed with 1009.
+        """
+        while True:
+            b0, b1 = await reader.readexactly(2)
+            n = b1 & 0x7F
+            if n > MAX_CONTROL:
+                writer.write(ws_frame(struct.pack("!H", CLOSE_TOO_BIG), OP_CLOSE))
+                return
+            mask = await reader.readexactly(4) if b1 & 0x80 else b"\0\0\0\0"
+            data = bytes(x ^ mask[i & 3] for i, x in enumerate(await reader.readexactly(n)))
+            op = b0 & 0x0F
+            if op == OP_CLOSE:
+                writer.write(ws_frame(data[:2], OP_CLOSE))
+                return
+            if op == OP_PING:
+                writer.write(ws_frame(data, OP_PONG))
+
+    async def serve(self, host: str = "0.0.0.0", port: int = 8201) -> None:
+        server = await asyncio.start_server(self.handle, host, port, backlog=4096)
+        flusher = asyncio.get_running_loop().create_task(self._flush_loop())
+        try:
+            async with server:
+                await server.serve_forever()
+        finally:
+            flusher.cancel()
+
+    def stats(self) -> dict:
+        subs = sum(len(t.ws) + len(t.z) + len(t.z_wait) for t in self.topics.values())
+        return {"topics": len(self.topics), "subscribers": subs, "frames": self.frames,
+                "raw_bytes": self.raw_bytes, "wire_bytes": self.wire_bytes,
+                "saved": round(1 - self.wire_bytes / self.plain_bytes, 3) if self.plain_bytes else 0.0,
+                "deflate_ms": round(self.deflate_s * 1e3, 1), "dropped": self.dropped,
+                "resyncs": self.resyncs}
+
+
+# ──────────────────────────────────────────────
+# Client (tools, bench)
+# ──────────────────────────────────────────────
+
+async def subscribe(host: str, port: int, path: str, deflate: bool = True, on_line=None,
+                    stats: Optional[dict] = None) -> None:
+    """Reads a /ws or /z channel until closed; on_line(bytes) per JSON line."""
+    r, w = await asyncio.open_connection(host, port)
+    key = base64.b64encode(hashlib.sha1(path.encode()).digest()[:16])
+    w.write(f"GET {path} HTTP/1.1\r\nHost: {host}\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+            f"Sec-WebSocket-Key: {key.decode()}\r\nSec-WebSocket-Version: 13\r\n".encode()
+            + (b"Sec-WebSocket-Extensions: permessage-deflate\r\n" if deflate else b"") + b"\r\n")
+    head = await r.readuntil(b"\r\n\r\n")
+    if not head.startswith(b"HTTP/1.1 101"):
+        raise ConnectionError(head.split(b"\r\n", 1)[0].decode())
+    st = stats if stats is not None else {}
+    inflater = None
+    try:
+        while True:
+            b0, b1 = await r.readexactly(2)
+            n = b1 & 0x7F
+            if n == 126:
+                n = struct.unpack("!H", await r.readexactly(2))[0]
+            elif n == 127:
+                n = struct.unpack("!Q", await r.readexactly(8))[0]
+            payload = await r.readexactly(n)
+            st["wire"] = st.get("wire", 0) + n + 2
+            op = b0 & 0x0F
+            if op == OP_CLOSE:
+                return
+            if op == OP_TEXT and payload == b"sync":
+                inflater = zlib.decompressobj(-15)
+                continue
+            if on_line is None:
+                continue
+            if op == OP_BINARY:
+                data = inflater.decompress(payload)
+            elif b0 & 0x40:
+                data = zlib.decompressobj(-15).decompress(payload + DEFLATE_TAIL)
+            else:
+                data = payload
+            for line in data.splitlines():
+                on_line(line)
+    except asyncio.IncompleteReadError:
+        pass
+    finally:
+        w.close()
+
+
+def main() -> None:
+    ap = argparse.ArgumentParser(description="Subscribe to a gateway fan-out channel")
+    ap.add_argument("url", help="host:port/ws/<topic> or host:port/z/<topic>")
+    ap.add_argument("--conns", type=int, default=1, help="parallel subscribers")
+    ap.add_argument("--plain", action="store_true", help="/ws: don't offer permessage-deflate")
+    ap.add_argument("--seconds", type=float, default=0, help="stop after this long (0: print lines)")
+    ap.add_argument("--no-decode", action="store_true", help="with --seconds: count bytes only")
+    a = ap.parse_args()
+    addr, _, path = a.url.removeprefix("ws://").partition("/")
+    host, _, port = addr.rpartition(":")
+    path = "/" + path
+    st = {"lines": 0}
+
+    def count(line: bytes) -> None:
+        st["lines"] += 1
+
+    async def run():
+        on_line = None if a.no_decode else count if a.seconds else \
+            (lambda ln: print(ln.decode(), flush=True))
+        subs = [asyncio.ensure_future(subscribe(host, int(port), path, not a.plain, on_line, st))
+                for _ in range(a.conns)]
+        if a.seconds:
+            await asyncio.wait(subs, timeout=a.seconds)
+            for s in subs:
+                s.cancel()
+            print(json.dumps(st))
+        else:
+            await asyncio.gather(*subs)
+
+    try:
+        asyncio.run(run())
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,199 @@
+"""
+Session recorder: every device connection is written verbatim to
+<root>/<device>/<YYYYmmdd-HHMMSS>.sse (the exact SSE bytes, so a file can
+be replayed as-is).
+
+The event loop only copies incoming bytes into a per-session buffer taken
+from a fixed pool; full buffers (or any with data after flush_s) go on a
+queue to one writer thread, which batches them per file into a single
+os.writev() and returns them to the pool. The loop never touches the
+disk. If the disk falls so far behind that the pool runs dry, new bytes
+are dropped and counted rather than stalling ingest.
+
+There is no io_uring path. All writes go through the one writer thread,
+as os.writev() of up to IOV_MAX buffers per call, or one os.write() per
+buffer where writev is missing (Windows).
+"""
+
+import os
+import queue
+import threading
+import time
+from typing import Dict, List, Optional
+
+try:
+    IOV_MAX = os.sysconf("SC_IOV_MAX")
+except (AttributeError, ValueError, OSError):
+    IOV_MAX = 1024
+HAVE_WRITEV = hasattr(os, "writev")
+
+_OPEN, _CLOSE = "open", "close"
+
+
+class _Session:
+    __slots__ = ("buf", "since")
+
+    def __init__(self):
+        self.buf: Optional[bytearray] = None
+        self.since = 0.0
+
+
+class Recorder:
+    def __init__(self, root: str, buf_size: int = 64 * 1024, pool: int = 512,
+                 flush_s: float = 0.5):
+        self.root = root
+        self.buf_size = buf_size
+        self.flush_s = flush_s
+        self._pool: List[bytearray] = [bytearray() for _ in range(pool)]
+        self._pool_lock = threading.Lock()
+        self._q: "queue.SimpleQueue" = queue.SimpleQueue()
+        self._sessions: Dict[int, _Session] = {}
+        self._next = 0
+        self.bytes_in = 0
+        self.bytes_written = 0
+        self.bytes_dropped = 0
+        self.writes = 0
+        self.buffers_written = 0
+        self._thread = threading.Thread(target=self._writer, name="recorder", daemon=True)
+        self._thread.start()
+
+    # ──────────────────────────────────────────────
+    # Event-loop side (never blocks)
+    # ──────────────────────────────────────────────
+
+    def _take(self) -> Optional[bytearray]:
+        with self._pool_lock:
+            return self._pool.pop() if self._pool else None
+
+    def open(self, device: str, peer=None) -> int:
+        """New session; the file itself is created by the writer thread."""
+        self._next += 1
+        self._sessions[self._next] = _Session()
+        self._q.put((self._next, (_OPEN, device, time.strftime("%Y%m%d-%H%M%S"))))
+        return self._next
+
+    def data(self, handle: int, chunk: bytes) -> None:
+        s = self._sessions.get(handle)
+        if s is None:
+            return
+        self.bytes_in += len(chunk)
+        view = memoryview(chunk)
+        while view:
+            if s.buf is None:
+                s.buf = self._take()
+                if s.buf is None:
+                    self.bytes_dropped += len(view)
+                    return
+                s.since = time.monotonic()
+            room = self.buf_size - len(s.buf)
+            s.buf += view[:room]
+            view = view[room:]
+            if len(s.buf) >= self.buf_size:
+                self._q.put((handle, s.buf))
+                s.buf = None
+
+    def close(self, handle: int) -> None:
+        s = self._sessions.pop(handle, None)
+        if s is None:
+            return
+        if s.buf:
+            self._q.put((handle, s.buf))
+        elif s.buf is not None:
+            self._give([s.buf])
+        self._q.put((handle, _CLOSE))         # after its pending buffers
+
+    def sweep(self, now: float) -> None:
+        """Hands off partly filled buffers older than flush_s."""
+        for h, s in self._sessions.items():
+            if s.buf and now - s.since >= self.flush_s:
+                self._q.put((h, s.buf))
+                s.buf = None
+
+    def flush(self) -> None:
+        self.sweep(float("inf"))
+
+    def stop(self, timeout: float = 10.0) -> None:
+        for h in list(self._sessions):
+            self.close(h)
+        self._q.put(None)
+        self._thread.join(timeout)
+
+    # ──────────────────────────────────────────────
+    # Writer thread
+    # ──────────────────────────────────────────────
+
+    def _give(self, bufs: List[bytearray]) -> None:
+        for b in bufs:
+            del b[:]
+        with self._pool_lock:
+            self._pool.extend(bufs)
+
+    def _open(self, device: str, stamp: str) -> int:
+        d = os.path.join(self.root, device.replace("/", "_").replace("\\", "_"))
+        os.makedirs(d, exist_ok=True)
+        path, n = os.path.join(d, stamp + ".sse"), 1
+        while os.path.exists(path):
+            path, n = os.path.join(d, f"{stamp}-{n}.sse"), n + 1
+        return os.open(path, os.O_WRONLY | os.O_CREAT | os.O_APPEND | getattr(os, "O_BINARY", 0), 0o644)
+
+    def _write(self, fd: int, bufs: List[bytearray]) -> None:
+        step = IOV_MAX if HAVE_WRITEV else 1
+        for i in range(0, len(bufs), step):
+            part = bufs[i:i + step]
+            total = sum(len(b) for b in part)
+            if len(part) > 1:
+                n = os.writev(fd, part)
+            else:
+                n = os.write(fd, part[0])
+            # O_APPEND regular files: short writes only on a full disk
+            self.bytes_written += n
+            self.bytes_dropped += total - n
+            self.writes += 1
+            self.buffers_written += len(part)
+
+    def _writer(self) -> None:
+        fds: Dict[int, int] = {}
+        stop = False
+        while not stop:
+            batch = [self._q.get()]
+            # take whatever else is already queued: one writev per file
+            while True:
+                try:
+                    batch.append(self._q.get_nowait())
+                except queue.Empty:
+                    break
+            pending: Dict[int, List[bytearray]] = {}
+            closing = []
+            for it in batch:
+                if it is None:
+                    stop = True
+                    continue
+                h, what = it
+                if isinstance(what, bytearray):
+                    pending.setdefault(h, []).append(what)
+                elif what == _CLOSE:
+                    closing.append(h)
+                else:
+                    try:
+                        fds[h] = self._open(what[1], what[2])
+                    except OSError:
+                        fds[h] = -1
+            for h, bufs in pending.items():
+                fd = fds.get(h, -1)
+                try:
+                    if fd < 0:
+                        raise OSError
+                    self._write(fd, bufs)
+                except OSError:
+                    self.bytes_dropped += sum(len(b) for b in bufs)
+                self._give(bufs)
+            for h in closing:
+                fd = fds.pop(h, -1)
+                if fd >= 0:
+                    os.close(fd)
+
+    def stats(self) -> dict:
+        return {"sessions": len(self._sessions), "bytes_in": self.bytes_in,
+                "bytes_written": self.bytes_written, "bytes_dropped": self.bytes_dropped,
+                "writes": self.writes, "buffers_per_write": round(self.buffers_written / max(self.writes, 1), 2),
+                "pool_free": len(self._pool)}
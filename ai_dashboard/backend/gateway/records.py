@@ -0,0 +1,161 @@
+"""
+Records and the SSE wire format.
+
+The firmware sends `event: <name>\\r\\ndata: <json>\\r\\n\\r\\n` frames
+(AsyncEventSource, fed by sseSink() in src/main.cpp); its UDP and
+WebSocket sinks use bare LF. Parsing follows the SSE spec and takes CRLF,
+LF or CR line endings, mixed freely. A device pushing to the gateway
+(pushSink(), BUS_PUSH) opens a TCP connection, sends one hello line
+
+    TREMOR <device_id>\\n
+
+and then the same frames it would serve on /events. The window events
+(bands, gated, quality) carry the device time `t` (seconds since boot,
+wrap-free) and the window number `seq` (include/events.h); other events
+have no `t`, and for them the arrival time stands in.
+"""
+
+import json
+import time
+from dataclasses import dataclass, field
+from typing import Iterator, List, Optional, Tuple
+
+HELLO = b"TREMOR "
+
+
+@dataclass(slots=True)
+class Record:
+    device: str
+    kind: str            # SSE event name: bands, gated, sample, ...
+    data: dict
+    t_dev: float         # device event time, s
+    t_arr: float = field(default_factory=time.monotonic)   # gateway arrival
+
+
+def encode_frame(kind: str, data: dict) -> bytes:
+    """
+    One SSE frame as AsyncEventSource::send(payload, event) writes it for a
+    single-line payload with no id: CRLF line endings, blank-line terminated.
+    """
+    return b"event: " + kind.encode() + b"\r\ndata: " + \
+        json.dumps(data, separators=(",", ":")).encode() + b"\r\n\r\n"
+
+
+def split_frames(buf: bytes, pos: int = 0, final: bool = False) -> Iterator[Tuple[int, int]]:
+    """
+    Complete frames in buf from pos on, as (end, nxt): the frame's lines are
+    buf[start:end] and the next frame starts at nxt (start is pos, then the
+    previous nxt). A frame ends at an empty line, whatever mix of CRLF, LF
+    and CR ends the lines. A CR as the very last byte may be half of a CRLF,
+    so that frame waits for more data unless final is set.
+
+    An empty line shows up as "\\n\\n", "\\n\\r" or "\\r\\r" (a lone
+    "\\r\\n" is one line end), so the scan follows LFs and a single
+    find() covers the CR-only case.
+    """
+    n = len(buf)
+    cr = buf.find(b"\r\r", pos)
+    lf = buf.find(b"\n", pos)
+    while True:
+        if lf >= 0 and (cr < 0 or lf < cr):
+            i = lf + 1
+            if i >= n:
+                return
+            c = buf[i]
+            if c == 10:                         # LF LF
+                nxt = i + 1
+            elif c == 13:                       # LF CR, or LF CRLF
+                if i + 1 < n:
+                    nxt = i + 2 if buf[i + 1] == 10 else i + 1
+                elif final:
+                    nxt = i + 1
+                else:
+                    return
+            else:
+                lf = buf.find(b"\n", i)
+                continue
+            end = lf - 1 if lf > pos and buf[lf - 1] == 13 else lf
+        elif cr >= 0:                           # CR CR, or CR CRLF
+            i = cr + 1
+            if i + 1 < n:
+                nxt = i + 2 if buf[i + 1] == 10 else i + 1
+            elif final:
+                nxt = i + 1
+            else:
+                return
+            end = cr
+        else:
+            return
+        yield end, nxt
+        pos = nxt
+        if 0 <= cr < pos:
+            cr = buf.find(b"\r\r", pos)
+        lf = buf.find(b"\n", pos)
+
+
+def parse_frame(frame: bytes) -> Optional[Tuple[str, str]]:
+    """(event, data) of one frame's lines; None when it has no data field."""
+    event, data = "message", []
+    for line in frame.splitlines():
+        if line.startswith(b"event:"):
+            event = line[6:].strip().decode()
+        elif line.startswith(b"data:"):
+            data.append(line[5:].lstrip().decode())
+    return (event, "\n".join(data)) if data else None
+
+
+class SseParser:
+    """
+    Incremental SSE parser: feed() raw bytes, get complete (event, data)
+    pairs. Only the `event:` and `data:` fields are used by the firmware.
+    """
+
+    __slots__ = ("_buf",)
+
+    def __init__(self) -> None:
+        self._buf = b""
+
+    def feed(self, chunk: bytes) -> List[Tuple[str, str]]:
+        buf = self._buf + chunk if self._buf else chunk
+        out = []
+        start = 0
+        for end, nxt in split_frames(buf):
+            ev = parse_frame(buf[start:end])
+            if ev is not None:
+                out.append(ev)
+            start = nxt
+        self._buf = buf[start:]
+        return out
+
+    def finish(self) -> List[Tuple[str, str]]:
+        """At end of input: the last frame, if only a trailing CR held it back."""
+        buf, self._buf = self._buf, b""
+        out = []
+        start = 0
+        for end, nxt in split_frames(buf, final=True):
+            ev = parse_frame(buf[start:end])
+            if ev is not None:
+                out.append(ev)
+            start = nxt
+        return out
+
+
+def to_record(device: str, event: str, data: str,
+              t_arr: Optional[float] = None) -> Optional[Record]:
+    """Builds a Record from one SSE frame; None for non-JSON payloads."""
+    try:
+        d = json.loads(data)
+    except ValueError:
+        return None
+    if not isinstance(d, dict):
+        return None
+    now = time.monotonic() if t_arr is None else t_arr
+    t_dev = d.get("t")
+    return Record(device, event, d, float(t_dev) if t_dev is not None else now, now)
+
+
+def iter_records(device: str, frames: Iterator[Tuple[str, str]]) -> Iterator[Record]:
+    for event, data in frames:
+        r = to_record(device, event, data)
+        if r is not None:
+            yield r
@@ -0,0 +1,296 @@
+"""
+Session replay server: recorded sessions (the recorder's .sse files) served
+back as live `/events` streams in the firmware's exact bytes, at 1x to
+100x, to many clients at once. The dashboards, the backend and the gateway
+can then be driven with real data without devices.
+
+    python -m gateway.replay --root rec --port 8300 --speed 10
+        GET /events                    the default session (--session, or the first)
+        GET /s/<device>/<stamp>/events one session by id
+        GET /sessions                  ids and durations
+        GET /stats                     replays, bytes, worst tick lag
+        query: ?speed=1..100&loop=1
+    Point a dashboard at "127.0.0.1:8300" (or "127.0.0.1:8300/s/<id>")
+    in place of the device IP. Device control routes answer 200 and do
+    nothing.
+
+    python -m gateway.replay --root rec --push 127.0.0.1:8200 --devices 500
+        replays sessions round-robin as devices pushing to a gateway
+
+Timing. Recordings carry no clock, so each file gets a timeline once,
+when it is loaded. Frames are split as SseParser splits them (CRLF, LF or
+CR line endings; recordings keep the device's CRLF). Window events (bands,
+gated) are WINDOW_S apart, or follow their `t` field when present, and the
+frames between them are spread evenly. A file is loaded once and shared.
+Every replay holds only a cursor into it, and on each tick it writes one
+slice of the original bytes, so concurrent replays cost no parsing and no
+copies.
+"""
+
+import argparse
+import asyncio
+import bisect
+import json
+import os
+import time
+from array import array
+from typing import Dict, List, Optional, Tuple
+
+from gateway.records import HELLO, parse_frame, split_frames
+
+WINDOW_S = 128 / 50.0
+SAMPLE_DT = 2 / 50.0          # firmware sends every second sample
+WINDOW_EVENTS = ("bands", "gated")
+TICK = 0.02
+MAX_SPEED = 100.0
+
+
+class Session:
+    """A recorded file with its timeline: frame i ends at byte ends[i] and plays at times[i]."""
+
+    def __init__(self, sid: str, path: str):
+        self.id = sid
+        with open(path, "rb") as f:
+            self.buf = f.read()
+        self.view = memoryview(self.buf)
+        self.times, self.ends = timeline(self.buf)
+        self.duration = self.times[-1] if self.times else 0.0
+
+
+def timeline(buf: bytes) -> Tuple[array, array]:
+    ends = array("Q")
+    win: List[Tuple[int, Optional[float]]] = []    # (frame index, t)
+    start = 0
+    for end, nxt in split_frames(buf, final=True):
+        ev = parse_frame(buf[start:end])
+        if ev is not None and ev[0] in WINDOW_EVENTS:
+            t = None
+            try:
+                d = json.loads(ev[1])
+                t = float(d["t"]) if isinstance(d, dict) and "t" in d else None
+            except (ValueError, TypeError):
+                pass
+            win.append((len(ends), t))
+        ends.append(nxt)
+        start = nxt
+    n = len(ends)
+    times = array("d", bytes(8 * n))
+    if not n:
+        return times, ends
+    if not win:
+        for i in range(n):
+            times[i] = i * SAMPLE_DT
+        return times, ends
+    # window boundaries, then linear in between
+    bt = [0.0]
+    for k in range(1, len(win)):
+        (_, t0), (_, t1) = win[k - 1], win[k]
+        step = t1 - t0 if t0 is not None and t1 is not None and 0 < t1 - t0 < 60 else WINDOW_S
+        bt.append(bt[-1] + step)
+    # before the first window event, the first interval's pace (or SAMPLE_DT)
+    first = win[0][0]
+    dt = bt[1] / max(win[1][0] - first, 1) if len(win) > 1 else SAMPLE_DT
+    lead = first * dt
+    for i in range(first + 1):
+        times[i] = i * dt
+    for k in range(1, len(win)):
+        a, b = win[k - 1][0], win[k][0]
+        for i in range(a + 1, b + 1):
+            times[i] = lead + bt[k - 1] + (bt[k] - bt[k - 1]) * (i - a) / (b - a)
+    last = win[-1][0]
+    dt = SAMPLE_DT
+    if len(win) > 1:
+        a = win[-2][0]
+        dt = (bt[-1] - bt[-2]) / max(last - a, 1)
+    for i in range(last + 1, n):
+        times[i] = lead + bt[-1] + (i - last) * dt
+    return times, ends
+
+
+class Library:
+    """Session files under root, loaded on first use and then shared."""
+
+    def __init__(self, root: str):
+        self.root = root
+        self._cache: Dict[str, Session] = {}
+
+    def ids(self) -> List[str]:
+        out = []
+        for d, _, files in os.walk(self.root):
+            for f in files:
+                if f.endswith(".sse"):
+                    out.append(os.path.relpath(os.path.join(d, f), self.root)[:-4].replace(os.sep, "/"))
+        return sorted(out)
+
+    def get(self, sid: str) -> Optional[Session]:
+        s = self._cache.get(sid)
+        if s is None:
+            path = os.path.normpath(os.path.join(self.root, sid + ".sse"))
+            if not path.startswith(os.path.normpath(self.root) + os.sep) or not os.path.isfile(path):
+                return None
+            s = self._cache[sid] = Session(sid, path)
+        return s
+
+
+# ──────────────────────────────────────────────
+# Playback
+# ──────────────────────────────────────────────
+
+class Stats:
+    def __init__(self):
+        self.active = self.started = 0
+        self.bytes = self.frames = 0
+        self.max_lag = 0.0
+
+
+async def play(s: Session, writer: asyncio.StreamWriter, speed: float, loop: bool,
+               stats: Stats) -> None:
+    """Writes the session's frames on schedule; one slice per tick."""
+    stats.active += 1
+    stats.started += 1
+    try:
+        while True:
+            t0 = wake = time.monotonic()
+            i = 0
+            n = len(s.ends)
+            start = 0
+            while i < n:
+                # frames due within a tick go out together
+                wake = max(t0 + s.times[i] / speed, wake + TICK)
+                now = time.monotonic()
+                if wake > now:
+                    await asyncio.sleep(wake - now)
+                    now = time.monotonic()
+                lag = now - wake
+                if lag > stats.max_lag:
+                    stats.max_lag = lag
+                j = bisect.bisect_right(s.times, (now - t0) * speed, i)
+                j = max(j, i + 1)
+                end = s.ends[j - 1]
+                writer.write(s.view[start:end])
+                stats.bytes += end - start
+                stats.frames += j - i
+                start, i = end, j
+                if writer.transport.get_write_buffer_size() > 262144:
+                    await writer.drain()       # slow client: this replay falls behind alone
+            if not loop:
+                break
+        await writer.drain()
+    except (ConnectionError, asyncio.CancelledError):
+        pass
+    finally:
+        stats.active -= 1
+
+
+# ──────────────────────────────────────────────
+# HTTP (the device's /events, plus a few routes)
+# ──────────────────────────────────────────────
+
+CORS = b"Access-Control-Allow-Origin: *\r\n"
+
+
+class ReplayServer:
+    def __init__(self, lib: Library, default: Optional[str], speed: float):
+        self.lib = lib
+        self.default = default
+        self.speed = speed
+        self.stats = Stats()
+
+    def _reply(self, w: asyncio.StreamWriter, code: int, ctype: str, body: bytes) -> None:
+        w.write(b"HTTP/1.1 %d %s\r\nContent-Type: %s\r\nContent-Length: %d\r\n%sConnection: close\r\n\r\n"
+                % (code, b"OK" if code == 200 else b"Error", ctype.encode(), len(body), CORS) + body)
+
+    async def handle(self, reader: asyncio.StreamReader, writer: asyncio.StreamWriter) -> None:
+        try:
+            head = await reader.readuntil(b"\r\n\r\n")
+            target = head.split(b" ", 2)[1].decode()
+            path, _, q = target.partition("?")
+            query = dict(p.partition("=")[::2] for p in q.split("&") if p)
+            if path == "/sessions":
+                lst = [{"id": i, "duration": round(self.lib.get(i).duration, 2)} for i in self.lib.ids()]
+                self._reply(writer, 200, "application/json", json.dumps(lst).encode())
+            elif path == "/stats":
+                st = self.stats
+                self._reply(writer, 200, "application/json", json.dumps(
+                    {"active": st.active, "started": st.started, "bytes": st.bytes,
+                     "frames": st.frames, "max_lag_ms": round(st.max_lag * 1e3, 2)}).encode())
+            elif path == "/events" or (path.startswith("/s/") and path.endswith("/events")):
+                sid = path[3:-7] if path.startswith("/s/") else self.default
+                if sid is None:
+                    ids = self.lib.ids()
+                    sid = ids[0] if ids else None
+                s = self.lib.get(sid) if sid else None
+                if s is None:
+                    self._reply(writer, 404, "text/plain", b"no such session")
+                else:
+                    speed = min(max(float(query.get("speed", self.speed)), 0.1), MAX_SPEED)
+                    writer.write(b"HTTP/1.1 200 OK\r\nContent-Type: text/event-stream\r\n"
+                                 b"Cache-Control: no-cache\r\n" + CORS + b"Connection: keep-alive\r\n\r\n")
+                    await play(s, writer, speed, query.get("loop", "0") == "1", self.stats)
+            else:
+                self._reply(writer, 200, "text/plain", b"OK (replay)")
+            await writer.drain()
+        except (ConnectionError, asyncio.IncompleteReadError, asyncio.LimitOverrunError,
+                IndexError, ValueError):
+            pass
+        finally:
+            writer.close()
+
+
+# ──────────────────────────────────────────────
+# Push to a gateway
+# ──────────────────────────────────────────────
+
+async def push(lib: Library, host: str, port: int, devices: int, speed: float,
+               prefix: str = "replay") -> dict:
+    ids = lib.ids()
+    stats = Stats()
+
+    async def one(k: int) -> None:
+        s = lib.get(ids[k % len(ids)])
+        _, w = await asyncio.open_connection(host, port)
+        w.write(HELLO + f"{prefix}-{k:05d}".encode() + b"\n")
+        await play(s, w, speed, False, stats)
+        w.close()
+
+    t0 = time.monotonic()
+    await asyncio.gather(*(one(k) for k in range(devices)))
+    dt = time.monotonic() - t0
+    return {"devices": devices, "seconds": round(dt, 2), "frames": stats.frames,
+            "frames_per_s": round(stats.frames / dt), "max_lag_ms": round(stats.max_lag * 1e3, 2)}
+
+
+def main() -> None:
+    ap = argparse.ArgumentParser(description="Replay recorded sessions as live /events streams")
+    ap.add_argument("--root", required=True, help="recorder output directory")
+    ap.add_argument("--session", help="default session id for /events")
+    ap.add_argument("--host", default="0.0.0.0")
+    ap.add_argument("--port", type=int, default=8300)
+    ap.add_argument("--speed", type=float, default=1.0)
+    ap.add_argument("--push", metavar="HOST:PORT", help="push to a gateway instead of serving")
+    ap.add_argument("--devices", type=int, default=1, help="push: simulated devices")
+    a = ap.parse_args()
+    lib = Library(a.root)
+    if not lib.ids():
+        raise SystemExit(f"no .sse sessions under {a.root}")
+    speed = min(max(a.speed, 0.1), MAX_SPEED)
+    if a.push:
+        host, port = a.push.rsplit(":", 1)
+        print(json.dumps(asyncio.run(push(lib, host, int(port), a.devices, speed))))
+        return
+    srv = ReplayServer(lib, a.session, speed)
+
+    async def run():
+        server = await asyncio.start_server(srv.handle, a.host, a.port, backlog=4096)
+        print(f"[REPLAY] {len(lib.ids())} sessions on {a.host}:{a.port}, speed {speed:g}x", flush=True)
+        async with server:
+            await server.serve_forever()
+
+    try:
+        asyncio.run(run())
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()
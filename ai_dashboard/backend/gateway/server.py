@@ -0,0 +1,108 @@
+"""
+Gateway core: TCP ingest of device pushes and fan-out to sinks.
+
+A sink is any callable taking a Record. Sinks run inline on the event
+loop, so they must not block; anything slow (disk, network) belongs
+behind a queue owned by the sink.
+
+A tap sees the raw bytes of each connection before parsing
+(open(device, peer) -> handle, data(handle, chunk), close(handle)); the
+session recorder and the flash-log backfill are taps. The same no-blocking rule applies.
+"""
+
+import asyncio
+import socket
+import time
+from typing import Callable, List, Optional
+
+from gateway.records import HELLO, Record, SseParser, to_record
+
+Sink = Callable[[Record], None]
+
+READ_CHUNK = 16384
+BACKLOG = 4096          # a ward reconnecting at once after a gateway restart
+
+
+class Gateway:
+    def __init__(self, sweep_s: float = 1.0):
+        self.sinks: List[Sink] = []
+        self.taps: list = []
+        self.sweepers: List[Callable[[float], None]] = []
+        self.sweep_s = sweep_s
+        self.connections = 0
+        self.records = 0
+        self.bytes_in = 0
+        self._server: Optional[asyncio.base_events.Server] = None
+
+    def add_sink(self, sink: Sink, sweep: Optional[Callable[[float], None]] = None) -> None:
+        """Registers a sink; `sweep(now)` is also called every sweep_s."""
+        self.sinks.append(sink)
+        if sweep is not None:
+            self.sweepers.append(sweep)
+
+    def add_tap(self, tap, sweep: Optional[Callable[[float], None]] = None) -> None:
+        self.taps.append(tap)
+        if sweep is not None:
+            self.sweepers.append(sweep)
+
+    def dispatch(self, rec: Record) -> None:
+        self.records += 1
+        for s in self.sinks:
+            s(rec)
+
+    # ──────────────────────────────────────────────
+    # Ingest
+    # ──────────────────────────────────────────────
+
+    async def _handle(self, reader: asyncio.StreamReader, writer: asyncio.StreamWriter) -> None:
+        self.connections += 1
+        handles = []
+        try:
+            hello = await reader.readline()
+            if not hello.startswith(HELLO):
+                return
+            device = hello[len(HELLO):].strip().decode(errors="replace")
+            parser = SseParser()
+            peer = writer.get_extra_info("peername")
+            handles = [(t, t.open(device, peer)) for t in self.taps]
+            while True:
+                chunk = await reader.read(READ_CHUNK)
+                if not chunk:
+                    break
+                self.bytes_in += len(chunk)
+                for t, h in handles:
+                    t.data(h, chunk)
+                now = time.monotonic()
+                for event, data in parser.feed(chunk):
+                    rec = to_record(device, event, data, now)
+                    if rec is not None:
+                        self.dispatch(rec)
+        except (ConnectionError, asyncio.IncompleteReadError):
+            pass
+        finally:
+            self.connections -= 1
+            for t, h in handles:
+                t.close(h)
+            writer.close()
+
+    async def adopt(self, sock: socket.socket) -> None:
+        """Runs a connection accepted elsewhere (see gateway.shard)."""
+        reader, writer = await asyncio.open_connection(sock=sock)
+        await self._handle(reader, writer)
+
+    async def _sweep_loop(self) -> None:
+        while True:
+            await asyncio.sleep(self.sweep_s)
+            now = time.monotonic()
+            for s in self.sweepers:
+                s(now)
+
+    async def serve(self, host: str = "0.0.0.0", port: int = 8200, **kw) -> None:
+        kw.setdefault("backlog", BACKLOG)
+        self._server = await asyncio.start_server(self._handle, host, port, **kw)
+        sweeper = asyncio.create_task(self._sweep_loop())
+        try:
+            async with self._server:
+                await self._server.serve_forever()
+        finally:
+            sweeper.cancel()
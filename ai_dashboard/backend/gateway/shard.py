@@ -0,0 +1,305 @@
+"""
+Shared-nothing sharding: one gateway process, with its own event loop,
+per core (Linux).
+
+Every shard binds the same port with SO_REUSEPORT, so the kernel spreads
+accepts across them. A shard peeks at the hello line (MSG_PEEK, nothing is
+consumed) and, if the device hashes to another shard, passes the socket
+to that shard over a Unix datagram socket (SCM_RIGHTS) and forgets it.
+After that a device's connection, parser, alert state and recording live
+on exactly one core, and a reconnect lands on the same one.
+
+Shards share no state. The only cross-shard traffic is for subscribers
+that span shards, such as the ward-wide alert feed and stats. Each shard
+has its own pipe to the parent: one producer and one consumer, so no shard
+ever waits on a lock another shard holds. The pipe is non-blocking on the
+shard side: if the parent falls behind and the pipe fills, a message is
+dropped and counted (publish_dropped) rather than stalling the shard's
+loop. Per-record traffic never leaves its shard.
+"""
+
+import asyncio
+import json
+import multiprocessing as mp
+import os
+import select
+import signal
+import socket
+import struct
+import time
+import zlib
+from collections import deque
+from dataclasses import asdict
+from multiprocessing.connection import wait
+from typing import Callable, Dict, List, Optional
+
+from gateway.alerts import AlertEngine, BandSwitch, ScoreAbove, Silence
+from gateway.records import HELLO
+from gateway.server import BACKLOG, Gateway
+
+HELLO_MAX = 256
+HELLO_TIMEOUT = 10.0
+
+
+def shard_of(device: str, n: int) -> int:
+    """Stable across processes and restarts (str hash() is salted)."""
+    return zlib.crc32(device.encode()) % n
+
+
+class Shard:
+    """One core's gateway. Built and run inside its own process."""
+
+    def __init__(self, index: int, n: int, inboxes, out, stats_s: float):
+        self.index = index
+        self.n = n
+        self.inboxes = inboxes          # [(rx, tx)] per shard
+        self.out = out                  # this shard's pipe to the parent
+        os.set_blocking(out.fileno(), False)
+        self.stats_s = stats_s
+        self.gw = Gateway()
+        self.stats_fns: List[Callable[[], dict]] = []
+        self.on_stop: List[Callable[[], None]] = []
+        self.handoffs_in = 0
+        self.handoffs_out = 0
+        self.handoff_failed = 0
+        self.publish_dropped = 0
+        self._outq = [deque() for _ in range(n)]   # sockets waiting for a full inbox
+        self._tasks = set()
+
+    def publish(self, msg: dict) -> None:
+        """
+        Sends to the parent (spanning subscribers). Keep it rare. Never waits:
+        one os.write() of at most PIPE_BUF bytes goes in whole or not at all,
+        so a full pipe, or a message too big for that, is dropped and counted.
+        Framed as Connection.send_bytes() frames it, for the parent's recv_bytes().
+        """
+        msg["shard"] = self.index
+        body = json.dumps(msg).encode()
+        frame = struct.pack("!i", len(body)) + body
+        if len(frame) > select.PIPE_BUF:
+            self.publish_dropped += 1
+            return
+        try:
+            os.write(self.out.fileno(), frame)
+        except BlockingIOError:
+            self.publish_dropped += 1
+
+    def stats(self) -> dict:
+        st = {"kind": "stats", "connections": self.gw.connections, "records": self.gw.records,
+              "bytes_in": self.gw.bytes_in, "handoffs_in": self.handoffs_in,
+              "handoffs_out": self.handoffs_out, "handoff_failed": self.handoff_failed,
+              "publish_dropped": self.publish_dropped}
+        for f in self.stats_fns:
+            st.update(f())
+        return st
+
+    def _spawn(self, coro) -> None:
+        t = asyncio.get_running_loop().create_task(coro)
+        self._tasks.add(t)
+        t.add_done_callback(self._tasks.discard)
+
+    # ──────────────────────────────────────────────
+    # Accept and route
+    # ──────────────────────────────────────────────
+
+    async def _peek_hello(self, conn: socket.socket) -> Optional[str]:
+        loop = asyncio.get_running_loop()
+        deadline = time.monotonic() + HELLO_TIMEOUT
+        while time.monotonic() < deadline:
+            ready = loop.create_future()
+            loop.add_reader(conn.fileno(), lambda: ready.done() or ready.set_result(None))
+            try:
+                await asyncio.wait_for(ready, deadline - time.monotonic())
+            except asyncio.TimeoutError:
+                return None
+            finally:
+                loop.remove_reader(conn.fileno())
+            try:
+                head = conn.recv(HELLO_MAX, socket.MSG_PEEK)
+            except BlockingIOError:
+                continue
+            except OSError:
+                return None
+            if not head or not head.startswith(HELLO[:len(head)]):
+                return None
+            nl = head.find(b"\n")
+            if nl >= 0:
+                return head[len(HELLO):nl].strip().decode(errors="replace")
+            if len(head) >= HELLO_MAX:
+                return None
+            await asyncio.sleep(0.01)   # partial hello stays readable: don't spin
+        return None
+
+    async def _route(self, conn: socket.socket) -> None:
+        device = await self._peek_hello(conn)
+        if device is None:
+            conn.close()
+            return
+        owner = shard_of(device, self.n)
+        if owner == self.index:
+            await self.gw.adopt(conn)
+            return
+        q = self._outq[owner]
+        q.append(conn)
+        if len(q) == 1:
+            self._flush(owner)
+
+    def _flush(self, owner: int) -> None:
+        """Hands queued sockets to their owner until its inbox is full."""
+        loop = asyncio.get_running_loop()
+        q, tx = self._outq[owner], self.inboxes[owner][1]
+        while q:
+            conn = q[0]
+            try:
+                socket.send_fds(tx, [b"c"], [conn.fileno()])
+                self.handoffs_out += 1
+            except BlockingIOError:
+                loop.add_writer(tx.fileno(), self._flush, owner)
+                return
+            except OSError:
+                self.handoff_failed += 1    # device reconnects and tries again
+            q.popleft()
+            conn.close()
+        loop.remove_writer(tx.fileno())
+
+    def _on_handoff(self, rx: socket.socket) -> None:
+        while True:
+            try:
+                _, fds, _, _ = socket.recv_fds(rx, 16, 8)
+            except BlockingIOError:
+                return
+            for fd in fds:
+                self.handoffs_in += 1
+                self._spawn(self.gw.adopt(socket.socket(fileno=fd)))
+
+    async def _accept(self, lsock: socket.socket) -> None:
+        loop = asyncio.get_running_loop()
+        while True:
+            conn, _ = await loop.sock_accept(lsock)
+            conn.setblocking(False)
+            self._spawn(self._route(conn))
+
+    def open_inbox(self) -> None:
+        """Starts taking handoffs; all inboxes non-blocking."""
+        rx = self.inboxes[self.index][0]
+        rx.setblocking(False)
+        for _, tx in self.inboxes:
+            tx.setblocking(False)
+        asyncio.get_running_loop().add_reader(rx.fileno(), self._on_handoff, rx)
+
+    async def _report(self) -> None:
+        while True:
+            await asyncio.sleep(self.stats_s)
+            self.publish(self.stats())
+
+    async def run(self, host: str, port: int, setup: Callable[["Shard"], None]) -> None:
+        loop = asyncio.get_running_loop()
+        setup(self)
+        lsock = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+        lsock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        lsock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEPORT, 1)
+        lsock.bind((host, port))
+        lsock.listen(BACKLOG)
+        lsock.setblocking(False)
+        self.open_inbox()
+
+        stop = asyncio.Event()
+        for sig in (signal.SIGTERM, signal.SIGINT):
+            loop.add_signal_handler(sig, stop.set)
+        tasks = [loop.create_task(c) for c in (self._accept(lsock), self.gw._sweep_loop(), self._report())]
+        await stop.wait()
+        for t in tasks:
+            t.cancel()
+        lsock.close()
+        for f in self.on_stop:
+            f()
+        os.set_blocking(self.out.fileno(), True)     # the final stats wait for the parent
+        final = json.dumps({**self.stats(), "final": True, "shard": self.index}).encode()
+        self.out.send_bytes(final)
+
+
+def _shard_main(index, n, host, port, inboxes, out, setup, stats_s) -> None:
+    asyncio.run(Shard(index, n, inboxes, out, stats_s).run(host, port, setup))
+
+
+def alert_setup(score: float = 7.0, hold: float = 60.0, silence: float = 10.0,
+                record: Optional[str] = None, backfill: Optional[dict] = None) -> Callable[[Shard], None]:
+    """Per-shard alert engine, recorder and backfill; alerts go to the parent."""
+    def setup(sh: Shard) -> None:
+        engine = AlertEngine([ScoreAbove(score, hold), BandSwitch()], Silence(silence),
+                             lambda al: sh.publish({"kind": "alert", **asdict(al)}))
+        sh.gw.add_sink(engine, engine.sweep)
+        sh.stats_fns.append(engine.stats)
+        if record:
+            from gateway.recorder import Recorder
+            rec = Recorder(record)
+            sh.gw.add_tap(rec, rec.sweep)
+            sh.stats_fns.append(lambda: {"record": rec.stats()})
+            sh.on_stop.append(rec.stop)
+        if backfill:
+            from gateway.backfill import Backfill
+            bf = Backfill(**backfill)
+            sh.gw.add_tap(bf, bf.sweep)
+            sh.stats_fns.append(lambda: {"backfill": bf.stats()})
+    return setup
+
+
+# ──────────────────────────────────────────────
+# Parent
+# ──────────────────────────────────────────────
+
+class ShardedGateway:
+    def __init__(self, shards: int, setup: Optional[Callable[[Shard], None]] = None,
+                 stats_s: float = 5.0):
+        self.n = shards
+        self.setup = setup or alert_setup()
+        self.stats_s = stats_s
+        self.procs: List[mp.Process] = []
+        self.pipes = []
+        self.last: Dict[int, dict] = {}
+
+    def start(self, host: str = "0.0.0.0", port: int = 8200) -> None:
+        ctx = mp.get_context("fork")
+        inboxes = [socket.socketpair(socket.AF_UNIX, socket.SOCK_DGRAM) for _ in range(self.n)]
+        pipes = [ctx.Pipe(duplex=False) for _ in range(self.n)]
+        for i in range(self.n):
+            p = ctx.Process(target=_shard_main, name=f"gw-shard-{i}", daemon=True,
+                            args=(i, self.n, host, port, inboxes, pipes[i][1], self.setup, self.stats_s))
+            p.start()
+            self.procs.append(p)
+        for r, w in pipes:
+            w.close()
+            self.pipes.append(r)
+        for rx, tx in inboxes:
+            rx.close()
+            tx.close()
+
+    def poll(self, timeout: Optional[float] = None) -> List[dict]:
+        """Messages from the shards (alerts, stats); latest stats kept in .last."""
+        msgs = []
+        for r in wait(self.pipes, timeout):
+            try:
+                m = json.loads(r.recv_bytes())
+            except EOFError:
+                self.pipes.remove(r)
+                continue
+            if m.get("kind") == "stats":
+                self.last[m["shard"]] = m
+            msgs.append(m)
+        return msgs
+
+    def stop(self, timeout: float = 10.0) -> List[dict]:
+        for p in self.procs:
+            p.terminate()               # SIGTERM: shards flush and send final stats
+        msgs = []
+        deadline = time.monotonic() + timeout
+        while self.pipes and time.monotonic() < deadline:
+            msgs += self.poll(0.2)
+        for p in self.procs:
+            p.join(1.0)
+        return msgs
+
+    def totals(self) -> dict:
+        keys = ("connections", "records", "bytes_in", "handoffs_in", "handoffs_out", "handoff_failed",
+                "publish_dropped")
+        return {k: sum(s.get(k, 0) for s in self.last.values()) for k in keys}
@@ -0,0 +1,125 @@
+"""
+Device simulator for gateway load tests.
+
+Each SimDevice produces the firmware's per-window events (`bands`, and
+`gated` for voluntary windows) with a device timestamp: a random-walk
+score, a dominant band that occasionally moves, and optional dropouts.
+`speed` compresses time, so 1000 devices at speed 10 push like 10000.
+With raw=True each window is preceded by its 128 `sample` frames, as the
+firmware streams them, which is what the session recorder has to keep up
+with.
+
+    python -m gateway.simulator --gateway 127.0.0.1:8200 --devices 1000 --speed 10
+"""
+
+import argparse
+import asyncio
+import json
+import math
+import random
+import time
+from typing import List, Tuple
+
+from gateway.records import HELLO, encode_frame
+
+FS = 50.0
+WINDOW = 128
+WINDOW_S = WINDOW / FS
+TYPES = {1: "Parkinsonian", 2: "Essential", 3: "Physiological"}
+
+
+class SimDevice:
+    def __init__(self, device_id: str, seed: int = 0):
+        self.id = device_id
+        self.rng = random.Random(seed)
+        self.t = 0.0
+        self.score = self.rng.uniform(1, 5)
+        self.band = self.rng.randint(1, 3)
+
+    def next_window(self) -> Tuple[str, dict]:
+        """Advances one window; returns (event, payload)."""
+        r = self.rng
+        self.t += WINDOW_S
+        if r.random() < 0.03:
+            return "gated", {"t": round(self.t, 3), "type": "Voluntary Movement",
+                             "volRms": round(r.uniform(0.05, 0.3), 4), "ratio": 0.9}
+        self.score = min(10.0, max(0.0, self.score + r.gauss(0, 0.6)))
+        if r.random() < 0.02:
+            self.band = r.randint(1, 3)
+        total = 10 ** (self.score / 3.0) * 0.01
+        b = [total * r.uniform(0.05, 0.2) for _ in range(3)]
+        b[self.band - 1] = total * 0.7
+        return "bands", {"t": round(self.t, 3), "b1": round(b[0], 6), "b2": round(b[1], 6),
+                         "b3": round(b[2], 6), "type": TYPES[self.band],
+                         "confidence": 0.7, "score": round(self.score, 3), "meanNorm": 0.05}
+
+    def samples(self) -> bytes:
+        """One window of raw `sample` frames at the current score."""
+        r, f = self.rng, 4.0 + self.band
+        amp = 10 ** (self.score / 6.0) * 0.01
+        t0 = self.t
+        out = []
+        for i in range(WINDOW):
+            s = amp * math.sin(2 * math.pi * f * (t0 + i / FS))
+            out.append(encode_frame("sample", {"ax": round(s + r.gauss(0, 0.003), 4),
+                                               "ay": round(0.5 * s + r.gauss(0, 0.003), 4),
+                                               "az": round(1.0 + r.gauss(0, 0.003), 4)}))
+        return b"".join(out)
+
+    def frames(self, n: int) -> List[bytes]:
+        return [encode_frame(*self.next_window()) for _ in range(n)]
+
+
+async def _push(dev: SimDevice, host: str, port: int, speed: float, windows: int,
+                stats: dict, raw: bool = False) -> None:
+    try:
+        reader, writer = await asyncio.open_connection(host, port)
+        writer.write(HELLO + dev.id.encode() + b"\n")
+        period = WINDOW_S / speed
+        # spread devices over the first period so pushes are not synchronised
+        await asyncio.sleep(dev.rng.uniform(0, period))
+        # one window of samples, rendered once: the load is what matters here
+        pre = dev.samples() if raw else b""
+        start = time.monotonic()
+        for i in range(windows):
+            buf = pre + encode_frame(*dev.next_window())
+            writer.write(buf)
+            stats["frames"] += 1
+            stats["bytes"] += len(buf)
+            if writer.transport.get_write_buffer_size() > 65536:
+                await writer.drain()
+            delay = start + (i + 1) * period - time.monotonic()
+            if delay > 0:
+                await asyncio.sleep(delay)
+        await writer.drain()
+        writer.close()
+    except OSError:
+        stats["errors"] += 1
+
+
+async def run(host: str, port: int, devices: int, speed: float, windows: int,
+              prefix: str = "sim", raw: bool = False) -> dict:
+    stats = {"frames": 0, "bytes": 0, "errors": 0}
+    devs = [SimDevice(f"{prefix}-{i:05d}", seed=i) for i in range(devices)]
+    t0 = time.monotonic()
+    await asyncio.gather(*(_push(d, host, port, speed, windows, stats, raw) for d in devs))
+    stats["seconds"] = round(time.monotonic() - t0, 2)
+    stats["frames_per_s"] = round(stats["frames"] / max(stats["seconds"], 1e-9))
+    return stats
+
+
+def main() -> None:
+    ap = argparse.ArgumentParser(description="Push simulated devices to a gateway")
+    ap.add_argument("--gateway", default="127.0.0.1:8200")
+    ap.add_argument("--devices", type=int, default=100)
+    ap.add_argument("--speed", type=float, default=1.0, help="time compression factor")
+    ap.add_argument("--windows", type=int, default=100, help="windows per device")
+    ap.add_argument("--raw", action="store_true", help="also stream per-sample frames")
+    ap.add_argument("--prefix", default="sim", help="device id prefix")
+    a = ap.parse_args()
+    host, port = a.gateway.rsplit(":", 1)
+    print(json.dumps(asyncio.run(run(host, int(port), a.devices, a.speed, a.windows, a.prefix, a.raw))))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,388 @@
+"""
+Minimal Apache Arrow IPC file (Feather v2) writer and reader.
+
+Training data goes out as columnar record batches that NumPy, pandas
+(pd.read_feather) and pyarrow (pyarrow.ipc.open_file) map straight from
+disk. Only what the exporters need is implemented, so there is no
+pyarrow dependency:
+    types       f4 f8 i1 i4 i8 u4 bool utf8, no nulls (the reader refuses
+                a batch with any)
+    metadata    schema-level key/value strings
+    no dictionaries, no compression
+
+Writing is streamed. The schema goes out when the file is opened, each
+batch as soon as it is full, and the footer (the batch index) on close.
+Only one batch is ever held in memory.
+
+Layout (Arrow columnar format, IPC file):
+    "ARROW1\\0\\0"
+    message*     0xFFFFFFFF, int32 metadata size, flatbuffer Message, body
+    0xFFFFFFFF 0x00000000
+    flatbuffer Footer, int32 footer size, "ARROW1"
+Every message and buffer is 8-byte aligned, so read() hands out NumPy
+views on the memory-mapped file with no copying or parsing.
+"""
+
+import json
+import mmap
+import struct
+from typing import Dict, Iterator, List, Optional, Sequence, Tuple
+
+import numpy as np
+
+MAGIC = b"ARROW1"
+CONT = 0xFFFFFFFF
+V5 = 4                      # MetadataVersion
+HDR_SCHEMA, HDR_BATCH = 1, 3
+
+# column type -> (Arrow Type union tag, type table fields, numpy dtype)
+_INT, _FLOAT, _UTF8, _BOOL = 2, 3, 5, 6
+TYPES = {
+    "i1": (_INT, [(0, "i32", 8), (1, "bool", True)], "<i1"),
+    "i4": (_INT, [(0, "i32", 32), (1, "bool", True)], "<i4"),
+    "i8": (_INT, [(0, "i32", 64), (1, "bool", True)], "<i8"),
+    "u4": (_INT, [(0, "i32", 32), (1, "bool", False)], "<u4"),
+    "f4": (_FLOAT, [(0, "i16", 1)], "<f4"),
+    "f8": (_FLOAT, [(0, "i16", 2)], "<f8"),
+    "bool": (_BOOL, [], None),
+    "utf8": (_UTF8, [], None),
+}
+
+
+# ──────────────────────────────────────────────
+# Flatbuffers (just enough for Arrow metadata)
+# ──────────────────────────────────────────────
+# A table is a list of (slot, kind, value). Scalars: u8 bool i16 i32 i64.
+# References: "str" (str), "table" (fields), "tables" (list of fields),
+# "structs" ((raw bytes, count)). The writer lays each object out before
+# the ones it points at, so every uoffset points forward.
+
+_SCALAR = {"u8": "<B", "bool": "<?", "i16": "<h", "i32": "<i", "i64": "<q"}
+
+
+class _Builder:
+    def __init__(self):
+        self.buf = bytearray(4)
+
+    def _pad(self, align: int, extra: int = 0) -> None:
+        self.buf += bytes(-(len(self.buf) + extra) % align)
+
+    def finish(self, root: list) -> bytes:
+        struct.pack_into("<I", self.buf, 0, self.table(root))
+        self._pad(8)
+        return bytes(self.buf)
+
+    def table(self, fields: list) -> int:
+        slots = {}
+        off = 4                                  # after the soffset
+        for slot, kind, _ in fields:
+            size = struct.calcsize(_SCALAR[kind]) if kind in _SCALAR else 4
+            off += -off % size
+            slots[slot] = off
+            off += size
+        nslots = max(slots, default=-1) + 1
+        self._pad(2)
+        vt = len(self.buf)
+        self.buf += struct.pack(f"<HH{nslots}H", 4 + 2 * nslots, off,
+                                *(slots.get(s, 0) for s in range(nslots)))
+        self._pad(8)                             # table start 8-aligned: i64 fields are too
+        t = len(self.buf)
+        self.buf += bytes(off)
+        struct.pack_into("<i", self.buf, t, t - vt)
+        refs = []
+        for slot, kind, v in fields:
+            if kind in _SCALAR:
+                struct.pack_into(_SCALAR[kind], self.buf, t + slots[slot], v)
+            else:
+                refs.append((t + slots[slot], kind, v))
+        for at, kind, v in refs:
+            struct.pack_into("<I", self.buf, at, self._ref(kind, v) - at)
+        return t
+
+    def _ref(self, kind: str, v) -> int:
+        if kind == "table":
+            return self.table(v)
+        if kind == "str":
+            self._pad(4)
+            p = len(self.buf)
+            raw = v.encode()
+            self.buf += struct.pack("<I", len(raw)) + raw + b"\0"
+            return p
+        if kind == "structs":                    # elements hold i64s: 8-aligned
+            raw, count = v
+            self._pad(8, 4)
+            p = len(self.buf)
+            self.buf += struct.pack("<I", count) + raw
+            return p
+        if kind == "tables":
+            self._pad(4)
+            p = len(self.buf)
+            self.buf += struct.pack("<I", len(v)) + bytes(4 * len(v))
+            for i, fields in enumerate(v):
+                at = p + 4 + 4 * i
+                struct.pack_into("<I", self.buf, at, self.table(fields) - at)
+            return p
+        raise ValueError(kind)
+
+
+class _Table:
+    """Read side: a flatbuffer table at pos in buf."""
+
+    __slots__ = ("buf", "pos", "vt", "vlen")
+
+    def __init__(self, buf, pos: int):
+        self.buf, self.pos = buf, pos
+        self.vt = pos - struct.unpack_from("<i", buf, pos)[0]
+        self.vlen = struct.unpack_from("<H", buf, self.vt)[0]
+
+    @classmethod
+    def root(cls, buf, base: int = 0) -> "_Table":
+        return cls(buf, base + struct.unpack_from("<I", buf, base)[0])
+
+    def _field(self, slot: int) -> int:
+        o = 4 + 2 * slot
+        return struct.unpack_from("<H", self.buf, self.vt + o)[0] if o < self.vlen else 0
+
+    def scalar(self, slot: int, fmt: str, default=0):
+        o = self._field(slot)
+        return struct.unpack_from(fmt, self.buf, self.pos + o)[0] if o else default
+
+    def _deref(self, slot: int) -> Optional[int]:
+        o = self._field(slot)
+        if not o:
+            return None
+        p = self.pos + o
+        return p + struct.unpack_from("<I", self.buf, p)[0]
+
+    def table(self, slot: int) -> Optional["_Table"]:
+        p = self._deref(slot)
+        return None if p is None else _Table(self.buf, p)
+
+    def string(self, slot: int) -> str:
+        p = self._deref(slot)
+        if p is None:
+            return ""
+        n = struct.unpack_from("<I", self.buf, p)[0]
+        return bytes(self.buf[p + 4:p + 4 + n]).decode()
+
+    def tables(self, slot: int) -> List["_Table"]:
+        p = self._deref(slot)
+        if p is None:
+            return []
+        n = struct.unpack_from("<I", self.buf, p)[0]
+        return [_Table(self.buf, q + struct.unpack_from("<I", self.buf, q)[0])
+                for q in range(p + 4, p + 4 + 4 * n, 4)]
+
+    def structs(self, slot: int, fmt: str) -> List[tuple]:
+        p = self._deref(slot)
+        if p is None:
+            return []
+        n = struct.unpack_from("<I", self.buf, p)[0]
+        return list(struct.iter_unpack(fmt, self.buf[p + 4:p + 4 + n * struct.calcsize(fmt)]))
+
+
+# ──────────────────────────────────────────────
+# Writer
+# ──────────────────────────────────────────────
+
+_NODE = struct.Struct("<qq")                # FieldNode: length, null_count
+_BUF = struct.Struct("<qq")                 # Buffer: offset, length
+_BLOCK = struct.Struct("<qi4xq")            # Block: offset, metaDataLength, bodyLength
+
+
+class ArrowWriter:
+    """
+    Streams record batches to an Arrow IPC file.
+
+        with ArrowWriter("w.arrow", [("b1", "f8"), ("label", "utf8")]) as w:
+            w.append(b1=0.4, label="essential")        # row at a time, or
+            w.write_batch({"b1": arr, "label": labels})
+    """
+
+    def __init__(self, path: str, schema: Sequence[Tuple[str, str]],
+                 batch_rows: int = 65536, metadata: Optional[Dict[str, str]] = None):
+        for name, typ in schema:
+            if typ not in TYPES:
+                raise ValueError(f"column {name}: unsupported type {typ!r}")
+        self.path = path
+        self.schema = list(schema)
+        self.batch_rows = batch_rows
+        self.metadata = metadata or {}
+        self.rows = 0
+        self._pending: Dict[str, list] = {n: [] for n, _ in self.schema}
+        self._blocks: List[bytes] = []
+        self._f = open(path, "wb")
+        self._f.write(MAGIC + b"\0\0")
+        self._message(HDR_SCHEMA, self._schema_fields(), b"")
+
+    def __enter__(self) -> "ArrowWriter":
+        return self
+
+    def __exit__(self, *exc) -> None:
+        self.close()
+
+    def _schema_fields(self) -> list:
+        fields = []
+        for name, typ in self.schema:
+            tag, tfields, _ = TYPES[typ]
+            fields.append([(0, "str", name), (1, "bool", False), (2, "u8", tag),
+                           (3, "table", [(s, k, v) for s, k, v in tfields]), (5, "tables", [])])
+        out = [(0, "i16", 0), (1, "tables", fields)]
+        if self.metadata:
+            out.append((2, "tables", [[(0, "str", k), (1, "str", str(v))]
+                                      for k, v in self.metadata.items()]))
+        return out
+
+    def _message(self, header_type: int, header: list, body: bytes) -> None:
+        meta = _Builder().finish([(0, "i16", V5), (1, "u8", header_type), (2, "table", header),
+                                  (3, "i64", len(body))])
+        pos = self._f.tell()
+        self._f.write(struct.pack("<Ii", CONT, len(meta)))
+        self._f.write(meta)
+        self._f.write(body)
+        if header_type == HDR_BATCH:
+            self._blocks.append(_BLOCK.pack(pos, 8 + len(meta), len(body)))
+
+    def append(self, **row) -> None:
+        for name, _ in self.schema:
+            self._pending[name].append(row[name])
+        if len(self._pending[self.schema[0][0]]) >= self.batch_rows:
+            self.flush()
+
+    def flush(self) -> None:
+        if self._pending[self.schema[0][0]]:
+            cols, self._pending = self._pending, {n: [] for n, _ in self.schema}
+            self.write_batch(cols)
+
+    def write_batch(self, cols: Dict[str, Sequence]) -> None:
+        """One record batch; columns are sequences or NumPy arrays of equal length."""
+        n = len(cols[self.schema[0][0]])
+        body = bytearray()
+        nodes, bufs = [], []
+
+        def put(raw) -> None:
+            bufs.append(_BUF.pack(len(body), len(raw)))
+            body.extend(raw)
+            body.extend(bytes(-len(body) % 8))
+
+        for name, typ in self.schema:
+            col = cols[name]
+            if len(col) != n:
+                raise ValueError(f"column {name}: {len(col)} rows, expected {n}")
+            nodes.append(_NODE.pack(n, 0))
+            put(b"")                                       # validity: no nulls
+            if typ == "utf8":
+                raw = [("" if s is None else str(s)).encode() for s in col]
+                offs = np.zeros(n + 1, dtype="<i4")
+                np.cumsum([len(r) for r in raw], out=offs[1:])
+                put(offs.tobytes())
+                put(b"".join(raw))
+            elif typ == "bool":
+                put(np.packbits(np.asarray(col, dtype=bool), bitorder="little").tobytes())
+            else:
+                put(np.ascontiguousarray(col, dtype=TYPES[typ][2]).tobytes())
+        self._message(HDR_BATCH, [(0, "i64", n), (1, "structs", (b"".join(nodes), len(nodes))),
+                                  (2, "structs", (b"".join(bufs), len(bufs)))], bytes(body))
+        self.rows += n
+
+    def close(self) -> None:
+        if self._f.closed:
+            return
+        self.flush()
+        self._f.write(struct.pack("<Ii", CONT, 0))
+        footer = _Builder().finish([(0, "i16", V5), (1, "table", self._schema_fields()),
+                                    (2, "structs", (b"", 0)),
+                                    (3, "structs", (b"".join(self._blocks), len(self._blocks)))])
+        self._f.write(footer)
+        self._f.write(struct.pack("<i", len(footer)) + MAGIC)
+        self._f.close()
+
+
+# ──────────────────────────────────────────────
+# Reader
+# ──────────────────────────────────────────────
+
+def _column_type(field: _Table) -> str:
+    tag = field.scalar(2, "<B")
+    t = field.table(3)
+    if tag == _FLOAT:
+        return {1: "f4", 2: "f8"}[t.scalar(0, "<h")]
+    if tag == _INT:
+        bits, signed = t.scalar(0, "<i"), t.scalar(1, "<?")
+        return {(8, True): "i1", (32, True): "i4", (64, True): "i8", (32, False): "u4"}[(bits, signed)]
+    if tag == _BOOL:
+        return "bool"
+    if tag == _UTF8:
+        return "utf8"
+    raise ValueError(f"unsupported Arrow type tag {tag}")
+
+
+class ArrowFile:
+    """An Arrow IPC file mapped read-only; numeric columns are views on the map."""
+
+    def __init__(self, path: str):
+        with open(path, "rb") as f:
+            self.map = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+        m = self.map
+        if m[:6] != MAGIC or m[-6:] != MAGIC:
+            raise ValueError(f"{path}: not an Arrow IPC file")
+        flen = struct.unpack_from("<i", m, len(m) - 10)[0]
+        footer = _Table.root(m, len(m) - 10 - flen)
+        schema = footer.table(1)
+        self.schema = [(f.string(0), _column_type(f)) for f in schema.tables(1)]
+        self.metadata = {kv.string(0): kv.string(1) for kv in schema.tables(2)}
+        self.blocks = footer.structs(3, "<qi4xq")
+        self.rows = 0
+        for off, _, _ in self.blocks:
+            self.rows += _Table.root(m, off + 8).table(2).scalar(0, "<q")
+
+    def batches(self, columns: Optional[Sequence[str]] = None) -> Iterator[Dict[str, np.ndarray]]:
+        m = self.map
+        want = set(columns) if columns else None
+        for off, meta_len, _ in self.blocks:
+            rb = _Table.root(m, off + 8).table(2)
+            n = rb.scalar(0, "<q")
+            if any(nulls for _, nulls in rb.structs(1, "<qq")):
+                raise ValueError("batch has nulls; this reader only handles null-free columns")
+            bufs = rb.structs(2, "<qq")
+            body = off + meta_len
+            cols, k = {}, 0
+            for name, typ in self.schema:
+                if want is not None and name not in want:
+                    k += 3 if typ == "utf8" else 2
+                elif typ == "utf8":
+                    (o_off, _), (d_off, d_len) = bufs[k + 1], bufs[k + 2]
+                    offs = np.frombuffer(m, "<i4", n + 1, body + o_off)
+                    data = m[body + d_off:body + d_off + d_len]
+                    cols[name] = np.array([data[a:b].decode() for a, b in zip(offs[:-1], offs[1:])],
+                                          dtype=object)
+                    k += 3
+                elif typ == "bool":
+                    v_off, v_len = bufs[k + 1]
+                    bits = np.frombuffer(m, np.uint8, v_len, body + v_off)
+                    cols[name] = np.unpackbits(bits, bitorder="little")[:n].astype(bool)
+                    k += 2
+                else:
+                    cols[name] = np.frombuffer(m, TYPES[typ][2], n, body + bufs[k + 1][0])
+                    k += 2
+            yield cols
+
+    def read(self, columns: Optional[Sequence[str]] = None) -> Dict[str, np.ndarray]:
+        """Whole columns; zero-copy when the file holds a single batch."""
+        names = list(columns) if columns else [n for n, _ in self.schema]
+        parts: Dict[str, list] = {n: [] for n in names}
+        for b in self.batches(names):
+            for n in names:
+                parts[n].append(b[n])
+        return {n: p[0] if len(p) == 1 else np.concatenate(p) if p else np.empty(0)
+                for n, p in parts.items()}
+
+
+def read(path: str, columns: Optional[Sequence[str]] = None) -> Dict[str, np.ndarray]:
+    return ArrowFile(path).read(columns)
+
+
+def describe(path: str) -> str:
+    f = ArrowFile(path)
+    return json.dumps({"rows": f.rows, "batches": len(f.blocks),
+                       "schema": dict(f.schema), "metadata": f.metadata})
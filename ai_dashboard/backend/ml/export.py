@@ -0,0 +1,220 @@
+"""
+Exports recorded device data as Arrow IPC files (ml/arrow_ipc.py), so
+training code can memory-map it instead of parsing CSV.
+
+Usage:
+  # Gateway recordings (<root>/<device>/<start>.sse), optionally with raw samples
+  python -m ml.export sessions ../rec -o windows.arrow --samples samples.arrow
+
+  # Flash-log backfill (<root>/<device>/log-<epoch>.jsonl)
+  python -m ml.export backfill ../backfill -o windows.arrow
+
+  # Train on it
+  python -m ml.train_model --from-arrow windows.arrow
+
+windows.arrow has one row per window: device, session, t, gated,
+device_type (the firmware's label), score, confidence, the FEATURE_NAMES
+columns, and label / label_idx from the rule-based labeller (gated
+windows are no_tremor). samples.arrow has one row per raw sample (ax, ay,
+az) plus `window`, the row in windows.arrow of the window it belongs to
+(-1 for samples after a session's last window).
+
+    cols = arrow_ipc.read("windows.arrow")          # NumPy views, no parsing
+    df = pandas.read_feather("windows.arrow")       # or pyarrow.ipc.open_file
+
+Input is read in chunks and output goes out one record batch at a time.
+At most one batch of windows and one window of samples are held in memory.
+"""
+
+import argparse
+import json
+import os
+import time
+from pathlib import Path
+from typing import Iterator, Optional, Tuple
+
+import numpy as np
+
+from gateway.records import SseParser
+from ml.arrow_ipc import ArrowWriter
+from ml.features import (
+    CLASSES,
+    CLASS_TO_IDX,
+    FEATURE_NAMES,
+    extract_features_columns,
+    label_window_rule_based,
+)
+
+WINDOW_S = 128 / 50.0
+CHUNK = 16384                 # bytes per SseParser.feed()
+
+WINDOW_SCHEMA = (
+    [("device", "utf8"), ("session", "utf8"), ("t", "f8"), ("gated", "bool"),
+     ("device_type", "utf8"), ("score", "f4"), ("confidence", "f4")]
+    + [(n, "f8") for n in FEATURE_NAMES]
+    + [("label", "utf8"), ("label_idx", "i1")]
+)
+SAMPLE_SCHEMA = [("window", "i8"), ("ax", "f4"), ("ay", "f4"), ("az", "f4")]
+_RAW = ("device", "session", "t", "gated", "device_type", "score", "confidence",
+        "b1", "b2", "b3", "meanNorm")
+
+
+class WindowExport:
+    """Collects window rows and writes them a batch at a time, with features and labels."""
+
+    def __init__(self, path: str, batch_rows: int = 65536, source: str = ""):
+        self.w = ArrowWriter(path, WINDOW_SCHEMA, batch_rows, metadata={
+            "tremor.source": source, "tremor.classes": json.dumps(CLASSES),
+            "tremor.features": json.dumps(FEATURE_NAMES)})
+        self.batch_rows = batch_rows
+        self._cols = {k: [] for k in _RAW}
+        self.rows = 0                        # row number the next window gets
+
+    def add(self, **row) -> int:
+        for k in _RAW:
+            self._cols[k].append(row[k])
+        self.rows += 1
+        if len(self._cols["t"]) >= self.batch_rows:
+            self.flush()
+        return self.rows - 1
+
+    def flush(self) -> None:
+        c = self._cols
+        if not c["t"]:
+            return
+        out = {k: c[k] for k in ("device", "session", "t", "gated", "device_type", "score",
+                                 "confidence")}
+        out.update(extract_features_columns(c["b1"], c["b2"], c["b3"], c["meanNorm"]))
+        labels = ["no_tremor" if g else label_window_rule_based(b1, b2, b3, mn)
+                  for g, b1, b2, b3, mn in zip(c["gated"], c["b1"], c["b2"], c["b3"], c["meanNorm"])]
+        out["label"] = labels
+        out["label_idx"] = np.array([CLASS_TO_IDX[x] for x in labels], dtype=np.int8)
+        self.w.write_batch(out)
+        self._cols = {k: [] for k in _RAW}
+
+    def close(self) -> None:
+        self.flush()
+        self.w.close()
+
+
+# ──────────────────────────────────────────────
+# Sources
+# ──────────────────────────────────────────────
+
+def _files(root: str, suffix: str) -> Iterator[Tuple[str, str, str]]:
+    """(path, device, session) for every matching file, in a stable order."""
+    for d, dirs, files in os.walk(root):
+        dirs.sort()
+        for f in sorted(files):
+            if f.endswith(suffix):
+                path = os.path.join(d, f)
+                rel = os.path.relpath(path, root)[:-len(suffix)].replace(os.sep, "/")
+                yield path, os.path.basename(d), rel
+
+
+def _frames(path: str) -> Iterator[Tuple[str, str]]:
+    parser = SseParser()
+    with open(path, "rb") as f:
+        while True:
+            chunk = f.read(CHUNK)
+            if not chunk:
+                yield from parser.finish()
+                return
+            yield from parser.feed(chunk)
+
+
+def export_sessions(root: str, windows: WindowExport,
+                    samples: Optional[ArrowWriter] = None) -> dict:
+    n_files = n_samples = 0
+    for path, device, session in _files(root, ".sse"):
+        n_files += 1
+        k = 0                                   # window index within the session
+        pend = []                               # samples of the window in progress
+        for event, data in _frames(path):
+            if event == "sample":
+                if samples is not None:
+                    try:
+                        d = json.loads(data)
+                        pend.append((d["ax"], d["ay"], d["az"]))
+                    except (ValueError, KeyError):
+                        pass
+                continue
+            if event not in ("bands", "gated"):
+                continue
+            try:
+                d = json.loads(data)
+            except ValueError:
+                continue
+            gated = event == "gated"
+            row = windows.add(
+                device=device, session=session, t=float(d.get("t", k * WINDOW_S)), gated=gated,
+                device_type=d.get("type", ""), score=d.get("score", 0.0),
+                confidence=d.get("confidence", 0.0), b1=0.0 if gated else d.get("b1", 0.0),
+                b2=0.0 if gated else d.get("b2", 0.0), b3=0.0 if gated else d.get("b3", 0.0),
+                meanNorm=d.get("meanNorm", 0.0))
+            k += 1
+            if pend:
+                n_samples += _put_samples(samples, row, pend)
+                pend = []
+        if pend:
+            n_samples += _put_samples(samples, -1, pend)
+    return {"files": n_files, "samples": n_samples}
+
+
+def _put_samples(w: ArrowWriter, row: int, pend: list) -> int:
+    for x, y, z in pend:
+        w.append(window=row, ax=x, ay=y, az=z)
+    return len(pend)
+
+
+def export_backfill(root: str, windows: WindowExport) -> dict:
+    n_files = gaps = 0
+    for path, device, session in _files(root, ".jsonl"):
+        n_files += 1
+        with open(path, "rb") as f:
+            for line in f:
+                try:
+                    d = json.loads(line)
+                except ValueError:
+                    continue                    # torn tail: backfill cuts it on next sync
+                if "gap" in d:
+                    gaps += 1
+                    continue
+                windows.add(device=device, session=session, t=d["ms"] / 1000.0,
+                            gated=d["gated"], device_type=d["type"], score=d["score"],
+                            confidence=d["conf"], b1=d["p1"], b2=d["p2"], b3=d["p3"],
+                            meanNorm=d["meanNorm"])
+    return {"files": n_files, "gaps": gaps}
+
+
+# ──────────────────────────────────────────────
+# CLI
+# ──────────────────────────────────────────────
+def main():
+    parser = argparse.ArgumentParser(description="Export recorded data as Arrow IPC for training")
+    parser.add_argument("source", choices=["sessions", "backfill"])
+    parser.add_argument("root", help="recorder or backfill output directory")
+    parser.add_argument("-o", "--out", default="windows.arrow", help="window table")
+    parser.add_argument("--samples", metavar="PATH",
+                        help="sessions: also write raw samples to PATH")
+    parser.add_argument("--batch", type=int, default=65536, help="rows per record batch")
+    args = parser.parse_args()
+
+    t0 = time.perf_counter()
+    windows = WindowExport(args.out, args.batch, source=f"{args.source}:{Path(args.root).name}")
+    samples = ArrowWriter(args.samples, SAMPLE_SCHEMA, args.batch) if args.samples else None
+    try:
+        if args.source == "sessions":
+            r = export_sessions(args.root, windows, samples)
+        else:
+            r = export_backfill(args.root, windows)
+    finally:
+        windows.close()
+        if samples is not None:
+            samples.close()
+    print(json.dumps({**r, "windows": windows.rows, "out": args.out,
+                      "seconds": round(time.perf_counter() - t0, 2)}))
+
+
+if __name__ == "__main__":
+    main()
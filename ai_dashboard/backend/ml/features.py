@@ -69,6 +69,24 @@ def extract_features_batch(windows: list[dict]) -> np.ndarray:
     return np.array(rows)
 
 
+def extract_features_columns(b1, b2, b3, mean_norm) -> dict[str, np.ndarray]:
+    """
+    Column-wise version of extract_features_batch for exporters: arrays of
+    band powers and meanNorm in, one array per FEATURE_NAMES entry out.
+    """
+    eps = 1e-6
+    bands = np.vstack([np.asarray(b1, np.float64), np.asarray(b2, np.float64),
+                       np.asarray(b3, np.float64)])
+    total = bands.sum(axis=0)
+    return {
+        "b1": bands[0], "b2": bands[1], "b3": bands[2],
+        "total_power": total,
+        "meanNorm": np.asarray(mean_norm, np.float64),
+        "dom_ratio": bands.max(axis=0) / (bands.min(axis=0) + eps),
+        "spectral_centroid": (bands[1] + 2 * bands[2]) / (total + eps),
+    }
+
+
 def label_window_rule_based(b1: float, b2: float, b3: float,
                              mean_norm: float = 0.0) -> str:
     """
@@ -8,8 +8,14 @@ Usage:
   # Augment with real session data from profiles.db, then train
   python -m ml.train_model --augment-from-db
 
+  # Augment with windows exported as Arrow (python -m ml.export ...)
+  python -m ml.train_model --from-arrow windows.arrow
+
   # Only generate and save synthetic CSV (for inspection)
   python -m ml.train_model --export-csv
+
+  # Same, as Arrow IPC (memory-mappable from NumPy/pandas/pyarrow)
+  python -m ml.train_model --export-arrow
 """
 
 import argparse
@@ -232,6 +238,26 @@ def load_real_data_from_db() -> tuple[np.ndarray, np.ndarray] | None:
     return np.array(X_all), np.array(y_all)
 
 
+# ──────────────────────────────────────────────
+# Augment from exported windows (Arrow IPC)
+# ──────────────────────────────────────────────
+def load_real_data_from_arrow(path: str) -> tuple[np.ndarray, np.ndarray] | None:
+    """
+    Load an ml.export window table. The feature columns are views on the
+    memory-mapped file; only the stacking into X copies.
+    """
+    from ml.arrow_ipc import read
+
+    cols = read(path, FEATURE_NAMES + ["label_idx"])
+    if not len(cols["label_idx"]):
+        print(f"  ⚠ No windows in {path}")
+        return None
+    X = np.column_stack([cols[n] for n in FEATURE_NAMES])
+    y = cols["label_idx"].astype(np.int64)
+    print(f"  ✓ Loaded {len(X)} windows from {path}")
+    return X, y
+
+
 # ──────────────────────────────────────────────
 # Training
 # ──────────────────────────────────────────────
@@ -327,8 +353,12 @@ def main():
     parser = argparse.ArgumentParser(description="Train tremor RF classifier")
     parser.add_argument("--augment-from-db", action="store_true",
                         help="Augment synthetic data with real sessions from profiles.db")
+    parser.add_argument("--from-arrow", metavar="PATH",
+                        help="Augment with windows exported by ml.export (Arrow IPC)")
     parser.add_argument("--export-csv", action="store_true",
                         help="Export synthetic data to CSV for inspection")
+    parser.add_argument("--export-arrow", action="store_true",
+                        help="Export the training set to Arrow IPC (training_data.arrow)")
     parser.add_argument("--n-per-class", type=int, default=1500,
                         help="Number of synthetic samples per class (default: 1500)")
     parser.add_argument("--n-estimators", type=int, default=150,
@@ -358,6 +388,14 @@ def main():
             y = np.concatenate([y, y_real_up])
             print(f"  ✓ Total training set: {len(X)} samples")
 
+    if args.from_arrow:
+        print(f"\n► Loading exported windows from {args.from_arrow}...")
+        real = load_real_data_from_arrow(args.from_arrow)
+        if real is not None:
+            X = np.vstack([X, np.tile(real[0], (3, 1))])
+            y = np.concatenate([y, np.tile(real[1], 3)])
+            print(f"  ✓ Total training set: {len(X)} samples")
+
     # Step 3: Export CSV (optional)
     if args.export_csv:
         import csv
@@ -370,6 +408,19 @@ def main():
                 writer.writerow(list(xi) + [CLASSES[yi]])
         print(f"\n  ✓ CSV exported to {csv_path}")
 
+    if args.export_arrow:
+        from ml.arrow_ipc import ArrowWriter
+        arrow_path = MODEL_DIR / "training_data.arrow"
+        MODEL_DIR.mkdir(parents=True, exist_ok=True)
+        schema = [(n, "f8") for n in FEATURE_NAMES] + [("label", "utf8"), ("label_idx", "i1")]
+        with ArrowWriter(str(arrow_path), schema,
+                         metadata={"tremor.classes": json.dumps(CLASSES)}) as w:
+            for i in range(0, len(X), w.batch_rows):
+                xb, yb = X[i:i + w.batch_rows], y[i:i + w.batch_rows]
+                w.write_batch({**{n: xb[:, j] for j, n in enumerate(FEATURE_NAMES)},
+                               "label": [CLASSES[k] for k in yb], "label_idx": yb})
+        print(f"\n  ✓ Arrow exported to {arrow_path}")
+
     # Step 4: Train
     clf = train_random_forest(X, y,
                                n_estimators=args.n_estimators,
@@ -0,0 +1,148 @@
+"""
+Round-trip checks for ml/arrow_ipc.py and the exporter (no pyarrow needed).
+Usage:
+    python test_arrow.py
+Exits non-zero if any check fails.
+"""
+
+import os
+import shutil
+import struct
+import sys
+import tempfile
+
+import numpy as np
+
+from ml import arrow_ipc
+from ml.arrow_ipc import ArrowFile, ArrowWriter
+from ml.export import SAMPLE_SCHEMA, WindowExport, export_sessions
+
+CAPTURE = os.path.join(os.path.dirname(__file__), "gateway", "testdata", "events.sse")
+
+passed = 0
+failed = 0
+
+
+def report(name: str, ok: bool, detail: str = ""):
+    global passed, failed
+    icon = "✅" if ok else "❌"
+    print(f"  {icon} {name}")
+    if detail:
+        print(f"     ↳ {detail}")
+    if ok:
+        passed += 1
+    else:
+        failed += 1
+
+
+# ── writer → reader ───────────────────────────────────
+SCHEMA = [("f", "f8"), ("g", "f4"), ("i", "i1"), ("j", "i4"), ("k", "i8"), ("u", "u4"),
+          ("ok", "bool"), ("s", "utf8")]
+
+
+def rows(n: int) -> dict:
+    r = np.arange(n)
+    return {"f": r * 0.5, "g": (r * 0.25).astype(np.float32), "i": (r % 100 - 50).astype(np.int8),
+            "j": r * -3, "k": r * 1_000_000_007, "u": r * 7, "ok": r % 3 == 0,
+            "s": ["" if x % 5 == 0 else "ü" * (x % 4) + str(x) for x in r]}
+
+
+def test_roundtrip(tmp: str):
+    print("Writer → reader")
+    path = os.path.join(tmp, "t.arrow")
+    want = rows(23)
+    # 23 rows, 10 per batch: row-at-a-time batches of 10, 10 and 3
+    with ArrowWriter(path, SCHEMA, batch_rows=10,
+                     metadata={"tremor.source": "test", "empty": ""}) as w:
+        for x in range(23):
+            w.append(**{k: v[x] for k, v in want.items()})
+    f = ArrowFile(path)
+    ok = len(f.blocks) == 3 and f.rows == 23 and f.schema == SCHEMA
+    report("three batches, schema and row count", ok, "" if ok else f"{len(f.blocks)} {f.rows}")
+    ok = f.metadata == {"tremor.source": "test", "empty": ""}
+    report("schema metadata", ok, "" if ok else str(f.metadata))
+    got = f.read()
+    bad = [k for k, v in want.items()
+           if not np.array_equal(got[k], np.asarray(v, dtype=got[k].dtype))]
+    report("every column survives across batches", not bad, ", ".join(bad))
+    ok = got["ok"].dtype == bool and list(got["ok"][:4]) == [True, False, False, True]
+    report("bool bits unpacked per batch", ok)
+    ok = list(got["s"][:5]) == ["", "ü1", "üü2", "üüü3", "4"]
+    report("utf8 including empty and multi-byte", ok, "" if ok else str(got["s"][:5]))
+    part = f.read(["s", "k"])
+    ok = list(part) == ["s", "k"] and np.array_equal(part["k"], want["k"])
+    report("column subset skips the other buffers", ok)
+    f.map.close()
+
+    # one write_batch: numeric columns are views on the map
+    path1 = os.path.join(tmp, "one.arrow")
+    with ArrowWriter(path1, SCHEMA) as w:
+        w.write_batch(rows(5))
+    f = ArrowFile(path1)
+    col = f.read()["f"]
+    ok = not col.flags.owndata and np.array_equal(col, rows(5)["f"])
+    report("single batch read is zero-copy", ok)
+    del col
+    f.map.close()
+
+    # a null count on any column is refused, not read as values
+    with open(path1, "r+b") as fh:
+        raw = bytearray(fh.read())
+        node = arrow_ipc._NODE.pack(5, 0)
+        at = raw.index(node, raw.index(b"\xff\xff\xff\xff", 16))
+        struct.pack_into("<qq", raw, at, 5, 1)
+        fh.seek(0)
+        fh.write(raw)
+    f = ArrowFile(path1)
+    try:
+        f.read()
+        ok = False
+    except ValueError as e:
+        ok = "nulls" in str(e)
+    f.map.close()
+    report("batch with a non-zero null count rejected", ok)
+
+
+# ── exporter ──────────────────────────────────────────
+def test_export(tmp: str):
+    print("Session export (windows + samples)")
+    root = os.path.join(tmp, "rec", "dev1")
+    os.makedirs(root)
+    shutil.copy(CAPTURE, os.path.join(root, "s1.sse"))
+    wpath, spath = os.path.join(tmp, "w.arrow"), os.path.join(tmp, "s.arrow")
+    windows = WindowExport(wpath, batch_rows=4, source="test")
+    samples = ArrowWriter(spath, SAMPLE_SCHEMA, batch_rows=100)
+    r = export_sessions(os.path.join(tmp, "rec"), windows, samples)
+    windows.close()
+    samples.close()
+
+    with open(CAPTURE, "rb") as fh:
+        text = fh.read().decode()
+    n_win = text.count("event: bands\r\n") + text.count("event: gated\r\n")
+    n_smp = text.count("event: sample\r\n")
+    wf, sf = ArrowFile(wpath), ArrowFile(spath)
+    w, s = wf.read(), sf.read()
+    ok = wf.rows == windows.rows == n_win and len(wf.blocks) == -(-n_win // 4)
+    report("one window row per bands/gated event", ok, "" if ok else f"{wf.rows} vs {n_win}")
+    ok = sf.rows == r["samples"] == n_smp and len(sf.blocks) > 1
+    report("one sample row per sample event", ok, "" if ok else f"{sf.rows} vs {n_smp}")
+    idx = s["window"]
+    ok = np.all(np.diff(idx[idx >= 0]) >= 0) and idx.max() == n_win - 1 and \
+        set(w["device"]) == {"dev1"} and w["gated"].any() and not w["gated"].all()
+    report("samples point at their window rows", bool(ok))
+    ok = "tremor.classes" in wf.metadata and wf.metadata["tremor.source"] == "test"
+    report("window file metadata", ok)
+    wf.map.close()
+    sf.map.close()
+
+
+def main() -> int:
+    with tempfile.TemporaryDirectory() as tmp:
+        test_roundtrip(tmp)
+        test_export(tmp)
+    print(f"\n{passed} passed, {failed} failed")
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
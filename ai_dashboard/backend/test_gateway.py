@@ -0,0 +1,624 @@
+"""
+Offline checks for the gateway package (no device, no network beyond
+loopback).
+Usage:
+    python test_gateway.py
+Exits non-zero if any check fails.
+"""
+
+import asyncio
+import json
+import multiprocessing as mp
+import os
+import socket
+import struct
+import sys
+import tempfile
+import threading
+import time
+import zlib
+
+from gateway.alerts import LatencyHistogram
+from gateway import backfill
+from gateway.align import Aligner
+from gateway.fanout import Fanout
+from gateway.recorder import Recorder
+from gateway.records import HELLO, Record, SseParser, encode_frame, split_frames
+from gateway.replay import WINDOW_EVENTS, timeline
+from gateway.server import Gateway
+from gateway.shard import Shard, shard_of
+
+# What the firmware serves on /events and pushes after its hello; written by
+# tools/capture_events (see its header to regenerate).
+CAPTURE = os.path.join(os.path.dirname(__file__), "gateway", "testdata", "events.sse")
+
+passed = 0
+failed = 0
+
+
+def report(name: str, ok: bool, detail: str = ""):
+    global passed, failed
+    icon = "✅" if ok else "❌"
+    print(f"  {icon} {name}")
+    if detail:
+        print(f"     ↳ {detail}")
+    if ok:
+        passed += 1
+    else:
+        failed += 1
+
+
+# ── SSE framing ───────────────────────────────────────
+def test_framing():
+    print("SSE framing")
+    frame = b'event: bands\r\ndata: {"b1":0.1}\r\n\r\n'
+    report("CRLF frame (AsyncEventSource)", SseParser().feed(frame) == [("bands", '{"b1":0.1}')])
+    report("LF frame", SseParser().feed(frame.replace(b"\r\n", b"\n")) == [("bands", '{"b1":0.1}')])
+    p = SseParser()
+    got = p.feed(frame.replace(b"\r\n", b"\r"))
+    report("CR frame, released by finish()", got == [] and p.finish() == [("bands", '{"b1":0.1}')])
+
+    stream = (b"event: a\r\ndata: 1\r\n\r\n" b"event: b\ndata: 2\n\n"
+              b"event: c\rdata: 3\r\r\n" b"event: d\r\ndata: 4\n\r\n" b": comment\n\n")
+    want = [("a", "1"), ("b", "2"), ("c", "3"), ("d", "4")]
+    p, got = SseParser(), []
+    for i in range(len(stream)):
+        got += p.feed(stream[i:i + 1])
+    got += p.finish()
+    report("mixed endings fed byte by byte", got == want, str(got) if got != want else "")
+
+    enc = encode_frame("gated", {"t": 1.5})
+    report("encode_frame writes CRLF", enc == b'event: gated\r\ndata: {"t":1.5}\r\n\r\n')
+    spans = list(split_frames(enc * 3))
+    want = [(len(enc) * k + len(enc) - 4, len(enc) * (k + 1)) for k in range(3)]
+    report("split_frames offsets", spans == want, "" if spans == want else str(spans))
+
+
+# ── device push ───────────────────────────────────────
+def test_push():
+    print("Device push (tools/capture_events output)")
+    with open(CAPTURE, "rb") as f:
+        capture = f.read()
+    push = HELLO + b"tremor-host\n" + capture
+    gw = Gateway()
+    got = []
+    gw.add_sink(got.append)
+
+    async def run():
+        dev, gw_end = socket.socketpair()
+        dev.setblocking(False)
+        task = asyncio.create_task(gw.adopt(gw_end))
+        loop = asyncio.get_running_loop()
+        # odd-sized writes so frames and CRLF pairs straddle reads
+        for i in range(0, len(push), 997):
+            await loop.sock_sendall(dev, push[i:i + 997])
+        dev.shutdown(socket.SHUT_WR)
+        await asyncio.wait_for(task, 5)
+        dev.close()
+
+    asyncio.run(run())
+    ok = gw.bytes_in == len(capture)
+    report("every byte read", ok, "" if ok else f"{gw.bytes_in} of {len(capture)}")
+    report("device id from the hello", got and all(r.device == "tremor-host" for r in got))
+    win = [r for r in got if r.kind in ("bands", "gated", "quality")]
+    kinds = {k: sum(r.kind == k for r in got) for k in ("bands", "gated", "quality", "sample")}
+    ok = (kinds["bands"] > 0 and kinds["gated"] > 0 and kinds["sample"] > 0
+          and kinds["quality"] == kinds["bands"] + kinds["gated"])
+    report("window events arrive", ok, "" if ok else str(kinds))
+    report("window events keep the device time",
+           all(r.t_dev == r.data["t"] for r in win))
+    q = [r for r in win if r.kind == "quality"]
+    seqs = [r.data["seq"] for r in q]
+    ts = [r.t_dev for r in q]
+    ok = seqs == list(range(len(q)))
+    report("seq runs 0..n-1", ok, "" if ok else str(seqs))
+    ok = all(b > a for a, b in zip(ts, ts[1:])) and ts[0] < 2 ** 32 / 1000 < ts[-1]
+    report("t rises across the millis() wrap", ok, "" if ok else f"{ts[0]} .. {ts[-1]}")
+
+
+# ── replay timeline ───────────────────────────────────
+def test_timeline():
+    print("Replay timeline (captured /events)")
+    with open(CAPTURE, "rb") as f:
+        capture = f.read()
+    p = SseParser()
+    frames = p.feed(capture) + p.finish()
+    times, ends = timeline(capture)
+    ok = len(ends) == len(frames) and ends[-1] == len(capture)
+    report("one slice per frame, covering the file", ok,
+           "" if ok else f"{len(ends)} slices for {len(frames)} frames, last ends at {ends[-1]} of {len(capture)}")
+    report("slices end after a blank line", all(capture[e - 4:e] == b"\r\n\r\n" for e in ends))
+    win = [(times[i], json.loads(d)["t"]) for i, (ev, d) in enumerate(frames) if ev in WINDOW_EVENTS]
+    ok = len(win) > 1 and all(abs((b[0] - a[0]) - (b[1] - a[1])) < 1e-6 for a, b in zip(win, win[1:]))
+    report("window events play at their device t", ok)
+    ok = all(b >= a for a, b in zip(times, times[1:]))
+    report("times never go back", ok)
+    for name, sep in (("LF", b"\n"), ("CR", b"\r")):
+        conv = capture.replace(b"\r\n", sep)
+        t2, e2 = timeline(conv)
+        ok = len(e2) == len(ends) and e2[-1] == len(conv) and list(t2) == list(times)
+        report(f"same timeline with {name} line endings", ok)
+
+
+# ── alert latency ─────────────────────────────────────
+def test_latency():
+    print("Alert latency histogram")
+    h = LatencyHistogram()
+    for ms in (0.3, 0.4, 0.5, 1.1, 1.2, 3.0):
+        h.add(ms)
+    q = [h.quantile(x) for x in (0.5, 0.99, 1.0)]
+    ok = all(v <= 3.0 for v in q) and q[-1] == 3.0
+    report("quantiles never above the max seen", ok, "" if ok else str(q))
+    report("p50 is its bucket's upper edge", q[0] == 0.512, str(q[0]) if q[0] != 0.512 else "")
+    h = LatencyHistogram(buckets=4)
+    h.add(50.0)
+    ok = h.quantile(0.5) == 50.0
+    report("open-ended last bucket reports the max", ok, "" if ok else str(h.quantile(0.5)))
+
+
+# ── fan-out ───────────────────────────────────────────
+async def ws_open(port: int, path: str, ext: str = ""):
+    r, w = await asyncio.open_connection("127.0.0.1", port)
+    w.write(f"GET {path} HTTP/1.1\r\nHost: x\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+            f"Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n".encode()
+            + (f"Sec-WebSocket-Extensions: {ext}\r\n".encode() if ext else b"") + b"\r\n")
+    head = await asyncio.wait_for(r.readuntil(b"\r\n\r\n"), 2)
+    return r, w, head.decode()
+
+
+async def ws_read(r: asyncio.StreamReader) -> bytes:
+    """One whole server frame, header included."""
+    h = await asyncio.wait_for(r.readexactly(2), 2)
+    n = h[1] & 0x7F
+    if n == 126:
+        x = await r.readexactly(2)
+        h, n = h + x, struct.unpack("!H", x)[0]
+    elif n == 127:
+        x = await r.readexactly(8)
+        h, n = h + x, struct.unpack("!Q", x)[0]
+    return h + await r.readexactly(n)
+
+
+def ws_payload(frame: bytes) -> bytes:
+    n = frame[1] & 0x7F
+    return frame[2 + (2 if n == 126 else 8 if n == 127 else 0):]
+
+
+def test_fanout():
+    print("Fan-out (/ws, /z)")
+    out = {}
+
+    async def run():
+        fan = Fanout(tick=3600)            # flushed by hand below
+        srv = await asyncio.start_server(fan.handle, "127.0.0.1", 0)
+        port = srv.sockets[0].getsockname()[1]
+        subs = {
+            "plain": await ws_open(port, "/ws/ward"),
+            "d1": await ws_open(port, "/ws/ward", "permessage-deflate; client_max_window_bits"),
+            "d2": await ws_open(port, "/ws/ward", "permessage-deflate"),
+            "w10": await ws_open(port, "/ws/ward", "permessage-deflate; server_max_window_bits=10"),
+            "w8": await ws_open(port, "/ws/ward", "permessage-deflate; server_max_window_bits=8"),
+            "w8alt": await ws_open(port, "/ws/ward", "permessage-deflate; server_max_window_bits=8, "
+                                                     "permessage-deflate"),
+        }
+        out["heads"] = {k: v[2] for k, v in subs.items()}
+        # a repeat 2 KB back: a 15-bit window reaches it, a 10-bit one must not
+        blob = os.urandom(800).hex()
+        for k in range(3):
+            fan(Record("dev1", "bands", {"t": 1.0 + k, "score": 2.5, "blob": blob}, 1.0 + k))
+        out["raw"] = b"".join(fan.topics["ward"].pending)
+        fan.flush()
+        out["frames"] = {k: await ws_read(v[0]) for k, v in subs.items()}
+
+        # /z: A from the start, B joining at the third frame
+        za = await ws_open(port, "/z/dev/dev1")
+        got_a, got_b = [], []
+        inf_a = inf_b = None
+        lines = []
+        for k in range(3):
+            if k == 2:
+                zb = await ws_open(port, "/z/dev/dev1")
+            rec = Record("dev1", "track", {"f": 5.0 + k, "a": 0.01}, 10.0 + k)
+            fan(rec)
+            lines.append(b"".join(fan.topics["dev/dev1"].pending))
+            fan.flush()
+            f = await ws_read(za[0])
+            if ws_payload(f) == b"sync":
+                inf_a = zlib.decompressobj(-15)
+                f = await ws_read(za[0])
+            got_a.append(inf_a.decompress(ws_payload(f)))
+            if k == 2:
+                f = await ws_read(zb[0])
+                out["b_sync"] = ws_payload(f) == b"sync"
+                inf_b = zlib.decompressobj(-15)
+                got_b.append(inf_b.decompress(ws_payload(await ws_read(zb[0]))))
+        out["z"] = (lines, got_a, got_b)
+
+        # a client frame longer than a control frame may be
+        r, w, _ = await ws_open(port, "/ws/alerts")
+        w.write(bytes([0x89, 0x80 | 126]) + struct.pack("!H", 200) + b"\0" * 204)
+        out["close"] = await ws_read(r)
+
+        for v in list(subs.values()) + [za, zb, (r, w, "")]:
+            v[1].close()
+        srv.close()
+        while fan.topics:                  # handlers see EOF and unsubscribe
+            await asyncio.sleep(0.01)
+
+    asyncio.run(run())
+    heads, frames, raw = out["heads"], out["frames"], out["raw"]
+    ext = lambda k: [ln for ln in heads[k].split("\r\n") if ln.lower().startswith("sec-websocket-extensions")]
+    ok = heads["plain"].startswith("HTTP/1.1 101") and not ext("plain") and \
+        frames["plain"][0] & 0x40 == 0 and ws_payload(frames["plain"]) == raw
+    report("/ws without deflate: plain text frames", ok)
+    ok = ext("d2") == ["Sec-WebSocket-Extensions: permessage-deflate; server_no_context_takeover"] \
+        and ext("d1") == ext("d2")
+    report("/ws with deflate: negotiated", ok, "" if ok else str(ext("d1") + ext("d2")))
+    inflate = lambda f, bits: zlib.decompressobj(-bits).decompress(ws_payload(f) + b"\x00\x00\xff\xff")
+    ok = frames["d1"] == frames["d2"] and frames["d1"][0] & 0x40 and \
+        inflate(frames["d1"], 15) == raw and inflate(frames["d2"], 15) == raw
+    report("one deflated frame, same bytes for two subscribers, both inflate", bool(ok))
+    ok = ext("w10") == ["Sec-WebSocket-Extensions: permessage-deflate; server_no_context_takeover; "
+                        "server_max_window_bits=10"]
+    try:
+        ok = ok and inflate(frames["w10"], 10) == raw
+    except zlib.error as e:
+        ok = False
+        report("server_max_window_bits=10 honoured", ok, str(e))
+    else:
+        report("server_max_window_bits=10 honoured", ok)
+    ok = not ext("w8") and ws_payload(frames["w8"]) == raw
+    report("server_max_window_bits=8 declined, plain frames", ok)
+    ok = ext("w8alt") == ext("d2") and inflate(frames["w8alt"], 15) == raw
+    report("falls through to the next offer", ok)
+    lines, got_a, got_b = out["z"]
+    report("/z stream decodes frame after frame", got_a == lines, "" if got_a == lines else str(got_a))
+    ok = out["b_sync"] and got_b == lines[2:]
+    report("/z late join: sync, then decodes from the flush point", ok)
+    c = out["close"]
+    ok = c[0] & 0x0F == 8 and ws_payload(c) == struct.pack("!H", 1009)
+    report("oversized client frame closed with 1009", ok, "" if ok else c.hex())
+
+
+# ── backfill ──────────────────────────────────────────
+class FakeLog:
+    """/log/marks and /log/range as a device serves them, with hooks to misbehave."""
+
+    def __init__(self, epoch: int, lo: int, hi: int):
+        self.epoch, self.lo, self.hi = epoch, lo, hi
+        self.cut = None              # bytes of the next range body actually sent
+        self.on_range = None         # called with `from` before answering
+        self.reply_epoch = None      # X-Log-Epoch override
+
+    def rec(self, seq: int) -> bytes:
+        return backfill.REC.pack(seq, 1000 * seq, 0.1, 0.2, 0.3, 1.5, 0.9, 1, 0, 1000)
+
+    async def handle(self, r, w):
+        path = (await r.readuntil(b"\r\n\r\n")).split(b" ")[1].decode()
+        hdr = ""
+        if path == "/log/marks":
+            st, body = 200, json.dumps({"epoch": self.epoch, "lo": self.lo, "hi": self.hi,
+                                        "max": 64}).encode()
+        else:
+            q = dict(kv.split("=") for kv in path.partition("?")[2].split("&"))
+            frm, n = int(q["from"]), int(q["n"])
+            if self.on_range:
+                self.on_range(frm)
+            if frm < self.lo:
+                st, body = 416, b""
+            else:
+                st = 200
+                body = b"".join(self.rec(s) for s in range(frm, min(frm + n, self.hi)))
+                hdr = f"X-Log-Epoch: {self.reply_epoch or self.epoch}\r\n"
+        w.write(f"HTTP/1.0 {st} X\r\nContent-Length: {len(body)}\r\n{hdr}\r\n".encode())
+        if self.cut is not None and path != "/log/marks":
+            body, self.cut = body[:self.cut], None
+        w.write(body)
+        await w.drain()
+        w.close()
+
+
+def seqs(path: str) -> list:
+    with open(path) as f:
+        return [json.loads(ln) for ln in f]
+
+
+def test_backfill():
+    print("Backfill (/log/marks + /log/range)")
+    out = {}
+
+    async def run(root):
+        dev = FakeLog(epoch=7, lo=0, hi=40)
+        srv = await asyncio.start_server(dev.handle, "127.0.0.1", 0)
+        port = srv.sockets[0].getsockname()[1]
+        bf = backfill.Backfill(root, port=port, rate=1e6, batch=16)
+        path = os.path.join(root, "d1", "log-7.jsonl")
+
+        # reply cut mid-record: whole records kept, the rest fetched next sync
+        dev.cut = 2 * backfill.REC.size + 9
+        try:
+            await bf.sync("d1", "127.0.0.1")
+            out["cut_raised"] = False
+        except backfill.SyncError:
+            out["cut_raised"] = True
+        out["cut_kept"] = [r["seq"] for r in seqs(path)]
+        out["resumed"] = await bf.sync("d1", "127.0.0.1")
+        out["after_cut"] = [r["seq"] for r in seqs(path)]
+
+        # torn last line from a crash mid-append
+        with open(path, "ab") as f:
+            f.write(b'{"seq":40,"ms":4')
+        out["resume"] = backfill.resume_point(path)
+        with open(path, "rb") as f:
+            out["torn_cut"] = f.read().endswith(b"\n")
+
+        # the device overwrites past our cursor while we fetch
+        dev.hi = 80
+
+        def overrun(frm):
+            if frm == 40:
+                dev.lo = 60
+        dev.on_range = overrun
+        out["overrun"] = await bf.sync("d1", "127.0.0.1")
+        dev.on_range = None
+        out["after_overrun"] = seqs(path)[40:]
+
+        # reformatted mid-sync: replies carry the new epoch
+        dev.hi = 100
+        dev.reply_epoch = 8
+        try:
+            await bf.sync("d1", "127.0.0.1")
+            out["epoch_raised"] = False
+        except backfill.SyncError:
+            out["epoch_raised"] = True
+        out["epoch_kept"] = len(seqs(path))
+        dev.epoch, dev.reply_epoch, dev.lo, dev.hi = 8, None, 0, 5
+        out["new_epoch"] = await bf.sync("d1", "127.0.0.1")
+        out["new_file"] = [r["seq"] for r in seqs(os.path.join(root, "d1", "log-8.jsonl"))]
+        srv.close()
+
+    with tempfile.TemporaryDirectory() as root:
+        asyncio.run(run(root))
+    ok = out["cut_raised"] and out["cut_kept"] == [0, 1]
+    report("truncated reply keeps the whole records", ok, "" if ok else str(out["cut_kept"]))
+    ok = out["after_cut"] == list(range(40)) and out["resumed"]["records"] == 38
+    report("next sync resumes without duplicates", ok, "" if ok else str(out["resumed"]))
+    ok = out["resume"] == 40 and out["torn_cut"]
+    report("torn last line cut, resume after the last whole one", ok, "" if ok else str(out["resume"]))
+    rows = out["after_overrun"]
+    ok = rows[0] == {"seq": 59, "gap": [40, 59]} and [r["seq"] for r in rows[1:]] == list(range(60, 80)) \
+        and out["overrun"]["gaps"] == 1
+    report("lo past the cursor becomes one gap line", ok, "" if ok else str(rows[:2]))
+    ok = out["epoch_raised"] and out["epoch_kept"] == 61
+    report("epoch change mid-sync stops without writing", ok, "" if ok else str(out["epoch_kept"]))
+    ok = out["new_epoch"]["epoch"] == 8 and out["new_file"] == list(range(5))
+    report("new epoch starts its own file from lo", ok, "" if ok else str(out["new_epoch"]))
+
+
+# ── alignment ─────────────────────────────────────────
+def bands(device: str, t_dev: float, t_arr: float = None, score: float = 1.0) -> Record:
+    return Record(device, "bands", {"score": score, "b1": 0.1, "b2": 0.5, "b3": 0.1,
+                                    "type": "Essential"}, t_dev, t_dev if t_arr is None else t_arr)
+
+
+def aligned(late: str = "drop", **kw):
+    out = {"rec": [], "win": [], "late": []}
+    kw.setdefault("idle", 5.0)
+    a = Aligner({"pair": ["L", "R"]}, window=1.0, max_delay=2.0, late=late,
+                on_record=lambda g, ev, r: out["rec"].append((ev, r.device, r.t_dev)),
+                on_window=out["win"].append,
+                on_late=lambda r, ev: out["late"].append(r.t_dev), **kw)
+    return a, out
+
+
+def test_align():
+    print("Alignment (event-time merge, late policies)")
+    # each device's first record arrives on time, so its offset is 0
+    a, out = aligned()
+    for dev, t_dev, t_arr in [("L", 0.5, 0.5), ("R", 0.6, 0.6), ("L", 2.5, 2.5), ("R", 1.6, 2.6),
+                              ("L", 1.5, 2.7), ("R", 3.6, 3.6), ("L", 4.5, 4.5), ("R", 2.6, 4.6),
+                              ("L", 3.5, 4.7), ("R", 4.6, 4.8), ("L", 6.5, 6.5), ("R", 6.6, 6.6)]:
+        a(bands(dev, t_dev, t_arr))
+    early = len(out["rec"])
+    a.flush()
+    evs = [ev for ev, _, _ in out["rec"]]
+    ok = evs == sorted(evs) and len(evs) == 12 and 0 < early < 12 and a.late_n == 0
+    report("out-of-order records released in event-time order", ok, "" if ok else str(out["rec"]))
+    ks = [w["t0"] for w in out["win"]]
+    ok = ks == [0.0, 1.0, 2.0, 3.0, 4.0, 6.0] and all(w["features"]["present"] == 2 for w in out["win"][:5])
+    report("windows emitted once, in order, with both hands", ok, "" if ok else str(ks))
+
+    def late_run(policy):
+        a, out = aligned(policy)
+        for k in range(10):
+            a(bands("L", k + 0.5))
+            a(bands("R", k + 0.5))
+        n = len(out["win"])
+        a(bands("L", 5.2, 9.6, score=3.0))     # window 5: next_k is 7, within keep
+        a(bands("L", 1.3, 9.7))                # window 1: long gone
+        return a, out, out["win"][n:]
+    a, out, extra = late_run("drop")
+    ok = a.late_n == 2 and not extra and not out["late"]
+    report("late=drop counts and drops", ok)
+    a, out, extra = late_run("side")
+    ok = a.late_n == 2 and not extra and out["late"] == [5.2, 1.3]
+    report("late=side hands records to on_late", ok, "" if ok else str(out["late"]))
+    a, out, extra = late_run("revise")
+    ok = len(extra) == 1 and extra[0]["t0"] == 5.0 and extra[0]["revision"] == 1 and \
+        extra[0]["devices"]["L"]["n"] == 2 and extra[0]["devices"]["L"]["score"] == 2.0 and a.revisions == 1
+    report("late=revise re-emits its window within keep", ok, "" if ok else str(extra))
+    ok = a.late_n == 2 and a.stats()["windows"] == len(out["win"]) - 1
+    report("late=revise drops outside keep", ok)
+
+    a, out = aligned()
+    a(bands("L", 0.5))
+    a(bands("R", 0.5))
+    for k in range(1, 21):
+        a(bands("L", k + 0.5))
+    ok = out["win"] and out["win"][-1]["t0"] == 17.0 and "R" not in [d for _, d, _ in out["rec"][2:]]
+    report("idle member does not stall the group", bool(ok), "" if ok else str(out["win"][-1:]))
+
+    a, out = aligned(cap=4, idle=100.0)
+    a(bands("R", 0.5))
+    queued = []
+    for k in range(1, 11):
+        a(bands("L", k + 0.5))
+        queued.append(a.stats()["queued"])
+    evs = [ev for ev, _, _ in out["rec"]]
+    ok = a.forced == 6 and max(queued) <= 4 + 1 and evs == sorted(evs)
+    report("cap forces release when a member stalls", ok, "" if ok else f"{a.forced} {queued}")
+
+    try:
+        Aligner({"a": ["L", "R"], "b": ["R", "X"]})
+        ok = False
+    except ValueError:
+        ok = True
+    report("device in two groups is refused", ok)
+
+
+# ── recorder ──────────────────────────────────────────
+def session_file(root: str, device: str) -> bytes:
+    d = os.path.join(root, device)
+    (name,) = os.listdir(d)
+    with open(os.path.join(d, name), "rb") as f:
+        return f.read()
+
+
+def test_recorder():
+    print("Recorder (pool, writer thread)")
+    with open(CAPTURE, "rb") as f:
+        raw = f.read()
+    with tempfile.TemporaryDirectory() as root:
+        rec = Recorder(root, buf_size=512, pool=8, flush_s=0.0)
+        h = rec.open("dev/1")
+        pos, k = 0, 0
+        while pos < len(raw):
+            n = (37, 1, 900, 512, 3)[k % 5]
+            rec.data(h, raw[pos:pos + n])
+            pos, k = pos + n, k + 1
+            if k % 7 == 0:
+                rec.sweep(time.monotonic())    # partly filled buffers too
+            while k % 3 == 0 and len(rec._pool) < 4:
+                time.sleep(0.001)              # let the writer keep up: no drops here
+        rec.stop()
+        st = rec.stats()
+        ok = session_file(root, "dev_1") == raw and st["bytes_dropped"] == 0 and \
+            st["bytes_written"] == st["bytes_in"] == len(raw)
+        report("session file is the bytes received", ok, "" if ok else str(st))
+
+    with tempfile.TemporaryDirectory() as root:
+        rec = Recorder(root, buf_size=16, pool=2)
+        stall = threading.Event()
+        write = rec._write
+        rec._write = lambda fd, bufs: (stall.wait(5), write(fd, bufs))
+        h = rec.open("dev1")
+        rec.data(h, bytes(range(64)))          # two buffers' worth fit, the rest has none
+        dropped = rec.bytes_dropped
+        stall.set()
+        deadline = time.monotonic() + 5
+        while len(rec._pool) < 2 and time.monotonic() < deadline:
+            time.sleep(0.001)
+        rec.data(h, b"after")
+        rec.stop()
+        st = rec.stats()
+        ok = dropped == 32 and st["bytes_dropped"] == 32 and st["bytes_in"] == 69 and \
+            st["bytes_written"] == 37 and st["pool_free"] == 2
+        report("pool exhaustion drops and counts, then recovers", ok, "" if ok else str(st))
+        ok = session_file(root, "dev1") == bytes(range(32)) + b"after"
+        report("file holds what was pooled, in order", ok)
+
+
+# ── shards ────────────────────────────────────────────
+def test_shard():
+    print("Shards (hello peek, handoff, parent pipe)")
+    with open(CAPTURE, "rb") as f:
+        capture = f.read()
+    own, other = "bed-1", "bed-4"
+    assert (shard_of(own, 2), shard_of(other, 2)) == (0, 1)
+    inboxes = [socket.socketpair(socket.AF_UNIX, socket.SOCK_DGRAM) for _ in range(2)]
+    pipes = [mp.Pipe(duplex=False) for _ in range(2)]
+    got = [[], []]
+    out = {}
+
+    async def connect(sh: Shard, device: str) -> None:
+        dev, gw_end = socket.socketpair()
+        dev.setblocking(False)
+        gw_end.setblocking(False)
+        task = asyncio.create_task(sh._route(gw_end))
+        loop = asyncio.get_running_loop()
+        hello = HELLO + device.encode() + b"\n"
+        await loop.sock_sendall(dev, hello[:5])        # the peek waits for the whole line
+        await asyncio.sleep(0.05)
+        await loop.sock_sendall(dev, hello[5:] + capture)
+        dev.shutdown(socket.SHUT_WR)
+        await asyncio.wait_for(task, 5)
+        dev.close()
+
+    async def run():
+        shards = [Shard(i, 2, inboxes, pipes[i][1], 60.0) for i in range(2)]
+        for sh, g in zip(shards, got):
+            sh.gw.add_sink(g.append)
+            sh.open_inbox()
+        await connect(shards[0], own)
+        await connect(shards[0], other)
+        deadline = time.monotonic() + 5
+        while (shards[1].handoffs_in == 0 or shards[1].gw.connections or not got[1]) \
+                and time.monotonic() < deadline:
+            await asyncio.sleep(0.01)
+        bad, gw_end = socket.socketpair()
+        gw_end.setblocking(False)
+        bad.sendall(b"GET / HTTP/1.1\r\n\r\n")
+        await shards[0]._route(gw_end)
+        try:
+            out["bad_closed"] = bad.recv(16) == b""
+        except ConnectionResetError:                  # closed with the request unread
+            out["bad_closed"] = True
+        bad.close()
+        out["shards"] = shards
+
+    asyncio.run(run())
+    s0, s1 = out["shards"]
+    ok = got[0] and {r.device for r in got[0]} == {own} and s0.handoffs_in == 0
+    report("own device stays on the accepting shard", bool(ok))
+    ok = s0.handoffs_out == 1 and s1.handoffs_in == 1 and {r.device for r in got[1]} == {other} \
+        and len(got[1]) == len(got[0]) and s1.gw.bytes_in == s0.gw.bytes_in == len(capture)
+    report("other device handed off whole, hello unconsumed", ok,
+           "" if ok else f"{s0.handoffs_out} {s1.handoffs_in} {len(got[0])} {len(got[1])}")
+    report("non-hello connection closed", out["bad_closed"])
+
+    # parent not reading: publish drops instead of blocking, framing intact
+    r = pipes[0][0]
+    sent = 0
+    while s0.publish_dropped == 0 and sent < 10000:
+        s0.publish({"kind": "stats", "pad": "x" * 1000})
+        sent += 1
+    s0.publish({"kind": "stats", "pad": "x" * 5000})
+    recv = []
+    while r.poll():
+        recv.append(json.loads(r.recv_bytes()))
+    ok = s0.publish_dropped == 2 and len(recv) == sent - 1 and all(m["shard"] == 0 for m in recv)
+    report("full parent pipe drops and counts", ok, "" if ok else f"{sent} {len(recv)} {s0.publish_dropped}")
+    s0.publish({"kind": "alert"})
+    ok = r.poll() and r.recv_bytes() and s0.stats()["publish_dropped"] == 2
+    report("publishing resumes once the parent reads", bool(ok))
+    for a, b in inboxes:
+        a.close()
+        b.close()
+
+
+def main() -> int:
+    test_framing()
+    test_push()
+    test_timeline()
+    test_latency()
+    test_fanout()
+    test_backfill()
+    test_align()
+    test_recorder()
+    test_shard()
+    print(f"\n{passed} passed, {failed} failed")
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
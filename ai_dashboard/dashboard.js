@@ -396,6 +396,18 @@ function connectESP() {
     }
   });
 
+  // Windows gated as voluntary movement on the device carry no band powers
+  // and are kept out of session / test-phase statistics.
+  sse.addEventListener('gated', e => {
+    const j = JSON.parse(e.data);
+    document.getElementById('liveClass').textContent = j.type || 'Voluntary Movement';
+  });
+
+  // Device-run test suite: all phase summaries arrive in one event.
+  sse.addEventListener('tests', e => {
+    deviceTestResult = JSON.parse(e.data);
+  });
+
   sse.addEventListener('calibrated', e => {
     const j = JSON.parse(e.data);
     calibratedNoiseFloor = j.baseline;
@@ -777,6 +789,13 @@ let testCountdownInt = null; // setInterval handle
 let testGsapAnims = [];   // GSAP tween refs to kill on cleanup
 let demoInterval = null; // mock data interval when no device
 let isDemo = false;
+let deviceTests = false;  // device times the phases and aggregates windows
+let deviceTestResult = null;
+
+function _espFetch(path) {
+  const ip = document.getElementById('espIP').value.trim();
+  return fetch(`http://${ip}${path}`);
+}
 
 // ─── OPEN ───────────────────────────────────────────
 function openTestSuite() {
@@ -792,6 +811,17 @@ function openTestSuite() {
   isDemo = !sse || sse.readyState !== EventSource.OPEN;
   document.getElementById('tmDemoTag').classList.toggle('hidden', !isDemo);
 
+  // With a device attached it runs the schedule itself, sample-aligned;
+  // the countdown here is only for the UI.
+  deviceTests = false;
+  deviceTestResult = null;
+  if (!isDemo) {
+    const q = TEST_PHASES.map(p => `${p.id}=${p.duration}`).join('&');
+    _espFetch('/tests/start?' + q)
+      .then(r => { deviceTests = r.ok; })
+      .catch(() => { deviceTests = false; });
+  }
+
   log(`<span style="color:#38bdf8">🔬 Standardized test suite started${isDemo ? ' (DEMO MODE)' : ''}</span>`);
   _startNextPhase();
 }
@@ -944,6 +974,7 @@ function skipTestPhase() {
   clearInterval(testCountdownInt); testCountdownInt = null;
   _stopDemoData();
   _saveCurrentPhasePayload();
+  if (deviceTests) _espFetch('/tests/skip').catch(() => {});
   log(`<span style="color:#fbbf24">⏭ Skipped ${TEST_PHASES[currentPhaseIdx].label}</span>`);
   _advancePhase();
 }
@@ -953,6 +984,7 @@ function abortTestSuite() {
   _stopDemoData();
   testGsapAnims.forEach(t => t && t.kill()); testGsapAnims = [];
   currentPhaseIdx = -1;
+  if (deviceTests) { _espFetch('/tests/abort').catch(() => {}); deviceTests = false; }
   const modal = document.getElementById('testModal');
   gsap.to(modal, { opacity: 0, duration: 0.3, onComplete: () => modal.classList.add('hidden') });
   log('<span style="color:#fb7185">✗ Test suite aborted</span>');
@@ -976,10 +1008,15 @@ async function _finishTests() {
   document.getElementById('trs-confidence').innerHTML = '';
   document.getElementById('trs-advisory').textContent = '';
 
+  // The device may finish up to a window after the UI countdown.
+  const device = deviceTests ? await _awaitDeviceTests() : null;
+  if (deviceTests && !device) log('<span style="color:#fbbf24">⚠ No device test result — using browser windows</span>');
+
   // Analyse each phase (rule-based, no MedGemma)
   for (let i = 0; i < testResults.length; i++) {
     const r = testResults[i];
-    const summary = _buildPhaseSummary(r.windows, r.phase);
+    const dp = device && device.phases.find(p => p.phase === r.phase);
+    const summary = dp ? _summaryFromDevice(dp) : _buildPhaseSummary(r.windows, r.phase);
     if (!summary) { r.aiResponse = null; continue; }
 
     // Update score chip
@@ -1009,6 +1046,63 @@ async function _finishTests() {
   log('<span style="color:#38bdf8">✅ Standardized test report ready</span>');
 }
 
+// ─── DEVICE-RUN PHASES ──────────────────────────────
+async function _awaitDeviceTests() {
+  for (let i = 0; i < 20 && !deviceTestResult; i++) {
+    try {
+      const r = await _espFetch('/tests/result');
+      if (r.ok) deviceTestResult = await r.json();
+    } catch (e) { /* keep waiting for the SSE event */ }
+    if (!deviceTestResult) await new Promise(res => setTimeout(res, 500));
+  }
+  deviceTests = false;
+  return deviceTestResult;
+}
+
+// Same schema as _buildPhaseSummary(), from the device's per-phase aggregates.
+function _summaryFromDevice(d) {
+  if (!d || d.n < 2) return null;
+  const [b1m, b2m, b3m] = d.bm, [b1std, b2std, b3std] = d.bs;
+  const tot = b1m + b2m + b3m || 1;
+  const domBand = b1m >= b2m && b1m >= b3m ? '4_6_hz' : b2m >= b3m ? '6_8_hz' : '8_12_hz';
+  const domPct = Math.max(b1m, b2m, b3m) / tot;
+  const domRatio = Math.max(b1m, b2m, b3m) / (Math.min(b1m, b2m, b3m) || 0.001);
+  const pB = [b1m, b2m, b3m].map(v => v / tot);
+  const spEnt = +(-(pB.reduce((s, p) => p > 0 ? s + p * Math.log2(p) : s, 0)) / Math.log2(3)).toFixed(4);
+  const [low, mod, high, vh] = d.dist.map(c => c / d.n);
+  const cv = d.std / (d.mean || 1);
+
+  return {
+    metadata: {
+      session_id: 'T' + Date.now().toString().slice(-4),
+      timestamp: new Date().toISOString(),
+      duration_minutes: +(d.sec / 60).toFixed(3),
+      sampling_rate_hz: deviceTestResult?.fs || 50,
+      condition: d.phase,
+      medication_status: 'unknown',
+      tremor_score_scale: '0_to_10_log_scaled'
+    },
+    frequency_profile: {
+      band_power_mean: { hz_4_6: +b1m.toFixed(3), hz_6_8: +b2m.toFixed(3), hz_8_12: +b3m.toFixed(3) },
+      band_power_std: { hz_4_6: +b1std.toFixed(3), hz_6_8: +b2std.toFixed(3), hz_8_12: +b3std.toFixed(3) },
+      dominant_band: domBand, dominance_ratio: +domRatio.toFixed(2),
+      dominant_band_percentage: +domPct.toFixed(3), band_switch_count: d.sw
+    },
+    intensity_profile: {
+      tremor_score: {
+        mean: +d.mean.toFixed(2), std: +d.std.toFixed(2), min: d.min, max: d.max,
+        p25: d.p25, p50: d.p50, p75: d.p75, p90: d.p90
+      },
+      rms_mean: +d.rms.toFixed(3),
+      noise_floor_adjusted_intensity: +(d.rms * 0.93).toFixed(3)
+    },
+    intensity_distribution: { low_fraction: +low.toFixed(3), moderate_fraction: +mod.toFixed(3), high_fraction: +high.toFixed(3), very_high_fraction: +vh.toFixed(3) },
+    variability_profile: { coefficient_of_variation: +cv.toFixed(3), stability_index: +Math.max(0, 1 - cv).toFixed(3), spectral_entropy: spEnt, window_to_window_variance: +d.wtv.toFixed(3) },
+    within_session_trend: { linear_slope_per_minute_score_units: +d.slope.toFixed(4), early_vs_late_change_percent: +d.el.toFixed(1), fatigue_pattern_detected: d.el > 5 },
+    multi_session_trend: { dominant_band_consistency_last_3: 'N/A (single test)', tremor_score_weekly_slope: '+0.0', severity_change_percent: 'N/A', band_shift_detected: false }
+  };
+}
+
 // ─── BUILD SESSION-SUMMARY FOR A PHASE ──────────────
 function _buildPhaseSummary(windows, phase) {
   if (!windows || windows.length < 2) return null;
@@ -0,0 +1,79 @@
+#pragma once
+// Biquad sections (RBJ designs) and the multi-channel SOS engine built on
+// them. Plain C++ so the pipeline can run on the host.
+#include <math.h>
+#include <stdint.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// Second-order section, direct form I.
+struct Biquad {
+  double a1,a2,b0,b1,b2;
+  double x1=0,x2=0,y1=0,y2=0;
+  void initHPF(double fs,double fc,double Q=0.707){
+    double w0=2*M_PI*fc/fs;
+    double c=cos(w0), s=sin(w0);
+    double alpha=s/(2*Q);
+
+    double b0n=(1+c)/2;
+    double b1n=-(1+c);
+    double b2n=(1+c)/2;
+    double a0n=1+alpha;
+    double a1n=-2*c;
+    double a2n=1-alpha;
+
+    b0=b0n/a0n; b1=b1n/a0n; b2=b2n/a0n;
+    a1=a1n/a0n; a2=a2n/a0n;
+  }
+  // Constant 0 dB peak gain band-pass between fl and fh
+  void initBPF(double fs,double fl,double fh){
+    double fc=sqrt(fl*fh);
+    double Q=fc/(fh-fl);
+    double w0=2*M_PI*fc/fs;
+    double c=cos(w0), s=sin(w0);
+    double alpha=s/(2*Q);
+    double a0n=1+alpha;
+
+    b0=alpha/a0n; b1=0; b2=-alpha/a0n;
+    a1=-2*c/a0n; a2=(1-alpha)/a0n;
+  }
+  void initLPF(double fs,double fc,double Q=0.707){
+    double w0=2*M_PI*fc/fs;
+    double c=cos(w0), s=sin(w0);
+    double alpha=s/(2*Q);
+
+    double a0n=1+alpha;
+    b0=(1-c)/2/a0n; b1=(1-c)/a0n; b2=(1-c)/2/a0n;
+    a1=-2*c/a0n; a2=(1-alpha)/a0n;
+  }
+  double process(double x){
+    double y=b0*x + b1*x1 + b2*x2 - a1*y1 - a2*y2;
+    x2=x1; x1=x; y2=y1; y1=y;
+    return y;
+  }
+};
+
+// Multi-channel SOS engine: a cascade of S sections designed with Biquad,
+// applied in place to C channels that share coefficients but keep their
+// own state.
+template<uint8_t C,uint8_t S>
+struct SosBank {
+  Biquad sec[S];
+  double x1[S][C],x2[S][C],y1[S][C],y2[S][C];
+  void reset(){
+    for(uint8_t s=0;s<S;s++) for(uint8_t c=0;c<C;c++) x1[s][c]=x2[s][c]=y1[s][c]=y2[s][c]=0;
+  }
+  void process(double *v){
+    for(uint8_t s=0;s<S;s++){
+      const Biquad &q=sec[s];
+      for(uint8_t c=0;c<C;c++){
+        double x=v[c];
+        double y=q.b0*x + q.b1*x1[s][c] + q.b2*x2[s][c] - q.a1*y1[s][c] - q.a2*y2[s][c];
+        x2[s][c]=x1[s][c]; x1[s][c]=x; y2[s][c]=y1[s][c]; y1[s][c]=y;
+        v[c]=y;
+      }
+    }
+  }
+};
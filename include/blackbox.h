@@ -0,0 +1,110 @@
+#pragma once
+// Pre-trigger "black box" for raw IMU data.
+// A RAM ring always holds the last N frames of ax/ay/az/gx/gy/gz at the
+// sample rate. trigger() arms a post-trigger countdown; once it runs out
+// the capture (pre + post frames) is complete and can be drained in
+// chronological order while recording carries on. The drain cursor starts
+// at the oldest frame and the writer only ever overwrites the slot just
+// behind it, so draining at least one frame per sample never races the
+// writer. If the drain falls behind anyway, push() catches the cursor and
+// sets `lost`; from then on the capture is no longer contiguous.
+//
+// File image: BlackBoxHeader followed by frames int16[6], little-endian.
+#include <stdint.h>
+#include <string.h>
+
+const uint32_t BB_MAGIC = 0x42425254;   // "TRBB"
+const uint16_t BB_FORMAT = 1;
+const float BB_ACC_LSB = 1.0f/2048;     // g per LSB (+-16 g)
+const float BB_GYRO_LSB = 1.0f/16;      // deg/s per LSB (+-2048 deg/s)
+
+enum BlackBoxReason : uint8_t { BB_BUTTON=0, BB_EPISODE=1, BB_HTTP=2 };
+
+struct BlackBoxHeader {
+  uint32_t magic;
+  uint16_t format;
+  uint8_t reason,pad;
+  uint32_t seq;          // capture number since boot
+  uint32_t triggerMs;    // millis() at trigger
+  float fs;
+  float accLsb,gyroLsb;
+  uint16_t frames;       // total frames in the file
+  uint16_t preFrames;    // frames before the trigger
+};
+
+struct BlackBoxFrame { int16_t v[6]; };
+
+template<uint16_t N>
+struct BlackBox {
+  BlackBoxFrame ring[N];
+  uint16_t head=0;       // next slot to write
+  uint16_t fill=0;
+  uint16_t post=0;       // frames still to record after the trigger
+  uint16_t postLen=0;
+  bool armed=false;
+  bool ready=false;      // capture complete, waiting to be drained
+  uint16_t start=0,count=0,pre=0,drained=0;
+  uint16_t lost=0;       // times the writer caught the drain cursor since ready
+  uint8_t reason=0;
+  uint32_t triggerMs=0;
+
+  static int16_t q(float x,float lsb){
+    float v=x/lsb;
+    v=v>32767?32767:v<-32768?-32768:v;
+    return (int16_t)(v<0?v-0.5f:v+0.5f);
+  }
+
+  void push(float ax,float ay,float az,float gx,float gy,float gz){
+    if(ready && drained<count && head==(start+drained)%N) lost++;
+    BlackBoxFrame &f=ring[head];
+    f.v[0]=q(ax,BB_ACC_LSB); f.v[1]=q(ay,BB_ACC_LSB); f.v[2]=q(az,BB_ACC_LSB);
+    f.v[3]=q(gx,BB_GYRO_LSB); f.v[4]=q(gy,BB_GYRO_LSB); f.v[5]=q(gz,BB_GYRO_LSB);
+    head=head+1>=N?0:head+1;
+    if(fill<N) fill++;
+    if(armed && --post==0){
+      armed=false;
+      ready=true;
+      count=fill;
+      start=fill<N?0:head;
+      pre=count>postLen?count-postLen:0;
+      drained=0;
+      lost=0;
+    }
+  }
+
+  // Ignored while a capture is being recorded or drained.
+  // postFrames must be < N.
+  bool trigger(uint16_t postFrames,uint8_t why,uint32_t ms){
+    if(armed || ready || postFrames==0 || postFrames>=N) return false;
+    armed=true;
+    post=postLen=postFrames;
+    reason=why;
+    triggerMs=ms;
+    return true;
+  }
+
+  void header(BlackBoxHeader &h,uint32_t seq,float fs) const {
+    memset(&h,0,sizeof(h));
+    h.magic=BB_MAGIC; h.format=BB_FORMAT;
+    h.reason=reason; h.seq=seq; h.triggerMs=triggerMs;
+    h.fs=fs; h.accLsb=BB_ACC_LSB; h.gyroLsb=BB_GYRO_LSB;
+    h.frames=count; h.preFrames=pre;
+  }
+
+  // Copies up to max frames in chronological order; returns how many.
+  // Call after every push() while ready, with max >= 1, so the cursor
+  // stays ahead of the writer.
+  uint16_t drain(BlackBoxFrame *out,uint16_t max){
+    uint16_t n=0;
+    while(ready && n<max && drained<count){
+      uint16_t i=start+drained;
+      if(i>=N) i-=N;
+      out[n++]=ring[i];
+      drained++;
+    }
+    return n;
+  }
+
+  bool drainedAll() const { return ready && drained>=count; }
+  void release(){ ready=false; }
+};
@@ -0,0 +1,260 @@
+#pragma once
+// Output bus: each record the DSP produces (a sample, a window's bands, a
+// phase change ...) is formatted once into a byte ring, and every sink that
+// subscribes to its topic (SSE, gateway push, WebSocket, UDP, UART) reads it
+// from there in place, at its own pace, from loop() between samples.
+//
+// A message carries a bitmask of the sinks that have not consumed it yet,
+// which is its reference count. It is freed when the mask is empty and
+// reclaimed once it reaches the tail. Publishing costs the same whatever the
+// number of sinks: reserve() is one mask lookup, and returns nullptr when no
+// sink takes the topic, so the caller skips formatting altogether.
+//
+//   char *m=bus.reserve(T_TRACK,64); if(!m) return;
+//   bus.commit(snprintf(m,64,"{\"f\":%.2f}",f));
+//
+// Drop policies, per sink:
+//   BUS_DROP_OLDEST  when the ring is full the oldest message is evicted and
+//                    counted as `dropped` for every sink still holding it
+//   BUS_DROP_NEWEST  once the sink's backlog passes hiWater bytes it is left
+//                    out of new messages (`shed`) until it is back under
+//                    loWater: it keeps a contiguous backlog and sees one gap
+// Backlogs are measured in pace(), called by the pump, and on eviction; the
+// publishing side never looks at them.
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+enum BusTopic : uint8_t {
+  T_SAMPLE, T_BANDS_CSV, T_BANDS, T_ZOOM, T_TRACK, T_ENV, T_GATED, T_QUALITY,
+  T_CNN, T_SHADOW, T_BLACKBOX, T_PHASE, T_TESTS, T_CALIBRATED, T_MODEL, T_MAX,
+  T_PAD=0xFF                   // filler from a message that did not fit to the end
+};
+// Topic names are the SSE event names.
+const char *const BUS_TOPICS[T_MAX]={
+  "sample","bands_csv","bands","zoom","track","env","gated","quality",
+  "cnn","shadow","blackbox","phase","tests","calibrated","model"};
+const uint32_t BUS_ALL=(1u<<T_MAX)-1;
+const uint8_t BUS_SINKS=8;
+
+enum BusPolicy : uint8_t { BUS_DROP_OLDEST=0, BUS_DROP_NEWEST=1 };
+
+// 8-byte header, then the NUL-terminated payload; messages are 8-aligned
+// and never wrap.
+struct BusMsg {
+  uint16_t size;               // ring bytes, header included
+  uint8_t topic;               // BusTopic or T_PAD
+  uint8_t holders;             // sinks that still have to consume it
+  uint32_t seq;
+  char *data(){ return (char*)(this+1); }
+  const char *data() const { return (const char*)(this+1); }
+};
+
+struct BusSink {
+  const char *name=nullptr;
+  uint32_t topics=0;
+  BusPolicy policy=BUS_DROP_OLDEST;
+  uint16_t hiWater=0,loWater=0;     // DROP_NEWEST backlog bounds, bytes
+  uint16_t off=0;                   // cursor: next message to look at
+  uint32_t seq=0;                   // and its seq
+  uint16_t lag=0;                   // backlog in bytes at the last pace()
+  uint32_t sent=0,dropped=0,shed=0;
+};
+
+// Parses "bands,gated,phase" (or "all", or "") into a topic mask.
+inline uint32_t busTopicMask(const char *list){
+  if(!strcmp(list,"all")) return BUS_ALL;
+  uint32_t mask=0;
+  while(*list){
+    const char *e=strchr(list,',');
+    size_t n=e?(size_t)(e-list):strlen(list);
+    for(uint8_t t=0;t<T_MAX;t++)
+      if(strlen(BUS_TOPICS[t])==n && !strncmp(BUS_TOPICS[t],list,n)) mask|=1u<<t;
+    list+=n;
+    if(*list) list++;
+  }
+  return mask;
+}
+
+// One message as the SSE frame AsyncEventSource writes for it,
+// "event: <topic>\r\ndata: <payload>\r\n\r\n"; snprintf's return. The push
+// sink and the host tools frame with it so the gateway sees the same bytes
+// from either.
+inline int busSseFrame(char *out,size_t cap,const BusMsg *m){
+  return snprintf(out,cap,"event: %s\r\ndata: %s\r\n\r\n",BUS_TOPICS[m->topic],m->data());
+}
+// The line a device sends once before pushing frames to a gateway
+// (gateway/records.py HELLO).
+inline int busHello(char *out,size_t cap,const char *device){
+  return snprintf(out,cap,"TREMOR %s\n",device);
+}
+
+template<uint16_t BYTES>
+struct Bus {
+  static_assert(BYTES%8==0 && BYTES<=32768,"ring size");
+  alignas(8) uint8_t ring[BYTES];
+  uint16_t head=0,tail=0,used=0;
+  uint32_t headSeq=0,tailSeq=0;     // seq of the next message, of the oldest held
+  uint8_t topicMask[T_MAX]={0};     // sinks taking each topic
+  uint8_t throttled=0;              // DROP_NEWEST sinks over hiWater
+  uint8_t nSinks=0;
+  BusSink sink[BUS_SINKS];
+  uint32_t published=0,tooBig=0;
+  uint16_t resOff=0,resCap=0;
+
+  int8_t addSink(const char *name,uint32_t topics,BusPolicy p=BUS_DROP_OLDEST,
+                 uint16_t hi=BYTES*3/4,uint16_t lo=BYTES/4){
+    if(nSinks>=BUS_SINKS) return -1;
+    BusSink &s=sink[nSinks];
+    s.name=name; s.policy=p; s.hiWater=hi; s.loWater=lo;
+    s.off=head; s.seq=headSeq;
+    setTopics(nSinks,topics);
+    return nSinks++;
+  }
+  int8_t find(const char *name) const {
+    for(uint8_t i=0;i<nSinks;i++) if(!strcmp(sink[i].name,name)) return i;
+    return -1;
+  }
+  // Messages already held stay held; only new ones follow the mask.
+  void setTopics(uint8_t id,uint32_t topics){
+    sink[id].topics=topics;
+    for(uint8_t t=0;t<T_MAX;t++){
+      if(topics&(1u<<t)) topicMask[t]|=1<<id;
+      else topicMask[t]&=~(1<<id);
+    }
+  }
+  void setPolicy(uint8_t id,BusPolicy p){
+    sink[id].policy=p;
+    if(p==BUS_DROP_OLDEST) throttled&=~(1<<id);
+  }
+
+  // ── producer ──
+  // Room for cap bytes (NUL included), or nullptr when nobody takes the
+  // topic. Evicts from the tail as needed. commit() must follow before the
+  // next reserve().
+  char *reserve(BusTopic t,uint16_t cap){
+    uint8_t mask=topicMask[t];
+    if(mask&throttled){
+      for(uint8_t i=0;i<nSinks;i++) if(mask&throttled&(1<<i)) sink[i].shed++;
+      mask&=~throttled;
+    }
+    if(!mask) return nullptr;
+    uint16_t need=(sizeof(BusMsg)+cap+7)&~7;
+    if(need>BYTES/2){ tooBig++; return nullptr; }
+    for(;;){
+      if(!used) head=tail=0;
+      if(used && head==tail){ evict(); continue; }
+      if(head>=tail){
+        if(BYTES-head>=need) break;
+        BusMsg *p=at(head);
+        p->size=BYTES-head; p->topic=T_PAD; p->holders=0;
+        used+=p->size; head=0;
+        continue;
+      }
+      if(tail-head>=need) break;
+      evict();
+    }
+    BusMsg *m=at(head);
+    m->topic=t; m->holders=mask;
+    resOff=head; resCap=cap;
+    return m->data();
+  }
+  // n: the payload length, as snprintf returns it (clipped to the room).
+  void commit(int n){
+    BusMsg *m=at(resOff);
+    if(n<0) n=0;
+    if(n>resCap-1) n=resCap-1;
+    m->data()[n]=0;
+    m->size=(sizeof(BusMsg)+n+1+7)&~7;
+    m->seq=headSeq++;
+    used+=m->size;
+    head=resOff+m->size;
+    if(head>=BYTES) head=0;
+    published++;
+  }
+
+  // ── sinks ──
+  // The sink's next message, or nullptr when it is up to date.
+  const BusMsg *peek(uint8_t id){
+    BusSink &s=sink[id];
+    sync(s);
+    while(s.seq!=headSeq){
+      BusMsg *m=at(s.off);
+      if(m->topic==T_PAD){ s.off=0; continue; }
+      if(m->holders&(1<<id)) return m;
+      s.off=next(s.off,m);
+      s.seq++;
+    }
+    return nullptr;
+  }
+  // Releases the message peek() returned.
+  void done(uint8_t id){
+    BusSink &s=sink[id];
+    BusMsg *m=at(s.off);
+    m->holders&=~(1<<id);
+    s.off=next(s.off,m);
+    s.seq++;
+    s.sent++;
+    reclaim();
+  }
+  // Backlogs, and the DROP_NEWEST hysteresis. Once per pump pass.
+  void pace(){
+    for(uint8_t i=0;i<nSinks;i++){
+      BusSink &s=sink[i];
+      sync(s);
+      s.lag=s.seq==headSeq?0:s.off<head?head-s.off:BYTES-s.off+head;
+      if(s.policy!=BUS_DROP_NEWEST) continue;
+      if(s.lag>=s.hiWater) throttled|=1<<i;
+      else if(s.lag<=s.loWater) throttled&=~(1<<i);
+    }
+  }
+
+  int json(char *out,size_t cap) const {
+    int p=snprintf(out,cap,"{\"bytes\":%u,\"used\":%u,\"published\":%lu,\"tooBig\":%lu,\"sinks\":[",
+                   (unsigned)BYTES,(unsigned)used,(unsigned long)published,(unsigned long)tooBig);
+    for(uint8_t i=0;i<nSinks && p<(int)cap;i++){
+      const BusSink &s=sink[i];
+      p+=snprintf(out+p,cap-p,"%s{\"name\":\"%s\",\"topics\":%lu,\"policy\":\"%s\",\"throttled\":%d,"
+                  "\"lag\":%u,\"sent\":%lu,\"dropped\":%lu,\"shed\":%lu}",
+                  i?",":"",s.name,(unsigned long)s.topics,
+                  s.policy==BUS_DROP_NEWEST?"newest":"oldest",(throttled>>i)&1,
+                  (unsigned)s.lag,(unsigned long)s.sent,(unsigned long)s.dropped,(unsigned long)s.shed);
+    }
+    if(p<(int)cap) p+=snprintf(out+p,cap-p,"]}");
+    return p;
+  }
+
+  BusMsg *at(uint16_t off){ return (BusMsg*)(ring+off); }
+  uint16_t next(uint16_t off,const BusMsg *m) const {
+    off+=m->size;
+    return off>=BYTES?0:off;
+  }
+  // A cursor at or behind the tail restarts there: whatever it skipped was
+  // evicted (and counted) or had been reclaimed.
+  void sync(BusSink &s){
+    if((int32_t)(s.seq-tailSeq)<=0){ s.seq=tailSeq; s.off=tail; }
+  }
+  void pop(){
+    BusMsg *m=at(tail);
+    if(m->topic!=T_PAD) tailSeq++;
+    used-=m->size;
+    tail=next(tail,m);
+  }
+  void reclaim(){
+    while(used){
+      BusMsg *m=at(tail);
+      if(m->topic!=T_PAD && m->holders) break;
+      pop();
+    }
+  }
+  void evict(){
+    BusMsg *m=at(tail);
+    if(m->topic!=T_PAD && m->holders){
+      for(uint8_t i=0;i<nSinks;i++) if(m->holders&(1<<i)){
+        sink[i].dropped++;
+        if(sink[i].policy==BUS_DROP_NEWEST) throttled|=1<<i;
+      }
+    }
+    pop();
+  }
+};
@@ -0,0 +1,89 @@
+#pragma once
+// Sequential baseline calibration on |tremor|.
+// Samples are averaged in blocks of CAL_BLOCK (0.2 s at 50 Hz) so that the
+// block means are close to independent; the per-sample values are strongly
+// correlated through the HPF and moving average and would make a naive
+// confidence interval far too narrow. Each block mean goes into a Welford
+// mean/variance and into a small buffer for the median/MAD.
+//
+// Calibration ends once at least minBlocks are in and the 95% interval of
+// the robust baseline is within relTol of it, or at maxBlocks regardless.
+// The baseline is the mean of the blocks within 3 MAD-sigmas of the
+// median, so a bump during calibration does not lift the noise floor, and
+// it stays on the same scale as the old mean(|tremor|).
+#include <math.h>
+#include <stdint.h>
+
+const uint8_t CAL_BLOCK = 10;
+const uint8_t CAL_MAX_BLOCKS = 64;
+
+struct Calibrator {
+  uint8_t minBlocks=8, maxBlocks=25;   // 1.6 s .. 5 s at 50 Hz
+  float relTol=0.1f;
+
+  float blocks[CAL_MAX_BLOCKS];
+  uint8_t nBlocks=0;
+  float blockSum=0;
+  uint8_t blockN=0;
+  double mean=0,m2=0;                   // Welford over block means
+  float median=0,sigma=0,baseline=0;    // sigma = 1.4826*MAD
+  bool done=false;
+
+  void start(){
+    nBlocks=0; blockSum=0; blockN=0;
+    mean=m2=0;
+    median=sigma=baseline=0;
+    done=false;
+    if(maxBlocks>CAL_MAX_BLOCKS) maxBlocks=CAL_MAX_BLOCKS;
+    if(minBlocks>maxBlocks) minBlocks=maxBlocks;
+  }
+
+  static float medianOf(float *v,uint8_t n){
+    for(uint8_t i=1;i<n;i++){
+      float x=v[i];
+      int8_t j=i-1;
+      while(j>=0 && v[j]>x){ v[j+1]=v[j]; j--; }
+      v[j+1]=x;
+    }
+    return n&1?v[n/2]:0.5f*(v[n/2-1]+v[n/2]);
+  }
+
+  void robust(){
+    float t[CAL_MAX_BLOCKS];
+    for(uint8_t i=0;i<nBlocks;i++) t[i]=blocks[i];
+    median=medianOf(t,nBlocks);
+    for(uint8_t i=0;i<nBlocks;i++) t[i]=fabsf(blocks[i]-median);
+    sigma=1.4826f*medianOf(t,nBlocks);
+    double s=0;
+    uint8_t k=0;
+    for(uint8_t i=0;i<nBlocks;i++){
+      if(fabsf(blocks[i]-median)<=3*sigma){ s+=blocks[i]; k++; }
+    }
+    baseline=k?s/k:median;
+  }
+
+  // Feeds one |tremor| sample; returns true when calibration has finished.
+  bool push(float x){
+    if(done) return true;
+    blockSum+=x;
+    if(++blockN<CAL_BLOCK) return false;
+    float b=blockSum/CAL_BLOCK;
+    blockSum=0; blockN=0;
+
+    blocks[nBlocks++]=b;
+    double d=b-mean;
+    mean+=d/nBlocks;
+    m2+=d*(b-mean);
+    if(nBlocks<minBlocks) return false;
+
+    robust();
+    // MAD spread, so a bump does not hold calibration open; the Welford
+    // sd covers the degenerate case where half the blocks are identical.
+    double sd=sigma>0?sigma:sqrt(m2/(nBlocks-1));
+    double half=1.96*sd/sqrt((double)nBlocks);
+    if(half<=relTol*baseline || nBlocks>=maxBlocks) done=true;
+    return done;
+  }
+
+  float seconds(double fs) const { return nBlocks*CAL_BLOCK/fs; }
+};
@@ -0,0 +1,181 @@
+#pragma once
+// Int8 1D-CNN interpreter for raw 3-axis windows.
+// A model is a flat list of layers produced by tools/cnn_export.py into
+// include/cnn_model.h. Activations are int8, symmetric (zero point 0) and
+// channel-last ([t][c]); conv weights are [cout][k][cin] so every output is
+// one contiguous dot product of length k*cin against the input slice.
+// Accumulators are int32 and are requantised with a Q31 multiplier and a
+// right shift. Everything is integer, so the host build of this header
+// produces bit-identical results to the device.
+#include <stdint.h>
+#include <string.h>
+
+enum CnnOp : uint8_t { CNN_CONV_RELU=0, CNN_MAXPOOL=1, CNN_GAP=2, CNN_DENSE=3 };
+
+struct CnnLayer {
+  uint8_t op;
+  uint16_t cin,cout;     // channels (DENSE: features)
+  uint8_t k,stride;      // CONV: kernel/stride, MAXPOOL: size (== stride)
+  const int8_t *w;
+  const int32_t *b;
+  int32_t mult;          // Q31 requant multiplier
+  int8_t shift;          // extra right shift after Q31
+};
+
+struct CnnModel {
+  const CnnLayer *layers;
+  uint8_t nLayers;
+  uint16_t inLen;        // samples
+  uint8_t inCh;          // axes
+  float inScale;         // g per input LSB
+  uint8_t nClasses;      // last layer must be DENSE
+  float logitScale;      // real value of one logit LSB
+};
+
+static inline int8_t cnnRequant(int32_t acc,int32_t mult,int8_t shift){
+  int rs=31+shift;
+  int64_t v=((int64_t)acc*mult + ((int64_t)1<<(rs-1))) >> rs;
+  if(v>127) v=127;
+  if(v<-128) v=-128;
+  return (int8_t)v;
+}
+
+static inline int32_t cnnDot(const int8_t *a,const int8_t *b,uint16_t n){
+  int32_t s0=0,s1=0,s2=0,s3=0;
+  uint16_t i=0;
+  for(;i+4<=n;i+=4){
+    s0+=(int32_t)a[i]*b[i];
+    s1+=(int32_t)a[i+1]*b[i+1];
+    s2+=(int32_t)a[i+2]*b[i+2];
+    s3+=(int32_t)a[i+3]*b[i+3];
+  }
+  for(;i<n;i++) s0+=(int32_t)a[i]*b[i];
+  return s0+s1+s2+s3;
+}
+
+const uint8_t CNN_MAX_CLASSES = 8;     // logits buffers are this long
+
+// Walks the layers with the running length and channel count and checks
+// that each one fits its input: kernel and stride >= 1 (MAXPOOL: stride
+// == k), cin equal to the incoming channels (DENSE: features), input at
+// least one kernel long, requant shift and biases in range, and a last
+// DENSE layer with cout == nClasses, 1..CNN_MAX_CLASSES. wLen, when given,
+// holds each layer's weight count, which must be exactly cout*k*cin
+// (CONV), cout*features (DENSE) or 0. Returns nullptr when the model is
+// sound, else a short reason; cnnArenaBytes() and cnnRun() assume a model
+// that passed.
+static inline const char *cnnCheck(const CnnModel &m,const uint32_t *wLen=nullptr){
+  if(m.nClasses<1 || m.nClasses>CNN_MAX_CLASSES) return "classes";
+  if(!m.nLayers || !m.inLen || !m.inCh || (uint32_t)m.inLen*m.inCh>0xFFFF) return "shape";
+  uint32_t len=m.inLen, ch=m.inCh;
+  for(uint8_t i=0;i<m.nLayers;i++){
+    const CnnLayer &L=m.layers[i];
+    uint32_t w=0;
+    if(L.op==CNN_CONV_RELU){
+      if(L.k<1 || L.stride<1 || L.cout<1) return "conv";
+      if(L.cin!=ch || len<L.k || (uint32_t)L.k*ch>0xFFFF) return "conv shape";
+      w=(uint32_t)L.cout*L.k*L.cin;
+      len=(len-L.k)/L.stride+1; ch=L.cout;
+    } else if(L.op==CNN_MAXPOOL){
+      if(L.k<1 || L.stride!=L.k) return "pool";
+      if(L.cin!=ch || L.cout!=ch || len<L.k) return "pool shape";
+      len/=L.k;
+    } else if(L.op==CNN_GAP){
+      if(L.cin!=ch || L.cout!=ch) return "gap shape";
+      len=1;
+    } else if(L.op==CNN_DENSE){
+      if(L.cout<1) return "dense";
+      if(L.cin!=len*ch || len*ch>0xFFFF) return "dense shape";
+      w=(uint32_t)L.cout*L.cin;
+      len=1; ch=L.cout;
+    } else return "op";
+    if(w && (!L.w || !L.b)) return "weights";
+    if(w && (L.shift<-30 || L.shift>31)) return "shift";   // cnnRequant shifts by 31+shift
+    // |bias| <= 2^30 and a dot product of at most 0xFFFF int8 pairs keep acc in int32
+    for(uint16_t o=0;w && o<L.cout;o++) if(L.b[o]< -(1<<30) || L.b[o]>(1<<30)) return "bias";
+    if(wLen && wLen[i]!=w) return "wlen";
+    if(len*ch>0xFFFF) return "size";
+  }
+  const CnnLayer &last=m.layers[m.nLayers-1];
+  if(last.op!=CNN_DENSE || last.cout!=m.nClasses) return "last";
+  return nullptr;
+}
+
+// Largest activation tensor in bytes; the arena must hold two of them.
+static inline uint32_t cnnArenaBytes(const CnnModel &m){
+  uint32_t len=m.inLen, ch=m.inCh, best=len*ch;
+  for(uint8_t i=0;i<m.nLayers;i++){
+    const CnnLayer &L=m.layers[i];
+    if(L.op==CNN_CONV_RELU){ len=(len-L.k)/L.stride+1; ch=L.cout; }
+    else if(L.op==CNN_MAXPOOL){ len/=L.k; }
+    else if(L.op==CNN_GAP){ len=1; }
+    else { len=1; ch=L.cout; }
+    if(len*ch>best) best=len*ch;
+  }
+  return 2*best;
+}
+
+// in: inLen*inCh int8 ([t][c]); arena: cnnArenaBytes(m); logits: nClasses.
+// m must have passed cnnCheck().
+// Returns the argmax class.
+static inline uint8_t cnnRun(const CnnModel &m,const int8_t *in,int8_t *arena,int32_t *logits){
+  uint32_t half=cnnArenaBytes(m)/2;
+  int8_t *src=arena, *dst=arena+half;
+  memcpy(src,in,(size_t)m.inLen*m.inCh);
+  uint16_t len=m.inLen, ch=m.inCh;
+
+  for(uint8_t li=0;li<m.nLayers;li++){
+    const CnnLayer &L=m.layers[li];
+    if(L.op==CNN_CONV_RELU){
+      uint16_t outLen=(len-L.k)/L.stride+1;
+      uint16_t span=L.k*ch;
+      for(uint16_t t=0;t<outLen;t++){
+        const int8_t *x=src+(uint32_t)t*L.stride*ch;
+        int8_t *y=dst+(uint32_t)t*L.cout;
+        const int8_t *w=L.w;
+        for(uint16_t o=0;o<L.cout;o++,w+=span){
+          int32_t acc=L.b[o]+cnnDot(x,w,span);
+          int8_t q=cnnRequant(acc,L.mult,L.shift);
+          y[o]=q>0?q:0;
+        }
+      }
+      len=outLen; ch=L.cout;
+    } else if(L.op==CNN_MAXPOOL){
+      uint16_t outLen=len/L.k;
+      for(uint16_t t=0;t<outLen;t++){
+        for(uint16_t c=0;c<ch;c++){
+          int8_t v=src[(uint32_t)t*L.k*ch+c];
+          for(uint8_t j=1;j<L.k;j++){
+            int8_t u=src[((uint32_t)t*L.k+j)*ch+c];
+            if(u>v) v=u;
+          }
+          dst[(uint32_t)t*ch+c]=v;
+        }
+      }
+      len=outLen;
+    } else if(L.op==CNN_GAP){
+      for(uint16_t c=0;c<ch;c++){
+        int32_t s=0;
+        for(uint16_t t=0;t<len;t++) s+=src[(uint32_t)t*ch+c];
+        // round half away from zero, same as the exporter
+        dst[c]=(int8_t)(s>=0?(s+len/2)/len:-((-s+len/2)/len));
+      }
+      len=1;
+    } else {
+      uint16_t feats=len*ch;
+      const int8_t *w=L.w;
+      bool last=li==m.nLayers-1;
+      for(uint16_t o=0;o<L.cout;o++,w+=feats){
+        int32_t acc=L.b[o]+cnnDot(src,w,feats);
+        if(last) logits[o]=acc;
+        else dst[o]=cnnRequant(acc,L.mult,L.shift);
+      }
+      len=1; ch=L.cout;
+    }
+    int8_t *t=src; src=dst; dst=t;
+  }
+
+  uint8_t best=0;
+  for(uint8_t c=1;c<m.nClasses;c++) if(logits[c]>logits[best]) best=c;
+  return best;
+}
@@ -0,0 +1,177 @@
+#pragma once
+// Generated by tools/cnn_export.py from random weights (seed 1), untrained placeholder. Do not edit.
+#include "cnn.h"
+
+static const int8_t cnn_w0[120] = {
+  16, 38, 15, -61, 42, 21, -25, 27, 17, 14, 1, 26, -34, -8, -23, 28,
+  2, -14, -37, -12, 0, -13, 61, 47, -127, -88, -8, -20, 10, 10, 99, -52,
+  -18, 96, 30, 31, -24, -77, 8, 5, -57, -32, -3, -44, -5, 4, 2, -24,
+  28, 42, 15, -38, 34, -23, 41, -50, 43, -1, -58, -15, 3, 13, -46, -52,
+  9, -22, 11, 36, -77, 12, 57, -14, -38, 35, 12, 42, -16, -69, -5, -21,
+  36, 9, -76, -56, 41, 32, -30, 0, 21, 22, 41, 12, -4, -12, 49, -105,
+  -6, 2, -67, 16, -31, 40, -6, 31, 57, 18, -41, -71, 82, -5, -32, 7,
+  -9, 40, 2, 1, -33, 22, -48, 31
+};
+
+static const int32_t cnn_b0[8] = {
+  0, 0, 0, 0, 0, 0, 0, 0
+};
+
+static const int8_t cnn_w2[640] = {
+  55, -55, -88, 22, 91, -36, -45, 21, -30, -18, -12, 19, -15, 10, -6, -30,
+  -11, -34, 0, -40, -39, 52, -2, -2, 18, -15, -8, 15, 10, -41, 30, -21,
+  -38, -32, -14, 58, -42, 6, -77, 0, 32, -8, -23, 8, 25, 24, 71, 7,
+  -21, -5, -3, 4, -1, 6, -60, 30, -21, -42, 23, 47, 18, 6, -33, 103,
+  32, -41, -28, 3, -56, 6, -16, 44, 34, -97, 1, -58, 40, 6, 20, -38,
+  65, 72, -38, 13, -24, -1, -45, 67, -35, -11, 18, -23, -9, -20, -5, -42,
+  -16, -7, -12, 2, -10, 27, -12, -5, -24, -19, -45, 19, -41, -27, 13, 14,
+  -14, -72, 15, 9, -51, 28, -25, -40, 3, -6, 7, -57, 65, -22, -55, 22,
+  -13, 12, -12, -2, 9, -27, 24, -17, -31, 3, 16, -8, -31, 22, -63, -37,
+  1, -49, 1, -2, 32, -33, -22, 12, -88, 111, -25, -26, 31, -1, -64, 22,
+  31, -16, -10, 17, -33, 16, 7, -24, -50, -8, -31, 36, 5, 28, 5, 9,
+  -28, 24, 64, -11, -21, -6, -17, -25, 5, -10, 51, 0, 12, 34, -11, 51,
+  -23, -29, -13, -4, -50, -1, -60, 50, -3, -23, -33, -14, -8, -37, -33, -7,
+  -19, 34, 41, 1, 17, -48, 23, -1, 17, 57, -82, 9, -39, 21, -47, -18,
+  7, 22, 3, -28, -20, 32, 0, -60, 30, 15, 31, -12, 30, -38, 20, -18,
+  24, 36, -26, -2, 1, 43, 25, -44, 16, 27, 76, -60, -19, 48, -48, -43,
+  19, 36, -24, 19, 4, 54, 0, 35, -32, -7, -3, 41, 21, -27, 24, 28,
+  -4, -9, -7, -61, 7, 8, -31, 27, -49, -20, -17, 71, -57, 20, 34, 14,
+  42, -36, -82, 27, -43, -12, -42, 38, 31, -26, 32, 4, -5, 2, -7, 22,
+  11, -13, 36, -22, 10, 15, 53, -18, 62, 6, -7, -24, 21, 2, -39, -40,
+  -20, -24, 39, 49, 31, 13, -15, 2, 32, 76, 33, -10, 1, -17, -28, -7,
+  7, 66, 2, 49, 63, 3, 58, 26, -15, 9, 1, -8, -7, 5, 16, -32,
+  0, -54, 9, 22, 6, 10, 21, -24, -9, 18, 36, 14, 91, -3, 36, 45,
+  -5, -29, -42, 6, 40, 10, 6, -14, 20, -76, 8, 1, -49, 78, -50, -39,
+  -43, 40, -32, 24, 21, 9, -47, -22, 60, -46, -30, -6, 29, 9, 27, -38,
+  34, 20, -57, 55, 82, -28, 2, 50, -53, -71, -46, -20, -21, 22, 10, -45,
+  20, 67, 43, 35, 1, 35, -35, 27, -3, 40, 17, -39, 5, 44, -40, -20,
+  -28, -54, 34, 47, 29, 9, -2, 9, -26, 32, 37, 33, -19, 3, -6, 64,
+  6, -67, 14, 67, 25, 31, 1, -71, -65, -45, -5, 11, 25, -12, 34, -10,
+  -25, 30, -33, -98, -38, 3, -110, -13, -12, -51, -53, -17, -20, 45, 13, -57,
+  -31, 25, 68, 14, 11, 67, -1, -11, -51, -18, 78, -51, 0, -50, 5, 32,
+  -9, 26, 26, 16, 61, 28, -11, -24, -30, 17, -12, 98, 66, -8, -12, 60,
+  -67, -16, 34, -33, -17, -13, 24, 5, 14, 21, 1, 40, -26, -51, -64, -58,
+  -20, 37, 6, -21, -38, -19, -14, -20, -51, -17, 36, -78, -9, -76, 7, -27,
+  -75, 4, 65, 4, 42, -3, -77, 18, -15, -52, 28, 10, -19, 31, -31, 23,
+  -34, 19, -39, 53, 9, 51, -29, -17, 30, -98, -38, 37, 17, 35, -11, 20,
+  -26, -49, -61, -20, -20, -23, -127, -72, -19, 10, -21, -31, -83, 72, -39, 60,
+  56, 10, -20, 5, -41, 9, 0, 19, 34, 62, -14, 37, -28, -32, -22, -35,
+  35, 33, 46, -1, 10, -21, -41, 16, 10, -40, 21, -62, -6, -23, -19, -39,
+  34, 20, 42, 5, -46, -14, -43, 16, 43, 11, -22, -14, 7, -52, 5, 7
+};
+
+static const int32_t cnn_b2[16] = {
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
+};
+
+static const int8_t cnn_w4[768] = {
+  -19, -15, 5, -28, -28, 26, 7, 56, -34, -61, 31, 32, -26, -51, -2, -60,
+  -12, -75, -9, -73, -9, 50, -10, 25, -23, -31, -52, 34, -3, 54, -41, -9,
+  1, 46, 60, -24, -40, -60, 44, -5, -24, -3, -88, -60, 30, 12, 3, -36,
+  18, 58, -43, -1, -17, 10, -1, -7, -32, -2, -23, -7, -4, 20, -22, -13,
+  34, -9, -11, 27, 7, 1, 6, -44, 14, 43, 18, -54, 8, -32, -9, 3,
+  -42, 44, -4, 25, 20, 44, 39, -51, 0, -74, -16, 23, 30, 42, -14, 10,
+  2, 42, 53, -13, 127, -1, -14, 19, 25, 17, -23, 49, 1, 51, 46, -44,
+  -34, -35, 8, 1, 8, -28, 14, 47, -46, -7, 8, -5, -7, 59, 43, 28,
+  -26, 75, 12, -20, -12, -17, 71, 6, 2, -73, 25, -36, -39, 20, -30, 28,
+  38, -61, -5, -54, -3, 30, -47, 61, -11, -41, -5, 26, -47, 0, -47, 40,
+  5, -15, 34, -44, -14, 62, -5, 45, 6, -24, -9, 2, -15, -29, -27, -51,
+  3, 13, 25, -62, 27, -1, -49, 3, 27, 17, 24, 31, 30, -2, -71, -26,
+  11, -17, 22, 26, 1, 63, -34, 31, -17, -27, 19, -22, 28, -40, 1, -29,
+  -9, -13, -39, 22, -43, -34, 30, 32, 22, 11, 77, -42, -26, -34, 30, 9,
+  37, 32, -8, -28, -34, 74, 32, 20, -12, -7, -12, -11, -82, -3, -13, 9,
+  7, 28, -1, 26, -87, -38, 58, -42, -10, 23, -30, 24, -49, -65, -45, -56,
+  -1, -11, 11, -36, 86, -4, -2, 15, -9, -22, 2, 31, 22, 31, -20, -27,
+  67, -9, 16, 25, 48, -46, -17, -15, -11, -82, -4, -98, 10, 18, 20, -41,
+  32, -30, -42, -34, -29, 6, 28, -71, -19, 30, 7, 17, -51, 32, -53, 6,
+  46, 64, 17, 30, -21, -16, 40, 0, -4, -48, 5, 22, -27, -17, 54, 6,
+  -10, -38, -21, -8, 46, -21, 61, -31, -12, 29, -8, -28, -4, 15, -58, -8,
+  -4, -14, 25, -19, -12, 1, 25, -7, 51, -31, 44, -29, -6, 12, 70, 30,
+  -14, 44, -7, -27, 15, 3, 32, -19, 13, 21, 9, -1, -24, 31, 5, 17,
+  -12, 0, -35, 3, 26, 3, 29, 11, 46, -6, -55, 15, -6, -33, 22, 9,
+  15, -11, 7, 9, 60, -23, 0, 12, -58, -54, 73, -60, 19, -29, -26, -67,
+  -30, 27, -47, 20, 11, 68, -16, 43, 30, -10, -56, 51, -46, -16, 30, 38,
+  -29, -1, -9, 40, 85, -62, 31, -97, 0, -38, 67, 6, -25, -17, -19, 6,
+  -5, 22, 52, 24, -42, -55, -26, 36, -11, -23, 5, -48, -39, 17, -10, -15,
+  11, -20, -23, -16, 20, 2, -40, -10, 22, 63, -39, 11, -9, 28, 15, 50,
+  18, -18, -18, 14, 13, 81, 57, -40, 12, -45, -56, 25, 19, -35, 56, -33,
+  -40, 22, 7, -5, -2, 8, -5, -6, -64, -45, 21, -24, 18, 42, -12, 10,
+  70, 24, 62, 52, 26, -4, -29, -38, 16, 16, -6, 29, -20, 38, 1, -1,
+  0, -3, 84, -55, 6, 42, 24, -10, 59, -36, -44, 19, -49, -80, 30, 26,
+  25, -17, 6, -33, 59, 27, 25, -66, 27, 51, 41, 27, 0, -12, 20, 13,
+  8, -10, 57, -40, -1, -20, 35, 48, 42, 26, -47, 70, 17, -4, 1, -11,
+  14, 10, -12, -87, -1, 16, 18, -5, 15, 35, -16, 50, -66, -43, -31, -83,
+  -34, 42, 42, 3, 58, 8, -17, 8, -5, 25, -51, 34, -16, 29, -52, -14,
+  3, 31, -41, 56, 16, -18, 41, 3, 39, 79, 26, -18, -14, 20, 10, -28,
+  -23, 23, 79, -89, 25, -7, 26, 29, 2, -34, -47, -63, 41, -7, -18, -9,
+  -45, 10, 45, 39, -53, 46, -26, -65, -42, -33, 0, -35, -51, -9, 65, -24,
+  16, 3, 90, -64, 37, -43, -20, -3, 108, -26, -64, 44, -28, -8, -1, 3,
+  -6, 9, 13, 29, -14, -25, -36, 20, -2, 19, 18, 57, 7, 25, -41, -37,
+  -11, -41, 23, -45, 2, -83, -37, -11, -9, -61, 4, 33, 22, -22, -20, -40,
+  21, 49, -18, -57, 7, 24, -92, 5, 73, 28, 19, 14, 36, -32, -29, 14,
+  -23, 9, -65, 26, 29, 1, 6, 55, -37, -31, -37, -14, -34, 1, -22, -49,
+  -52, 41, -2, -8, 1, -3, 26, 19, -20, -28, -37, -42, 47, -31, -68, -29,
+  -27, 11, -30, 18, 13, 43, 73, 96, 46, -39, -14, 8, 70, 23, 41, -6,
+  20, 24, -15, 26, 36, -5, 34, 56, 2, 0, -10, -21, 5, -14, -11, -26
+};
+
+static const int32_t cnn_b4[16] = {
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
+};
+
+static const int8_t cnn_w6[64] = {
+  -70, -43, 15, -54, -29, 75, 51, -32, 27, -30, 74, -27, 4, 63, -38, 59,
+  -37, 11, -13, -4, 7, -3, -46, 39, 33, 59, 63, -61, 58, 59, -24, 47,
+  67, -25, -63, -16, 127, 11, -55, -12, -45, -18, 4, -116, 16, 64, -9, -17,
+  50, -58, -57, -63, -7, 18, -4, 25, 38, 23, -37, -12, 57, -48, -12, -19
+};
+
+static const int32_t cnn_b6[4] = {
+  0, 0, 0, 0
+};
+
+static const CnnLayer cnn_layers[] = {
+  {CNN_CONV_RELU,3,8,5,1,cnn_w0,cnn_b0,1186046489,7},
+  {CNN_MAXPOOL,8,8,2,2,nullptr,nullptr,0,0},
+  {CNN_CONV_RELU,8,16,5,1,cnn_w2,cnn_b2,1226539450,7},
+  {CNN_MAXPOOL,16,16,2,2,nullptr,nullptr,0,0},
+  {CNN_CONV_RELU,16,16,3,1,cnn_w4,cnn_b4,1234680854,7},
+  {CNN_GAP,16,16,0,1,nullptr,nullptr,0,0},
+  {CNN_DENSE,16,4,0,1,cnn_w6,cnn_b6,1674226379,6},
+};
+
+static const CnnModel cnn_model = {cnn_layers,7,128,3,0.0115647414f,4,0.000215911113f};
+
+static const char *const cnn_classes[] = {"no_tremor","parkinsonian","essential","physiological"};
+
+// Self-test: one calibration window and its expected logits.
+static const int8_t cnn_test_in[384] = {
+  13, -27, 77, 9, -38, 67, 8, -47, 62, 8, -49, 59, 9, -50, 60, 10,
+  -43, 64, 11, -33, 72, 15, -21, 81, 20, -7, 91, 22, 4, 99, 26, 11,
+  106, 27, 17, 107, 25, 16, 108, 25, 9, 102, 19, -2, 95, 16, -14, 85,
+  14, -29, 75, 10, -40, 69, 8, -47, 61, 8, -49, 60, 6, -49, 61, 10,
+  -43, 67, 11, -32, 74, 16, -17, 82, 19, -6, 90, 21, 6, 100, 26, 12,
+  107, 25, 17, 107, 24, 14, 107, 23, 7, 100, 19, -3, 94, 16, -17, 85,
+  12, -30, 75, 8, -40, 66, 8, -48, 61, 8, -51, 60, 8, -47, 62, 10,
+  -40, 66, 12, -30, 73, 15, -17, 83, 19, -5, 93, 23, 8, 100, 26, 15,
+  107, 24, 17, 108, 25, 14, 106, 23, 6, 98, 20, -6, 93, 16, -18, 82,
+  12, -31, 72, 10, -41, 65, 6, -48, 60, 7, -51, 61, 8, -47, 60, 11,
+  -39, 68, 13, -28, 75, 17, -16, 83, 21, -5, 93, 23, 7, 102, 25, 14,
+  106, 25, 17, 108, 24, 11, 104, 23, 5, 99, 21, -8, 90, 15, -19, 81,
+  12, -33, 73, 10, -43, 65, 6, -49, 61, 7, -48, 58, 9, -47, 62, 10,
+  -39, 67, 16, -27, 74, 17, -13, 85, 22, -1, 94, 23, 8, 101, 24, 16,
+  108, 24, 15, 106, 24, 9, 103, 23, 3, 99, 18, -6, 90, 15, -19, 80,
+  11, -33, 71, 10, -44, 65, 8, -50, 60, 6, -48, 59, 8, -47, 62, 11,
+  -37, 68, 14, -27, 76, 20, -12, 86, 20, -1, 96, 24, 9, 101, 27, 16,
+  106, 25, 15, 105, 24, 10, 103, 21, 3, 96, 17, -9, 89, 14, -22, 79,
+  12, -36, 71, 10, -44, 64, 4, -49, 60, 7, -50, 59, 9, -45, 62, 12,
+  -37, 70, 15, -25, 78, 17, -10, 88, 21, 0, 97, 25, 10, 104, 25, 16,
+  107, 26, 14, 107, 24, 11, 103, 22, 0, 97, 17, -12, 88, 16, -24, 78,
+  10, -36, 69, 10, -45, 61, 9, -50, 59, 9, -50, 59, 9, -44, 64, 10,
+  -33, 71, 15, -23, 78, 19, -10, 88, 22, 3, 97, 25, 13, 103, 25, 17,
+  108, 25, 16, 106, 22, 9, 103, 20, -1, 95, 17, -14, 87, 15, -26, 77
+};
+
+static const int32_t cnn_test_logits[4] = {
+  300, 1216, -1484, -519
+};
@@ -0,0 +1,54 @@
+#pragma once
+// Payloads of the once-per-window events ("bands", "gated", "quality"),
+// shared by src/main.cpp and the host tools so both write the same bytes.
+// Each formats into out (cap bytes) and returns snprintf's length.
+//
+// Every window event carries a WindowStamp:
+//   t    device time of the window close, seconds since boot, from
+//        DevClock so it keeps counting across the 49.7-day millis() wrap
+//   seq  windows closed since boot, one per window whatever its events
+// A gateway orders and aligns on t (gateway/align.py) and can see lost
+// windows as gaps in seq; without t it falls back to arrival time.
+#include <stdint.h>
+#include <stdio.h>
+
+struct WindowStamp {
+  double t=0;
+  uint32_t seq=0;
+};
+
+// millis() widened to 64 bits. Needs a call at least once per wrap
+// (49.7 days); the firmware calls it every window.
+struct DevClock {
+  uint32_t last=0,wraps=0;
+  double seconds(uint32_t ms){
+    if(ms<last) wraps++;
+    last=ms;
+    return (((uint64_t)wraps<<32)|ms)/1000.0;
+  }
+};
+
+const uint16_t EV_BANDS_BYTES = 256;
+const uint16_t EV_GATED_BYTES = 160;
+const uint16_t EV_QUALITY_BYTES = 128;
+
+inline int fmtBands(char *out,size_t cap,const WindowStamp &s,double P1,double P2,double P3,
+                    const char *type,double conf,double score,double meanNorm,double personalW){
+  return snprintf(out,cap,
+    "{\"t\":%.3f,\"seq\":%lu,\"b1\":%.6f,\"b2\":%.6f,\"b3\":%.6f,"
+    "\"type\":\"%s\",\"confidence\":%.3f,"
+    "\"score\":%.3f,\"meanNorm\":%.4f,\"personal\":%.2f}",
+    s.t,(unsigned long)s.seq,P1,P2,P3,type,conf,score,meanNorm,personalW);
+}
+
+inline int fmtGated(char *out,size_t cap,const WindowStamp &s,double volRms,double ratio,double meanNorm){
+  return snprintf(out,cap,
+    "{\"t\":%.3f,\"seq\":%lu,\"type\":\"Voluntary Movement\",\"volRms\":%.4f,"
+    "\"ratio\":%.3f,\"meanNorm\":%.4f}",
+    s.t,(unsigned long)s.seq,volRms,ratio,meanNorm);
+}
+
+inline int fmtQuality(char *out,size_t cap,const WindowStamp &s,uint32_t rejWindow,uint32_t rejTotal,uint32_t maxCyc){
+  return snprintf(out,cap,"{\"t\":%.3f,\"seq\":%lu,\"rej\":%lu,\"rejTotal\":%lu,\"hampelCyc\":%lu}",
+    s.t,(unsigned long)s.seq,(unsigned long)rejWindow,(unsigned long)rejTotal,(unsigned long)maxCyc);
+}
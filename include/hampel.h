@@ -0,0 +1,101 @@
+#pragma once
+// Streaming Hampel spike rejection.
+// SlidingMedian keeps the last W samples in two indexed heaps (max-heap of
+// the lower half, min-heap of the upper half); each new sample overwrites
+// the oldest slot in place and is sifted back into order, O(log W).
+// Hampel compares the newest sample with the window median and replaces it
+// by the median when it lies more than K robust sigmas away. The scale is a
+// running mean of |x - median|, winsorised at the threshold so a spike
+// barely moves it (a streaming stand-in for the window MAD), with a floor
+// so sensor noise at rest is never cut.
+#include <stdint.h>
+#include <math.h>
+
+template<uint8_t W>
+struct SlidingMedian {
+  static_assert(W%2==1,"window must be odd");
+  static const uint8_t NLO=(W+1)/2, NHI=W/2;
+  float val[W];
+  uint8_t lo[NLO],hi[NHI];   // slot indices
+  uint8_t where[W];          // slot -> heap position, bit 7 set when in hi
+  uint8_t oldest=0;
+
+  void init(float x){
+    for(uint8_t i=0;i<W;i++) val[i]=x;
+    for(uint8_t i=0;i<NLO;i++){ lo[i]=i; where[i]=i; }
+    for(uint8_t i=0;i<NHI;i++){ hi[i]=NLO+i; where[NLO+i]=0x80|i; }
+    oldest=0;
+  }
+
+  float median() const { return val[lo[0]]; }
+
+  float push(float x){
+    uint8_t s=oldest;
+    if(++oldest>=W) oldest=0;
+    val[s]=x;
+    uint8_t w=where[s];
+    if(w&0x80){ uint8_t i=w&0x7f; i=upHi(i); downHi(i); }
+    else      { uint8_t i=upLo(w); downLo(i); }
+    while(NHI>0 && val[lo[0]]>val[hi[0]]){
+      uint8_t a=lo[0],b=hi[0];
+      lo[0]=b; where[b]=0;
+      hi[0]=a; where[a]=0x80;
+      downLo(0); downHi(0);
+    }
+    return median();
+  }
+
+private:
+  void setLo(uint8_t i,uint8_t s){ lo[i]=s; where[s]=i; }
+  void setHi(uint8_t i,uint8_t s){ hi[i]=s; where[s]=0x80|i; }
+  uint8_t upLo(uint8_t i){
+    while(i>0){ uint8_t p=(i-1)/2; if(val[lo[p]]>=val[lo[i]]) break;
+      uint8_t t=lo[p]; setLo(p,lo[i]); setLo(i,t); i=p; }
+    return i;
+  }
+  void downLo(uint8_t i){
+    for(;;){ uint8_t l=2*i+1,r=l+1,m=i;
+      if(l<NLO && val[lo[l]]>val[lo[m]]) m=l;
+      if(r<NLO && val[lo[r]]>val[lo[m]]) m=r;
+      if(m==i) return;
+      uint8_t t=lo[m]; setLo(m,lo[i]); setLo(i,t); i=m; }
+  }
+  uint8_t upHi(uint8_t i){
+    while(i>0){ uint8_t p=(i-1)/2; if(val[hi[p]]<=val[hi[i]]) break;
+      uint8_t t=hi[p]; setHi(p,hi[i]); setHi(i,t); i=p; }
+    return i;
+  }
+  void downHi(uint8_t i){
+    for(;;){ uint8_t l=2*i+1,r=l+1,m=i;
+      if(l<NHI && val[hi[l]]<val[hi[m]]) m=l;
+      if(r<NHI && val[hi[r]]<val[hi[m]]) m=r;
+      if(m==i) return;
+      uint8_t t=hi[m]; setHi(m,hi[i]); setHi(i,t); i=m; }
+  }
+};
+
+template<uint8_t W>
+struct Hampel {
+  SlidingMedian<W> med;
+  float scale=0;
+  float k=4.0f;            // threshold in robust sigmas
+  float minScale=0.02f;    // g; floor for the robust sigma
+  float alpha=0.05f;
+  uint32_t rejected=0;
+  bool primed=false;
+
+  float process(float x){
+    if(!primed){ med.init(x); primed=true; }
+    float m=med.push(x);
+    float d=fabsf(x-m);
+    float sigma=1.4826f*scale;
+    if(sigma<minScale) sigma=minScale;
+    bool spike=d>k*sigma;
+    scale+=alpha*((spike?k*sigma:d)-scale);
+    if(spike){
+      rejected++;
+      return m;
+    }
+    return x;
+  }
+};
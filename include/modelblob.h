@@ -0,0 +1,127 @@
+#pragma once
+// Binary model blobs for the "models" flash partition.
+// A blob is a fixed header followed by a payload; tools/cnn_export.py
+// writes them with --blob. All fields are little-endian (ESP32 and x86
+// both are), and every array in the payload starts on a 4-byte boundary
+// so the parser can point into the buffer instead of copying.
+//
+//   header   ModelBlobHeader
+//   payload  CnnBlobInfo
+//            per layer: CnnBlobLayer, int8 w[wLen] (padded to 4), int32 b[bLen]
+//            int8 testIn[inLen*inCh] (padded to 4), int32 testLogits[nClasses]
+#include <stdint.h>
+#include <string.h>
+#include "cnn.h"
+
+const uint32_t MODEL_MAGIC = 0x444D5254;   // "TRMD"
+const uint16_t MODEL_FORMAT = 1;
+const uint16_t MODEL_KIND_CNN = 1;
+const uint8_t CNN_MAX_LAYERS = 16;
+
+struct ModelBlobHeader {
+  uint32_t magic;
+  uint16_t format;
+  uint16_t kind;
+  uint32_t version;      // model version, chosen by whoever exports it
+  uint32_t length;       // payload bytes
+  uint32_t crc;          // CRC-32 (zlib polynomial) of the payload
+};
+
+struct CnnBlobInfo {
+  uint16_t inLen;
+  uint8_t inCh,nClasses;
+  float inScale,logitScale;
+  uint8_t nLayers,pad[3];
+};
+
+struct CnnBlobLayer {
+  uint8_t op,k,stride;
+  int8_t shift;
+  uint16_t cin,cout;
+  int32_t mult;
+  uint32_t wLen,bLen;
+};
+
+// A CNN whose arrays live inside a blob buffer owned by the caller.
+struct CnnBlobModel {
+  CnnLayer layers[CNN_MAX_LAYERS];
+  CnnModel model;
+  const int8_t *testIn;
+  const int32_t *testLogits;
+  uint32_t version;
+};
+
+inline uint32_t modelCrc32(const uint8_t *p,uint32_t n){
+  uint32_t c=0xFFFFFFFF;
+  for(uint32_t i=0;i<n;i++){
+    c^=p[i];
+    for(uint8_t k=0;k<8;k++) c=(c>>1)^(0xEDB88320 & (0u-(c&1)));
+  }
+  return ~c;
+}
+
+// Validates header, CRC, structure and layer shapes (cnnCheck), so nothing
+// runs a blob whose arrays do not match its layers. blob must be 4-byte
+// aligned.
+// Returns nullptr on success or a short reason.
+inline const char *cnnBlobParse(const uint8_t *blob,uint32_t size,CnnBlobModel &out){
+  if(size<sizeof(ModelBlobHeader)) return "short";
+  ModelBlobHeader h;
+  memcpy(&h,blob,sizeof(h));
+  if(h.magic!=MODEL_MAGIC) return "magic";
+  if(h.format!=MODEL_FORMAT) return "format";
+  if(h.kind!=MODEL_KIND_CNN) return "kind";
+  if(h.length>size-sizeof(h)) return "length";
+  const uint8_t *p=blob+sizeof(h), *end=p+h.length;
+  if(modelCrc32(p,h.length)!=h.crc) return "crc";
+
+  auto pad4=[](uint32_t n){ return (n+3)&~3u; };
+  if(end-p<(long)sizeof(CnnBlobInfo)) return "info";
+  const CnnBlobInfo *info=(const CnnBlobInfo*)p;
+  p+=sizeof(CnnBlobInfo);
+  if(info->nLayers==0 || info->nLayers>CNN_MAX_LAYERS) return "layers";
+
+  uint32_t wLen[CNN_MAX_LAYERS];
+  for(uint8_t i=0;i<info->nLayers;i++){
+    if(end-p<(long)sizeof(CnnBlobLayer)) return "layer";
+    const CnnBlobLayer *L=(const CnnBlobLayer*)p;
+    p+=sizeof(CnnBlobLayer);
+    if(L->op>CNN_DENSE) return "op";
+    if((uint32_t)(end-p)<pad4(L->wLen)+4*L->bLen) return "weights";
+    wLen[i]=L->wLen;
+    CnnLayer &d=out.layers[i];
+    d.op=L->op; d.cin=L->cin; d.cout=L->cout; d.k=L->k; d.stride=L->stride;
+    d.mult=L->mult; d.shift=L->shift;
+    d.w=L->wLen?(const int8_t*)p:nullptr;
+    p+=pad4(L->wLen);
+    d.b=L->bLen?(const int32_t*)p:nullptr;
+    p+=4*L->bLen;
+    bool hasW=d.op==CNN_CONV_RELU || d.op==CNN_DENSE;
+    if(L->bLen!=(hasW?d.cout:0u)) return "weights";
+  }
+
+  uint32_t inBytes=(uint32_t)info->inLen*info->inCh;
+  if((uint32_t)(end-p)<pad4(inBytes)+4u*info->nClasses) return "test";
+  out.testIn=(const int8_t*)p;
+  p+=pad4(inBytes);
+  out.testLogits=(const int32_t*)p;
+
+  out.model.layers=out.layers;
+  out.model.nLayers=info->nLayers;
+  out.model.inLen=info->inLen;
+  out.model.inCh=info->inCh;
+  out.model.inScale=info->inScale;
+  out.model.nClasses=info->nClasses;
+  out.model.logitScale=info->logitScale;
+  out.version=h.version;
+  return cnnCheck(out.model,wLen);
+}
+
+// Runs the blob's own test vector; arena must be cnnArenaBytes() long.
+inline bool cnnBlobSelfTest(const CnnBlobModel &m,int8_t *arena){
+  int32_t logits[CNN_MAX_CLASSES];
+  if(cnnCheck(m.model)) return false;
+  cnnRun(m.model,m.testIn,arena,logits);
+  for(uint8_t c=0;c<m.model.nClasses;c++) if(logits[c]!=m.testLogits[c]) return false;
+  return true;
+}
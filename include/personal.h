@@ -0,0 +1,74 @@
+#pragma once
+// Per-patient adaptive model in the 7-feature space of
+// ai_dashboard/backend/ml/features.py. Each class keeps a running mean and
+// diagonal covariance (Welford), so a labelled window costs O(features).
+// Power-like features are log1p-compressed first: dom_ratio alone spans
+// 1..1e5 and would swamp a Gaussian in raw units.
+// The struct is plain data so it can be stored in NVS as one blob.
+#include <math.h>
+#include <stdint.h>
+
+const uint8_t PM_FEATS = 7;
+const uint8_t PM_CLASSES = 4;          // no_tremor, parkinsonian, essential, physiological
+const uint16_t PM_VERSION = 1;
+const uint16_t PM_MIN_COUNT = 5;       // windows before a class takes part
+const float PM_VAR_FLOOR = 1e-4f;
+
+struct PersonalModel {
+  uint16_t version=PM_VERSION;
+  uint32_t n[PM_CLASSES]={0,0,0,0};
+  float mean[PM_CLASSES][PM_FEATS]={};
+  float m2[PM_CLASSES][PM_FEATS]={};
+
+  // Same features as extract_features_single(), then compressed.
+  static void features(double b1,double b2,double b3,double meanNorm,float *f){
+    const double eps=1e-6;
+    double total=b1+b2+b3;
+    double mx=b1>b2?(b1>b3?b1:b3):(b2>b3?b2:b3);
+    double mn=b1<b2?(b1<b3?b1:b3):(b2<b3?b2:b3);
+    f[0]=log1p(b1); f[1]=log1p(b2); f[2]=log1p(b3);
+    f[3]=log1p(total);
+    f[4]=meanNorm;
+    f[5]=log1p(mx/(mn+eps));
+    f[6]=(b2+2*b3)/(total+eps);
+  }
+
+  void update(uint8_t c,const float *f){
+    n[c]++;
+    for(uint8_t i=0;i<PM_FEATS;i++){
+      float d=f[i]-mean[c][i];
+      mean[c][i]+=d/n[c];
+      m2[c][i]+=d*(f[i]-mean[c][i]);
+    }
+  }
+
+  uint32_t total() const { uint32_t t=0; for(uint8_t c=0;c<PM_CLASSES;c++) t+=n[c]; return t; }
+
+  // Posterior over classes with enough data (others get 0).
+  // Returns the number of classes that took part.
+  uint8_t posterior(const float *f,float *p) const {
+    float ll[PM_CLASSES];
+    float best=-INFINITY;
+    uint8_t used=0;
+    for(uint8_t c=0;c<PM_CLASSES;c++){
+      if(n[c]<PM_MIN_COUNT){ ll[c]=-INFINITY; continue; }
+      float s=0;
+      for(uint8_t i=0;i<PM_FEATS;i++){
+        float var=m2[c][i]/(n[c]-1);
+        if(var<PM_VAR_FLOOR) var=PM_VAR_FLOOR;
+        float d=f[i]-mean[c][i];
+        s+=-0.5f*(d*d/var + logf(var));
+      }
+      ll[c]=s;
+      if(s>best) best=s;
+      used++;
+    }
+    float den=0;
+    for(uint8_t c=0;c<PM_CLASSES;c++){
+      p[c]=used?expf(ll[c]-best):0;
+      den+=p[c];
+    }
+    for(uint8_t c=0;c<PM_CLASSES;c++) if(den>0) p[c]/=den;
+    return used;
+  }
+};
@@ -0,0 +1,150 @@
+#pragma once
+// Guided test-suite runner (rest / postural / movement).
+// The schedule is counted in samples from a window boundary, so phase
+// edges do not depend on the browser's timers. A window belongs to the
+// phase that holds its middle sample. Each phase keeps streaming
+// aggregates of the per-window outputs that the dashboard's
+// _buildPhaseSummary() derives from its window list; the scores themselves
+// are kept (a phase is a few dozen windows) for the percentiles.
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+
+const uint8_t PH_MAX = 3;
+const uint8_t PH_MAX_WIN = 48;          // 120 s of 2.56 s windows
+const char *const PH_NAMES[PH_MAX] = {"rest","postural","movement"};
+
+struct PhaseAgg {
+  uint32_t samples;                     // phase length actually run
+  uint16_t n,gated;
+  float scores[PH_MAX_WIN];
+  double sMean,sM2;                     // Welford on score
+  double bSum[3],bSq[3];
+  double normSum;
+  double wtv;                           // sum of squared score steps
+  double sxy;                           // sum of i*score for the slope
+  float last;
+  uint8_t prevDom;
+  uint16_t switches;
+  uint16_t dist[4];                     // <2.5, <5, <7.5, >=7.5
+
+  void add(double P1,double P2,double P3,double score,double meanNorm){
+    if(n>0) wtv+=(score-last)*(score-last);
+    last=score;
+    if(n<PH_MAX_WIN) scores[n]=score;
+    sxy+=(double)n*score;
+    n++;
+    double d=score-sMean;
+    sMean+=d/n;
+    sM2+=d*(score-sMean);
+    double b[3]={P1,P2,P3};
+    for(int k=0;k<3;k++){ bSum[k]+=b[k]; bSq[k]+=b[k]*b[k]; }
+    normSum+=meanNorm;
+    uint8_t dom=P1>=P2&&P1>=P3?1:P2>=P3?2:3;
+    if(n>1 && dom!=prevDom) switches++;
+    prevDom=dom;
+    dist[score<2.5?0:score<5?1:score<7.5?2:3]++;
+  }
+};
+
+struct PhaseRunner {
+  uint32_t len[PH_MAX];                 // samples per phase
+  PhaseAgg agg[PH_MAX];
+  int8_t phase=-1;                      // running phase, -1 = idle
+  bool done=false;
+  uint32_t pos=0;                       // samples into the current phase
+  int8_t winPhase=-1;
+
+  void start(const uint32_t *samples){
+    for(uint8_t i=0;i<PH_MAX;i++){ len[i]=samples[i]; agg[i]=PhaseAgg(); }
+    phase=0; pos=0; done=false;
+    winPhase=-1;
+  }
+  void abort(){ phase=-1; done=false; winPhase=-1; }
+  bool running() const { return phase>=0; }
+  // The last phase's final window may close after the schedule ends.
+  bool finished() const { return done && winPhase<0; }
+
+  // Ends the current phase now; returns true if it was the last one.
+  bool next(){
+    agg[phase].samples=pos;
+    pos=0;
+    if(++phase>=PH_MAX){ phase=-1; done=true; return true; }
+    return false;
+  }
+
+  // Called once per sample after the pipeline push. idx is the sample's
+  // position in the window; a window's owner is fixed at its middle.
+  // Returns true when a phase boundary was crossed on this sample.
+  bool tick(uint16_t idx,uint16_t window){
+    if(phase<0) return false;
+    if(idx==window/2) winPhase=phase;
+    if(++pos<len[phase]) return false;
+    next();
+    return true;
+  }
+
+  // Called on window close with the window's outputs.
+  void window(bool gated,double P1,double P2,double P3,double score,double meanNorm){
+    if(winPhase<0) return;
+    PhaseAgg &a=agg[winPhase];
+    if(gated) a.gated++;
+    else a.add(P1,P2,P3,score,meanNorm);
+    winPhase=-1;
+  }
+
+  static float pct(const float *s,uint16_t n,float p){
+    float t[PH_MAX_WIN];
+    for(uint16_t i=0;i<n;i++){
+      float x=s[i];
+      int j=i-1;
+      while(j>=0 && t[j]>x){ t[j+1]=t[j]; j--; }
+      t[j+1]=x;
+    }
+    float r=p/100*(n-1);
+    uint16_t lo=(uint16_t)r, hi=lo+1<n?lo+1:lo;
+    return t[lo]+(t[hi]-t[lo])*(r-lo);
+  }
+
+  // Compact JSON of one phase; fields map onto _buildPhaseSummary().
+  int summary(uint8_t i,double fs,char *out,int cap) const {
+    const PhaseAgg &a=agg[i];
+    uint16_t n=a.n, k=n<PH_MAX_WIN?n:PH_MAX_WIN;
+    if(n==0) return snprintf(out,cap,"{\"phase\":\"%s\",\"n\":0,\"gated\":%u,\"sec\":%.2f}",
+                             PH_NAMES[i],a.gated,a.samples/fs);
+    double m[3],s[3];
+    for(int b=0;b<3;b++){
+      m[b]=a.bSum[b]/n;
+      double v=a.bSq[b]/n-m[b]*m[b];
+      s[b]=v>0?sqrt(v):0;
+    }
+    double sd=sqrt(a.sM2/n);
+    float mn=a.scores[0], mx=a.scores[0];
+    double early=0,late=0;
+    uint16_t h=k/2;
+    for(uint16_t j=0;j<k;j++){
+      if(a.scores[j]<mn) mn=a.scores[j];
+      if(a.scores[j]>mx) mx=a.scores[j];
+      if(j<h) early+=a.scores[j]; else late+=a.scores[j];
+    }
+    early=h?early/h:0;
+    late=k>h?late/(k-h):0;
+    // Least-squares slope per window, then per minute of phase time.
+    double xm=(n-1)/2.0, den=n*(n*(double)n-1)/12.0;
+    double slopeWin=den>0?(a.sxy-xm*n*a.sMean)/den:0;
+    double minutes=a.samples/fs/60;
+    return snprintf(out,cap,
+      "{\"phase\":\"%s\",\"n\":%u,\"gated\":%u,\"sec\":%.2f,"
+      "\"mean\":%.3f,\"std\":%.3f,\"min\":%.2f,\"max\":%.2f,"
+      "\"p25\":%.2f,\"p50\":%.2f,\"p75\":%.2f,\"p90\":%.2f,"
+      "\"bm\":[%.4f,%.4f,%.4f],\"bs\":[%.4f,%.4f,%.4f],\"sw\":%u,"
+      "\"dist\":[%u,%u,%u,%u],\"wtv\":%.4f,\"slope\":%.4f,\"el\":%.1f,\"rms\":%.4f}",
+      PH_NAMES[i],n,a.gated,a.samples/fs,
+      a.sMean,sd,mn,mx,
+      pct(a.scores,k,25),pct(a.scores,k,50),pct(a.scores,k,75),pct(a.scores,k,90),
+      m[0],m[1],m[2],s[0],s[1],s[2],a.switches,
+      a.dist[0],a.dist[1],a.dist[2],a.dist[3],
+      n>1?a.wtv/(n-1):0,minutes>0?slopeWin*n/minutes:0,
+      early?(late-early)/early*100:0,a.normSum/n);
+  }
+};
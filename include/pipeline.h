@@ -0,0 +1,282 @@
+#pragma once
+// The per-sample tremor pipeline: spike rejection, HPF and voluntary SOS
+// branches, moving-average detrend, tremor magnitude, Goertzel bands,
+// voluntary gating and the rule classifier. Output sinks (SSE etc.) stay in
+// main.cpp; this header is plain C++ so several instances can run side by
+// side (live + shadow) and the host tools can drive the exact same code.
+//
+// Define PIPE_CYCLES() before including to time the spike stage in CPU
+// cycles (the firmware uses ESP.getCycleCount()).
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include "biquad.h"
+#include "spectrum.h"
+#include "hampel.h"
+
+#ifndef PIPE_CYCLES
+#define PIPE_CYCLES() 0u
+#endif
+
+// Spectral mode: 1 = advance the Goertzel bins as each sample arrives
+// (no window buffer, no end-of-window burst), 0 = buffer WINDOW samples
+// and run goertzel() over them at window close. Both give identical P1/P2/P3.
+#ifndef STREAM_GOERTZEL
+#define STREAM_GOERTZEL 1
+#endif
+
+const uint16_t WINDOW = 128;
+const uint8_t MA_MAX = 32;
+const uint8_t HAMPEL_LEN = 7;
+// The moving-average sums are kept in fixed point (2^-20 g per LSB) so the
+// subtract/add update is exact and cannot drift over multi-day runs; a
+// float running sum picks up rounding error on every step and never sheds
+// it (see tools/soak.cpp).
+const double MA_Q = 1048576.0;
+
+struct PipelineConfig {
+  double fs=50.0;
+  double hpfHz=3.5;
+  uint8_t maLen=20;                  // <= MA_MAX
+  bool despike=true;
+  // Voluntary-movement branch: 0.3-2 Hz energy tracked next to the >hpfHz
+  // tremor energy. A window whose low band holds more than volGateRatio of
+  // the total and exceeds volGateRms (g) is gated: no band readout and no
+  // classification.
+  bool volGate=true;
+  double volGateRatio=0.8;
+  double volGateRms=0.05;
+  double band1[3]={4,5,6};
+  double band2[3]={6,7,8};
+  double band3[3]={8,10,12};
+  // Classification thresholds (set by calibration)
+  double noiseFloor=0.01;
+  double baseForScore=0.01;
+  double scoreScale=3.0;
+};
+
+struct SampleOut {
+  uint16_t idx;                      // position in the window
+  float ax,ay,az;                    // raw after spike rejection
+  float dx,dy,dz;                    // HPF minus moving average
+  float tremor,meanNorm;
+};
+
+struct WindowOut {
+  bool gated;
+  double P1,P2,P3,meanNorm;
+  double volRms,volRatio;
+  const char *type;
+  double conf,score;
+  uint32_t rejWindow,rejTotal,spikeMaxCyc;
+};
+
+// Rule classifier on band powers (mirrors label_window_rule_based()).
+inline void classifyBands(const PipelineConfig &cfg,double P1,double P2,double P3,double meanNorm,
+                          const char *&type,double &conf,double &score){
+  double A1=P1>cfg.noiseFloor?P1:0;
+  double A2=P2>cfg.noiseFloor?P2:0;
+  double A3=P3>cfg.noiseFloor?P3:0;
+
+  double total=A1+A2+A3;
+  type="No Tremor";
+  conf=0;
+
+  bool voluntary=meanNorm>0.7 && total<5;
+
+  if(total<cfg.noiseFloor){
+    type="No Tremor";
+    conf=1.0;
+  } else if(voluntary){
+    type="Voluntary Movement";
+    conf=0.6;
+  } else {
+    if(A1>A2 && A1>A3 && A1>0.3){ type="Parkinsonian"; conf=A1/total; }
+    else if(A2>A1 && A2>A3 && A2>0.3){ type="Essential"; conf=A2/total; }
+    else if(A3>A1 && A3>A2 && A3>0.3){ type="Physiological"; conf=A3/total; }
+    else { type="Mixed/Weak"; conf=0.5; }
+  }
+
+  score=0;
+  if(total>=cfg.noiseFloor){
+    score=log10(total/cfg.baseForScore+1)*cfg.scoreScale;
+    score=score<0?0:score>10?10:score;
+  }
+}
+
+struct Pipeline {
+  PipelineConfig cfg;
+
+  Hampel<HAMPEL_LEN> spikeX,spikeY,spikeZ;
+  uint32_t winRejStart=0;
+  uint32_t spikeMaxCyc=0;
+
+  SosBank<3,1> hpf;       // tremor branch: > hpfHz
+  SosBank<3,2> volBank;   // voluntary branch: 0.3-2 Hz
+  double winVolE=0,winTremE=0;
+
+  int32_t maAx[MA_MAX], maAy[MA_MAX], maAz[MA_MAX], maNorm[MA_MAX];
+  int64_t sumAx=0,sumAy=0,sumAz=0,sumNorm=0;
+  uint8_t maIdx=0;
+  bool maFilled=false;
+
+#if STREAM_GOERTZEL
+  GoertzelBin gb1[3],gb2[3],gb3[3];
+#else
+  double windowBuf[WINDOW];
+#endif
+  uint16_t winIdx=0;
+
+  void init(const PipelineConfig &c){
+    *this=Pipeline();
+    cfg=c;
+    if(cfg.maLen<1) cfg.maLen=1;
+    if(cfg.maLen>MA_MAX) cfg.maLen=MA_MAX;
+    hpf.sec[0].initHPF(cfg.fs,cfg.hpfHz);
+    hpf.reset();
+    volBank.sec[0].initHPF(cfg.fs,0.3);
+    volBank.sec[1].initLPF(cfg.fs,2.0);
+    volBank.reset();
+    for(int i=0;i<MA_MAX;i++){ maAx[i]=maAy[i]=maAz[i]=maNorm[i]=0; }
+#if STREAM_GOERTZEL
+    for(int k=0;k<3;k++){
+      gb1[k].init(cfg.band1[k],cfg.fs);
+      gb2[k].init(cfg.band2[k],cfg.fs);
+      gb3[k].init(cfg.band3[k],cfg.fs);
+    }
+#else
+    for(int i=0;i<WINDOW;i++){ windowBuf[i]=0; }
+#endif
+  }
+
+  static int32_t ma_q(double x){ return (int32_t)lrint(x*MA_Q); }
+  float ma_get(int64_t s) const { return s/(MA_Q*cfg.maLen); }
+
+  // One raw sample in. Returns true when it closed a window (w is filled).
+  bool push(float axr,float ayr,float azr,SampleOut &o,WindowOut &w){
+    if(cfg.despike){
+      uint32_t hc0=PIPE_CYCLES();
+      axr=spikeX.process(axr);
+      ayr=spikeY.process(ayr);
+      azr=spikeZ.process(azr);
+      uint32_t hc=PIPE_CYCLES()-hc0;
+      if(hc>spikeMaxCyc) spikeMaxCyc=hc;
+    }
+
+    double hp[3]={axr,ayr,azr};
+    hpf.process(hp);
+    double hpx=hp[0], hpy=hp[1], hpz=hp[2];
+    if(cfg.volGate){
+      double lp[3]={axr,ayr,azr};
+      volBank.process(lp);
+      winVolE+=lp[0]*lp[0]+lp[1]*lp[1]+lp[2]*lp[2];
+      winTremE+=hpx*hpx+hpy*hpy+hpz*hpz;
+    }
+
+    sumAx-=maAx[maIdx]; maAx[maIdx]=ma_q(hpx); sumAx+=maAx[maIdx];
+    sumAy-=maAy[maIdx]; maAy[maIdx]=ma_q(hpy); sumAy+=maAy[maIdx];
+    sumAz-=maAz[maIdx]; maAz[maIdx]=ma_q(hpz); sumAz+=maAz[maIdx];
+
+    maIdx++; if(maIdx>=cfg.maLen){ maIdx=0; maFilled=true; }
+
+    float meanAx=ma_get(sumAx);
+    float meanAy=ma_get(sumAy);
+    float meanAz=ma_get(sumAz);
+
+    float dx=hpx-meanAx;
+    float dy=hpy-meanAy;
+    float dz=hpz-meanAz;
+
+    float norm=sqrt(dx*dx+dy*dy+dz*dz);
+
+    uint8_t pos=(maIdx==0?cfg.maLen-1:maIdx-1);
+    sumNorm-=maNorm[pos]; maNorm[pos]=ma_q(norm); sumNorm+=maNorm[pos];
+    float meanNorm=maFilled?ma_get(sumNorm):sumNorm/(MA_Q*(winIdx+1));
+
+    float tremor=norm-meanNorm;
+
+    o.idx=winIdx;
+    o.ax=axr; o.ay=ayr; o.az=azr;
+    o.dx=dx; o.dy=dy; o.dz=dz;
+    o.tremor=tremor; o.meanNorm=meanNorm;
+
+#if STREAM_GOERTZEL
+    for(int k=0;k<3;k++){ gb1[k].push(tremor); gb2[k].push(tremor); gb3[k].push(tremor); }
+#else
+    windowBuf[winIdx]=tremor;
+#endif
+    winIdx++;
+    if(winIdx<WINDOW) return false;
+
+    closeWindow(meanNorm,w);
+    winIdx=0;
+    return true;
+  }
+
+  void closeWindow(double meanNorm,WindowOut &w){
+    w.meanNorm=meanNorm;
+    w.volRms=sqrt(winVolE/WINDOW);
+    w.volRatio=winVolE/(winVolE+winTremE+1e-12);
+    w.gated=cfg.volGate && w.volRatio>cfg.volGateRatio && w.volRms>cfg.volGateRms;
+    w.P1=w.P2=w.P3=0;
+    w.type="Voluntary Movement";
+    w.conf=0.6;
+    w.score=0;
+
+#if STREAM_GOERTZEL
+    // Read the band powers and restart the recurrences (discarded if gated).
+    for(int k=0;k<3;k++){
+      if(!w.gated){ w.P1+=gb1[k].power(); w.P2+=gb2[k].power(); w.P3+=gb3[k].power(); }
+      gb1[k].reset(); gb2[k].reset(); gb3[k].reset();
+    }
+#else
+    if(!w.gated){
+      for(double f:cfg.band1) w.P1+=goertzel(windowBuf,WINDOW,f,cfg.fs);
+      for(double f:cfg.band2) w.P2+=goertzel(windowBuf,WINDOW,f,cfg.fs);
+      for(double f:cfg.band3) w.P3+=goertzel(windowBuf,WINDOW,f,cfg.fs);
+    }
+#endif
+    if(!w.gated){
+      w.P1/=3; w.P2/=3; w.P3/=3;
+      classifyBands(cfg,w.P1,w.P2,w.P3,meanNorm,w.type,w.conf,w.score);
+    }
+
+    w.rejTotal=spikeX.rejected+spikeY.rejected+spikeZ.rejected;
+    w.rejWindow=w.rejTotal-winRejStart;
+    w.spikeMaxCyc=spikeMaxCyc;
+    winRejStart=w.rejTotal;
+    spikeMaxCyc=0;
+    winVolE=winTremE=0;
+  }
+};
+
+// ----------------------- Shadow agreement -----------------------
+// Live vs candidate, window by window. The candidate starts from cleared
+// filters, Hampel and MA history while the live pipeline is warm, so its
+// first windows differ for that reason alone: they are skipped (window()
+// returns false) and stay out of the counters. With the live configuration
+// and a small tremor the first window reads "Gated" (the filters' start-up
+// transient) and the second already matches live exactly; the second is
+// margin for a low hpf (tools/test_shadow.cpp).
+const uint8_t SHADOW_WARMUP = 2;      // windows
+
+struct ShadowStats {
+  uint32_t windows=0,agree=0;
+  uint8_t warm=0;
+
+  void start(){ windows=agree=0; warm=SHADOW_WARMUP; }
+
+  static bool agrees(const WindowOut &live,const WindowOut &cand){
+    return live.gated==cand.gated && (live.gated || !strcmp(live.type,cand.type));
+  }
+
+  // Both pipelines closed a window; true if it counts (send the diff).
+  bool window(const WindowOut &live,const WindowOut &cand){
+    if(warm){ warm--; return false; }
+    windows++;
+    if(agrees(live,cand)) agree++;
+    return true;
+  }
+
+  double rate() const { return windows?(double)agree/windows:1.0; }
+};
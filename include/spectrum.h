@@ -0,0 +1,205 @@
+#pragma once
+// Spectral engines shared by the firmware and the host tools in tools/.
+// Plain C++ only (no Arduino headers) so the same code can be benchmarked
+// and checked on a PC.
+#include <math.h>
+#include <stdint.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// ----------------------- Goertzel -----------------------
+inline double goertzel(const double *data,uint16_t N,double f,double fs){
+  double w=2*M_PI*f/fs;
+  double c=2*cos(w);
+  double s0=0,s1=0,s2=0;
+  for(int i=0;i<N;i++){
+    s0=data[i] + c*s1 - s2;
+    s2=s1;
+    s1=s0;
+  }
+  return s1*s1 + s2*s2 - c*s1*s2;
+}
+
+// Streaming form of goertzel(): same recurrence, one step per sample.
+struct GoertzelBin {
+  double c=0,s1=0,s2=0;
+  void init(double f,double fs){
+    double w=2*M_PI*f/fs;
+    c=2*cos(w);
+    s1=s2=0;
+  }
+  void push(double x){
+    double s0=x + c*s1 - s2;
+    s2=s1;
+    s1=s0;
+  }
+  double power() const { return s1*s1 + s2*s2 - c*s1*s2; }
+  void reset(){ s1=s2=0; }
+};
+
+// ----------------------- Chirp-Z zoom spectrum -----------------------
+// Evaluates |X(f)|^2 at M frequencies f0, f0+df, ... for an N-sample block
+// (Bluestein: pre-chirp, one L-point convolution via FFT, post-chirp).
+// Power is on the same scale as goertzel(), so bins can be compared or
+// summed into bands directly. Single precision: the ESP32 FPU has no
+// hardware double. Chirp tables are built in double once in init().
+template<uint16_t N,uint16_t M>
+struct Czt {
+  static const uint16_t L = (N+M-1)<=64?64:(N+M-1)<=128?128:(N+M-1)<=256?256:
+                            (N+M-1)<=512?512:1024;
+  float pre[2*N];     // A^-n W^(n^2/2)
+  float post[2*M];    // W^(k^2/2)
+  float V[2*L];       // FFT of the W^(-m^2/2) filter
+  float tw[L];        // cos/sin twiddles, L/2 pairs
+  float buf[2*L];
+  double f0=0,df=0;
+
+  void init(double fStart,double fStep,double fs){
+    f0=fStart; df=fStep;
+    for(uint16_t i=0;i<L/2;i++){
+      double a=-2*M_PI*i/L;
+      tw[2*i]=cos(a); tw[2*i+1]=sin(a);
+    }
+    for(uint16_t n=0;n<N;n++){
+      double ph=-M_PI*fStep*(double)n*n/fs - 2*M_PI*fStart*n/fs;
+      pre[2*n]=cos(ph); pre[2*n+1]=sin(ph);
+    }
+    for(uint16_t k=0;k<M;k++){
+      double ph=-M_PI*fStep*(double)k*k/fs;
+      post[2*k]=cos(ph); post[2*k+1]=sin(ph);
+    }
+    for(uint16_t i=0;i<2*L;i++) V[i]=0;
+    for(uint16_t m=0;m<M;m++){
+      double ph=M_PI*fStep*(double)m*m/fs;
+      V[2*m]=cos(ph); V[2*m+1]=sin(ph);
+    }
+    for(uint16_t m=1;m<N;m++){
+      double ph=M_PI*fStep*(double)m*m/fs;
+      V[2*(L-m)]=cos(ph); V[2*(L-m)+1]=sin(ph);
+    }
+    fft(V,false);
+  }
+
+  double freq(uint16_t k) const { return f0+df*k; }
+
+  // x: N real samples; out: M powers.
+  template<typename T>
+  void compute(const T *x,float *out){
+    for(uint16_t n=0;n<N;n++) feed(n,x[n],0);
+    run(out);
+  }
+
+  // Streaming form: feed() sample n (complex) of the block as it arrives,
+  // run() once all N are in. buf holds the block, so no copy is kept.
+  void feed(uint16_t n,float re,float im){
+    buf[2*n]=re*pre[2*n]-im*pre[2*n+1];
+    buf[2*n+1]=re*pre[2*n+1]+im*pre[2*n];
+  }
+
+  // out: M powers, times gain.
+  void run(float *out,float gain=1.0f){
+    for(uint16_t i=2*N;i<2*L;i++) buf[i]=0;
+    fft(buf,false);
+    for(uint16_t i=0;i<L;i++){
+      float re=buf[2*i]*V[2*i]-buf[2*i+1]*V[2*i+1];
+      float im=buf[2*i]*V[2*i+1]+buf[2*i+1]*V[2*i];
+      buf[2*i]=re; buf[2*i+1]=im;
+    }
+    fft(buf,true);
+    const float s=1.0f/L;
+    for(uint16_t k=0;k<M;k++){
+      float re=(buf[2*k]*post[2*k]-buf[2*k+1]*post[2*k+1])*s;
+      float im=(buf[2*k]*post[2*k+1]+buf[2*k+1]*post[2*k])*s;
+      out[k]=(re*re+im*im)*gain;
+    }
+  }
+
+  // In-place iterative radix-2 FFT on interleaved re/im (unscaled).
+  void fft(float *d,bool inverse){
+    for(uint16_t i=1,j=0;i<L;i++){
+      uint16_t bit=L>>1;
+      for(;j&bit;bit>>=1) j^=bit;
+      j^=bit;
+      if(i<j){
+        float t=d[2*i]; d[2*i]=d[2*j]; d[2*j]=t;
+        t=d[2*i+1]; d[2*i+1]=d[2*j+1]; d[2*j+1]=t;
+      }
+    }
+    for(uint16_t len=2;len<=L;len<<=1){
+      uint16_t step=L/len;
+      for(uint16_t i=0;i<L;i+=len){
+        for(uint16_t j=0;j<len/2;j++){
+          float wr=tw[2*j*step], wi=inverse?-tw[2*j*step+1]:tw[2*j*step+1];
+          float *a=d+2*(i+j), *b=d+2*(i+j+len/2);
+          float tr=b[0]*wr-b[1]*wi, ti=b[0]*wi+b[1]*wr;
+          b[0]=a[0]-tr; b[1]=a[1]-ti;
+          a[0]+=tr; a[1]+=ti;
+        }
+      }
+    }
+  }
+};
+
+// ----------------------- Decimated zoom -----------------------
+// Czt for a real N-sample block when the band sits inside fs/4 +- 0.19 fs
+// (3-22 Hz at 50 Hz). Each sample is shifted down by fs/4 as it arrives
+// (times 1,-j,-1,j: no multiplies), half-band filtered and kept every 2nd,
+// so the transform runs on N/2 complex samples at fs/2: Czt<N/2,M> instead
+// of Czt<N,M>, which halves L once N/2+M-1 fits the smaller FFT.
+// The half-band filter is TAPS long (Kaiser-windowed sinc, beta 4): within
+// 0.5% in amplitude over the band, images at least 45 dB down. The block it
+// transforms is therefore the window delayed by DELAY samples. Powers are
+// on goertzel()'s scale, as Czt's are.
+template<uint16_t N,uint16_t M>
+struct ZoomSpectrum {
+  static const uint8_t TAPS = 23, DELAY = TAPS/2;
+  Czt<N/2,M> czt;
+  float h[DELAY/2+1];   // off-centre taps, outermost first, pairs summed by symmetry
+  float center=0.5f;
+  float v[32];          // shifted samples, real or imaginary by parity
+  uint8_t pos=0;
+  double f0=0,df=0;
+
+  void init(double fStart,double fStep,double fs){
+    f0=fStart; df=fStep;
+    czt.init(fStart-fs/4,fStep,fs/2);
+    double sum=0.5,hd[DELAY/2+1];
+    for(uint8_t i=0;2*i<DELAY;i++){
+      double k=DELAY-2*i;                  // odd distance from the centre
+      double r=k/DELAY;
+      hd[i]=sin(M_PI*k/2)/(M_PI*k)*bessel0(4*sqrt(1-r*r))/bessel0(4);
+      sum+=2*hd[i];
+    }
+    for(uint8_t i=0;2*i<DELAY;i++) h[i]=hd[i]/sum;
+    center=0.5/sum;
+    for(uint8_t i=0;i<32;i++) v[i]=0;
+    pos=0;
+  }
+
+  double freq(uint16_t k) const { return f0+df*k; }
+
+  // Every sample, with its position in the window (0..N-1).
+  void push(uint16_t idx,float x){
+    pos=(pos+1)&31;
+    v[pos]=(pos&3)==1||(pos&3)==2?-x:x;   // x times (-j)^pos, sign part
+    if(idx&1) return;
+    float same=0;                           // off-centre taps: same parity as pos
+    for(uint8_t i=0;2*i<DELAY;i++)
+      same+=h[i]*(v[(pos-2*i)&31]+v[(pos-(TAPS-1-2*i))&31]);
+    float other=center*v[(pos-DELAY)&31];
+    if(pos&1) czt.feed(idx/2,other,same);
+    else czt.feed(idx/2,same,other);
+  }
+
+  // out: M powers of the block just completed. Twice the samples at half
+  // the rate: |X|^2 scales by 4.
+  void run(float *out){ czt.run(out,4.0f); }
+
+  static double bessel0(double x){
+    double s=1,t=1;
+    for(int k=1;k<20;k++){ t*=(x/(2*k))*(x/(2*k)); s+=t; }
+    return s;
+  }
+};
@@ -0,0 +1,56 @@
+#pragma once
+// Synthetic IMU source: a tremor sinusoid on top of gravity, with slow
+// amplitude modulation, optional voluntary sway and white noise. It stands
+// in for the MPU6050 read so the whole pipeline and network stack can run
+// with no sensor attached (demos, load and throughput tests). Output is in
+// the same units as MPU6050_light: g and deg/s.
+//
+// Phases are kept in [0,1) turns and wrapped every step, so long runs do
+// not lose precision.
+#include <math.h>
+#include <stdint.h>
+
+struct SynthImu {
+  float freq=6.0f;         // tremor Hz
+  float amp=0.05f;         // tremor amplitude, g
+  float noise=0.005f;      // white noise sd, g
+  float modDepth=0.3f;     // amplitude modulation depth (0..1)
+  float modHz=0.2f;
+  float swayAmp=0.0f;      // voluntary 0.5 Hz sway, g (exercises the gate)
+  float dir[3]={0.6f,0.7f,0.39f};   // tremor direction (unit-ish)
+
+  float ph=0,modPh=0,swayPh=0;
+  uint32_t rng=0x9E3779B9;
+
+  float uniform(){
+    rng^=rng<<13; rng^=rng>>17; rng^=rng<<5;
+    return (rng>>8)*(1.0f/16777216.0f);
+  }
+  // Irwin-Hall approximation of a unit normal: cheap, no log/sqrt.
+  float gauss(){
+    float s=0;
+    for(int i=0;i<6;i++) s+=uniform();
+    return (s-3.0f)*1.41421356f;
+  }
+
+  static void wrap(float &p,float step){ p+=step; if(p>=1.0f) p-=1.0f; }
+
+  void next(float fs,float *acc,float *gyro){
+    const float tw=6.2831853f;
+    float a=amp*(1.0f+modDepth*sinf(tw*modPh));
+    float s=a*sinf(tw*ph);
+    float sway=swayAmp*sinf(tw*swayPh);
+    acc[0]=dir[0]*s+sway+noise*gauss();
+    acc[1]=dir[1]*s+noise*gauss();
+    acc[2]=1.0f+dir[2]*s+noise*gauss();
+    // Rotational tremor: angular rate of a small wrist rotation in phase
+    // quadrature with the linear component, ~100 deg/s per g.
+    float w=100.0f*a*cosf(tw*ph);
+    gyro[0]=w*dir[1]+noise*50*gauss();
+    gyro[1]=-w*dir[0]+noise*50*gauss();
+    gyro[2]=noise*50*gauss();
+    wrap(ph,freq/fs);
+    wrap(modPh,modHz/fs);
+    wrap(swayPh,0.5f/fs);
+  }
+};
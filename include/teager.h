@@ -0,0 +1,43 @@
+#pragma once
+// Teager-Kaiser energy operator with DESA-2 demodulation.
+//   psi[x](n) = x(n)^2 - x(n-1)x(n+1)
+//   y(n) = x(n+1) - x(n-1)
+//   Omega = 0.5*acos(1 - psi[y]/(2 psi[x])),  |a| = 2 psi[x] / sqrt(psi[y])
+// Meant for a narrow-band (band-passed) input. Both energies are smoothed
+// with a one-pole average before demodulation, which keeps the estimates
+// stable without a window. Output lags the input by two samples.
+#include <math.h>
+#include <stdint.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+struct Desa {
+  float x[5]={0,0,0,0,0};   // x[0] newest
+  float psiX=0,psiY=0;
+  float alpha=0.1f;         // smoothing of the energies
+
+  void push(float s){
+    x[4]=x[3]; x[3]=x[2]; x[2]=x[1]; x[1]=x[0]; x[0]=s;
+    // centred on x[2]; y(n+1), y(n), y(n-1) from x[0..4]
+    float px=x[2]*x[2] - x[1]*x[3];
+    float yp=x[0]-x[2], y0=x[1]-x[3], ym=x[2]-x[4];
+    float py=y0*y0 - yp*ym;
+    psiX+=alpha*(px-psiX);
+    psiY+=alpha*(py-psiY);
+  }
+
+  float amplitude() const {
+    if(psiX<=0 || psiY<=0) return 0;
+    return 2*psiX/sqrtf(psiY);
+  }
+
+  float freq(double fs) const {
+    if(psiX<=0 || psiY<=0) return 0;
+    float c=1 - psiY/(2*psiX);
+    if(c<-1) c=-1;
+    if(c>1) c=1;
+    return 0.5f*acosf(c)*fs/(2*M_PI);
+  }
+};
@@ -0,0 +1,66 @@
+#pragma once
+// Weighted-frequency Fourier linear combiner (Riviere et al.): adapts a
+// harmonic model sum_r w_r sin(r*phi) + v_r cos(r*phi) to the input and
+// moves the model frequency down the error gradient, one update per sample.
+// O(M) per sample, no window buffer. Plain C++ for host reuse.
+#include <math.h>
+#include <stdint.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+template<uint8_t M>
+struct Wflc {
+  float w[M],v[M];
+  float omega=0;          // rad/sample
+  float phase=0;
+  float mu=0.05f;         // amplitude weight step
+  float mu0=0.003f;       // frequency step
+  float pow=1e-4f;        // running input power, normalises the frequency step
+  float wMin=0,wMax=0;
+
+  void init(double f0,double fMin,double fMax,double fs){
+    for(uint8_t r=0;r<M;r++){ w[r]=v[r]=0; }
+    omega=2*M_PI*f0/fs;
+    wMin=2*M_PI*fMin/fs;
+    wMax=2*M_PI*fMax/fs;
+    phase=0;
+    pow=1e-4f;
+  }
+
+  void push(float s){
+    pow+=0.01f*(s*s-pow);
+    float norm=1.0f/(pow+1e-6f);
+
+    float s1=sinf(phase), c1=cosf(phase);
+    float sr=s1, cr=c1;
+    float sn[M],cs[M];
+    float y=0;
+    for(uint8_t r=0;r<M;r++){
+      sn[r]=sr; cs[r]=cr;
+      y+=w[r]*sr + v[r]*cr;
+      float t=sr*c1 + cr*s1;       // sin((r+2)phi), cos((r+2)phi)
+      cr=cr*c1 - sr*s1;
+      sr=t;
+    }
+    float e=s-y;
+
+    float g=0;
+    for(uint8_t r=0;r<M;r++) g+=(r+1)*(w[r]*cs[r] - v[r]*sn[r]);
+    omega+=2*mu0*e*g*norm;
+    if(omega<wMin) omega=wMin;
+    if(omega>wMax) omega=wMax;
+
+    for(uint8_t r=0;r<M;r++){
+      w[r]+=2*mu*e*sn[r];
+      v[r]+=2*mu*e*cs[r];
+    }
+
+    phase+=omega;
+    if(phase>2*(float)M_PI) phase-=2*(float)M_PI;
+  }
+
+  float freq(double fs) const { return omega*fs/(2*M_PI); }
+  float amplitude() const { return sqrtf(w[0]*w[0]+v[0]*v[0]); }
+};
@@ -0,0 +1,95 @@
+#pragma once
+// Window log for store-and-forward: one fixed-size LogRecord per closed
+// window, numbered by a sequence that only ever grows, kept in flash so a
+// gateway can fetch whatever it missed while the device was offline.
+//
+// Records live in `segs` segment files of `segRecs` records each. Record
+// seq is in segment (seq/segRecs)%segs at byte (seq%segRecs)*sizeof(rec),
+// so any seq is found without an index. Starting a new segment truncates
+// the one it reuses, which drops the oldest segRecs records: the device
+// holds [lo,hi) with hi-lo <= segs*segRecs. `epoch` is drawn at random
+// when the log is formatted, so a reader can tell a wiped device's new
+// numbering from a continuation.
+//
+// Record image (little-endian, 32 bytes) is also decoded by
+// ai_dashboard/backend/gateway/backfill.py.
+#include <stdint.h>
+#include <string.h>
+
+const uint16_t LOG_FORMAT = 1;
+
+enum LogType : uint8_t { LT_NONE=0, LT_PARK=1, LT_ESS=2, LT_PHYS=3, LT_MIXED=4, LT_VOLUNTARY=5 };
+const uint8_t LOG_GATED = 1;
+
+struct LogRecord {
+  uint32_t seq;
+  uint32_t ms;                 // millis() at window close
+  float p1,p2,p3;              // band powers
+  float score,conf;
+  uint8_t type;                // LogType
+  uint8_t flags;               // LOG_GATED
+  uint16_t meanMg;             // mean |a| in milli-g
+};
+
+inline uint8_t logType(const char *t){
+  if(!strcmp(t,"Parkinsonian")) return LT_PARK;
+  if(!strcmp(t,"Essential")) return LT_ESS;
+  if(!strcmp(t,"Physiological")) return LT_PHYS;
+  if(!strcmp(t,"Mixed/Weak")) return LT_MIXED;
+  if(!strcmp(t,"Voluntary Movement")) return LT_VOLUNTARY;
+  return LT_NONE;
+}
+
+struct WinLog {
+  uint16_t segRecs=1024, segs=8;
+  uint32_t epoch=0;
+  uint32_t lo=0,hi=0;          // records [lo,hi) are on flash
+
+  void init(uint16_t recs,uint16_t n){ segRecs=recs; segs=n; lo=hi=0; }
+
+  uint16_t segOf(uint32_t seq) const { return (seq/segRecs)%segs; }
+  uint32_t offsetOf(uint32_t seq) const { return (seq%segRecs)*sizeof(LogRecord); }
+
+  // Records of [seq, seq+n) that can be read in one go: clipped to what is
+  // held and to the end of seq's segment. 0 if seq is not held.
+  uint32_t span(uint32_t seq,uint32_t n) const {
+    if(seq<lo || seq>=hi) return 0;
+    uint32_t segEnd=(seq/segRecs+1)*segRecs;
+    uint32_t end=seq+n;
+    if(end>hi) end=hi;
+    if(end>segEnd) end=segEnd;
+    return end-seq;
+  }
+
+  // Call before writing record hi. True when it starts a segment, i.e. the
+  // file must be truncated; lo moves past the records that drops.
+  bool beginAppend(){
+    if(hi%segRecs) return false;
+    uint32_t s=hi/segRecs;
+    if(s>=segs){
+      uint32_t drop=(s-segs+1)*segRecs;
+      if(lo<drop) lo=drop;
+    }
+    return true;
+  }
+  void appended(){ hi++; }
+
+  // Rebuilds [lo,hi) at boot from each segment file's first seq and whole
+  // record count (count 0 = missing or empty). A torn last record is not
+  // counted and gets overwritten by the next append.
+  void recover(const uint32_t *first,const uint32_t *count){
+    bool any=false;
+    for(uint16_t s=0;s<segs;s++){
+      if(!count[s]) continue;
+      uint32_t end=first[s]+count[s];
+      if(!any || end>hi) hi=end;
+      if(!any || first[s]<lo) lo=first[s];
+      any=true;
+    }
+    if(!any){ lo=hi=0; return; }
+    // segments older than a full ring behind hi are stale leftovers
+    uint32_t keep=(uint32_t)segs*segRecs;
+    uint32_t floor=hi>keep?((hi-1)/segRecs+1)*segRecs-keep:0;
+    if(lo<floor) lo=floor;
+  }
+};
@@ -3,9 +3,26 @@
 #include <WiFi.h>
 #include <ESPAsyncWebServer.h>
 #include <SPIFFS.h>
+#include <Preferences.h>
+#include <esp_partition.h>
 #include <MPU6050_light.h>
 #include <math.h>
 
+#define PIPE_CYCLES() ESP.getCycleCount()
+#include "pipeline.h"
+#include "wflc.h"
+#include "teager.h"
+#include "cnn_model.h"
+#include "modelblob.h"
+#include "personal.h"
+#include "blackbox.h"
+#include "calib.h"
+#include "phases.h"
+#include "synth.h"
+#include "winlog.h"
+#include "bus.h"
+#include "events.h"
+
 // ----------------------- CONFIG -----------------------
 // Access-Point fallback (used when STA connection fails)
 const char *AP_SSID = "TremorDevice";
@@ -24,12 +41,116 @@ AsyncEventSource events("/events");
 
 MPU6050 mpu(Wire);
 
-// Sampling
+// Sampling (WINDOW, filters, gating and thresholds: PipelineConfig in
+// include/pipeline.h)
 const double SAMPLE_RATE = 50.0;
-const uint16_t WINDOW = 128;
 
-// Filters
-const uint8_t MA_LEN = 20;
+// Zoom spectrum: 0.2 Hz-spaced Chirp-Z power over 3-15 Hz (ZoomSpectrum:
+// decimated as samples arrive, transform after window close outside the
+// sample gate), sent as the "zoom" event (peak, per-band power, cycles
+// spent on the transform). Covers the window delayed by the half-band
+// filter, ZoomSpectrum::DELAY samples.
+#ifndef ZOOM_SPECTRUM
+#define ZOOM_SPECTRUM 1
+#endif
+const double ZOOM_F0 = 3.0;
+const double ZOOM_DF = 0.2;
+const uint16_t ZOOM_BINS = 61;    // 3.0 .. 15.0 Hz
+
+// Adaptive tremor tracker (WFLC), updated every sample; "track" event
+// every TRACK_DECIM samples.
+const uint8_t TRACK_DECIM = 10;   // 5 Hz
+
+// Per-band Teager-Kaiser envelopes (band-pass + DESA-2); "env" event every
+// ENV_DECIM samples.
+const uint8_t ENV_DECIM = 10;     // 5 Hz
+
+// Optional int8 1D-CNN on the raw 3-axis window (include/cnn.h, weights
+// from tools/cnn_export.py); result goes out as the "cnn" event.
+#ifndef CNN_CLASSIFIER
+#define CNN_CLASSIFIER 0
+#endif
+const uint16_t CNN_ARENA = 4096;
+
+// Hot-swappable models: two A/B slots in the "models" data partition
+// (partitions.csv). Uploads go to the inactive slot and are validated and
+// switched in between windows; rollback returns to whatever ran before.
+const uint32_t MODEL_SLOT_SIZE = 0x10000;
+const uint32_t MODEL_SECTOR = 0x1000;    // erased as upload chunks reach it
+
+// Per-patient personalisation: labelled windows update class statistics
+// (include/personal.h) kept in NVS; the blend weight of the personal
+// posterior grows as n/(n+PERSONAL_N0), capped at PERSONAL_MAX_W.
+const double PERSONAL_N0 = 40;
+const double PERSONAL_MAX_W = 0.7;
+const uint8_t PERSONAL_SAVE_EVERY = 10;   // labelled windows between NVS writes
+
+// Black box: the last BB_FRAMES raw accel+gyro frames stay in RAM
+// (include/blackbox.h). A double button press, /blackbox/trigger or the
+// start of a tremor episode (rule score >= BB_EPISODE_SCORE) keeps recording
+// BB_POST more frames, then writes the lot to SPIFFS as /bb<n>.bin
+// (BB_FILES names, reused round-robin) and announces it on "blackbox".
+#ifndef BLACKBOX
+#define BLACKBOX 1
+#endif
+const uint16_t BB_FRAMES = 600;          // 12 s at 50 Hz, 7.2 KB
+const uint16_t BB_POST = 200;            // 4 s after the trigger
+const double BB_EPISODE_SCORE = 4.0;
+const uint8_t BB_FILES = 8;
+const uint8_t BB_DRAIN = 50;             // RAM staging between the ring and SPIFFS, frames
+const uint8_t BB_FLUSH = 20;             // frames written to SPIFFS per loop() pass
+const unsigned long DOUBLE_PRESS_MS = 400;
+
+// Window log (include/winlog.h): every closed window goes to flash with a
+// sequence number so a gateway can backfill what it missed while the device
+// was offline (/log/marks, /log/range). LOG_SEGS files of LOG_SEG_RECS
+// 32-byte records: 256 KB, about 5.8 h of windows. Windows are queued in
+// RAM and written LOG_BATCH at a time from loop(), so a reset loses the
+// last few (/log/marks "queued").
+#ifndef WINDOW_LOG
+#define WINDOW_LOG 1
+#endif
+const uint16_t LOG_SEG_RECS = 1024;
+const uint8_t LOG_SEGS = 8;
+const uint16_t LOG_RANGE_MAX = 256;      // records per /log/range reply (8 KB)
+const uint8_t LOG_QUEUE = 16;            // closed windows waiting for SPIFFS, 41 s
+const uint8_t LOG_BATCH = 4;             // written together, one open per batch
+
+// Synthetic IMU (include/synth.h) in place of the MPU6050 read; same DSP
+// path. 1 = boot in synthetic mode. The device also falls back to it when
+// the sensor does not answer, and /synth switches it at runtime.
+#ifndef SYNTH_IMU
+#define SYNTH_IMU 0
+#endif
+
+// Output bus (include/bus.h): events are formatted once into a BUS_BYTES
+// ring and each sink drains it from loop() between samples, at most
+// BUS_BUDGET messages per pass. /events (SSE) is always a sink; the others
+// are build options. A sink with no listener or target drops its topics, and
+// a topic no sink takes is not formatted at all. GET /bus reports per-sink
+// counters; /bus?sink=<name>&topics=a,b|all&policy=oldest|newest changes one.
+const uint16_t BUS_BYTES = 8192;
+const uint8_t BUS_BUDGET = 8;
+const uint8_t SSE_QUEUE = 16;            // pause while clients average this many queued
+#ifndef BUS_UART
+#define BUS_UART 0                       // "<event> <data>" lines on Serial
+#endif
+const uint16_t UART_TX_BUF = 2048;
+#ifndef BUS_UDP
+#define BUS_UDP 0                        // SSE frames in datagrams, target from /bus/udp?host=&port=
+#endif
+const uint16_t UDP_MTU = 1400;
+#ifndef BUS_WS
+#define BUS_WS 0                         // SSE frames as WebSocket text messages on /ws
+#endif
+#ifndef BUS_PUSH
+#define BUS_PUSH 1                       // SSE frames over TCP to a gateway, target from /bus/push?host=&port=
+#endif
+#ifndef PUSH_HOST
+#define PUSH_HOST ""                     // gateway to push to from boot, "" for none until /bus/push
+#endif
+const uint16_t PUSH_PORT = 8200;         // gateway/server.py default
+const uint16_t PUSH_RETRY_MS = 5000;
 
 // Button & LED
 const int BUTTON_PIN = 16;
@@ -42,167 +163,960 @@ bool lastState = HIGH;
 bool stableState = HIGH;
 const unsigned long DEBOUNCE_MS = 50;
 const unsigned long LONG_PRESS_MS = 2000;
+unsigned long lastShortPress = 0;
 
 // States
 bool streaming = false;
 bool calibrationMode = false;
 bool staConnected = false;  // true when connected to a router (STA mode)
-unsigned long calibStart = 0;
-double calibSum = 0.0;
-unsigned long calibCount = 0;
-const unsigned long CALIB_DURATION = 5000;
+// Calibration stops as soon as the baseline has settled (include/calib.h),
+// between 1.6 s and the old fixed 5 s.
+Calibrator calib;
+// /startCalib runs on the async_tcp task; loop() owns calib and
+// calibrationMode and applies the request before the next sample.
+volatile bool calibStartReq=false;
 
 // LED blink
 unsigned long lastBlink = 0;
 bool ledState = false;
 const unsigned long BLINK_MS = 300;
 
+SynthImu synth;
+bool synthMode=SYNTH_IMU;
+
 // ----------------------- DSP Buffers -----------------------
-double windowBuf[WINDOW];
-uint16_t winIdx = 0;
-
-float maAx[MA_LEN], maAy[MA_LEN], maAz[MA_LEN], maNorm[MA_LEN];
-float sumAx=0,sumAy=0,sumAz=0,sumNorm=0;
-uint8_t maIdx=0;
-bool maFilled=false;
-
-float ma_get(float s){ return s / MA_LEN; }
-
-// High-pass filter
-struct Biquad {
-  double a1,a2,b0,b1,b2;
-  double x1=0,x2=0,y1=0,y2=0;
-  void initHPF(double fs,double fc,double Q=0.707){
-    double w0=2*M_PI*fc/fs;
-    double c=cos(w0), s=sin(w0);
-    double alpha=s/(2*Q);
-
-    double b0n=(1+c)/2;
-    double b1n=-(1+c);
-    double b2n=(1+c)/2;
-    double a0n=1+alpha;
-    double a1n=-2*c;
-    double a2n=1-alpha;
-
-    b0=b0n/a0n; b1=b1n/a0n; b2=b2n/a0n;
-    a1=a1n/a0n; a2=a2n/a0n;
-  }
-  double process(double x){
-    double y=b0*x + b1*x1 + b2*x2 - a1*y1 - a2*y2;
-    x2=x1; x1=x; y2=y1; y1=y;
-    return y;
-  }
-};
-
-Biquad hpfX,hpfY,hpfZ;
-
-// ----------------------- Goertzel Bands -----------------------
-double goertzel(const double *data,uint16_t N,double f,double fs){
-  double w=2*M_PI*f/fs;
-  double c=2*cos(w);
-  double s0=0,s1=0,s2=0;
-  for(int i=0;i<N;i++){
-    s0=data[i] + c*s1 - s2;
-    s2=s1;
-    s1=s0;
-  }
-  return s1*s1 + s2*s2 - c*s1*s2;
-}
-
-const double band1[]={4,5,6};
-const double band2[]={6,7,8};
-const double band3[]={8,10,12};
-
-double NOISE_FLOOR=0.01;
-double BASE_FOR_SCORE=0.01;
-double SCORE_SCALE=3.0;
-double MAX_POWER=25.0;
-
-// ----------------------- SSE helpers -----------------------
+// The live pipeline drives every output; see include/pipeline.h.
+Pipeline live;
+
+// Shadow mode: a candidate configuration runs on the same raw samples and
+// only ever produces the "shadow" diff event. Started/stopped from HTTP,
+// applied at a window boundary so both pipelines see identical windows.
+Pipeline shadow;
+bool shadowOn=false;
+PipelineConfig shadowPending;
+volatile bool shadowStartReq=false, shadowStopReq=false;
+double shadowNfScale=1.0;            // candidate noise floor = live * scale
+uint32_t cycLive=0,cycShadow=0;      // cycles spent in push() this window
+ShadowStats shadowStats;             // agreement, warm-up windows skipped
+
+// Guided test suite (include/phases.h), started at a window boundary.
+PhaseRunner tests;
+uint32_t testsPending[PH_MAX];
+volatile bool testsStartReq=false, testsSkipReq=false, testsAbortReq=false;
+bool testsReported=false;
+char testsJson[1400];
+
+#if BLACKBOX
+BlackBox<BB_FRAMES> blackbox;
+BlackBoxFrame bbChunk[BB_DRAIN];
+uint8_t bbStaged=0;                  // frames in bbChunk not yet written
+bool bbOpen=false;
+uint32_t bbOverruns=0;               // captures dropped because the flush fell behind
+File bbFile;
+char bbName[16];
+uint32_t bbSeq=0;
+bool bbEpisode=false;                // inside an episode (edge trigger)
+volatile bool bbHttpReq=false;
+#endif
+
+#if WINDOW_LOG
+WinLog wlog;
+LogRecord wlogQ[LOG_QUEUE];          // seq is set when written
+uint8_t wlogHead=0,wlogCount=0;
+uint32_t wlogErrors=0;               // windows dropped: queue full, open or write failed
+#endif
+
+#if ZOOM_SPECTRUM
+float zoomPow[ZOOM_BINS];
+ZoomSpectrum<WINDOW,ZOOM_BINS> zoom;
+bool zoomReady=false;             // window closed, transform pending
+#endif
+#if CNN_CLASSIFIER
+int8_t cnnIn[WINDOW*3];
+int8_t cnnArena[CNN_ARENA];
+bool cnnOk=false;
+bool cnnBuiltinOk=false;             // compiled-in model passed its self-test
+#endif
+
+// WFLC input is the signed HPF residual on the axis carrying the most
+// energy (the 3-axis norm used for the bands is rectified, which would
+// double the tracked frequency).
+Wflc<1> tracker;
+float axisPow[3]={0,0,0};
+uint8_t trackDecim=0;
+
+// Band envelopes run on the same signed signal as the tracker.
+Biquad bpf1,bpf2,bpf3;
+Desa desa1,desa2,desa3;
+uint8_t envDecim=0;
+
+// ----------------------- Output bus -----------------------
+Bus<BUS_BYTES> bus;
+int8_t sinkSse=-1;
+uint32_t busWant[BUS_SINKS];         // topics each sink takes while it has a listener
+volatile bool busReq=false;
+int8_t busReqSink;
+uint32_t busReqTopics;
+int8_t busReqPolicy;                 // -1 = unchanged
+
+// Subscribes a sink to its topics only while someone is there to read them.
+void busListen(int8_t id,bool on){
+  uint32_t t=on?busWant[id]:0;
+  if(bus.sink[id].topics!=t) bus.setTopics(id,t);
+}
+
+void sseSink(){
+  busListen(sinkSse,events.count()>0);
+  const BusMsg *m;
+  for(uint8_t n=0;n<BUS_BUDGET && (m=bus.peek(sinkSse));n++){
+    if(events.avgPacketsWaiting()>=SSE_QUEUE) break;
+    events.send(m->data(),BUS_TOPICS[m->topic]);
+    bus.done(sinkSse);
+  }
+}
+
+#if BUS_UART
+int8_t sinkUart=-1;
+void uartSink(){
+  busListen(sinkUart,true);
+  const BusMsg *m;
+  for(uint8_t n=0;n<BUS_BUDGET && (m=bus.peek(sinkUart));n++){
+    const char *name=BUS_TOPICS[m->topic];
+    size_t len=strlen(m->data());
+    if((size_t)Serial.availableForWrite()<strlen(name)+len+2) break;
+    Serial.print(name);
+    Serial.write(' ');
+    Serial.write((const uint8_t*)m->data(),len);
+    Serial.write('\n');
+    bus.done(sinkUart);
+  }
+}
+#endif
+
+#if BUS_UDP
+// One datagram per pass: as many whole frames as fit in UDP_MTU.
+int8_t sinkUdp=-1;
+WiFiUDP udp;
+IPAddress udpHost;
+uint16_t udpPort=0;
+volatile bool udpReq=false;
+IPAddress udpReqHost;
+uint16_t udpReqPort;
+char udpBuf[UDP_MTU+1];
+
+void udpSink(){
+  if(udpReq){ udpHost=udpReqHost; udpPort=udpReqPort; udpReq=false; }
+  busListen(sinkUdp,udpPort!=0);
+  size_t p=0;
+  const BusMsg *m;
+  while((m=bus.peek(sinkUdp))){
+    const char *name=BUS_TOPICS[m->topic];
+    size_t need=strlen(name)+strlen(m->data())+16;
+    if(p+need>UDP_MTU){
+      if(p) break;
+      bus.done(sinkUdp);              // larger than a datagram on its own
+      continue;
+    }
+    p+=sprintf(udpBuf+p,"event: %s\ndata: %s\n\n",name,m->data());
+    bus.done(sinkUdp);
+  }
+  if(!p || !udpPort) return;
+  udp.beginPacket(udpHost,udpPort);
+  udp.write((const uint8_t*)udpBuf,p);
+  udp.endPacket();
+}
+#endif
+
+#if BUS_WS
+AsyncWebSocket ws("/ws");
+int8_t sinkWs=-1;
+char wsBuf[1500];
+
+void wsSink(){
+  static unsigned long lastCleanup=0;
+  if(millis()-lastCleanup>1000){ lastCleanup=millis(); ws.cleanupClients(); }
+  busListen(sinkWs,ws.count()>0);
+  const BusMsg *m;
+  for(uint8_t n=0;n<BUS_BUDGET && (m=bus.peek(sinkWs));n++){
+    if(!ws.availableForWriteAll()) break;
+    int len=snprintf(wsBuf,sizeof(wsBuf),"event: %s\ndata: %s",BUS_TOPICS[m->topic],m->data());
+    ws.textAll(wsBuf,min((size_t)len,sizeof(wsBuf)-1));
+    bus.done(sinkWs);
+  }
+}
+#endif
+
+#if BUS_PUSH
+// Pushes to a ward gateway (ai_dashboard/backend/gateway): one TCP
+// connection, a "TREMOR <id>\n" hello, then the frames /events serves.
+// AsyncClient connects without blocking; its callbacks run on the async_tcp
+// task and only move pushState, everything else happens here. Reconnects
+// every PUSH_RETRY_MS while a target is set (port=0 clears it); what is
+// published while the link is down is not kept.
+enum : uint8_t { PUSH_IDLE, PUSH_CONNECTING, PUSH_OPEN, PUSH_UP };
+int8_t sinkPush=-1;
+AsyncClient pushClient;
+volatile uint8_t pushState=PUSH_IDLE;
+IPAddress pushHost;
+uint16_t pushPort=0;
+volatile bool pushReq=false;
+IPAddress pushReqHost;
+uint16_t pushReqPort;
+unsigned long pushLastTry=0;
+char pushBuf[1500];
+
+void pushInit(){
+  pushClient.onConnect([](void*,AsyncClient*){ pushState=PUSH_OPEN; });
+  pushClient.onDisconnect([](void*,AsyncClient*){ pushState=PUSH_IDLE; });
+  pushClient.onError([](void*,AsyncClient*,int8_t){ pushState=PUSH_IDLE; });
+  if(pushHost.fromString(PUSH_HOST)) pushPort=PUSH_PORT;
+}
+
+void pushSink(){
+  if(pushReq){
+    pushHost=pushReqHost; pushPort=pushReqPort; pushReq=false;
+    if(pushState!=PUSH_IDLE) pushClient.close(true);
+    pushState=PUSH_IDLE;
+    pushLastTry=millis()-PUSH_RETRY_MS;
+  }
+  if(pushState==PUSH_IDLE && pushPort && WiFi.isConnected() && millis()-pushLastTry>=PUSH_RETRY_MS){
+    pushLastTry=millis();
+    pushState=PUSH_CONNECTING;
+    if(!pushClient.connect(pushHost,pushPort)) pushState=PUSH_IDLE;
+  }
+  if(pushState==PUSH_OPEN){
+    uint8_t mac[6];
+    WiFi.macAddress(mac);
+    char id[16];
+    snprintf(id,sizeof(id),"tremor-%02x%02x%02x",mac[3],mac[4],mac[5]);
+    int n=busHello(pushBuf,sizeof(pushBuf),id);
+    pushClient.add(pushBuf,n);
+    pushClient.send();
+    pushState=PUSH_UP;
+  }
+  busListen(sinkPush,pushState==PUSH_UP);
+  if(pushState!=PUSH_UP) return;
+  const BusMsg *m;
+  bool any=false;
+  for(uint8_t n=0;n<BUS_BUDGET && (m=bus.peek(sinkPush));n++){
+    int len=busSseFrame(pushBuf,sizeof(pushBuf),m);
+    if(len<(int)sizeof(pushBuf)){
+      if(pushClient.space()<(size_t)len) break;
+      pushClient.add(pushBuf,len);
+      any=true;
+    }
+    bus.done(sinkPush);               // larger than pushBuf: dropped
+  }
+  if(any) pushClient.send();
+}
+#endif
+
+void busInit(){
+  sinkSse=bus.addSink("sse",0);
+  busWant[sinkSse]=BUS_ALL;
+#if BUS_UART
+  // A serial logger would rather keep a contiguous run and see one gap.
+  sinkUart=bus.addSink("uart",0,BUS_DROP_NEWEST);
+  busWant[sinkUart]=BUS_ALL&~(1u<<T_SAMPLE);
+#endif
+#if BUS_UDP
+  sinkUdp=bus.addSink("udp",0);
+  busWant[sinkUdp]=BUS_ALL;
+#endif
+#if BUS_WS
+  sinkWs=bus.addSink("ws",0);
+  busWant[sinkWs]=BUS_ALL;
+#endif
+#if BUS_PUSH
+  sinkPush=bus.addSink("push",0);
+  busWant[sinkPush]=BUS_ALL;
+  pushInit();
+#endif
+}
+
+// Runs on every loop() pass, sampled or not.
+void busPump(){
+  if(busReq){
+    busWant[busReqSink]=busReqTopics;
+    if(busReqPolicy>=0) bus.setPolicy(busReqSink,(BusPolicy)busReqPolicy);
+    busReq=false;
+  }
+  bus.pace();
+  sseSink();
+#if BUS_UART
+  uartSink();
+#endif
+#if BUS_UDP
+  udpSink();
+#endif
+#if BUS_WS
+  wsSink();
+#endif
+#if BUS_PUSH
+  pushSink();
+#endif
+}
+
+// ----------------------- Events -----------------------
+// Each helper formats its record straight into the output bus, and not at
+// all when no sink takes the topic. Window events (bands, gated, quality)
+// are formatted by include/events.h and stamped with winStamp: device time
+// and window number, set when the window closes.
+DevClock devClock;
+WindowStamp winStamp;
+uint32_t winSeq=0;
+
 void sendSample(float ax,float ay,float az){
   static int limiter=0; limiter++;
   if(limiter<2) return;
   limiter=0;
-  char m[120];
-  sprintf(m,"{\"ax\":%.4f,\"ay\":%.4f,\"az\":%.4f}",ax,ay,az);
-  events.send(m,"sample");
+  char *m=bus.reserve(T_SAMPLE,120);
+  if(!m) return;
+  bus.commit(snprintf(m,120,"{\"ax\":%.4f,\"ay\":%.4f,\"az\":%.4f}",ax,ay,az));
 }
 
 // Spectrogram
 void sendBandsCSV(double P1,double P2,double P3,double mean){
-  char m[128];
-  sprintf(m,"%.6f,%.6f,%.6f,%.4f",P1,P2,P3,mean);
-  events.send(m,"bands_csv");
+  char *m=bus.reserve(T_BANDS_CSV,128);
+  if(!m) return;
+  bus.commit(snprintf(m,128,"%.6f,%.6f,%.6f,%.4f",P1,P2,P3,mean));
 }
 
 // Classification SSE
-void sendBandsSSE(double P1,double P2,double P3,const char *type,double conf,double score,double meanNorm){
-  char m[256];
-  sprintf(m,
-  "{\"b1\":%.6f,\"b2\":%.6f,\"b3\":%.6f,"
-  "\"type\":\"%s\",\"confidence\":%.3f,"
-  "\"score\":%.3f,\"meanNorm\":%.4f}",
-  P1,P2,P3,type,conf,score,meanNorm);
-  events.send(m,"bands");
+void sendBandsSSE(double P1,double P2,double P3,const char *type,double conf,double score,double meanNorm,double personalW){
+  char *m=bus.reserve(T_BANDS,EV_BANDS_BYTES);
+  if(!m) return;
+  bus.commit(fmtBands(m,EV_BANDS_BYTES,winStamp,P1,P2,P3,type,conf,score,meanNorm,personalW));
+}
+
+#if ZOOM_SPECTRUM
+// Zoom spectrum SSE
+void sendZoom(double peakHz,double peakPow,double Z1,double Z2,double Z3,uint32_t cycles){
+  char *m=bus.reserve(T_ZOOM,160);
+  if(!m) return;
+  bus.commit(snprintf(m,160,
+  "{\"peakHz\":%.2f,\"peakPow\":%.6f,"
+  "\"z1\":%.6f,\"z2\":%.6f,\"z3\":%.6f,\"cyc\":%lu}",
+  peakHz,peakPow,Z1,Z2,Z3,(unsigned long)cycles));
+}
+#endif
+
+// Tracker SSE
+void sendTrack(double f,double amp){
+  char *m=bus.reserve(T_TRACK,64);
+  if(!m) return;
+  bus.commit(snprintf(m,64,"{\"f\":%.2f,\"a\":%.4f}",f,amp));
+}
+
+// Band envelope SSE
+void sendEnvelope(){
+  char *m=bus.reserve(T_ENV,160);
+  if(!m) return;
+  bus.commit(snprintf(m,160,
+  "{\"a1\":%.4f,\"a2\":%.4f,\"a3\":%.4f,"
+  "\"f1\":%.2f,\"f2\":%.2f,\"f3\":%.2f}",
+  desa1.amplitude(),desa2.amplitude(),desa3.amplitude(),
+  desa1.freq(SAMPLE_RATE),desa2.freq(SAMPLE_RATE),desa3.freq(SAMPLE_RATE)));
+}
+
+// Voluntary-movement gate SSE (replaces bands/bands_csv for the window)
+void sendGated(double volRms,double ratio,double meanNorm){
+  char *m=bus.reserve(T_GATED,EV_GATED_BYTES);
+  if(!m) return;
+  bus.commit(fmtGated(m,EV_GATED_BYTES,winStamp,volRms,ratio,meanNorm));
+}
+
+// Spike-rejection SSE
+void sendQuality(uint32_t rejWindow,uint32_t rejTotal,uint32_t maxCyc){
+  char *m=bus.reserve(T_QUALITY,EV_QUALITY_BYTES);
+  if(!m) return;
+  bus.commit(fmtQuality(m,EV_QUALITY_BYTES,winStamp,rejWindow,rejTotal,maxCyc));
+}
+
+#if CNN_CLASSIFIER
+// CNN classification SSE
+void sendCnn(const char *cls,double conf,uint32_t cycles,uint32_t arena){
+  char *m=bus.reserve(T_CNN,128);
+  if(!m) return;
+  bus.commit(snprintf(m,128,"{\"cls\":\"%s\",\"conf\":%.3f,\"cyc\":%lu,\"arena\":%lu}",
+    cls,conf,(unsigned long)cycles,(unsigned long)arena));
+}
+#endif
+
+// Shadow pipeline diff SSE
+void sendShadow(const WindowOut &a,const WindowOut &b,bool agree){
+  char *m=bus.reserve(T_SHADOW,256);
+  if(!m) return;
+  bus.commit(snprintf(m,256,
+  "{\"agree\":%d,\"live\":\"%s\",\"cand\":\"%s\","
+  "\"dScore\":%.3f,\"d1\":%.6f,\"d2\":%.6f,\"d3\":%.6f,"
+  "\"cycLive\":%lu,\"cycCand\":%lu,\"rate\":%.3f}",
+  agree?1:0,a.gated?"Gated":a.type,b.gated?"Gated":b.type,
+  b.score-a.score,b.P1-a.P1,b.P2-a.P2,b.P3-a.P3,
+  (unsigned long)cycLive,(unsigned long)cycShadow,shadowStats.rate()));
+}
+
+#if BLACKBOX
+// Black-box capture SSE; the file itself is served from SPIFFS.
+void sendBlackBox(const char *status){
+  char *m=bus.reserve(T_BLACKBOX,160);
+  if(!m) return;
+  bus.commit(snprintf(m,160,"{\"status\":\"%s\",\"file\":\"%s\",\"seq\":%lu,\"reason\":%u,"
+          "\"frames\":%u,\"pre\":%u,\"overruns\":%lu}",
+          status,bbName,(unsigned long)bbSeq,blackbox.reason,blackbox.count,blackbox.pre,
+          (unsigned long)bbOverruns));
+}
+#endif
+
+// Test-suite SSE: phase transitions, then all summaries in one event
+void sendPhase(){
+  char *m=bus.reserve(T_PHASE,96);
+  if(!m) return;
+  int n;
+  if(tests.running())
+    n=snprintf(m,96,"{\"phase\":\"%s\",\"idx\":%d,\"sec\":%.2f}",
+            PH_NAMES[tests.phase],tests.phase,tests.len[tests.phase]/SAMPLE_RATE);
+  else
+    n=snprintf(m,96,"{\"phase\":\"end\",\"idx\":%d}",PH_MAX);
+  bus.commit(n);
+}
+
+void buildTestsJson(){
+  int p=sprintf(testsJson,"{\"fs\":%.1f,\"phases\":[",SAMPLE_RATE);
+  for(uint8_t i=0;i<PH_MAX;i++){
+    if(i) testsJson[p++]=',';
+    p+=tests.summary(i,SAMPLE_RATE,testsJson+p,sizeof(testsJson)-p-4);
+  }
+  strcpy(testsJson+p,"]}");
+}
+
+void sendTests(){
+  char *m=bus.reserve(T_TESTS,sizeof(testsJson));
+  if(!m) return;
+  bus.commit(strlcpy(m,testsJson,sizeof(testsJson)));
 }
 
 // Calibration SSE
 void sendCalibrated(double baseline){
-  char m[128];
-  sprintf(m,"{\"baseline\":%.6f}",baseline);
-  events.send(m,"calibrated");
+  char *m=bus.reserve(T_CALIBRATED,128);
+  if(!m) return;
+  bus.commit(snprintf(m,128,"{\"baseline\":%.6f,\"median\":%.6f,\"sigma\":%.6f,\"seconds\":%.1f}",
+          baseline,calib.median,calib.sigma,calib.seconds(SAMPLE_RATE)));
 }
 
-// ----------------------- Classification -----------------------
-void classify(double P1,double P2,double P3,double meanNorm){
-  double A1=P1>NOISE_FLOOR?P1:0;
-  double A2=P2>NOISE_FLOOR?P2:0;
-  double A3=P3>NOISE_FLOOR?P3:0;
-
-  double total=A1+A2+A3;
-  const char *type="No Tremor";
-  double conf=0;
-
-  bool voluntary=meanNorm>0.7 && total<5;
-
-  if(total<NOISE_FLOOR){
-    type="No Tremor";
-    conf=1.0;
-  } else if(voluntary){
-    type="Voluntary Movement";
-    conf=0.6;
-  } else {
-    if(A1>A2 && A1>A3 && A1>0.3){ type="Parkinsonian"; conf=A1/total; }
-    else if(A2>A1 && A2>A3 && A2>0.3){ type="Essential"; conf=A2/total; }
-    else if(A3>A1 && A3>A2 && A3>0.3){ type="Physiological"; conf=A3/total; }
-    else { type="Mixed/Weak"; conf=0.5; }
+// ----------------------- Zoom spectrum -----------------------
+#if ZOOM_SPECTRUM
+// Band means over the 0.2 Hz bins (same band edges as band1..3) and the
+// interpolated spectral peak. From loop(), before the sample gate: done
+// before the next sample is fed into the transform's buffer.
+void zoomService(){
+  if(!zoomReady) return;
+  zoomReady=false;
+  uint32_t c0=ESP.getCycleCount();
+  zoom.run(zoomPow);
+
+  double Z1=0,Z2=0,Z3=0;
+  int n1=0,n2=0,n3=0;
+  uint16_t pk=0;
+  for(uint16_t k=0;k<ZOOM_BINS;k++){
+    double f=zoom.freq(k);
+    if(f>=4-1e-6 && f<6-1e-6){ Z1+=zoomPow[k]; n1++; }
+    else if(f>=6-1e-6 && f<8-1e-6){ Z2+=zoomPow[k]; n2++; }
+    else if(f>=8-1e-6 && f<=12+1e-6){ Z3+=zoomPow[k]; n3++; }
+    if(zoomPow[k]>zoomPow[pk]) pk=k;
   }
+  Z1/=n1; Z2/=n2; Z3/=n3;
 
-  double score=0;
-  if(total>=NOISE_FLOOR){
-    score=log10(total/BASE_FOR_SCORE+1)*SCORE_SCALE;
-    score=constrain(score,0.0,10.0);
+  double peakHz=zoom.freq(pk);
+  if(pk>0 && pk<ZOOM_BINS-1){
+    double a=zoomPow[pk-1],b=zoomPow[pk],c=zoomPow[pk+1];
+    double d=a-2*b+c;
+    if(d!=0) peakHz+=0.5*(a-c)/d*ZOOM_DF;
   }
+  uint32_t cycles=ESP.getCycleCount()-c0;
+  sendZoom(peakHz,zoomPow[pk],Z1,Z2,Z3,cycles);
+}
+#endif
+
+// ----------------------- CNN classifier -----------------------
+#if CNN_CLASSIFIER
+// Model in use: the compiled-in cnn_model, or one loaded from a flash slot.
+const CnnModel *cnnActive=&cnn_model;
+uint32_t cnnVersion=0;   // 0 = compiled-in
+
+int8_t cnnQuant(float g){
+  float q=roundf(g/cnnActive->inScale);
+  return (int8_t)constrain(q,-128.0f,127.0f);
+}
+
+// Layer shapes chain (cnnCheck), the arena fits and the test vector
+// reproduces. Shapes go first: cnnArenaBytes() and cnnRun() trust them.
+bool cnnAccept(const CnnModel &m,const int8_t *testIn,const int32_t *testLogits){
+  if(cnnCheck(m)) return false;
+  if(cnnArenaBytes(m)>CNN_ARENA) return false;
+  int32_t logits[CNN_MAX_CLASSES];
+  cnnRun(m,testIn,cnnArena,logits);
+  for(uint8_t c=0;c<m.nClasses;c++) if(logits[c]!=testLogits[c]) return false;
+  return true;
+}
+
+void cnnInit(){
+  cnnOk=cnnBuiltinOk=cnnAccept(cnn_model,cnn_test_in,cnn_test_logits);
+  if(!cnnOk) Serial.println("CNN: built-in model failed self-test");
+}
+
+void cnnClassify(){
+  if(!cnnOk) return;
+  int32_t logits[CNN_MAX_CLASSES];
+  uint32_t c0=ESP.getCycleCount();
+  uint8_t cls=cnnRun(*cnnActive,cnnIn,cnnArena,logits);
+  uint32_t cycles=ESP.getCycleCount()-c0;
+
+  double den=0;
+  for(uint8_t c=0;c<cnnActive->nClasses;c++)
+    den+=exp((logits[c]-logits[cls])*(double)cnnActive->logitScale);
+  sendCnn(cls<4?cnn_classes[cls]:"other",1.0/den,cycles,cnnArenaBytes(*cnnActive));
+}
+#endif
+
+// ----------------------- Personalisation -----------------------
+Preferences prefs;
+PersonalModel personal;
+const char *const PM_TYPES[PM_CLASSES]={"No Tremor","Parkinsonian","Essential","Physiological"};
+
+// Set from HTTP handlers; labels are consumed in classify(), the reset in
+// personalService(), both on the loop task.
+volatile int8_t labelClass=-1;
+volatile uint16_t labelLeft=0;
+volatile bool personalResetReq=false;
+uint8_t personalUnsaved=0;
+bool personalDirty=false;            // due for an NVS write by personalService()
+
+void personalSave(){
+  prefs.begin("personal",false);
+  prefs.putBytes("model",&personal,sizeof(personal));
+  prefs.end();
+  personalUnsaved=0;
+}
+
+void personalLoad(){
+  prefs.begin("personal",true);
+  PersonalModel m;
+  if(prefs.getBytesLength("model")==sizeof(m)){
+    prefs.getBytes("model",&m,sizeof(m));
+    if(m.version==PM_VERSION) personal=m;
+  }
+  prefs.end();
+}
+
+// Runs from loop() outside the sample gate, gated windows or not: applies
+// a reset and does the NVS writes personalize() asked for.
+void personalService(){
+  if(personalResetReq){
+    personal=PersonalModel();
+    personalResetReq=false;
+    personalDirty=true;
+  }
+  if(personalDirty){
+    personalSave();
+    personalDirty=false;
+  }
+}
 
-  sendBandsSSE(P1,P2,P3,type,conf,score,meanNorm);
+int8_t personalClassIndex(const char *name){
+  static const char *const keys[PM_CLASSES]={"no_tremor","parkinsonian","essential","physiological"};
+  for(uint8_t c=0;c<PM_CLASSES;c++) if(!strcmp(name,keys[c])) return c;
+  return -1;
+}
+
+// Learn from a labelled window, then blend the rule output with the
+// personal posterior. Returns the blend weight used (0 = rules only).
+double personalize(double P1,double P2,double P3,double meanNorm,const char *&type,double &conf){
+  float f[PM_FEATS];
+  PersonalModel::features(P1,P2,P3,meanNorm,f);
+
+  if(labelLeft>0 && labelClass>=0){
+    personal.update(labelClass,f);
+    labelLeft--;
+    if(++personalUnsaved>=PERSONAL_SAVE_EVERY || labelLeft==0) personalDirty=true;
+  }
+
+  if(!strcmp(type,"Voluntary Movement")) return 0;
+
+  float p[PM_CLASSES];
+  if(personal.posterior(f,p)<2) return 0;
+
+  double n=personal.total();
+  double w=min(PERSONAL_MAX_W,n/(n+PERSONAL_N0));
+  int8_t rule=-1;
+  for(uint8_t c=0;c<PM_CLASSES;c++) if(!strcmp(type,PM_TYPES[c])) rule=c;
+
+  uint8_t best=0;
+  double bestScore=-1;
+  for(uint8_t c=0;c<PM_CLASSES;c++){
+    double sc=w*p[c] + (c==rule?(1-w)*conf:0);
+    if(sc>bestScore){ bestScore=sc; best=c; }
+  }
+  type=PM_TYPES[best];
+  conf=bestScore;
+  return w;
+}
+
+// ----------------------- Model slots -----------------------
+#if CNN_CLASSIFIER
+const esp_partition_t *modelPart=nullptr;
+uint8_t *modelBuf=nullptr;          // blob backing cnnActive when loaded from flash
+CnnBlobModel modelBlob;
+int8_t modelSlot=-1;                // -1 = compiled-in
+int8_t modelPrevSlot=-1;            // active before modelSlot: what rollback returns to
+
+// Written by the upload handler (async task), consumed by modelService().
+volatile int8_t modelStageSlot=-1;
+volatile bool modelRollbackReq=false;
+bool modelUploadOk=false;
+AsyncWebServerRequest *modelUploader=nullptr;   // the one upload writing a slot
+char modelStatus[48]="built-in";
+
+// Loaded and checked by modelService() outside the sample gate, put in by
+// modelSwap() at the next window close so a window is never quantised
+// with two models' scales.
+bool modelNextReady=false;
+int8_t modelNextSlot=-1;
+uint8_t *modelNextBuf=nullptr;
+CnnBlobModel modelNext;
+char modelNextStatus[48];
+uint8_t *modelOldBuf=nullptr;       // replaced blob, freed by modelService()
+bool modelSaveReq=false;            // slots changed, NVS not written yet
+
+// Reads and fully validates a slot. On success the caller owns *buf.
+const char *modelLoadSlot(int8_t slot,uint8_t *&buf,CnnBlobModel &m){
+  buf=nullptr;
+  if(!modelPart || slot<0 || slot>1) return "no partition";
+  ModelBlobHeader h;
+  uint32_t base=slot*MODEL_SLOT_SIZE;
+  if(esp_partition_read(modelPart,base,&h,sizeof(h))!=ESP_OK) return "read";
+  if(h.magic!=MODEL_MAGIC) return "empty";
+  uint32_t size=sizeof(h)+h.length;
+  if(size>MODEL_SLOT_SIZE) return "length";
+  buf=(uint8_t*)malloc(size);
+  if(!buf) return "alloc";
+  const char *err=nullptr;
+  if(esp_partition_read(modelPart,base,buf,size)!=ESP_OK) err="read";
+  if(!err) err=cnnBlobParse(buf,size,m);
+  if(!err && !cnnAccept(m.model,m.testIn,m.testLogits)) err="self-test";
+  if(err){ free(buf); buf=nullptr; }
+  return err;
+}
+
+// Cheap: pointers and flags only. NVS is written by modelService().
+void modelActivate(int8_t slot,uint8_t *buf,const CnnBlobModel &m){
+  if(modelOldBuf) free(modelOldBuf);
+  modelOldBuf=modelBuf;
+  modelBlob=m;
+  modelBlob.model.layers=modelBlob.layers;
+  modelBuf=buf;
+  if(slot!=modelSlot) modelPrevSlot=modelSlot;
+  modelSlot=slot;
+  cnnActive=slot<0?&cnn_model:&modelBlob.model;
+  cnnVersion=slot<0?0:m.version;
+  cnnOk=slot<0?cnnBuiltinOk:true;
+  modelSaveReq=true;
+}
+
+void sendModel(const char *status){
+  char *m=bus.reserve(T_MODEL,128);
+  if(!m) return;
+  bus.commit(snprintf(m,128,"{\"slot\":%d,\"version\":%lu,\"status\":\"%s\"}",
+    modelSlot,(unsigned long)cnnVersion,status));
+}
+
+// Runs from loop() outside the sample gate: the flash read, malloc,
+// self-test and NVS write of a model change all happen here. Rollback
+// returns to modelPrevSlot (-1 = built-in), or to built-in when that slot
+// no longer validates.
+void modelService(){
+  if(modelOldBuf){ free(modelOldBuf); modelOldBuf=nullptr; }
+  if(modelSaveReq){
+    prefs.begin("models",false);
+    prefs.putUChar("active",(uint8_t)(modelSlot+1));
+    prefs.putUChar("prev",(uint8_t)(modelPrevSlot+1));
+    prefs.end();
+    modelSaveReq=false;
+  }
+  if(modelNextReady) return;
+  if(modelStageSlot>=0){
+    int8_t slot=modelStageSlot;
+    uint8_t *buf; CnnBlobModel m;
+    const char *err=modelLoadSlot(slot,buf,m);
+    modelStageSlot=-1;                // the slot may be rewritten from here on
+    if(err){
+      if(slot==modelPrevSlot){ modelPrevSlot=-1; modelSaveReq=true; }   // overwritten
+      snprintf(modelStatus,sizeof(modelStatus),"rejected: %s",err);
+      sendModel(modelStatus);
+      return;
+    }
+    modelNextSlot=slot; modelNextBuf=buf; modelNext=m;
+    snprintf(modelNextStatus,sizeof(modelNextStatus),"active");
+    modelNextReady=true;
+    return;
+  }
+  if(modelRollbackReq){
+    modelRollbackReq=false;
+    int8_t prev=modelPrevSlot;
+    uint8_t *buf=nullptr; CnnBlobModel m;
+    const char *err=prev<0?"built-in":modelLoadSlot(prev,buf,m);
+    if(err){
+      modelNextSlot=-1; modelNextBuf=nullptr; modelNext=CnnBlobModel();
+      snprintf(modelNextStatus,sizeof(modelNextStatus),"rolled back to built-in");
+    } else {
+      modelNextSlot=prev; modelNextBuf=buf; modelNext=m;
+      snprintf(modelNextStatus,sizeof(modelNextStatus),"rolled back");
+    }
+    modelNextReady=true;
+  }
+}
+
+// Window close: the only place the active model changes.
+void modelSwap(){
+  if(!modelNextReady) return;
+  modelActivate(modelNextSlot,modelNextBuf,modelNext);
+  memcpy(modelStatus,modelNextStatus,sizeof(modelStatus));
+  modelNextReady=false;
+  sendModel(modelStatus);
+}
+
+void modelInit(){
+  modelPart=esp_partition_find_first(ESP_PARTITION_TYPE_DATA,(esp_partition_subtype_t)0x40,"models");
+  if(!modelPart) return;
+  prefs.begin("models",true);
+  int8_t slot=(int8_t)prefs.getUChar("active",0)-1;
+  int8_t prev=(int8_t)prefs.getUChar("prev",0)-1;
+  prefs.end();
+  if(slot>=0){
+    uint8_t *buf; CnnBlobModel m;
+    const char *err=modelLoadSlot(slot,buf,m);
+    if(err) snprintf(modelStatus,sizeof(modelStatus),"slot %d rejected: %s",slot,err);
+    else { modelActivate(slot,buf,m); snprintf(modelStatus,sizeof(modelStatus),"active"); }
+  }
+  modelPrevSlot=prev!=modelSlot?prev:-1;
+  modelSaveReq=false;
+}
+
+// Streams the upload into the inactive slot; the loop validates it. One
+// upload at a time, and none while a staged one waits for modelService():
+// the slot it would write may be the one being read. Sectors are erased as
+// the chunks reach them, so no single call blocks the async task for the
+// whole slot.
+void modelUploadChunk(AsyncWebServerRequest *r,const String &fn,size_t index,uint8_t *data,size_t len,bool final){
+  static int8_t target=1;
+  static uint32_t erased=0;
+  if(index==0){
+    if(modelUploader || modelStageSlot>=0 || modelNextReady) return;   // answered 409
+    modelUploader=r;
+    r->onDisconnect([r](){ if(modelUploader==r) modelUploader=nullptr; });
+    // not the active slot, nor (when built-in runs) the rollback one
+    target=modelSlot>=0?1-modelSlot:modelPrevSlot==0?1:0;
+    erased=0;
+    modelUploadOk=modelPart!=nullptr;
+  }
+  if(r!=modelUploader || !modelUploadOk) return;
+  uint32_t base=target*MODEL_SLOT_SIZE;
+  if(index+len>MODEL_SLOT_SIZE){ modelUploadOk=false; return; }
+  while(erased<index+len){
+    if(esp_partition_erase_range(modelPart,base+erased,MODEL_SECTOR)!=ESP_OK){ modelUploadOk=false; return; }
+    erased+=MODEL_SECTOR;
+  }
+  if(esp_partition_write(modelPart,base+index,data,len)!=ESP_OK){
+    modelUploadOk=false;
+    return;
+  }
+  if(final) modelStageSlot=target;
+}
+#endif
+
+// ----------------------- Black box -----------------------
+#if BLACKBOX
+void bbTrigger(uint8_t why){
+  blackbox.trigger(BB_POST,why,millis());
+}
+
+// Sample context: copies frames from the ring into bbChunk, which is only
+// RAM, so the cursor stays ahead of the writer without touching flash.
+void bbStage(){
+  if(!blackbox.ready || bbStaged>=BB_DRAIN) return;
+  bbStaged+=blackbox.drain(bbChunk+bbStaged,BB_DRAIN-bbStaged);
+}
+
+// Runs from loop() outside the sample gate: opens the file when a capture
+// completes and writes at most BB_FLUSH staged frames per pass. If SPIFFS
+// stalls long enough for the ring to overwrite undrained frames (about
+// BB_DRAIN samples), the capture is dropped and counted.
+void bbService(){
+  if(!blackbox.ready) return;
+  if(blackbox.lost){
+    if(bbOpen){ bbFile.close(); SPIFFS.remove(bbName); bbOpen=false; }
+    bbStaged=0;
+    bbOverruns++;
+    blackbox.release();
+    sendBlackBox("overrun");
+    return;
+  }
+  if(!bbOpen){
+    sprintf(bbName,"/bb%u.bin",(unsigned)(bbSeq%BB_FILES));
+    bbFile=SPIFFS.open(bbName,FILE_WRITE);
+    if(!bbFile){ bbStaged=0; blackbox.release(); sendBlackBox("error"); return; }
+    bbOpen=true;
+    BlackBoxHeader h;
+    blackbox.header(h,bbSeq,SAMPLE_RATE);
+    bbFile.write((const uint8_t*)&h,sizeof(h));
+    return;
+  }
+  uint8_t n=bbStaged<BB_FLUSH?bbStaged:BB_FLUSH;
+  if(n){
+    bbFile.write((const uint8_t*)bbChunk,n*sizeof(BlackBoxFrame));
+    memmove(bbChunk,bbChunk+n,(bbStaged-n)*sizeof(BlackBoxFrame));
+    bbStaged-=n;
+  }
+  if(blackbox.drainedAll() && !bbStaged){
+    bbFile.close();
+    bbOpen=false;
+    blackbox.release();
+    sendBlackBox("saved");
+    bbSeq++;
+  }
+}
+#endif
+
+// ----------------------- Window log -----------------------
+#if WINDOW_LOG
+void wlogPath(char *p,uint16_t seg){ sprintf(p,"/lg%u.bin",seg); }
+
+// Epoch from /lg.meta (a new one formats the log), then [lo,hi) from the
+// first record and size of each segment.
+void wlogInit(){
+  wlog.init(LOG_SEG_RECS,LOG_SEGS);
+  char p[16];
+  File f=SPIFFS.open("/lg.meta","r");
+  if(!f || f.read((uint8_t*)&wlog.epoch,4)!=4){
+    if(f) f.close();
+    wlog.epoch=esp_random();
+    f=SPIFFS.open("/lg.meta","w");
+    if(f) f.write((const uint8_t*)&wlog.epoch,4);
+    for(uint16_t s=0;s<LOG_SEGS;s++){ wlogPath(p,s); SPIFFS.remove(p); }
+  }
+  if(f) f.close();
+  uint32_t first[LOG_SEGS],count[LOG_SEGS];
+  for(uint16_t s=0;s<LOG_SEGS;s++){
+    first[s]=count[s]=0;
+    wlogPath(p,s);
+    if(!SPIFFS.exists(p)) continue;
+    f=SPIFFS.open(p,"r");
+    if(f && f.size()>=sizeof(LogRecord) && f.read((uint8_t*)&first[s],4)==4)
+      count[s]=f.size()/sizeof(LogRecord);
+    if(f) f.close();
+  }
+  wlog.recover(first,count);
+}
+
+// Sample context: queues the window in RAM. wlogFlush() writes it.
+void wlogAppend(const WindowOut &w,const char *type,double conf){
+  if(wlogCount>=LOG_QUEUE){ wlogErrors++; return; }
+  LogRecord &r=wlogQ[(wlogHead+wlogCount)%LOG_QUEUE];
+  r.ms=millis();
+  r.p1=w.P1; r.p2=w.P2; r.p3=w.P3;
+  r.score=w.gated?0:w.score;
+  r.conf=conf;
+  r.type=logType(type);
+  r.flags=w.gated?LOG_GATED:0;
+  r.meanMg=(uint16_t)constrain(w.meanNorm*1000.0,0.0,65535.0);
+  wlogCount++;
+}
+
+// Runs from loop() outside the sample gate: once LOG_BATCH windows are
+// queued, writes those that fall in hi's segment with one open and one
+// write. Only a segment being started is opened "w" (truncated); an
+// existing one is opened "r+", and if that fails the batch is dropped and
+// counted rather than the segment wiped. Readers (/log/range) check every
+// record's seq, so a segment truncated under them shows up as a short
+// reply, not as wrong data.
+void wlogFlush(){
+  if(wlogCount<LOG_BATCH) return;
+  uint8_t n=LOG_BATCH;
+  uint32_t room=LOG_SEG_RECS-wlog.hi%LOG_SEG_RECS;
+  if(n>room) n=room;
+  char p[16];
+  wlogPath(p,wlog.segOf(wlog.hi));
+  bool fresh=wlog.beginAppend();
+  File f=SPIFFS.open(p,fresh?"w":"r+");
+  size_t put=0;
+  if(f){
+    LogRecord batch[LOG_BATCH];
+    for(uint8_t i=0;i<n;i++){
+      batch[i]=wlogQ[(wlogHead+i)%LOG_QUEUE];
+      batch[i].seq=wlog.hi+i;
+    }
+    if(f.seek(wlog.offsetOf(wlog.hi))) put=f.write((const uint8_t*)batch,n*sizeof(LogRecord))/sizeof(LogRecord);
+    f.close();
+  }
+  for(size_t i=0;i<put;i++) wlog.appended();
+  wlogErrors+=n-put;
+  wlogHead=(wlogHead+n)%LOG_QUEUE;
+  wlogCount-=n;
+}
+#endif
+
+// ----------------------- Classification -----------------------
+// Rule output comes from the pipeline (classifyBands()); personalisation is
+// applied on top before it goes out.
+void classify(const WindowOut &w){
+  const char *type=w.type;
+  double conf=w.conf;
+  double pw=personalize(w.P1,w.P2,w.P3,w.meanNorm,type,conf);
+
+  sendBandsSSE(w.P1,w.P2,w.P3,type,conf,w.score,w.meanNorm,pw);
+#if WINDOW_LOG
+  wlogAppend(w,type,conf);
+#endif
 }
 
 // ----------------------- Setup -----------------------
 void setup(){
+#if BUS_UART
+  Serial.setTxBufferSize(UART_TX_BUF);
+#endif
   Serial.begin(115200);
   SPIFFS.begin(true);
 
-  Wire.begin();
-  mpu.begin();
-  delay(200);
-  mpu.calcOffsets();
+  personalLoad();
+  busInit();
+#if WINDOW_LOG
+  wlogInit();
+#endif
 
-  hpfX.initHPF(SAMPLE_RATE,3.5);
-  hpfY.initHPF(SAMPLE_RATE,3.5);
-  hpfZ.initHPF(SAMPLE_RATE,3.5);
+  Wire.begin();
+  if(mpu.begin()!=0){
+    Serial.println("MPU6050 not found, using synthetic IMU");
+    synthMode=true;
+  } else {
+    delay(200);
+    mpu.calcOffsets();
+  }
 
-  for(int i=0;i<MA_LEN;i++){ maAx[i]=maAy[i]=maAz[i]=maNorm[i]=0; }
-  for(int i=0;i<WINDOW;i++){ windowBuf[i]=0; }
+  PipelineConfig cfg;
+  cfg.fs=SAMPLE_RATE;
+  live.init(cfg);
+  tracker.init(6.0,3.0,15.0,SAMPLE_RATE);
+  bpf1.initBPF(SAMPLE_RATE,4,6);
+  bpf2.initBPF(SAMPLE_RATE,6,8);
+  bpf3.initBPF(SAMPLE_RATE,8,12);
+
+#if ZOOM_SPECTRUM
+  zoom.init(ZOOM_F0,ZOOM_DF,SAMPLE_RATE);
+#endif
+#if CNN_CLASSIFIER
+  cnnInit();
+  modelInit();
+#endif
 
   pinMode(BUTTON_PIN,INPUT_PULLUP);
   pinMode(LED_PIN,OUTPUT);
@@ -252,14 +1166,210 @@ void setup(){
 
   server.serveStatic("/",SPIFFS,"/");
   server.on("/startCalib",HTTP_GET,[](AsyncWebServerRequest *r){
-    calibrationMode=true;
-    calibStart=millis();
-    calibSum=0;
-    calibCount=0;
+    calibStartReq=true;
+    r->send(200,"text/plain","OK");
+  });
+
+  // Label the next n windows as one class (no_tremor, parkinsonian,
+  // essential, physiological) for the personal model.
+  server.on("/personal/label",HTTP_GET,[](AsyncWebServerRequest *r){
+    if(!r->hasParam("cls")){ r->send(400,"text/plain","missing cls"); return; }
+    int8_t c=personalClassIndex(r->getParam("cls")->value().c_str());
+    if(c<0){ r->send(400,"text/plain","unknown cls"); return; }
+    int n=r->hasParam("n")?r->getParam("n")->value().toInt():1;
+    labelLeft=0;
+    labelClass=c;
+    labelLeft=constrain(n,1,1000);
     r->send(200,"text/plain","OK");
   });
+  server.on("/personal/reset",HTTP_GET,[](AsyncWebServerRequest *r){
+    personalResetReq=true;
+    r->send(200,"text/plain","OK");
+  });
+  server.on("/personal/status",HTTP_GET,[](AsyncWebServerRequest *r){
+    char m[128];
+    sprintf(m,"{\"n\":[%lu,%lu,%lu,%lu],\"labelLeft\":%u}",
+      (unsigned long)personal.n[0],(unsigned long)personal.n[1],
+      (unsigned long)personal.n[2],(unsigned long)personal.n[3],(unsigned)labelLeft);
+    r->send(200,"application/json",m);
+  });
+
+#if CNN_CLASSIFIER
+  // Classifier model hot-swap (blob from tools/cnn_export.py --blob)
+  server.on("/model/upload",HTTP_POST,[](AsyncWebServerRequest *r){
+    if(r!=modelUploader){ r->send(409,"text/plain","another model is being uploaded or staged"); return; }
+    modelUploader=nullptr;
+    if(modelUploadOk) r->send(202,"text/plain","staged, switching at next window");
+    else r->send(400,"text/plain","upload failed");
+  },modelUploadChunk);
+  server.on("/model/rollback",HTTP_GET,[](AsyncWebServerRequest *r){
+    modelRollbackReq=true;
+    r->send(202,"text/plain","rolling back at next window");
+  });
+  server.on("/model/status",HTTP_GET,[](AsyncWebServerRequest *r){
+    char m[128];
+    sprintf(m,"{\"slot\":%d,\"prev\":%d,\"version\":%lu,\"status\":\"%s\"}",
+      modelSlot,modelPrevSlot,(unsigned long)cnnVersion,modelStatus);
+    r->send(200,"application/json",m);
+  });
+#endif
+
+  // Synthetic source: on=0|1, f (Hz), amp (g), noise (g), sway (g).
+  server.on("/synth",HTTP_GET,[](AsyncWebServerRequest *r){
+    if(r->hasParam("f")) synth.freq=constrain(r->getParam("f")->value().toFloat(),0.5f,20.0f);
+    if(r->hasParam("amp")) synth.amp=constrain(r->getParam("amp")->value().toFloat(),0.0f,2.0f);
+    if(r->hasParam("noise")) synth.noise=constrain(r->getParam("noise")->value().toFloat(),0.0f,1.0f);
+    if(r->hasParam("sway")) synth.swayAmp=constrain(r->getParam("sway")->value().toFloat(),0.0f,2.0f);
+    if(r->hasParam("on")) synthMode=r->getParam("on")->value().toInt()!=0;
+    char m[128];
+    sprintf(m,"{\"on\":%d,\"f\":%.2f,\"amp\":%.3f,\"noise\":%.4f,\"sway\":%.3f}",
+            synthMode?1:0,synth.freq,synth.amp,synth.noise,synth.swayAmp);
+    r->send(200,"application/json",m);
+  });
+
+  // Guided test suite: optional phase lengths in seconds.
+  server.on("/tests/start",HTTP_GET,[](AsyncWebServerRequest *r){
+    const uint16_t defSec[PH_MAX]={35,35,40};
+    for(uint8_t i=0;i<PH_MAX;i++){
+      uint16_t sec=defSec[i];
+      if(r->hasParam(PH_NAMES[i])) sec=constrain(r->getParam(PH_NAMES[i])->value().toInt(),1,110);
+      testsPending[i]=(uint32_t)(sec*SAMPLE_RATE);
+    }
+    testsStartReq=true;
+    r->send(202,"text/plain","tests start at next window");
+  });
+  server.on("/tests/skip",HTTP_GET,[](AsyncWebServerRequest *r){
+    testsSkipReq=true;
+    r->send(202,"text/plain","OK");
+  });
+  server.on("/tests/abort",HTTP_GET,[](AsyncWebServerRequest *r){
+    testsAbortReq=true;
+    r->send(202,"text/plain","OK");
+  });
+  server.on("/tests/result",HTTP_GET,[](AsyncWebServerRequest *r){
+    if(!testsReported){ r->send(409,"text/plain",tests.running()?"running":"no result"); return; }
+    r->send(200,"application/json",testsJson);
+  });
+
+  // Shadow pipeline: start from the live configuration and override any of
+  // hpf, ma, despike, gate, gateRatio, gateRms, nf (noise-floor scale).
+  server.on("/shadow/start",HTTP_GET,[](AsyncWebServerRequest *r){
+    PipelineConfig c=live.cfg;
+    double nf=1.0;
+    if(r->hasParam("hpf")) c.hpfHz=constrain(r->getParam("hpf")->value().toFloat(),0.5f,10.0f);
+    if(r->hasParam("ma")) c.maLen=constrain(r->getParam("ma")->value().toInt(),1,(int)MA_MAX);
+    if(r->hasParam("despike")) c.despike=r->getParam("despike")->value().toInt()!=0;
+    if(r->hasParam("gate")) c.volGate=r->getParam("gate")->value().toInt()!=0;
+    if(r->hasParam("gateRatio")) c.volGateRatio=r->getParam("gateRatio")->value().toFloat();
+    if(r->hasParam("gateRms")) c.volGateRms=r->getParam("gateRms")->value().toFloat();
+    if(r->hasParam("nf")) nf=constrain(r->getParam("nf")->value().toFloat(),0.1f,10.0f);
+    c.noiseFloor=live.cfg.noiseFloor*nf;
+    shadowNfScale=nf;
+    shadowPending=c;
+    shadowStartReq=true;
+    r->send(202,"text/plain","shadow starts at next window");
+  });
+  server.on("/shadow/stop",HTTP_GET,[](AsyncWebServerRequest *r){
+    shadowStopReq=true;
+    r->send(202,"text/plain","OK");
+  });
+
+#if BLACKBOX
+  server.on("/blackbox/trigger",HTTP_GET,[](AsyncWebServerRequest *r){
+    bbHttpReq=true;
+    r->send(202,"text/plain","OK");
+  });
+#endif
+
+#if WINDOW_LOG
+  // Store-and-forward: the gateway reads the marks, then pulls what it is
+  // missing with /log/range?from=<seq>&n=<count>. A reply holds at most
+  // LOG_RANGE_MAX records of one segment and is read from flash in the
+  // web server task, in pieces, never in loop().
+  server.on("/log/marks",HTTP_GET,[](AsyncWebServerRequest *r){
+    char m[192];
+    sprintf(m,"{\"format\":%u,\"epoch\":%lu,\"lo\":%lu,\"hi\":%lu,\"rec\":%u,"
+            "\"segRecs\":%u,\"max\":%u,\"queued\":%u,\"errors\":%lu}",
+            LOG_FORMAT,(unsigned long)wlog.epoch,(unsigned long)wlog.lo,(unsigned long)wlog.hi,
+            (unsigned)sizeof(LogRecord),LOG_SEG_RECS,LOG_RANGE_MAX,
+            (unsigned)wlogCount,(unsigned long)wlogErrors);
+    r->send(200,"application/json",m);
+  });
+  server.on("/log/range",HTTP_GET,[](AsyncWebServerRequest *r){
+    if(!r->hasParam("from")){ r->send(400,"text/plain","missing from"); return; }
+    uint32_t from=strtoul(r->getParam("from")->value().c_str(),nullptr,10);
+    uint32_t n=r->hasParam("n")?r->getParam("n")->value().toInt():LOG_RANGE_MAX;
+    n=wlog.span(from,constrain(n,1u,(uint32_t)LOG_RANGE_MAX));
+    if(!n){ r->send(416,"text/plain","not held"); return; }
+    char p[16];
+    wlogPath(p,wlog.segOf(from));
+    String path(p);
+    uint32_t off=wlog.offsetOf(from);
+    AsyncWebServerResponse *res=r->beginResponse("application/octet-stream",n*sizeof(LogRecord),
+      [path,off](uint8_t *buf,size_t maxLen,size_t index)->size_t{
+        File f=SPIFFS.open(path,"r");
+        size_t got=0;
+        if(f){ f.seek(off+index); got=f.read(buf,maxLen); f.close(); }
+        // truncated under us: pad with 0xFF, which no valid seq matches
+        if(got<maxLen) memset(buf+got,0xFF,maxLen-got);
+        return maxLen;
+      });
+    res->addHeader("X-Log-Epoch",String((unsigned long)wlog.epoch));
+    r->send(res);
+  });
+#endif
+
+  // Output bus counters; sink, topics and policy change one sink's
+  // subscription at the next loop() pass.
+  server.on("/bus",HTTP_GET,[](AsyncWebServerRequest *r){
+    if(r->hasParam("sink")){
+      int8_t id=bus.find(r->getParam("sink")->value().c_str());
+      if(id<0){ r->send(400,"text/plain","unknown sink"); return; }
+      int8_t pol=-1;
+      if(r->hasParam("policy")){
+        String p=r->getParam("policy")->value();
+        if(p=="oldest") pol=BUS_DROP_OLDEST;
+        else if(p=="newest") pol=BUS_DROP_NEWEST;
+        else { r->send(400,"text/plain","unknown policy"); return; }
+      }
+      busReqTopics=r->hasParam("topics")?busTopicMask(r->getParam("topics")->value().c_str()):busWant[id];
+      busReqPolicy=pol;
+      busReqSink=id;
+      busReq=true;
+    }
+    char m[1024];
+    bus.json(m,sizeof(m));
+    r->send(200,"application/json",m);
+  });
+#if BUS_UDP
+  server.on("/bus/udp",HTTP_GET,[](AsyncWebServerRequest *r){
+    IPAddress ip;
+    if(!r->hasParam("host") || !r->hasParam("port") || !ip.fromString(r->getParam("host")->value())){
+      r->send(400,"text/plain","missing host or port"); return;
+    }
+    udpReqHost=ip;
+    udpReqPort=r->getParam("port")->value().toInt();
+    udpReq=true;
+    r->send(202,"text/plain","OK");
+  });
+#endif
+#if BUS_PUSH
+  server.on("/bus/push",HTTP_GET,[](AsyncWebServerRequest *r){
+    IPAddress ip;
+    if(!r->hasParam("host") || !r->hasParam("port") || !ip.fromString(r->getParam("host")->value())){
+      r->send(400,"text/plain","missing host or port"); return;
+    }
+    pushReqHost=ip;
+    pushReqPort=r->getParam("port")->value().toInt();
+    pushReq=true;
+    r->send(202,"text/plain","OK");
+  });
+#endif
 
   server.addHandler(&events);
+#if BUS_WS
+  server.addHandler(&ws);
+#endif
   server.begin();
 }
 
@@ -281,12 +1391,19 @@ void loop(){
         unsigned long pressDur=millis()-pressStart;
 
         if(pressDur>LONG_PRESS_MS){
-          calibrationMode=true;
-          calibStart=millis();
-          calibSum=0;
-          calibCount=0;
+          calibStartReq=true;
         } else {
           streaming=!streaming;
+#if BLACKBOX
+          // A second short press right after the first undoes the toggle
+          // and marks the moment in the black box instead.
+          if(millis()-lastShortPress<DOUBLE_PRESS_MS){
+            bbTrigger(BB_BUTTON);
+            lastShortPress=0;
+          } else {
+            lastShortPress=millis();
+          }
+#endif
         }
       }
     }
@@ -303,56 +1420,109 @@ void loop(){
     digitalWrite(LED_PIN, streaming ? HIGH : LOW);
   }
 
+  busPump();
+#if BLACKBOX
+  bbService();
+#endif
+#if WINDOW_LOG
+  wlogFlush();
+#endif
+#if CNN_CLASSIFIER
+  modelService();
+#endif
+  personalService();
+#if ZOOM_SPECTRUM
+  zoomService();
+#endif
+
   // Sampling timing
   static unsigned long lastMicros=0;
   unsigned long now=micros();
   if(now-lastMicros<(1000000/SAMPLE_RATE)) return;
   lastMicros=now;
 
-  mpu.update();
-  float axr=mpu.getAccX();
-  float ayr=mpu.getAccY();
-  float azr=mpu.getAccZ();
-
-  double hpx=hpfX.process(axr);
-  double hpy=hpfY.process(ayr);
-  double hpz=hpfZ.process(azr);
-
-  sumAx-=maAx[maIdx]; maAx[maIdx]=hpx; sumAx+=maAx[maIdx];
-  sumAy-=maAy[maIdx]; maAy[maIdx]=hpy; sumAy+=maAy[maIdx];
-  sumAz-=maAz[maIdx]; maAz[maIdx]=hpz; sumAz+=maAz[maIdx];
-
-  maIdx++; if(maIdx>=MA_LEN){ maIdx=0; maFilled=true; }
-
-  float meanAx=ma_get(sumAx);
-  float meanAy=ma_get(sumAy);
-  float meanAz=ma_get(sumAz);
-
-  float dx=hpx-meanAx;
-  float dy=hpy-meanAy;
-  float dz=hpz-meanAz;
-
-  float norm=sqrt(dx*dx+dy*dy+dz*dz);
-
-  uint8_t pos=(maIdx==0?MA_LEN-1:maIdx-1);
-  sumNorm-=maNorm[pos]; maNorm[pos]=norm; sumNorm+=maNorm[pos];
-  float meanNorm=maFilled?sumNorm/MA_LEN:sumNorm/(winIdx+1);
+  float acc[3],gyro[3];
+  if(synthMode){
+    synth.next(SAMPLE_RATE,acc,gyro);
+  } else {
+    mpu.update();
+    acc[0]=mpu.getAccX(); acc[1]=mpu.getAccY(); acc[2]=mpu.getAccZ();
+    gyro[0]=mpu.getGyroX(); gyro[1]=mpu.getGyroY(); gyro[2]=mpu.getGyroZ();
+  }
+  float axr=acc[0];
+  float ayr=acc[1];
+  float azr=acc[2];
+#if BLACKBOX
+  blackbox.push(axr,ayr,azr,gyro[0],gyro[1],gyro[2]);
+  if(bbHttpReq){ bbHttpReq=false; bbTrigger(BB_HTTP); }
+  bbStage();
+#endif
+
+  SampleOut o;
+  WindowOut w;
+  uint32_t c0=ESP.getCycleCount();
+  bool closed=live.push(axr,ayr,azr,o,w);
+  cycLive+=ESP.getCycleCount()-c0;
+
+  SampleOut so;
+  WindowOut sw;
+  bool shadowClosed=false;
+  if(shadowOn){
+    c0=ESP.getCycleCount();
+    shadowClosed=shadow.push(axr,ayr,azr,so,sw);
+    cycShadow+=ESP.getCycleCount()-c0;
+  }
+  if(testsSkipReq){
+    testsSkipReq=false;
+    if(tests.running()){ tests.next(); sendPhase(); }
+  }
+  if(tests.tick(o.idx,WINDOW)) sendPhase();
 
-  float tremor=norm-meanNorm;
+  float dx=o.dx, dy=o.dy, dz=o.dz;
+  float tremor=o.tremor;
 
   if(streaming) sendSample(dx,dy,dz);
 
-  windowBuf[winIdx]=tremor;
-  winIdx++;
+  axisPow[0]+=0.02f*(dx*dx-axisPow[0]);
+  axisPow[1]+=0.02f*(dy*dy-axisPow[1]);
+  axisPow[2]+=0.02f*(dz*dz-axisPow[2]);
+  uint8_t ax=axisPow[0]>=axisPow[1]?(axisPow[0]>=axisPow[2]?0:2):(axisPow[1]>=axisPow[2]?1:2);
+  float sig=ax==0?dx:ax==1?dy:dz;
+  tracker.push(sig);
+  if(++trackDecim>=TRACK_DECIM){
+    trackDecim=0;
+    sendTrack(tracker.freq(SAMPLE_RATE),tracker.amplitude());
+  }
 
-  if(calibrationMode){
-    calibSum+=fabs(tremor);
-    calibCount++;
+  desa1.push(bpf1.process(sig));
+  desa2.push(bpf2.process(sig));
+  desa3.push(bpf3.process(sig));
+  if(++envDecim>=ENV_DECIM){
+    envDecim=0;
+    sendEnvelope();
+  }
 
-    if(millis()-calibStart>=CALIB_DURATION){
-      double baseline=calibSum/calibCount;
-      NOISE_FLOOR=max(0.001,baseline*1.8);
-      BASE_FOR_SCORE=max(0.001,baseline*1.4);
+#if ZOOM_SPECTRUM
+  zoom.push(o.idx,tremor);
+#endif
+#if CNN_CLASSIFIER
+  cnnIn[o.idx*3]=cnnQuant(o.ax);
+  cnnIn[o.idx*3+1]=cnnQuant(o.ay);
+  cnnIn[o.idx*3+2]=cnnQuant(o.az);
+#endif
+
+  if(calibStartReq){
+    calibStartReq=false;
+    calib.start();
+    calibrationMode=true;
+  }
+  if(calibrationMode){
+    if(calib.push(fabs(tremor))){
+      double baseline=calib.baseline;
+      live.cfg.noiseFloor=max(0.001,baseline*1.8);
+      live.cfg.baseForScore=max(0.001,baseline*1.4);
+      shadow.cfg.noiseFloor=live.cfg.noiseFloor*shadowNfScale;
+      shadow.cfg.baseForScore=live.cfg.baseForScore;
 
       sendCalibrated(baseline);
 
@@ -361,17 +1531,60 @@ void loop(){
     }
   }
 
-  if(winIdx>=WINDOW){
-    double P1=0,P2=0,P3=0;
-    for(double f:band1) P1+=goertzel(windowBuf,WINDOW,f,SAMPLE_RATE);
-    for(double f:band2) P2+=goertzel(windowBuf,WINDOW,f,SAMPLE_RATE);
-    for(double f:band3) P3+=goertzel(windowBuf,WINDOW,f,SAMPLE_RATE);
-
-    P1/=3; P2/=3; P3/=3;
+  if(closed){
+    winStamp.t=devClock.seconds(millis());
+    winStamp.seq=winSeq++;
+    if(w.gated){
+      sendGated(w.volRms,w.volRatio,w.meanNorm);
+#if WINDOW_LOG
+      wlogAppend(w,w.type,0);
+#endif
+    } else {
+      classify(w);
+      sendBandsCSV(w.P1,w.P2,w.P3,w.meanNorm);
+#if ZOOM_SPECTRUM
+      zoomReady=true;
+#endif
+    }
 
-    classify(P1,P2,P3,meanNorm);
-    sendBandsCSV(P1,P2,P3,meanNorm);
+#if CNN_CLASSIFIER
+    cnnClassify();
+    modelSwap();
+#endif
+
+    sendQuality(w.rejWindow,w.rejTotal,w.spikeMaxCyc);
+
+#if BLACKBOX
+    bool episode=!w.gated && w.score>=BB_EPISODE_SCORE &&
+                 (!strcmp(w.type,"Parkinsonian") || !strcmp(w.type,"Essential") ||
+                  !strcmp(w.type,"Physiological"));
+    if(episode && !bbEpisode) bbTrigger(BB_EPISODE);
+    bbEpisode=episode;
+#endif
+
+    if(shadowOn && shadowClosed && shadowStats.window(w,sw))
+      sendShadow(w,sw,ShadowStats::agrees(w,sw));
+    tests.window(w.gated,w.P1,w.P2,w.P3,w.score,w.meanNorm);
+    if(tests.finished() && !testsReported){
+      buildTestsJson();
+      sendTests();
+      testsReported=true;
+    }
+    if(testsAbortReq){ tests.abort(); testsAbortReq=false; }
+    if(testsStartReq){
+      tests.start(testsPending);
+      testsStartReq=false;
+      testsReported=false;
+      sendPhase();
+    }
 
-    winIdx=0;
+    if(shadowStopReq){ shadowOn=false; shadowStopReq=false; }
+    if(shadowStartReq){
+      shadow.init(shadowPending);
+      shadowOn=true;
+      shadowStartReq=false;
+      shadowStats.start();
+    }
+    cycLive=cycShadow=0;
   }
 }
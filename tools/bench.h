@@ -0,0 +1,107 @@
+#pragma once
+// Shared by the host benchmarks in tools/: a heap allocation counter, stage
+// timing over repeated trials, and the report, as a table or as the JSON
+// that tools/benchdb.py stores.
+//
+//   {"suite":"stages","unit":"sample","trials":9,"stages":[
+//     {"stage":"biquad","ns":4.1,"spread":0.012,"cycles":11.8,"allocs":0,"bytes":0},...]}
+//
+// ns and cycles are per unit (median over the trials), spread is the trials'
+// median absolute deviation over the median, allocs and bytes are per unit.
+// cycles is the x86 time-stamp counter (null elsewhere), so it only
+// compares within one host. Defines the global operator new: include it in
+// one translation unit only.
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <new>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_TSC() __rdtsc()
+#else
+#define BENCH_TSC() 0ull
+#endif
+
+// ----------------------- allocation counter -----------------------
+static uint64_t g_allocs=0;
+void *operator new(size_t n){ g_allocs++; void *p=malloc(n?n:1); if(!p) throw std::bad_alloc(); return p; }
+void *operator new[](size_t n){ g_allocs++; void *p=malloc(n?n:1); if(!p) throw std::bad_alloc(); return p; }
+void operator delete(void *p) noexcept { free(p); }
+void operator delete[](void *p) noexcept { free(p); }
+void operator delete(void *p,size_t) noexcept { free(p); }
+void operator delete[](void *p,size_t) noexcept { free(p); }
+
+// ----------------------- stages -----------------------
+struct StageResult {
+  const char *stage;
+  double ns,spread,cycles,allocs,bytes;
+};
+
+const int BENCH_TRIALS = 9;
+const double BENCH_TRIAL_NS = 20e6;     // each trial runs for at least 20 ms
+
+static double median(double *v,int n){
+  std::sort(v,v+n);
+  return n%2?v[n/2]:(v[n/2-1]+v[n/2])/2;
+}
+
+// fn() processes `units` units (samples, windows) per call. bytes is what
+// one call puts on the wire, when the stage produces output.
+template<typename F>
+StageResult benchStage(const char *stage,uint32_t units,F fn,double bytes=0){
+  fn();                                  // warm caches and lazy state
+  auto t0=std::chrono::steady_clock::now();
+  fn();
+  double once=std::chrono::duration<double,std::nano>(std::chrono::steady_clock::now()-t0).count();
+  int reps=once>0?(int)(BENCH_TRIAL_NS/once)+1:1000;
+
+  double ns[BENCH_TRIALS],cyc[BENCH_TRIALS],dev[BENCH_TRIALS];
+  uint64_t a0=g_allocs;
+  for(int t=0;t<BENCH_TRIALS;t++){
+    uint64_t c0=BENCH_TSC();
+    t0=std::chrono::steady_clock::now();
+    for(int r=0;r<reps;r++) fn();
+    double el=std::chrono::duration<double,std::nano>(std::chrono::steady_clock::now()-t0).count();
+    ns[t]=el/((double)reps*units);
+    cyc[t]=(double)(BENCH_TSC()-c0)/((double)reps*units);
+  }
+  uint64_t allocs=g_allocs-a0;
+  StageResult r;
+  r.stage=stage;
+  r.ns=median(ns,BENCH_TRIALS);
+  for(int t=0;t<BENCH_TRIALS;t++) dev[t]=fabs(ns[t]-r.ns);
+  r.spread=r.ns>0?median(dev,BENCH_TRIALS)/r.ns:0;
+  r.cycles=median(cyc,BENCH_TRIALS);
+  r.allocs=(double)allocs/((double)BENCH_TRIALS*reps*units);
+  r.bytes=bytes/units;
+  return r;
+}
+
+// ----------------------- report -----------------------
+static bool benchJson(int argc,char **argv){
+  for(int i=1;i<argc;i++) if(!strcmp(argv[i],"--json")) return true;
+  return false;
+}
+
+static void benchReport(const char *suite,const char *unit,const StageResult *r,int n,bool json){
+  if(json){
+    printf("{\"suite\":\"%s\",\"unit\":\"%s\",\"trials\":%d,\"stages\":[",suite,unit,BENCH_TRIALS);
+    for(int i=0;i<n;i++){
+      printf("%s\n {\"stage\":\"%s\",\"ns\":%.4g,\"spread\":%.4g,",i?",":"",r[i].stage,r[i].ns,r[i].spread);
+      if(BENCH_TSC()) printf("\"cycles\":%.4g,",r[i].cycles);
+      else printf("\"cycles\":null,");
+      printf("\"allocs\":%.4g,\"bytes\":%.4g}",r[i].allocs,r[i].bytes);
+    }
+    printf("]}\n");
+    return;
+  }
+  char per[24];
+  snprintf(per,sizeof(per),"ns/%s",unit);
+  printf("%-24s %10s %7s %10s %8s %8s\n","stage",per,"spread","cycles","allocs","bytes");
+  for(int i=0;i<n;i++)
+    printf("%-24s %10.1f %6.1f%% %10.1f %8.3g %8.1f\n",
+           r[i].stage,r[i].ns,100*r[i].spread,r[i].cycles,r[i].allocs,r[i].bytes);
+}
@@ -0,0 +1,105 @@
+// Host benchmark / cross-check for the spectral engines in include/spectrum.h.
+//
+//   g++ -O2 -std=c++17 -Iinclude tools/bench_spectrum.cpp -o bench_spectrum
+//   ./bench_spectrum [--json]
+//
+// Checks the plain Chirp-Z against goertzel() at every bin, and the
+// decimated zoom the firmware runs (ZoomSpectrum: 61 bins at 0.2 Hz over
+// 3-15 Hz) against the one-sided DFT of the same delayed window. Then
+// times one 128-sample window through: the 9 band bins used by the
+// firmware, the plain 121-bin CZT, the zoom (zoom_61: every sample pushed
+// plus the transform; zoom_61_run: the transform alone, the part left at
+// window close), goertzel() at 121 bins, and a full 512-point FFT (the
+// size needed for ~0.1 Hz bins over 0-25 Hz).
+// On the device the zoom_61_run cost is reported per window in the "zoom"
+// event's "cyc" field. --json prints the report tools/benchdb.py records
+// (see tools/bench.h); the cross-checks then go to stderr.
+#include <complex>
+#include "bench.h"
+#include "spectrum.h"
+
+const double FS = 50.0;
+const uint16_t N = 128;
+const uint16_t BINS = 121;
+const uint16_t ZBINS = 61;
+const uint16_t WARM = 64;               // zoom filter history before the window
+
+static volatile double sink;
+
+int main(int argc,char **argv){
+  bool json=benchJson(argc,argv);
+  FILE *out=json?stderr:stdout;
+  double x[N];
+  float xf[N];
+  srand(1);
+  for(int i=0;i<N;i++){
+    x[i]=0.8*sin(2*M_PI*5.3*i/FS)+0.3*sin(2*M_PI*9.1*i/FS)+0.05*(rand()/(double)RAND_MAX-0.5);
+    xf[i]=(float)x[i];
+  }
+
+  static Czt<N,BINS> czt;
+  czt.init(3.0,0.1,FS);
+  float pw[BINS];
+  czt.compute(xf,pw);
+
+  double maxRel=0,peakRef=0;
+  for(int k=0;k<BINS;k++){
+    double g=goertzel(x,N,czt.freq(k),FS);
+    if(g>peakRef) peakRef=g;
+  }
+  for(int k=0;k<BINS;k++){
+    double g=goertzel(x,N,czt.freq(k),FS);
+    double rel=fabs(pw[k]-g)/peakRef;
+    if(rel>maxRel) maxRel=rel;
+  }
+  fprintf(out,"czt vs goertzel: max |err| / peak = %.2e  %s\n",maxRel,maxRel<1e-4?"OK":"FAIL");
+
+  // Zoom: tones, so the one-sided reference has a closed form. It differs
+  // from goertzel() by the negative-frequency leakage the filter removes.
+  const double tf[3]={5.3,9.1,13.7}, ta[3]={0.8,0.3,0.1};
+  static float zx[WARM+N];
+  for(int i=0;i<WARM+N;i++){
+    double v=0;
+    for(int t=0;t<3;t++) v+=ta[t]*sin(2*M_PI*tf[t]*i/FS);
+    zx[i]=(float)v;
+  }
+  static ZoomSpectrum<N,ZBINS> zoom;
+  zoom.init(3.0,0.2,FS);
+  for(int i=0;i<WARM+N;i++) zoom.push((i+N-WARM)%N,zx[i]);
+  float zp[ZBINS];
+  zoom.run(zp);
+  const int s0=WARM-zoom.DELAY;
+  double ref[ZBINS],zPeak=0,zRel=0;
+  for(int k=0;k<ZBINS;k++){
+    std::complex<double> X=0;
+    for(int n=0;n<N;n++)
+      for(int t=0;t<3;t++)
+        X+=ta[t]/2*std::polar(1.0,2*M_PI*(tf[t]*(s0+n)-zoom.freq(k)*n)/FS-M_PI/2);
+    ref[k]=std::norm(X);
+    if(ref[k]>zPeak) zPeak=ref[k];
+  }
+  for(int k=0;k<ZBINS;k++){
+    double rel=fabs(zp[k]-ref[k])/zPeak;
+    if(rel>zRel) zRel=rel;
+  }
+  fprintf(out,"zoom vs one-sided DFT: max |err| / peak = %.2e  %s\n",zRel,zRel<1e-2?"OK":"FAIL");
+
+  const double bands[9]={4,5,6,6,7,8,8,10,12};
+  StageResult r[6];
+  r[0]=benchStage("goertzel_bands9",1,[&]{ double s=0; for(double f:bands) s+=goertzel(x,N,f,FS); sink=s; });
+  r[1]=benchStage("czt_121",1,[&]{ czt.compute(xf,pw); sink=pw[0]; });
+  r[2]=benchStage("zoom_61",1,[&]{ for(int i=0;i<N;i++) zoom.push(i,xf[i]); zoom.run(zp); sink=zp[0]; });
+  r[3]=benchStage("zoom_61_run",1,[&]{ zoom.run(zp); sink=zp[0]; });
+  r[4]=benchStage("goertzel_121",1,[&]{ double s=0; for(int k=0;k<BINS;k++) s+=goertzel(x,N,czt.freq(k),FS); sink=s; });
+
+  static Czt<384,129> full;   // L = 512; only its FFT kernel is used
+  full.init(0,1,FS);
+  static float fb[2*512];
+  r[5]=benchStage("fft_512",1,[&]{
+    for(int i=0;i<512;i++){ fb[2*i]=i<N?xf[i]:0; fb[2*i+1]=0; }
+    full.fft(fb,false); sink=fb[2];
+  });
+
+  benchReport("spectrum","window",r,6,json);
+  return maxRel<1e-4 && zRel<1e-2?0:1;
+}
@@ -0,0 +1,204 @@
+// Host benchmark of the firmware's per-sample chain, stage by stage.
+//
+//   g++ -O2 -std=c++17 -Iinclude tools/bench_stages.cpp -o bench_stages
+//   ./bench_stages [--json]
+//
+// Feeds WINDOW*32 synthetic IMU samples (include/synth.h) through each stage
+// of loop() in isolation and reports ns, cycles, heap allocations and bytes
+// on the wire per sample. Stages that run once a window (goertzel_window,
+// the zoom transform) are amortised over its WINDOW samples.
+//   hampel           3-axis spike rejection
+//   biquad_hpf       tremor high-pass, 3 channels (SosBank)
+//   biquad_bpf       the three band-pass Biquads in front of the envelopes
+//   goertzel_stream  9 band bins, one GoertzelBin step each (STREAM_GOERTZEL 1)
+//   goertzel_window  9 goertzel() calls on the closed window (STREAM_GOERTZEL 0)
+//   pipeline         Pipeline::push, everything above plus MA and classify
+//   wflc             adaptive tracker
+//   desa             three DESA-2 envelopes
+//   czt_zoom         61-bin zoom spectrum (ZOOM_SPECTRUM): every sample into
+//                    ZoomSpectrum, its transform once a window
+//   sse              events at the firmware's rates (sample every 2nd, track
+//                    and env every 10th, bands_csv/bands/quality per window)
+//                    published on the output bus and framed by an SSE sink
+//                    as AsyncEventSource does; bytes is what goes on the wire
+// --json prints the report tools/benchdb.py records (see tools/bench.h).
+#include "bench.h"
+#include "pipeline.h"
+#include "wflc.h"
+#include "teager.h"
+#include "synth.h"
+#include "bus.h"
+#include "events.h"
+
+const double FS = 50.0;
+const uint32_t N = WINDOW*32;
+const uint16_t ZOOM_BINS = 61;
+
+static float ax[N],ay[N],az[N];       // raw input
+static float sig[N];                  // dominant-axis residual (tracker, envelopes)
+static double tremor[N];              // pipeline output feeding the band bins
+static float tremorF[N];
+static volatile double sink;
+
+int main(int argc,char **argv){
+  bool json=benchJson(argc,argv);
+  static SynthImu synth;
+  synth.swayAmp=0.02f;
+  for(uint32_t i=0;i<N;i++){
+    float acc[3],gyro[3];
+    synth.next(FS,acc,gyro);
+    // a spike every ~200 samples, so the Hampel path is not all fast path
+    if(synth.uniform()<0.005f) acc[i%3]+=4;
+    ax[i]=acc[0]; ay[i]=acc[1]; az[i]=acc[2];
+  }
+  PipelineConfig cfg;
+  cfg.fs=FS;
+  {
+    static Pipeline p;
+    p.init(cfg);
+    float pow3[3]={0,0,0};
+    for(uint32_t i=0;i<N;i++){
+      SampleOut o; WindowOut w;
+      p.push(ax[i],ay[i],az[i],o,w);
+      tremor[i]=o.tremor; tremorF[i]=o.tremor;
+      pow3[0]+=0.02f*(o.dx*o.dx-pow3[0]);
+      pow3[1]+=0.02f*(o.dy*o.dy-pow3[1]);
+      pow3[2]+=0.02f*(o.dz*o.dz-pow3[2]);
+      uint8_t a=pow3[0]>=pow3[1]?(pow3[0]>=pow3[2]?0:2):(pow3[1]>=pow3[2]?1:2);
+      sig[i]=a==0?o.dx:a==1?o.dy:o.dz;
+    }
+  }
+
+  StageResult r[12];
+  int n=0;
+
+  static Hampel<HAMPEL_LEN> hx,hy,hz;
+  r[n++]=benchStage("hampel",N,[&]{
+    float s=0;
+    for(uint32_t i=0;i<N;i++) s+=hx.process(ax[i])+hy.process(ay[i])+hz.process(az[i]);
+    sink=s;
+  });
+
+  static SosBank<3,1> hpf;
+  hpf.sec[0].initHPF(FS,cfg.hpfHz);
+  hpf.reset();
+  r[n++]=benchStage("biquad_hpf",N,[&]{
+    double s=0;
+    for(uint32_t i=0;i<N;i++){ double v[3]={ax[i],ay[i],az[i]}; hpf.process(v); s+=v[0]; }
+    sink=s;
+  });
+
+  static Biquad bpf[3];
+  bpf[0].initBPF(FS,4,6); bpf[1].initBPF(FS,6,8); bpf[2].initBPF(FS,8,12);
+  r[n++]=benchStage("biquad_bpf",N,[&]{
+    double s=0;
+    for(uint32_t i=0;i<N;i++) s+=bpf[0].process(sig[i])+bpf[1].process(sig[i])+bpf[2].process(sig[i]);
+    sink=s;
+  });
+
+  static GoertzelBin gb[9];
+  for(int k=0;k<3;k++){
+    gb[k].init(cfg.band1[k],FS); gb[3+k].init(cfg.band2[k],FS); gb[6+k].init(cfg.band3[k],FS);
+  }
+  r[n++]=benchStage("goertzel_stream",N,[&]{
+    double s=0;
+    for(uint32_t i=0;i<N;i++){
+      for(auto &g:gb) g.push(tremor[i]);
+      if(i%WINDOW==WINDOW-1) for(auto &g:gb){ s+=g.power(); g.reset(); }
+    }
+    sink=s;
+  });
+
+  r[n++]=benchStage("goertzel_window",N,[&]{
+    double s=0;
+    for(uint32_t w=0;w<N;w+=WINDOW){
+      for(double f:cfg.band1) s+=goertzel(tremor+w,WINDOW,f,FS);
+      for(double f:cfg.band2) s+=goertzel(tremor+w,WINDOW,f,FS);
+      for(double f:cfg.band3) s+=goertzel(tremor+w,WINDOW,f,FS);
+    }
+    sink=s;
+  });
+
+  static Pipeline live;
+  live.init(cfg);
+  r[n++]=benchStage("pipeline",N,[&]{
+    double s=0;
+    for(uint32_t i=0;i<N;i++){
+      SampleOut o; WindowOut w;
+      if(live.push(ax[i],ay[i],az[i],o,w)) s+=w.score;
+      s+=o.tremor;
+    }
+    sink=s;
+  });
+
+  static Wflc<1> tracker;
+  tracker.init(6.0,3.0,15.0,FS);
+  r[n++]=benchStage("wflc",N,[&]{
+    for(uint32_t i=0;i<N;i++) tracker.push(sig[i]);
+    sink=tracker.freq(FS);
+  });
+
+  static Desa desa[3];
+  r[n++]=benchStage("desa",N,[&]{
+    for(uint32_t i=0;i<N;i++){ desa[0].push(sig[i]); desa[1].push(sig[i]*0.5f); desa[2].push(sig[i]*0.25f); }
+    sink=desa[0].amplitude()+desa[1].amplitude()+desa[2].amplitude();
+  });
+
+  static ZoomSpectrum<WINDOW,ZOOM_BINS> zoom;
+  zoom.init(3.0,0.2,FS);
+  static float zoomPow[ZOOM_BINS];
+  r[n++]=benchStage("czt_zoom",N,[&]{
+    for(uint32_t i=0;i<N;i++){
+      zoom.push(i%WINDOW,tremorF[i]);
+      if(i%WINDOW==WINDOW-1) zoom.run(zoomPow);
+    }
+    sink=zoomPow[15];
+  });
+
+  // Formats mirror sendSample/sendTrack/sendEnvelope/sendBandsCSV in
+  // src/main.cpp; the window events use its include/events.h formatters.
+  static Bus<8192> bus;
+  int8_t sse=bus.addSink("sse",BUS_ALL);
+  static char frame[1600];
+  static double wire=0;
+  auto drain=[&]{
+    const BusMsg *m;
+    while((m=bus.peek(sse))){
+      wire+=busSseFrame(frame,sizeof(frame),m);
+      bus.done(sse);
+    }
+  };
+  auto events=[&]{
+    for(uint32_t i=0;i<N;i++){
+      char *m;
+      if(i%2==1 && (m=bus.reserve(T_SAMPLE,120)))
+        bus.commit(snprintf(m,120,"{\"ax\":%.4f,\"ay\":%.4f,\"az\":%.4f}",ax[i],ay[i],az[i]));
+      if(i%10==9){
+        if((m=bus.reserve(T_TRACK,64)))
+          bus.commit(snprintf(m,64,"{\"f\":%.2f,\"a\":%.4f}",6.03,sig[i]));
+        if((m=bus.reserve(T_ENV,160)))
+          bus.commit(snprintf(m,160,"{\"a1\":%.4f,\"a2\":%.4f,\"a3\":%.4f,\"f1\":%.2f,\"f2\":%.2f,\"f3\":%.2f}",
+                              sig[i],sig[i]*0.5,sig[i]*0.25,5.1,6.9,9.8));
+      }
+      if(i%WINDOW==WINDOW-1){
+        WindowStamp st;
+        st.t=i/FS; st.seq=i/WINDOW;
+        double P1=tremor[i]*tremor[i],P2=P1*0.5,P3=P1*0.1;
+        if((m=bus.reserve(T_BANDS_CSV,128)))
+          bus.commit(snprintf(m,128,"%.6f,%.6f,%.6f,%.4f",P1,P2,P3,1.0123));
+        if((m=bus.reserve(T_BANDS,EV_BANDS_BYTES)))
+          bus.commit(fmtBands(m,EV_BANDS_BYTES,st,P1,P2,P3,"Parkinsonian",0.8,4.2,1.0123,0.0));
+        if((m=bus.reserve(T_QUALITY,EV_QUALITY_BYTES)))
+          bus.commit(fmtQuality(m,EV_QUALITY_BYTES,st,0,3,0));
+      }
+      drain();
+    }
+  };
+  wire=0;
+  events();
+  double perCall=wire;
+  r[n++]=benchStage("sse",N,events,perCall);
+
+  benchReport("stages","sample",r,n,json);
+  return 0;
+}
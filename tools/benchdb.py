@@ -0,0 +1,323 @@
+"""
+Benchmark results database: keeps the host benchmarks' per-stage results
+for every commit and flags stages that got slower.
+
+Usage:
+  # Build and run tools/bench_*.cpp (--json), record them under HEAD, check
+  python tools/benchdb.py run                       # all suites, 3 runs each
+  python tools/benchdb.py run --suite stages --repeat 5
+
+  # Record reports produced elsewhere (another machine, CI artefacts)
+  python tools/benchdb.py add stages.json --commit 1a2b3c4 --host ci-x86
+
+  # Compare a commit (default: the latest recorded) with the rolling baseline
+  python tools/benchdb.py check --window 10 --k 3 --min-rel 0.05
+
+  # One stage over time
+  python tools/benchdb.py history stages sse --metric bytes
+
+Reports are the JSON of tools/bench.h: a suite, and per stage ns, cycles,
+allocs and bytes per unit, plus the spread of ns over the bench's trials.
+Runs are stored in .benchdb/results.sqlite (--db) with the commit, whether
+the tree was dirty, and a host key (machine, CPU, compiler). Results are
+only ever compared with runs from the same host key.
+
+Regression test, per suite, stage and metric:
+  baseline  the last --window clean commits before the one checked, on the
+            same host. The centre is the median of their per-commit medians.
+  noise     1.4826 * MAD of every baseline run (run-to-run noise), or the
+            median in-run spread times the centre if that is larger
+  flag      current - centre > max(k * noise, min_rel * centre)
+allocs and bytes are deterministic, so any increase above 0.1% is flagged.
+With fewer than 3 baseline runs only min_rel applies. `check` and `run`
+exit with status 1 when something regressed.
+"""
+
+import argparse
+import json
+import os
+import platform
+import sqlite3
+import statistics
+import subprocess
+import sys
+import time
+from pathlib import Path
+from typing import Dict, List, Optional, Tuple
+
+ROOT = Path(__file__).resolve().parent.parent
+DEFAULT_DB = ROOT / ".benchdb" / "results.sqlite"
+SUITES = {"stages": "tools/bench_stages.cpp", "spectrum": "tools/bench_spectrum.cpp"}
+METRICS = ("ns", "cycles", "allocs", "bytes")
+EXACT = ("allocs", "bytes")              # deterministic: no noise allowance
+EXACT_REL = 0.001
+
+SCHEMA = """
+CREATE TABLE IF NOT EXISTS runs(
+  id INTEGER PRIMARY KEY, ts REAL, commit_id TEXT, dirty INTEGER, subject TEXT,
+  host TEXT, suite TEXT, unit TEXT);
+CREATE TABLE IF NOT EXISTS results(
+  run INTEGER REFERENCES runs(id), stage TEXT, metric TEXT, value REAL, spread REAL,
+  PRIMARY KEY(run, stage, metric));
+CREATE INDEX IF NOT EXISTS runs_key ON runs(host, suite, commit_id);
+"""
+
+
+def open_db(path: str) -> sqlite3.Connection:
+    Path(path).parent.mkdir(parents=True, exist_ok=True)
+    db = sqlite3.connect(path)
+    db.executescript(SCHEMA)
+    return db
+
+
+# ──────────────────────────────────────────────
+# Provenance
+# ──────────────────────────────────────────────
+
+def _git(*args: str) -> str:
+    return subprocess.run(["git", *args], cwd=ROOT, capture_output=True, text=True).stdout.strip()
+
+
+def git_state() -> Tuple[str, bool, str]:
+    commit = _git("rev-parse", "--short=12", "HEAD") or "unknown"
+    dirty = bool(_git("status", "--porcelain", "--untracked-files=no"))
+    return commit, dirty, _git("log", "-1", "--format=%s")
+
+
+def host_key(cxx: Optional[str] = None) -> str:
+    cpu = platform.processor() or platform.machine()
+    try:
+        with open("/proc/cpuinfo") as f:
+            for line in f:
+                if line.startswith("model name"):
+                    cpu = line.split(":", 1)[1].strip()
+                    break
+    except OSError:
+        pass
+    key = f"{platform.node()}|{cpu}"
+    if cxx:
+        out = subprocess.run([cxx, "--version"], capture_output=True, text=True).stdout
+        key += "|" + (out.splitlines()[0] if out else cxx)
+    return key
+
+
+def record(db: sqlite3.Connection, report: dict, commit: str, dirty: bool, subject: str,
+           host: str) -> int:
+    cur = db.execute(
+        "INSERT INTO runs(ts, commit_id, dirty, subject, host, suite, unit) VALUES(?,?,?,?,?,?,?)",
+        (time.time(), commit, int(dirty), subject, host, report["suite"], report.get("unit", "")))
+    run = cur.lastrowid
+    for st in report["stages"]:
+        for m in METRICS:
+            v = st.get(m)
+            if v is not None:
+                db.execute("INSERT INTO results VALUES(?,?,?,?,?)",
+                           (run, st["stage"], m, float(v), st.get("spread", 0.0) if m == "ns" else 0.0))
+    db.commit()
+    return run
+
+
+# ──────────────────────────────────────────────
+# Running the benches
+# ──────────────────────────────────────────────
+
+def build(suite: str, cxx: str, flags: List[str], outdir: Path) -> Path:
+    outdir.mkdir(parents=True, exist_ok=True)
+    exe = outdir / f"bench_{suite}"
+    cmd = [cxx, *flags, "-std=c++17", "-Iinclude", SUITES[suite], "-o", str(exe)]
+    r = subprocess.run(cmd, cwd=ROOT, capture_output=True, text=True)
+    if r.returncode:
+        sys.exit(f"build failed: {' '.join(cmd)}\n{r.stderr}")
+    return exe
+
+
+def run_bench(exe: Path) -> dict:
+    r = subprocess.run([str(exe), "--json"], cwd=ROOT, capture_output=True, text=True)
+    if r.returncode:
+        sys.exit(f"{exe.name} failed ({r.returncode}):\n{r.stderr}{r.stdout}")
+    return json.loads(r.stdout)
+
+
+# ──────────────────────────────────────────────
+# Regression check
+# ──────────────────────────────────────────────
+
+def _mad(xs: List[float]) -> float:
+    m = statistics.median(xs)
+    return statistics.median(abs(x - m) for x in xs)
+
+
+def _values(db: sqlite3.Connection, host: str, suite: str, commit: str,
+            dirty: Optional[bool]) -> Dict[Tuple[str, str], List[Tuple[float, float]]]:
+    q = ("SELECT r.stage, r.metric, r.value, r.spread FROM results r JOIN runs u ON r.run = u.id "
+         "WHERE u.host = ? AND u.suite = ? AND u.commit_id = ?")
+    args = [host, suite, commit]
+    if dirty is not None:
+        q += " AND u.dirty = ?"
+        args.append(int(dirty))
+    out: Dict[Tuple[str, str], List[Tuple[float, float]]] = {}
+    for stage, metric, v, sp in db.execute(q, args):
+        out.setdefault((stage, metric), []).append((v, sp))
+    return out
+
+
+def check(db: sqlite3.Connection, commit: Optional[str], window: int, k: float,
+          min_rel: float, out=sys.stdout) -> int:
+    if commit is None:
+        row = db.execute("SELECT commit_id, dirty, host FROM runs ORDER BY id DESC LIMIT 1").fetchone()
+        if row is None:
+            print("no runs recorded", file=out)
+            return 0
+        commit, dirty, host = row[0], bool(row[1]), row[2]
+    else:
+        row = db.execute("SELECT commit_id, dirty, host FROM runs WHERE commit_id LIKE ? "
+                         "ORDER BY id DESC LIMIT 1", (commit + "%",)).fetchone()
+        if row is None:
+            sys.exit(f"no runs for commit {commit}")
+        commit, dirty, host = row[0], bool(row[1]), row[2]
+
+    suites = [s for (s,) in db.execute(
+        "SELECT DISTINCT suite FROM runs WHERE commit_id = ? AND dirty = ? AND host = ? ORDER BY suite",
+        (commit, int(dirty), host))]
+    print(f"{commit}{'+dirty' if dirty else ''} on {host}", file=out)
+    print(f"{'suite':<10} {'stage':<18} {'metric':<7} {'baseline':>11} {'current':>11} "
+          f"{'delta':>8} {'limit':>7}  status", file=out)
+    regressed = 0
+    for suite in suites:
+        # the window: clean commits first seen before this one, newest first
+        first = db.execute("SELECT MIN(id) FROM runs WHERE commit_id = ? AND dirty = ? AND host = ? "
+                           "AND suite = ?", (commit, int(dirty), host, suite)).fetchone()[0]
+        base_commits = [c for (c,) in db.execute(
+            "SELECT commit_id FROM runs WHERE host = ? AND suite = ? AND dirty = 0 AND commit_id != ? "
+            "AND id < ? GROUP BY commit_id ORDER BY MAX(id) DESC LIMIT ?",
+            (host, suite, commit, first, window))]
+        cur = _values(db, host, suite, commit, dirty)
+        base = [_values(db, host, suite, c, False) for c in base_commits]
+        for (stage, metric) in sorted(cur, key=lambda sm: (sm[0], METRICS.index(sm[1]))):
+            vals = [v for v, _ in cur[(stage, metric)]]
+            now = statistics.median(vals)
+            per_commit = [statistics.median(v for v, _ in b[(stage, metric)])
+                          for b in base if (stage, metric) in b]
+            runs = [p for b in base for p in b.get((stage, metric), [])]
+            if not per_commit:
+                if metric in EXACT and now == 0:
+                    continue
+                status, centre, limit = "new", None, None
+            else:
+                centre = statistics.median(per_commit)
+                if metric in EXACT:
+                    if now == 0 and centre == 0:
+                        continue
+                    limit = max(EXACT_REL * centre, 1e-9)
+                else:
+                    noise = 0.0
+                    if len(runs) >= 3:
+                        noise = max(1.4826 * _mad([v for v, _ in runs]),
+                                    statistics.median(sp for _, sp in runs) * centre)
+                    limit = max(k * noise, min_rel * centre)
+                if now - centre > limit:
+                    status = "REGRESSED"
+                    regressed += 1
+                elif centre - now > limit:
+                    status = "improved"
+                else:
+                    status = "ok"
+                if len(runs) < 3 and metric not in EXACT:
+                    status += " (few)"
+            delta = f"{100 * (now - centre) / centre:+.1f}%" if centre else "-"
+            lim = f"{100 * limit / centre:.1f}%" if centre else "-"
+            print(f"{suite:<10} {stage:<18} {metric:<7} "
+                  f"{'-' if centre is None else f'{centre:.4g}':>11} {now:>11.4g} "
+                  f"{delta:>8} {lim:>7}  {status}", file=out)
+        print(f"{'':<10} baseline: {len(base_commits)} commit(s)", file=out)
+    if regressed:
+        print(f"{regressed} regression(s)", file=out)
+    return 1 if regressed else 0
+
+
+def history(db: sqlite3.Connection, suite: str, stage: str, metric: str, last: int,
+            host: Optional[str]) -> None:
+    q = ("SELECT u.commit_id, u.dirty, MIN(u.ts), u.subject, COUNT(*), GROUP_CONCAT(r.value) "
+         "FROM results r JOIN runs u ON r.run = u.id "
+         "WHERE u.suite = ? AND r.stage = ? AND r.metric = ?")
+    args = [suite, stage, metric]
+    if host:
+        q += " AND u.host = ?"
+        args.append(host)
+    q += " GROUP BY u.commit_id, u.dirty ORDER BY MIN(u.id) DESC LIMIT ?"
+    args.append(last)
+    rows = db.execute(q, args).fetchall()
+    for c, dirty, ts, subj, n, vals in reversed(rows):
+        v = statistics.median(float(x) for x in vals.split(","))
+        print(f"{c}{'+' if dirty else ' '} {time.strftime('%Y-%m-%d %H:%M', time.localtime(ts))} "
+              f"{v:>11.4g}  n={n:<3} {subj[:60]}")
+
+
+# ──────────────────────────────────────────────
+# CLI
+# ──────────────────────────────────────────────
+
+def main() -> None:
+    ap = argparse.ArgumentParser(description="Benchmark history and regression checks")
+    ap.add_argument("--db", default=str(DEFAULT_DB))
+    sub = ap.add_subparsers(dest="cmd", required=True)
+
+    def check_args(p):
+        p.add_argument("--window", type=int, default=10, help="baseline commits")
+        p.add_argument("--k", type=float, default=3.0, help="noise multiples before flagging")
+        p.add_argument("--min-rel", type=float, default=0.05, help="smallest change flagged")
+
+    p = sub.add_parser("run", help="build, run and record the host benches, then check")
+    p.add_argument("--suite", choices=[*SUITES, "all"], default="all")
+    p.add_argument("--repeat", type=int, default=3)
+    p.add_argument("--cxx", default=os.environ.get("CXX", "g++"))
+    p.add_argument("--flags", default="-O2", help="compiler flags")
+    p.add_argument("--no-check", action="store_true")
+    check_args(p)
+
+    p = sub.add_parser("add", help="record JSON reports (- for stdin)")
+    p.add_argument("files", nargs="+")
+    p.add_argument("--commit", help="default: HEAD")
+    p.add_argument("--host", help="default: this machine")
+
+    p = sub.add_parser("check", help="compare a commit with the rolling baseline")
+    p.add_argument("--commit", help="default: the latest recorded run")
+    check_args(p)
+
+    p = sub.add_parser("history", help="one stage's results per commit")
+    p.add_argument("suite")
+    p.add_argument("stage")
+    p.add_argument("--metric", choices=METRICS, default="ns")
+    p.add_argument("--last", type=int, default=30)
+    p.add_argument("--host")
+
+    a = ap.parse_args()
+    db = open_db(a.db)
+    if a.cmd == "run":
+        commit, dirty, subject = git_state()
+        host = host_key(a.cxx)
+        suites = list(SUITES) if a.suite == "all" else [a.suite]
+        for s in suites:
+            exe = build(s, a.cxx, a.flags.split(), Path(a.db).parent / "bin")
+            for i in range(a.repeat):
+                record(db, run_bench(exe), commit, dirty, subject, host)
+                print(f"[BENCH] {s} {i + 1}/{a.repeat}", file=sys.stderr)
+        if not a.no_check:
+            sys.exit(check(db, None, a.window, a.k, a.min_rel))
+    elif a.cmd == "add":
+        commit, dirty, subject = git_state()
+        if a.commit:
+            commit, dirty, subject = a.commit, False, ""
+        host = a.host or host_key()
+        for f in a.files:
+            report = json.load(sys.stdin if f == "-" else open(f))
+            for r in report if isinstance(report, list) else [report]:
+                record(db, r, commit, dirty, subject, host)
+    elif a.cmd == "check":
+        sys.exit(check(db, a.commit, a.window, a.k, a.min_rel))
+    else:
+        history(db, a.suite, a.stage, a.metric, a.last, a.host)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,100 @@
+// Host capture of what the firmware serves on /events, for gateway tests.
+//
+//   make -C tools
+//   ./tools/build/capture_events [windows] [startMs] [--hello <id>] > events.sse
+//
+// Runs synthetic IMU samples (include/synth.h) through Pipeline and
+// publishes sample, bands_csv, bands, gated and quality the way loop()
+// does: samples every 2nd, window events stamped by DevClock at each close,
+// formatted by include/events.h into the output bus and framed by
+// busSseFrame() as the SSE and push sinks frame them. The tremor runs for
+// the first two thirds of the windows, then a 0.5 Hz sway takes over so
+// the voluntary-movement gate fires. startMs (default 4294950000) is the
+// device's millis() at the first sample, so millis() wraps mid-capture.
+// --hello writes the push hello first, as a device pushing to the gateway
+// does. Personalisation is off (personal 0), as on a fresh device.
+//
+// ai_dashboard/backend/gateway/testdata/events.sse is this tool's output
+// with the defaults.
+#include <stdlib.h>
+#include <string.h>
+#include "pipeline.h"
+#include "synth.h"
+#include "bus.h"
+#include "events.h"
+
+const float FS = 50.0f;
+
+static Bus<8192> bus;
+static int8_t sse;
+static char frame[1600];
+
+static void drain(){
+  const BusMsg *m;
+  while((m=bus.peek(sse))){
+    fwrite(frame,1,busSseFrame(frame,sizeof(frame),m),stdout);
+    bus.done(sse);
+  }
+}
+
+int main(int argc,char **argv){
+  uint32_t windows=12, ms=4294950000u;
+  const char *hello=nullptr;
+  int pos=0;
+  for(int i=1;i<argc;i++){
+    if(!strcmp(argv[i],"--hello") && i+1<argc){ hello=argv[++i]; continue; }
+    char *end;
+    unsigned long v=strtoul(argv[i],&end,10);
+    if(*end || pos>1 || (pos==0 && !v)){
+      fprintf(stderr,"usage: %s [windows] [startMs] [--hello <id>]\n",argv[0]);
+      return 2;
+    }
+    if(pos++==0) windows=v; else ms=v;
+  }
+
+  if(hello){
+    int n=busHello(frame,sizeof(frame),hello);
+    fwrite(frame,1,n,stdout);
+  }
+  sse=bus.addSink("sse",BUS_ALL);
+
+  static Pipeline live;
+  PipelineConfig cfg;
+  live.init(cfg);
+  SynthImu synth;
+  synth.amp=0.3f;
+  DevClock clock;
+  WindowStamp st;
+  uint32_t seq=0, closedN=0, limiter=0;
+  for(uint32_t n=0;closedN<windows;n++,ms+=1000/(uint32_t)FS){
+    if(closedN==windows*2/3){ synth.amp=0.01f; synth.swayAmp=0.5f; }
+    float acc[3],gyro[3];
+    synth.next(FS,acc,gyro);
+    SampleOut o; WindowOut w;
+    bool closed=live.push(acc[0],acc[1],acc[2],o,w);
+    char *m;
+    if(++limiter>=2){
+      limiter=0;
+      if((m=bus.reserve(T_SAMPLE,120)))
+        bus.commit(snprintf(m,120,"{\"ax\":%.4f,\"ay\":%.4f,\"az\":%.4f}",o.dx,o.dy,o.dz));
+    }
+    if(closed){
+      closedN++;
+      st.t=clock.seconds(ms);
+      st.seq=seq++;
+      if(w.gated){
+        if((m=bus.reserve(T_GATED,EV_GATED_BYTES)))
+          bus.commit(fmtGated(m,EV_GATED_BYTES,st,w.volRms,w.volRatio,w.meanNorm));
+      } else {
+        if((m=bus.reserve(T_BANDS,EV_BANDS_BYTES)))
+          bus.commit(fmtBands(m,EV_BANDS_BYTES,st,w.P1,w.P2,w.P3,w.type,w.conf,w.score,w.meanNorm,0.0));
+        if((m=bus.reserve(T_BANDS_CSV,128)))
+          bus.commit(snprintf(m,128,"%.6f,%.6f,%.6f,%.4f",w.P1,w.P2,w.P3,w.meanNorm));
+      }
+      if((m=bus.reserve(T_QUALITY,EV_QUALITY_BYTES)))
+        bus.commit(fmtQuality(m,EV_QUALITY_BYTES,st,w.rejWindow,w.rejTotal,w.spikeMaxCyc));
+    }
+    drain();
+  }
+  return 0;
+}
@@ -0,0 +1,59 @@
+// Host reference for the int8 CNN in include/cnn.h.
+//
+//   python tools/cnn_export.py ...      (writes include/cnn_model.h)
+//   g++ -O2 -std=c++17 -Iinclude tools/cnn_check.cpp -o cnn_check
+//   ./cnn_check              (compiled-in include/cnn_model.h)
+//   ./cnn_check model.bin    (flash blob from cnn_export.py --blob)
+//
+// Runs the exporter's self-test window through cnnRun() and compares every
+// logit with the exporter's integer reference. The firmware runs the same
+// check at boot, so a pass here means device, host and exporter agree.
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include "cnn.h"
+#include "cnn_model.h"
+#include "modelblob.h"
+
+int main(int argc,char **argv){
+  static int8_t arena[8192];
+  CnnModel model=cnn_model;
+  const int8_t *testIn=cnn_test_in;
+  const int32_t *testLogits=cnn_test_logits;
+
+  static CnnBlobModel blobModel;
+  if(argc>1){
+    FILE *fp=fopen(argv[1],"rb");
+    if(!fp){ perror(argv[1]); return 1; }
+    fseek(fp,0,SEEK_END); long n=ftell(fp); fseek(fp,0,SEEK_SET);
+    uint8_t *blob=(uint8_t*)malloc(n);
+    if(fread(blob,1,n,fp)!=(size_t)n){ perror("read"); return 1; }
+    fclose(fp);
+    const char *err=cnnBlobParse(blob,n,blobModel);
+    if(err){ printf("blob rejected: %s\n",err); return 1; }
+    printf("blob version %u, %ld bytes\n",(unsigned)blobModel.version,n);
+    model=blobModel.model;
+    testIn=blobModel.testIn;
+    testLogits=blobModel.testLogits;
+  }
+
+  if(const char *err=cnnCheck(model)){ printf("model rejected: %s\n",err); return 1; }
+  uint32_t need=cnnArenaBytes(model);
+  if(need>sizeof(arena)){ printf("arena %u bytes > %u\n",(unsigned)need,(unsigned)sizeof(arena)); return 1; }
+
+  int32_t logits[CNN_MAX_CLASSES];
+  uint8_t cls=cnnRun(model,testIn,arena,logits);
+  int bad=0;
+  for(uint8_t c=0;c<model.nClasses;c++){
+    printf("  %-14s %10ld  (ref %ld)\n",c<4?cnn_classes[c]:"?",(long)logits[c],(long)testLogits[c]);
+    if(logits[c]!=testLogits[c]) bad++;
+  }
+  printf("class %s, arena %u bytes, self-test %s\n",cls<4?cnn_classes[cls]:"?",(unsigned)need,bad?"FAIL":"OK");
+
+  const int REPS=2000;
+  auto t0=std::chrono::steady_clock::now();
+  for(int r=0;r<REPS;r++) cnnRun(model,testIn,arena,logits);
+  auto t1=std::chrono::steady_clock::now();
+  printf("%.1f us / window\n",std::chrono::duration<double,std::micro>(t1-t0).count()/REPS);
+  return bad?1:0;
+}
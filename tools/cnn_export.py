@@ -0,0 +1,348 @@
+"""
+Convert a trained 1D-CNN into int8 C arrays for include/cnn.h.
+
+Usage:
+  # PyTorch: np.savez("w.npz", **{k: v.numpy() for k, v in model.state_dict().items()})
+  python tools/cnn_export.py --npz w.npz --layout torch --calib windows.npy
+
+  # Keras: np.savez("w.npz", *model.get_weights())
+  python tools/cnn_export.py --npz w.npz --layout keras --calib windows.npy
+
+  # ONNX (initializers in graph order, PyTorch layout)
+  python tools/cnn_export.py --onnx model.onnx --calib windows.npy
+
+  # Untrained placeholder with the default architecture
+  python tools/cnn_export.py --random 1
+
+  # Also write a flash blob for POST /model/upload (see include/modelblob.h)
+  python tools/cnn_export.py --npz w.npz --blob model.bin --version 3
+
+The network is described by --arch (default
+"conv5:8,pool2,conv5:16,pool2,conv3:16,gap,dense:4"): convK:C is a
+ReLU conv with kernel K and C output channels, poolN a max-pool, gap a
+global average pool and dense:N the final classifier. Weight/bias pairs
+are consumed in file order.
+
+Calibration windows are float g, shape (N, 128, 3), raw ax/ay/az as the
+firmware buffers them. Without --calib a synthetic set is generated.
+
+The integer forward pass below mirrors cnnRun() operation for operation;
+its output on one calibration window is written into the header as a
+self-test vector that both the firmware and tools/cnn_check.cpp verify.
+"""
+
+import argparse
+import math
+import struct
+import zlib
+from pathlib import Path
+
+import numpy as np
+
+CLASSES = ["no_tremor", "parkinsonian", "essential", "physiological"]
+DEFAULT_ARCH = "conv5:8,pool2,conv5:16,pool2,conv3:16,gap,dense:4"
+WINDOW = 128
+AXES = 3
+FS = 50.0
+
+OUT_PATH = Path(__file__).resolve().parent.parent / "include" / "cnn_model.h"
+
+
+# ──────────────────────────────────────────────
+# Architecture / weights
+# ──────────────────────────────────────────────
+
+def parse_arch(spec: str) -> list[dict]:
+    layers = []
+    for tok in spec.split(","):
+        tok = tok.strip()
+        if tok.startswith("conv"):
+            k, c = tok[4:].split(":")
+            layers.append({"op": "conv", "k": int(k), "cout": int(c)})
+        elif tok.startswith("pool"):
+            layers.append({"op": "pool", "k": int(tok[4:])})
+        elif tok == "gap":
+            layers.append({"op": "gap"})
+        elif tok.startswith("dense"):
+            layers.append({"op": "dense", "cout": int(tok.split(":")[1])})
+        else:
+            raise ValueError(f"unknown layer '{tok}'")
+    if layers[-1]["op"] != "dense":
+        raise ValueError("last layer must be dense")
+    return layers
+
+
+def load_npz(path: str) -> list[np.ndarray]:
+    with np.load(path) as z:
+        return [np.asarray(z[k], dtype=np.float64) for k in z.files]
+
+
+def load_onnx(path: str) -> list[np.ndarray]:
+    import onnx
+    from onnx import numpy_helper
+    model = onnx.load(path)
+    return [numpy_helper.to_array(t).astype(np.float64)
+            for t in model.graph.initializer]
+
+
+def attach_weights(layers: list[dict], arrays: list[np.ndarray], layout: str) -> None:
+    """Assign (W, b) pairs in order, converting to [cout][k][cin] / [cout][in]."""
+    it = iter(arrays)
+    cin = AXES
+    for L in layers:
+        if L["op"] == "conv":
+            W, b = next(it), next(it)
+            if layout == "keras":           # [k][cin][cout]
+                W = W.transpose(2, 0, 1)
+            else:                           # torch/onnx: [cout][cin][k]
+                W = W.transpose(0, 2, 1)
+            assert W.shape == (L["cout"], L["k"], cin), W.shape
+            L["W"], L["b"], L["cin"] = W, b.reshape(-1), cin
+            cin = L["cout"]
+        elif L["op"] == "dense":
+            W, b = next(it), next(it)
+            if layout == "keras":           # [in][out]
+                W = W.T
+            assert W.shape == (L["cout"], cin), W.shape
+            L["W"], L["b"], L["cin"] = W, b.reshape(-1), cin
+            cin = L["cout"]
+        else:
+            L["cin"] = cin
+
+
+def random_weights(layers: list[dict], seed: int) -> None:
+    rng = np.random.default_rng(seed)
+    cin = AXES
+    for L in layers:
+        L["cin"] = cin
+        if L["op"] == "conv":
+            fan = L["k"] * cin
+            L["W"] = rng.normal(0, math.sqrt(2 / fan), (L["cout"], L["k"], cin))
+            L["b"] = np.zeros(L["cout"])
+            cin = L["cout"]
+        elif L["op"] == "dense":
+            L["W"] = rng.normal(0, math.sqrt(1 / cin), (L["cout"], cin))
+            L["b"] = np.zeros(L["cout"])
+            cin = L["cout"]
+
+
+def synthetic_windows(n: int = 256, seed: int = 0) -> np.ndarray:
+    """Gravity + a tremor tone in the 3-12 Hz range + sensor noise."""
+    rng = np.random.default_rng(seed)
+    t = np.arange(WINDOW) / FS
+    out = np.empty((n, WINDOW, AXES))
+    for i in range(n):
+        g = rng.normal(0, 1, 3)
+        g /= np.linalg.norm(g)
+        f = rng.uniform(3, 12)
+        a = rng.uniform(0, 0.6)
+        d = rng.normal(0, 1, 3)
+        d /= np.linalg.norm(d)
+        tone = a * np.sin(2 * np.pi * f * t + rng.uniform(0, 2 * np.pi))
+        out[i] = g + np.outer(tone, d) + rng.normal(0, 0.01, (WINDOW, AXES))
+    return out
+
+
+# ──────────────────────────────────────────────
+# Float reference and quantisation
+# ──────────────────────────────────────────────
+
+def float_forward(layers: list[dict], x: np.ndarray) -> list[np.ndarray]:
+    """x: (N, T, C). Returns the activation after every layer."""
+    acts = []
+    for L in layers:
+        if L["op"] == "conv":
+            k = L["k"]
+            T = x.shape[1] - k + 1
+            cols = np.stack([x[:, t:t + k, :].reshape(x.shape[0], -1) for t in range(T)], 1)
+            x = np.maximum(cols @ L["W"].reshape(L["cout"], -1).T + L["b"], 0)
+        elif L["op"] == "pool":
+            k = L["k"]
+            T = x.shape[1] // k
+            x = x[:, :T * k, :].reshape(x.shape[0], T, k, -1).max(2)
+        elif L["op"] == "gap":
+            x = x.mean(1, keepdims=True)
+        else:
+            x = x.reshape(x.shape[0], -1) @ L["W"].T + L["b"]
+            x = x[:, None, :]
+        acts.append(x)
+    return acts
+
+
+def quantize_multiplier(m: float) -> tuple[int, int]:
+    """m ~= mult * 2^-(31 + shift), mult in [2^30, 2^31)."""
+    frac, exp = math.frexp(m)
+    mult = int(round(frac * (1 << 31)))
+    if mult == (1 << 31):
+        mult //= 2
+        exp += 1
+    return mult, -exp
+
+
+def quantize(layers: list[dict], calib: np.ndarray) -> float:
+    in_scale = max(float(np.abs(calib).max()), 1e-6) / 127
+    acts = float_forward(layers, calib)
+    s_in = in_scale
+    for L, a in zip(layers, acts):
+        if L["op"] in ("conv", "dense"):
+            s_w = max(float(np.abs(L["W"]).max()), 1e-12) / 127
+            L["Wq"] = np.clip(np.round(L["W"] / s_w), -127, 127).astype(np.int8)
+            L["bq"] = np.round(L["b"] / (s_in * s_w)).astype(np.int64)
+            s_out = max(float(np.abs(a).max()), 1e-6) / 127
+            L["mult"], L["shift"] = quantize_multiplier(s_in * s_w / s_out)
+            L["acc_scale"] = s_in * s_w
+            s_in = s_out
+        L["scale"] = s_in
+    return in_scale
+
+
+# ──────────────────────────────────────────────
+# Integer forward pass (mirrors cnnRun)
+# ──────────────────────────────────────────────
+
+def requant(acc: np.ndarray, mult: int, shift: int) -> np.ndarray:
+    rs = 31 + shift
+    v = (acc.astype(np.int64) * mult + (1 << (rs - 1))) >> rs
+    return np.clip(v, -128, 127).astype(np.int64)
+
+
+def int_forward(layers: list[dict], xq: np.ndarray) -> np.ndarray:
+    x = xq.astype(np.int64)                      # (T, C)
+    for i, L in enumerate(layers):
+        if L["op"] == "conv":
+            k = L["k"]
+            T = x.shape[0] - k + 1
+            W = L["Wq"].astype(np.int64).reshape(L["cout"], -1)
+            acc = np.stack([W @ x[t:t + k].reshape(-1) for t in range(T)]) + L["bq"]
+            x = np.maximum(requant(acc, L["mult"], L["shift"]), 0)
+        elif L["op"] == "pool":
+            k = L["k"]
+            T = x.shape[0] // k
+            x = x[:T * k].reshape(T, k, -1).max(1)
+        elif L["op"] == "gap":
+            s = x.sum(0)
+            n = x.shape[0]
+            x = np.where(s >= 0, (s + n // 2) // n, -((-s + n // 2) // n))[None, :]
+        else:
+            acc = L["Wq"].astype(np.int64) @ x.reshape(-1) + L["bq"]
+            if i == len(layers) - 1:
+                return acc
+            x = requant(acc, L["mult"], L["shift"])[None, :]
+    raise AssertionError("unreachable")
+
+
+# ──────────────────────────────────────────────
+# Header emission
+# ──────────────────────────────────────────────
+
+def c_array(ctype: str, name: str, values) -> str:
+    vals = [str(int(v)) for v in np.asarray(values).reshape(-1)]
+    rows = [", ".join(vals[i:i + 16]) for i in range(0, len(vals), 16)]
+    return f"static const {ctype} {name}[{len(vals)}] = {{\n  " + ",\n  ".join(rows) + "\n};\n"
+
+
+def emit(layers: list[dict], in_scale: float, test_in: np.ndarray,
+         test_logits: np.ndarray, source: str) -> str:
+    ops = {"conv": "CNN_CONV_RELU", "pool": "CNN_MAXPOOL", "gap": "CNN_GAP", "dense": "CNN_DENSE"}
+    out = [
+        "#pragma once",
+        f"// Generated by tools/cnn_export.py from {source}. Do not edit.",
+        '#include "cnn.h"',
+        "",
+    ]
+    for i, L in enumerate(layers):
+        if "Wq" in L:
+            out.append(c_array("int8_t", f"cnn_w{i}", L["Wq"]))
+            out.append(c_array("int32_t", f"cnn_b{i}", L["bq"]))
+    out.append("static const CnnLayer cnn_layers[] = {")
+    for i, L in enumerate(layers):
+        has_w = "Wq" in L
+        k = L.get("k", 0)
+        out.append(
+            f"  {{{ops[L['op']]},{L['cin']},{L.get('cout', L['cin'])},{k},{k if L['op'] == 'pool' else 1},"
+            f"{'cnn_w%d' % i if has_w else 'nullptr'},{'cnn_b%d' % i if has_w else 'nullptr'},"
+            f"{L.get('mult', 0)},{L.get('shift', 0)}}},"
+        )
+    out.append("};")
+    out.append("")
+    logit_scale = layers[-1]["acc_scale"]
+    out.append(
+        f"static const CnnModel cnn_model = {{cnn_layers,{len(layers)},{WINDOW},{AXES},"
+        f"{in_scale:.9g}f,{layers[-1]['cout']},{logit_scale:.9g}f}};"
+    )
+    out.append("")
+    out.append("static const char *const cnn_classes[] = {" +
+               ",".join(f'"{c}"' for c in CLASSES[:layers[-1]["cout"]]) + "};")
+    out.append("")
+    out.append("// Self-test: one calibration window and its expected logits.")
+    out.append(c_array("int8_t", "cnn_test_in", test_in))
+    out.append(c_array("int32_t", "cnn_test_logits", test_logits))
+    return "\n".join(out)
+
+
+def pad4(b: bytes) -> bytes:
+    return b + b"\0" * (-len(b) % 4)
+
+
+def emit_blob(layers: list[dict], in_scale: float, test_in: np.ndarray,
+              test_logits: np.ndarray, version: int) -> bytes:
+    """Binary layout of include/modelblob.h (MODEL_KIND_CNN)."""
+    ops = {"conv": 0, "pool": 1, "gap": 2, "dense": 3}
+    payload = struct.pack("<HBBffB3x", WINDOW, AXES, layers[-1]["cout"],
+                          in_scale, layers[-1]["acc_scale"], len(layers))
+    for L in layers:
+        k = L.get("k", 0)
+        w = L["Wq"].astype(np.int8).tobytes() if "Wq" in L else b""
+        b = L["bq"].astype("<i4").tobytes() if "Wq" in L else b""
+        payload += struct.pack("<BBBbHHiII", ops[L["op"]], k, k if L["op"] == "pool" else 1,
+                               L.get("shift", 0), L["cin"], L.get("cout", L["cin"]),
+                               L.get("mult", 0), len(w), len(b) // 4)
+        payload += pad4(w) + b
+    payload += pad4(test_in.astype(np.int8).tobytes())
+    payload += test_logits.astype("<i4").tobytes()
+    header = struct.pack("<IHHIII", 0x444D5254, 1, 1, version, len(payload),
+                         zlib.crc32(payload) & 0xFFFFFFFF)
+    return header + payload
+
+
+def main() -> None:
+    ap = argparse.ArgumentParser(description=__doc__.split("\n")[1])
+    src = ap.add_mutually_exclusive_group(required=True)
+    src.add_argument("--npz")
+    src.add_argument("--onnx")
+    src.add_argument("--random", type=int, metavar="SEED")
+    ap.add_argument("--layout", choices=["torch", "keras"], default="torch")
+    ap.add_argument("--arch", default=DEFAULT_ARCH)
+    ap.add_argument("--calib", help=".npy of float windows (N, 128, 3)")
+    ap.add_argument("--out", default=str(OUT_PATH))
+    ap.add_argument("--blob", help="also write a flash blob for /model/upload")
+    ap.add_argument("--version", type=int, default=1, help="model version in the blob header")
+    args = ap.parse_args()
+
+    layers = parse_arch(args.arch)
+    if args.random is not None:
+        random_weights(layers, args.random)
+        source = f"random weights (seed {args.random}), untrained placeholder"
+    elif args.onnx:
+        attach_weights(layers, load_onnx(args.onnx), "torch")
+        source = Path(args.onnx).name
+    else:
+        attach_weights(layers, load_npz(args.npz), args.layout)
+        source = Path(args.npz).name
+
+    calib = np.load(args.calib) if args.calib else synthetic_windows()
+    in_scale = quantize(layers, calib)
+
+    test_in = np.clip(np.round(calib[0] / in_scale), -128, 127).astype(np.int8)
+    test_logits = int_forward(layers, test_in)
+
+    Path(args.out).write_text(emit(layers, in_scale, test_in, test_logits, source))
+    print(f"✓ wrote {args.out}  ({len(layers)} layers, input scale {in_scale:.5f} g/LSB)")
+    if args.blob:
+        blob = emit_blob(layers, in_scale, test_in, test_logits, args.version)
+        Path(args.blob).write_bytes(blob)
+        print(f"✓ wrote {args.blob}  ({len(blob)} bytes, version {args.version})")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,13 @@
+#pragma once
+// Minimal check macros for the host tests in tools/ (test_*.cpp). A test
+// prints what it measured, counts failures with CHECK and returns
+// testExit() from main.
+#include <stdio.h>
+
+static int g_fail=0;
+#define CHECK(c,...) do{ if(!(c)){ g_fail++; if(g_fail<=20){ printf("FAIL %s:%d: ",__FILE__,__LINE__); printf(__VA_ARGS__); printf("\n"); } } }while(0)
+
+static int testExit(const char *name){
+  printf("%s %s\n",name,g_fail?"FAILED":"OK");
+  return g_fail?1:0;
+}
@@ -0,0 +1,229 @@
+// Host test for the output bus ring in include/bus.h.
+//
+//   make -C tools test
+//
+// A 1 KB ring, so every path is reached in a few messages:
+//   wrap       a message that does not fit before the end leaves a T_PAD
+//              filler and starts at 0; sinks step over the filler, and it
+//              is reclaimed with the messages around it
+//   oldest     a sink that never drains under DROP_OLDEST: the ring evicts
+//              from the tail, counts `dropped` for it alone, and it resumes
+//              at the oldest message still held, in order
+//   newest     DROP_NEWEST hysteresis: throttled once pace() sees its lag
+//              at hiWater, shed (not held) while throttled, still throttled
+//              between the marks, released at loWater; a sink sharing the
+//              topic gets every message meanwhile
+//   topics     setTopics() on a sink that holds a message: the held one is
+//              still delivered, new ones follow the new mask, and a topic
+//              nobody takes is not reserved at all
+//   random     3 sinks with mixed policies, random sizes (up to BYTES/2),
+//              drains and topic changes; every message a sink gets is
+//              intact and newer than the last, and once every sink is drained
+//              and unsubscribed the ring is empty
+#include <stdlib.h>
+#include <string.h>
+#include "test.h"
+#include "bus.h"
+
+const uint16_t BYTES = 1024;
+typedef Bus<BYTES> TestBus;
+
+// "<seq>:<len>:" then len filler letters, clipped to cap. The seq is the one
+// commit() is about to assign.
+static int fill(char *m,uint16_t cap,uint32_t seq,uint16_t len){
+  int n=snprintf(m,cap,"%08x:%04u:",(unsigned)seq,len);
+  for(uint16_t i=0;i<len && n<cap-1;i++) m[n++]='a'+(seq+i)%26;
+  m[n<cap?n:cap-1]=0;
+  return n;
+}
+static bool intact(const BusMsg *m){
+  unsigned seq,len;
+  if(sscanf(m->data(),"%08x:%04u:",&seq,&len)!=2 || seq!=m->seq) return false;
+  const char *p=m->data()+14;
+  for(unsigned i=0;i<len;i++) if(p[i]!=(char)('a'+(seq+i)%26)) return false;
+  return p[len]==0 && m->size==((sizeof(BusMsg)+14+len+1+7)&~7);
+}
+// A message of exactly `size` ring bytes (header and padding included).
+static bool publish(TestBus &b,BusTopic t,uint16_t size){
+  uint16_t len=size-sizeof(BusMsg)-15;
+  char *m=b.reserve(t,15+len);
+  if(!m) return false;
+  b.commit(fill(m,15+len,b.headSeq,len));
+  return true;
+}
+// Drains up to n messages; false if one is damaged or out of order.
+static bool drain(TestBus &b,int8_t id,int n,uint32_t *last=nullptr){
+  const BusMsg *m;
+  for(int k=0;k<n && (m=b.peek(id));k++){
+    if(!intact(m) || (last && *last!=~0u && (int32_t)(m->seq-*last)<=0)) return false;
+    if(last) *last=m->seq;
+    b.done(id);
+  }
+  return true;
+}
+
+static void testWrap(){
+  static TestBus b;
+  int8_t a=b.addSink("a",BUS_ALL);
+  for(int i=0;i<8;i++) CHECK(publish(b,T_BANDS,120),"wrap: publish %d",i);
+  CHECK(b.head==960 && b.used==960,"wrap: head %u used %u",b.head,b.used);
+  CHECK(drain(b,a,2),"wrap: first two");
+  CHECK(b.tail==240,"wrap: tail %u after two",b.tail);
+  CHECK(publish(b,T_BANDS,120),"wrap: ninth");
+  CHECK(b.at(960)->topic==T_PAD && b.at(960)->size==64,"wrap: no 64-byte filler at 960");
+  CHECK(b.head==120 && b.at(0)->seq==8,"wrap: ninth at %u, seq %lu",b.head-120,(unsigned long)b.at(0)->seq);
+  // a sink added now starts at head and never sees the filler
+  int8_t late=b.addSink("late",BUS_ALL);
+  CHECK(publish(b,T_BANDS,120),"wrap: tenth");
+  uint32_t last=~0u;
+  CHECK(drain(b,a,100,&last),"wrap: damaged or out of order after the filler");
+  CHECK(last==9 && b.sink[a].sent==10,"wrap: a got up to %lu, sent %lu",(unsigned long)last,(unsigned long)b.sink[a].sent);
+  last=~0u;
+  CHECK(drain(b,late,100,&last) && last==9 && b.sink[late].sent==1,"wrap: late sink");
+  CHECK(b.used==0,"wrap: %u bytes left in use",b.used);
+  printf("wrap    filler 64 B at 960, 10 messages, ring empty after\n");
+}
+
+static void testOldest(){
+  static TestBus b;
+  int8_t fast=b.addSink("fast",BUS_ALL);
+  int8_t slow=b.addSink("slow",BUS_ALL);
+  const uint32_t N=20;
+  uint32_t lastF=~0u;
+  for(uint32_t i=0;i<N;i++){
+    CHECK(publish(b,T_TRACK,120),"oldest: publish %u",i);
+    CHECK(b.used<=BYTES,"oldest: used %u",b.used);
+    CHECK(drain(b,fast,1,&lastF),"oldest: fast sink");
+  }
+  const BusSink &s=b.sink[slow],&f=b.sink[fast];
+  CHECK(f.sent==N && f.dropped==0,"oldest: fast sent %lu dropped %lu",(unsigned long)f.sent,(unsigned long)f.dropped);
+  uint32_t held=b.headSeq-b.tailSeq;
+  CHECK(s.dropped==N-held && held>=7,"oldest: slow dropped %lu, %lu held",(unsigned long)s.dropped,(unsigned long)held);
+  const BusMsg *m=b.peek(slow);
+  CHECK(m && m->seq==b.tailSeq,"oldest: slow resumes at %lu, tail %lu",m?(unsigned long)m->seq:0ul,(unsigned long)b.tailSeq);
+  uint32_t lastS=~0u;
+  CHECK(drain(b,slow,100,&lastS) && lastS==N-1,"oldest: slow tail in order");
+  CHECK(s.sent+s.dropped==N,"oldest: slow sent %lu + dropped %lu != %u",
+        (unsigned long)s.sent,(unsigned long)s.dropped,N);
+  CHECK(b.used==0,"oldest: %u bytes left",b.used);
+  printf("oldest  slow sink dropped %lu of %u, got the last %lu in order\n",
+         (unsigned long)s.dropped,N,(unsigned long)s.sent);
+}
+
+static void testNewest(){
+  static TestBus b;
+  int8_t n=b.addSink("newest",1u<<T_ENV,BUS_DROP_NEWEST,600,200);
+  int8_t other=b.addSink("other",1u<<T_ZOOM);
+  const BusSink &s=b.sink[n];
+  for(int i=0;i<5;i++){ CHECK(publish(b,T_ENV,120),"newest: publish %d",i); b.pace(); }
+  CHECK(s.lag==600 && (b.throttled>>n&1),"newest: lag %u, throttled %d at hiWater",s.lag,b.throttled>>n&1);
+  CHECK(!publish(b,T_ENV,120) && s.shed==1,"newest: sole taker not shed (shed %lu)",(unsigned long)s.shed);
+
+  // shared topic: published for the other sink, not held for this one
+  b.setTopics(other,(1u<<T_ENV)|(1u<<T_ZOOM));
+  CHECK(publish(b,T_ENV,120),"newest: shared topic not published");
+  CHECK(s.shed==2 && b.at((b.head+BYTES-120)%BYTES)->holders==(1<<other),"newest: holders");
+  drain(b,other,100);
+  b.setTopics(other,1u<<T_ZOOM);
+
+  // Lag is ring bytes from the cursor to head, messages it does not hold
+  // included, until they are reclaimed.
+  uint32_t seen[16], k=0;
+  const BusMsg *m;
+  auto take=[&](int cnt){ while(cnt-- && (m=b.peek(n))){ if(k<16) seen[k++]=m->seq; b.done(n); } };
+  take(2);
+  b.pace();
+  CHECK(s.lag==480 && (b.throttled>>n&1),"newest: lag %u between the marks, should stay throttled",s.lag);
+  CHECK(!publish(b,T_ENV,120) && s.shed==3,"newest: not shed between the marks");
+  take(2);
+  b.pace();
+  CHECK(s.lag==240 && (b.throttled>>n&1),"newest: lag %u, released above loWater",s.lag);
+  take(1);
+  b.pace();
+  CHECK(s.lag==0 && !(b.throttled>>n&1),"newest: lag %u, still throttled at loWater",s.lag);
+  CHECK(publish(b,T_ENV,120),"newest: after release");
+  take(100);
+  // one gap: the run before throttling, then what came after release
+  CHECK(k==6 && seen[0]==0 && seen[4]==4 && seen[5]==6,"newest: got %u messages, last %lu",
+        k,k?(unsigned long)seen[k-1]:0ul);
+  CHECK(s.sent==6 && s.dropped==0,"newest: sent %lu dropped %lu",(unsigned long)s.sent,(unsigned long)s.dropped);
+  CHECK(b.used==0,"newest: %u bytes left",b.used);
+  printf("newest  throttled at 600 B, held at 480 and 240 B, released at 0 B, shed %lu\n",(unsigned long)s.shed);
+}
+
+static void testTopics(){
+  static TestBus b;
+  int8_t a=b.addSink("a",1u<<T_BANDS);
+  CHECK(publish(b,T_BANDS,64),"topics: publish");
+  b.setTopics(a,0);
+  CHECK(!b.reserve(T_BANDS,64),"topics: reserved with no taker");
+  const BusMsg *m=b.peek(a);
+  CHECK(m && m->seq==0 && intact(m),"topics: held message lost on unsubscribe");
+  b.done(a);
+  CHECK(!b.peek(a) && b.used==0,"topics: ring not empty");
+
+  int8_t c=b.addSink("c",1u<<T_BANDS);
+  b.setTopics(a,1u<<T_BANDS);
+  CHECK(publish(b,T_BANDS,64),"topics: publish shared");
+  b.setTopics(a,1u<<T_GATED);
+  CHECK(publish(b,T_BANDS,64) && publish(b,T_GATED,64),"topics: publish after change");
+  uint32_t got[4], k=0;
+  while((m=b.peek(a)) && k<4){ got[k++]=m->seq; b.done(a); }
+  CHECK(k==2 && got[0]==1 && got[1]==3,"topics: a got %u messages",k);
+  uint32_t last=~0u;
+  CHECK(drain(b,c,100,&last) && b.sink[c].sent==2 && last==2,"topics: c");
+  CHECK(b.used==0,"topics: %u bytes left",b.used);
+  printf("topics  held message delivered after unsubscribe, new ones follow the mask\n");
+}
+
+static uint32_t rng=2463534242u;
+static uint32_t rnd(uint32_t n){ rng^=rng<<13; rng^=rng>>17; rng^=rng<<5; return rng%n; }
+
+static void testRandom(){
+  static TestBus b;
+  int8_t id[3]={b.addSink("o",BUS_ALL),b.addSink("n",BUS_ALL,BUS_DROP_NEWEST,512,128),
+                b.addSink("t",(1u<<T_BANDS)|(1u<<T_GATED))};
+  uint32_t last[3]={~0u,~0u,~0u};
+  int bad=0;
+  const int OPS=300000;
+  for(int op=0;op<OPS;op++){
+    uint32_t r=rnd(100);
+    if(r<60){
+      BusTopic t=(BusTopic)rnd(T_MAX);
+      uint16_t len=rnd(8)?rnd(100):rnd(BYTES/2);
+      char *m=b.reserve(t,15+len);
+      if(m) b.commit(fill(m,15+len,b.headSeq,len));
+    } else if(r<95){
+      int k=rnd(3);
+      if(!drain(b,id[k],1+rnd(4),&last[k])) bad++;
+    } else if(r<98){
+      b.pace();
+    } else if(r<99){
+      int k=rnd(3);
+      b.setTopics(id[k],rnd(4)?BUS_ALL:rnd(1u<<T_MAX));
+    } else {
+      int k=rnd(2);
+      b.setPolicy(id[k],rnd(2)?BUS_DROP_NEWEST:BUS_DROP_OLDEST);
+    }
+    if(b.used>BYTES) bad++;
+  }
+  for(int k=0;k<3;k++){
+    b.setTopics(id[k],0);
+    if(!drain(b,id[k],1<<20,&last[k])) bad++;
+  }
+  CHECK(!bad,"random: %d damaged, out-of-order or overfull",bad);
+  CHECK(b.used==0,"random: %u bytes left after draining",b.used);
+  printf("random  %d ops, %lu published, tooBig %lu;",OPS,(unsigned long)b.published,(unsigned long)b.tooBig);
+  for(int k=0;k<3;k++)
+    printf(" %s sent %lu dropped %lu shed %lu%s",b.sink[id[k]].name,(unsigned long)b.sink[id[k]].sent,
+           (unsigned long)b.sink[id[k]].dropped,(unsigned long)b.sink[id[k]].shed,k<2?",":"\n");
+}
+
+int main(){
+  testWrap();
+  testOldest();
+  testNewest();
+  testTopics();
+  testRandom();
+  return testExit("test_bus");
+}
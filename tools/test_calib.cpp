@@ -0,0 +1,73 @@
+// Host test for the sequential baseline calibration in include/calib.h.
+//
+//   make -C tools test
+//
+// Feeds |tremor|-like sample streams (deterministic xorshift noise) and
+// checks when Calibrator::push() ends and what baseline it reports:
+//   steady    low-spread input: ends at minBlocks, baseline within 2%
+//   noisy     |gaussian| input: ends once the 95% interval is within
+//             relTol, before maxBlocks, baseline within relTol
+//   wild      spread too wide to converge: runs to maxBlocks
+//   bump      10x for two blocks (0.4 s) mid-calibration: neither lifts the
+//             baseline nor holds calibration open
+//   constant  zero spread (MAD and Welford sd both 0): ends at minBlocks
+//   restart   start() clears the state and clamps min/max; push() after
+//             done changes nothing
+#include "test.h"
+#include "calib.h"
+
+static uint32_t rng=2463534242u;
+static float uniform(){ rng^=rng<<13; rng^=rng>>17; rng^=rng<<5; return (rng>>8)*(1.0f/16777216.0f); }
+static float gauss(){ float s=0; for(int i=0;i<6;i++) s+=uniform(); return (s-3.0f)*1.41421356f; }
+
+// Feeds samples until done (or a hard cap); returns blocks used.
+template<typename F>
+static int feed(Calibrator &c,F sample){
+  c.start();
+  for(int n=0;n<CAL_MAX_BLOCKS*CAL_BLOCK*2;n++)
+    if(c.push(sample(n))) return c.nBlocks;
+  return -1;
+}
+
+int main(){
+  const float base=0.01f;               // g
+  Calibrator c;
+
+  int n=feed(c,[&](int){ return base*(1+0.3f*gauss()); });
+  printf("steady    %d blocks (%.1f s), baseline %.5f\n",n,c.seconds(50),c.baseline);
+  CHECK(n==c.minBlocks,"ended after %d blocks",n);
+  CHECK(fabsf(c.baseline-base)<0.02f*base,"baseline %.5f",c.baseline);
+
+  const float halfNormal=base*0.79788456f;   // E|N(0,base)|
+  n=feed(c,[&](int){ return fabsf(base*gauss()); });
+  printf("noisy     %d blocks (%.1f s), baseline %.5f (true %.5f)\n",n,c.seconds(50),c.baseline,halfNormal);
+  CHECK(n>c.minBlocks && n<c.maxBlocks,"ended after %d blocks",n);
+  CHECK(fabsf(c.baseline-halfNormal)<c.relTol*halfNormal,"baseline %.5f",c.baseline);
+
+  n=feed(c,[&](int i){ return (i/CAL_BLOCK)%2?base*0.1f:base*3; });
+  printf("wild      %d blocks (%.1f s)\n",n,c.seconds(50));
+  CHECK(n==c.maxBlocks,"ended after %d blocks",n);
+
+  n=feed(c,[&](int i){ int b=i/CAL_BLOCK; float x=base*(1+0.3f*gauss()); return b>=3 && b<5?10*x:x; });
+  printf("bump      %d blocks (%.1f s), baseline %.5f, median %.5f, sigma %.5f\n",n,c.seconds(50),
+         c.baseline,c.median,c.sigma);
+  CHECK(n<=c.minBlocks+2,"bump held calibration open: %d blocks",n);
+  CHECK(fabsf(c.baseline-base)<0.05f*base,"bump lifted the baseline to %.5f",c.baseline);
+
+  n=feed(c,[&](int){ return base; });
+  printf("constant  %d blocks, baseline %.5f\n",n,c.baseline);
+  CHECK(n==c.minBlocks && fabsf(c.baseline-base)<1e-6f*base && c.sigma==0,"%d blocks, baseline %.5f",
+        n,c.baseline);
+
+  float b0=c.baseline;
+  CHECK(c.push(100*base) && c.baseline==b0 && c.nBlocks==n,"push after done changed state");
+  c.minBlocks=200; c.maxBlocks=200;
+  c.start();
+  CHECK(c.maxBlocks==CAL_MAX_BLOCKS && c.minBlocks==CAL_MAX_BLOCKS && !c.done && c.nBlocks==0,
+        "start: min %u max %u",c.minBlocks,c.maxBlocks);
+  n=feed(c,[&](int){ return base; });
+  printf("restart   clamped to %u blocks, ended after %d\n",c.maxBlocks,n);
+  CHECK(n==CAL_MAX_BLOCKS,"ended after %d blocks",n);
+
+  return testExit("test_calib");
+}
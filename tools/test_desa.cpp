@@ -0,0 +1,54 @@
+// Host test for the DESA-2 envelopes in include/teager.h.
+//
+//   make -C tools test
+//
+// 0.3 g tones at 4.5, 7 and 10 Hz (one per firmware band), 10 s at 50 Hz,
+// checked over the last 5 s:
+//   direct     the tone straight into Desa demodulates to its frequency
+//              and amplitude (within 1e-3 Hz and 0.1%)
+//   band-pass  through the band's Biquad::initBPF section, as in loop(),
+//              the frequency is unchanged and the amplitude is 0.3 g times
+//              the section's gain at that frequency (within 1%)
+#include <math.h>
+#include "test.h"
+#include "biquad.h"
+#include "teager.h"
+
+const double FS = 50.0;
+const double A = 0.3;
+
+// |H(e^jw)| of one section
+static double gain(const Biquad &q,double f){
+  double w=2*M_PI*f/FS;
+  double nr=q.b0+q.b1*cos(w)+q.b2*cos(2*w), ni=-q.b1*sin(w)-q.b2*sin(2*w);
+  double dr=1+q.a1*cos(w)+q.a2*cos(2*w), di=-q.a1*sin(w)-q.a2*sin(2*w);
+  return sqrt((nr*nr+ni*ni)/(dr*dr+di*di));
+}
+
+int main(){
+  const double tones[3]={4.5,7.0,10.0};
+  const double lo[3]={4,6,8}, hi[3]={6,8,12};
+  for(int b=0;b<3;b++){
+    double f=tones[b];
+    Desa direct,banded;
+    Biquad bpf;
+    bpf.initBPF(FS,lo[b],hi[b]);
+    double g=gain(bpf,f);
+    double dfD=0,daD=0,dfB=0,daB=0;
+    for(int n=0;n<FS*10;n++){
+      float x=(float)(A*sin(2*M_PI*f*n/FS));
+      direct.push(x);
+      banded.push((float)bpf.process(x));
+      if(n<FS*5) continue;
+      dfD=fmax(dfD,fabs(direct.freq(FS)-f));
+      daD=fmax(daD,fabs(direct.amplitude()-A)/A);
+      dfB=fmax(dfB,fabs(banded.freq(FS)-f));
+      daB=fmax(daB,fabs(banded.amplitude()-A*g)/(A*g));
+    }
+    printf("%4.1f Hz  direct |df| %.5f |da| %.3f%%   bpf %g-%g gain %.3f |df| %.5f |da| %.3f%%\n",
+           f,dfD,100*daD,lo[b],hi[b],g,dfB,100*daB);
+    CHECK(dfD<=1e-3 && daD<=1e-3,"%.1f Hz direct: df %.5f da %.5f",f,dfD,daD);
+    CHECK(dfB<=1e-3 && daB<=0.01,"%.1f Hz band-passed: df %.5f da %.5f",f,dfB,daB);
+  }
+  return testExit("test_desa");
+}
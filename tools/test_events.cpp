@@ -0,0 +1,38 @@
+// Host test for the window-event formatters in include/events.h.
+//
+//   make -C tools test
+//
+//   clock    DevClock keeps counting across the millis() wrap
+//   fit      with large but possible values (a year of uptime, the largest
+//            seq, band powers of 1e4 g^2, the longest type name) every
+//            payload fits its EV_*_BYTES reservation
+//   fields   each payload starts with the stamp, as the gateway reads it
+#include <string.h>
+#include "test.h"
+#include "events.h"
+
+int main(){
+  DevClock c;
+  double a=c.seconds(0xFFFFFC18u);               // 1000 ms before the wrap
+  double b=c.seconds(0x000003E8u);               // 1000 ms after it
+  CHECK(b-a>1.999 && b-a<2.001,"across the wrap: %.3f s, want 2",b-a);
+  CHECK(c.seconds(0x000007D0u)-b>0.999,"after the wrap");
+
+  WindowStamp s;
+  s.t=365.0*86400; s.seq=0xFFFFFFFFu;
+  char buf[512];
+  int n=fmtBands(buf,sizeof(buf),s,1e4,1e4,1e4,"Voluntary Movement",1,10,99.9999,1);
+  CHECK(n>0 && n<EV_BANDS_BYTES,"bands %d bytes > %u",n,EV_BANDS_BYTES);
+  printf("bands   %3d of %u: %s\n",n,EV_BANDS_BYTES,buf);
+  n=fmtGated(buf,sizeof(buf),s,99.9999,1,99.9999);
+  CHECK(n>0 && n<EV_GATED_BYTES,"gated %d bytes > %u",n,EV_GATED_BYTES);
+  printf("gated   %3d of %u: %s\n",n,EV_GATED_BYTES,buf);
+  n=fmtQuality(buf,sizeof(buf),s,0xFFFFFFFFu,0xFFFFFFFFu,0xFFFFFFFFu);
+  CHECK(n>0 && n<EV_QUALITY_BYTES,"quality %d bytes > %u",n,EV_QUALITY_BYTES);
+  printf("quality %3d of %u: %s\n",n,EV_QUALITY_BYTES,buf);
+
+  s.t=12.3456; s.seq=7;
+  fmtGated(buf,sizeof(buf),s,0.1,0.9,1.0);
+  CHECK(!strncmp(buf,"{\"t\":12.346,\"seq\":7,",20),"stamp: %s",buf);
+  return testExit("test_events");
+}
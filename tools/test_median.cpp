@@ -0,0 +1,89 @@
+// Host test for SlidingMedian and Hampel in include/hampel.h.
+//
+//   make -C tools test
+//
+// The two-heap sliding median is compared with a sort of the same window
+// after every push, for odd window sizes 3 to 63 (the firmware uses 7),
+// over 200k samples each of: uniform noise, coarsely quantised values (many
+// ties), constant runs, ramps up and down, and a sine with spikes.
+// The heap invariants (lower half <= upper half, `where` consistent with
+// the heaps) are checked too. Hampel must return either its input or the
+// window median.
+#include <stdlib.h>
+#include <algorithm>
+#include "test.h"
+#include "hampel.h"
+
+const int N = 200000;
+const uint8_t HAMPEL_LEN = 7;            // as in include/pipeline.h
+
+static uint32_t rng=12345;
+static float uniform(){ rng^=rng<<13; rng^=rng>>17; rng^=rng<<5; return (rng>>8)*(1.0f/16777216.0f); }
+
+static float source(int kind,int n){
+  switch(kind){
+    case 0: return uniform()*2-1;
+    case 1: return floorf(uniform()*5);                         // ties
+    case 2: return (float)((n/97)%3);                           // constant runs
+    case 3: return (n/500)%2?(float)(n%500):(float)(500-n%500); // ramps
+    default:{
+      float x=0.3f*sinf(0.7f*n)+0.01f*(uniform()-0.5f);
+      if(uniform()<0.01f) x+=uniform()<0.5f?-4:4;
+      return x;
+    }
+  }
+}
+static const char *KINDS[5]={"uniform","ties","runs","ramps","sine+spikes"};
+
+template<uint8_t W>
+static void check(){
+  static SlidingMedian<W> sm;
+  float hist[W],sorted[W];
+  for(int kind=0;kind<5;kind++){
+    float x0=source(kind,0);
+    sm.init(x0);
+    for(uint8_t i=0;i<W;i++) hist[i]=x0;
+    int bad=0;
+    for(int n=1;n<N;n++){
+      float x=source(kind,n);
+      hist[n%W]=x;
+      float m=sm.push(x);
+      std::copy(hist,hist+W,sorted);
+      std::nth_element(sorted,sorted+W/2,sorted+W);
+      if(m!=sorted[W/2]){
+        if(++bad<=3) CHECK(false,"W=%u %s n=%d: median %g, sort %g",W,KINDS[kind],n,m,sorted[W/2]);
+      }
+      // heap order and the slot -> position map
+      for(uint8_t i=0;i<sm.NLO;i++){
+        if(i && sm.val[sm.lo[(i-1)/2]]<sm.val[sm.lo[i]]) bad++;
+        if(sm.where[sm.lo[i]]!=i) bad++;
+      }
+      for(uint8_t i=0;i<sm.NHI;i++){
+        if(i && sm.val[sm.hi[(i-1)/2]]>sm.val[sm.hi[i]]) bad++;
+        if(sm.where[sm.hi[i]]!=(0x80|i)) bad++;
+      }
+      if(sm.NHI && sm.val[sm.lo[0]]>sm.val[sm.hi[0]]) bad++;
+    }
+    CHECK(!bad,"W=%u %s: %d mismatches",W,KINDS[kind],bad);
+  }
+  printf("W=%-3u %d samples x %d sources checked\n",W,N,5);
+}
+
+int main(){
+  check<3>(); check<5>(); check<7>(); check<9>(); check<15>(); check<31>(); check<63>();
+
+  // Hampel output is the sample or the median of the window that includes it
+  Hampel<HAMPEL_LEN> h;
+  SlidingMedian<HAMPEL_LEN> ref;
+  int odd=0;
+  for(int n=0;n<N;n++){
+    float x=source(4,n);
+    if(!n) ref.init(x);
+    float m=ref.push(x);
+    float y=h.process(x);
+    if(y!=x && y!=m) odd++;
+  }
+  printf("hampel W=%u rejected %u of %d\n",HAMPEL_LEN,h.rejected,N);
+  CHECK(!odd,"hampel returned %d values that are neither input nor median",odd);
+  return testExit("test_median");
+}
@@ -0,0 +1,163 @@
+// Host test for the model blob parser in include/modelblob.h.
+//
+//   make -C tools test
+//
+// Blobs are packed here the way tools/cnn_export.py --blob packs them.
+//   valid      the compiled-in include/cnn_model.h as a blob parses and
+//              passes its self-test
+//   shapes     blobs that are well formed but whose layers do not chain are
+//              rejected by cnnBlobParse: MAXPOOL k=0, a last DENSE with
+//              cout > CNN_MAX_CLASSES or != nClasses, wLen one short or one
+//              long, cin != incoming channels, a kernel longer than its input
+//   fuzz       random byte flips with the CRC fixed up; whatever parses must
+//              fit the arena and run under ASan without touching memory
+//              outside the blob
+#include <stdlib.h>
+#include <algorithm>
+#include <vector>
+#include "test.h"
+#include "modelblob.h"
+#include "cnn_model.h"
+
+static std::vector<uint8_t> out;
+static void put(const void *p,size_t n){ out.insert(out.end(),(const uint8_t*)p,(const uint8_t*)p+n); }
+static void pad(){ while(out.size()%4) out.push_back(0); }
+
+static uint32_t weights(const CnnLayer &L){
+  if(L.op==CNN_CONV_RELU) return (uint32_t)L.cout*L.k*L.cin;
+  if(L.op==CNN_DENSE) return (uint32_t)L.cout*L.cin;
+  return 0;
+}
+
+// Packs layers[] (at most cnn_model.nLayers of them) as a blob. wAdj[i] is added to layer i's weight count, so
+// the payload is self-consistent but the count is wrong for the shape.
+static std::vector<uint8_t> pack(const CnnLayer *layers,uint8_t nLayers,uint8_t nClasses,const int *wAdj=nullptr){
+  static const int8_t zeros[65536]={0};
+  out.clear();
+  CnnBlobInfo info={};
+  info.inLen=cnn_model.inLen; info.inCh=cnn_model.inCh; info.nClasses=nClasses;
+  info.inScale=cnn_model.inScale; info.logitScale=cnn_model.logitScale; info.nLayers=nLayers;
+  put(&info,sizeof(info));
+  for(uint8_t i=0;i<nLayers;i++){
+    const CnnLayer &L=layers[i];
+    CnnBlobLayer b={};
+    b.op=L.op; b.k=L.k; b.stride=L.stride; b.shift=L.shift;
+    b.cin=L.cin; b.cout=L.cout; b.mult=L.mult;
+    b.wLen=weights(L);
+    if(wAdj) b.wLen+=wAdj[i];
+    b.bLen=b.wLen?L.cout:0;
+    put(&b,sizeof(b));
+    // the real arrays as far as they go (a mutated layer may be bigger)
+    const CnnLayer &R=cnn_model.layers[i];
+    uint32_t have=L.w?std::min(b.wLen,weights(R)):0;
+    put(L.w,have); put(zeros,b.wLen-have); pad();
+    for(uint32_t c=0;c<b.bLen;c++){ int32_t v=L.b && c<R.cout?L.b[c]:0; put(&v,4); }
+  }
+  put(cnn_test_in,(size_t)cnn_model.inLen*cnn_model.inCh); pad();
+  for(uint8_t c=0;c<nClasses;c++){ int32_t v=c<cnn_model.nClasses?cnn_test_logits[c]:0; put(&v,4); }
+  ModelBlobHeader h={MODEL_MAGIC,MODEL_FORMAT,MODEL_KIND_CNN,7,(uint32_t)out.size(),modelCrc32(out.data(),out.size())};
+  std::vector<uint8_t> blob((const uint8_t*)&h,(const uint8_t*)&h+sizeof(h));
+  blob.insert(blob.end(),out.begin(),out.end());
+  return blob;
+}
+
+// Parses from a 4-byte aligned heap copy exactly as long as the blob, so
+// ASan sees any read past its end.
+static const char *parse(const std::vector<uint8_t> &blob,CnnBlobModel &m,uint8_t **buf){
+  *buf=(uint8_t*)malloc(blob.size());
+  memcpy(*buf,blob.data(),blob.size());
+  return cnnBlobParse(*buf,blob.size(),m);
+}
+
+static void expectReject(const char *what,const CnnLayer *layers,uint8_t nLayers,uint8_t nClasses,const int *wAdj=nullptr){
+  CnnBlobModel m; uint8_t *buf;
+  const char *err=parse(pack(layers,nLayers,nClasses,wAdj),m,&buf);
+  printf("  %-28s %s\n",what,err?err:"accepted");
+  CHECK(err,"%s: accepted",what);
+  free(buf);
+}
+
+int main(){
+  static int8_t arena[8192];
+  const uint8_t N=cnn_model.nLayers;
+  CnnLayer L[CNN_MAX_LAYERS];
+
+  // valid
+  {
+    CnnBlobModel m; uint8_t *buf;
+    const char *err=parse(pack(cnn_model.layers,N,cnn_model.nClasses),m,&buf);
+    CHECK(!err,"default model rejected: %s",err);
+    if(!err){
+      CHECK(cnnArenaBytes(m.model)<=sizeof(arena),"arena");
+      CHECK(cnnBlobSelfTest(m,arena),"default model self-test failed");
+    }
+    CHECK(!cnnCheck(cnn_model),"compiled-in model fails cnnCheck");
+    free(buf);
+  }
+
+  // shapes
+  memcpy(L,cnn_model.layers,N*sizeof(CnnLayer));
+  L[1].k=0; L[1].stride=0;
+  expectReject("maxpool k=0",L,N,cnn_model.nClasses);
+
+  memcpy(L,cnn_model.layers,N*sizeof(CnnLayer));
+  L[N-1].cout=9;
+  expectReject("dense cout=9, nClasses=9",L,N,9);
+  expectReject("dense cout=9, nClasses=4",L,N,cnn_model.nClasses);
+
+  memcpy(L,cnn_model.layers,N*sizeof(CnnLayer));
+  L[N-1].cout=3;
+  expectReject("dense cout=3, nClasses=4",L,N,cnn_model.nClasses);
+
+  int adj[CNN_MAX_LAYERS]={0};
+  adj[0]=-1;
+  expectReject("conv wLen one short",cnn_model.layers,N,cnn_model.nClasses,adj);
+  adj[0]=0; adj[N-1]=1;
+  expectReject("dense wLen one long",cnn_model.layers,N,cnn_model.nClasses,adj);
+  adj[N-1]=0; adj[1]=4;
+  expectReject("maxpool with weights",cnn_model.layers,N,cnn_model.nClasses,adj);
+
+  memcpy(L,cnn_model.layers,N*sizeof(CnnLayer));
+  L[2].cin=4;
+  expectReject("conv cin != channels",L,N,cnn_model.nClasses);
+
+  memcpy(L,cnn_model.layers,N*sizeof(CnnLayer));
+  L[N-1].cin=32;
+  expectReject("dense cin != features",L,N,cnn_model.nClasses);
+
+  memcpy(L,cnn_model.layers,N*sizeof(CnnLayer));
+  L[4].k=200;
+  expectReject("conv k > input length",L,N,cnn_model.nClasses);
+
+  memcpy(L,cnn_model.layers,N*sizeof(CnnLayer));
+  L[0].stride=0;
+  expectReject("conv stride=0",L,N,cnn_model.nClasses);
+
+  // fuzz
+  std::vector<uint8_t> good=pack(cnn_model.layers,N,cnn_model.nClasses);
+  const size_t H=sizeof(ModelBlobHeader), infoEnd=H+sizeof(CnnBlobInfo)+N*(sizeof(CnnBlobLayer)+64);
+  uint32_t rng=1, parsed=0;
+  const int ROUNDS=20000;
+  for(int r=0;r<ROUNDS;r++){
+    std::vector<uint8_t> b=good;
+    int flips=1+r%4;
+    for(int f=0;f<flips;f++){
+      rng^=rng<<13; rng^=rng>>17; rng^=rng<<5;
+      // mostly the info and layer records, where the shapes live
+      size_t at=H+rng%((r&1?infoEnd:b.size())-H);
+      if(at>=b.size()) at=b.size()-1;
+      b[at]^=(uint8_t)(1u<<(rng>>24)%8);
+    }
+    ModelBlobHeader h; memcpy(&h,b.data(),H);
+    h.crc=modelCrc32(b.data()+H,b.size()-H);
+    memcpy(b.data(),&h,H);
+    CnnBlobModel m; uint8_t *buf;
+    if(!parse(b,m,&buf)){
+      parsed++;
+      if(cnnArenaBytes(m.model)<=sizeof(arena)) cnnBlobSelfTest(m,arena);
+    }
+    free(buf);
+  }
+  printf("fuzz: %d mutated blobs, %u parsed and ran\n",ROUNDS,parsed);
+  return testExit("test_modelblob");
+}
@@ -0,0 +1,130 @@
+// Host test for shadow mode: ShadowStats in include/pipeline.h driven the
+// way loop() drives it, with a live and a candidate Pipeline on the same
+// synthetic IMU samples (include/synth.h).
+//
+//   make -C tools test
+//
+// The candidate is started at a live window close, as /shadow/start does.
+//   warmup    candidate = live config, four synth setups: the first
+//             candidate window reads "Gated" next to a small tremor (the
+//             cleared filters' start-up), it and the next stay out of the
+//             counters, every counted window agrees
+//   disagree  candidate noise floor out of reach reads "No Tremor" on a tremor:
+//             counted windows disagree, warm-up still skipped, rate 0
+//   gated     a 0.5 Hz sway gates both pipelines: counts as agreement
+//             whatever the type fields hold
+//   restart   a second start mid-run clears the counters and warms up again
+#include "test.h"
+#include "pipeline.h"
+#include "synth.h"
+
+const float FS = 50.0f;
+
+struct Run {
+  Pipeline live,cand;
+  SynthImu synth;
+  ShadowStats st;
+  bool on=false;
+  uint32_t firstAgree=0,firstN=0;        // raw agreement of the first candidate window
+  uint32_t sent=0,bothGated=0;
+  const char *firstType="";
+
+  // n live windows; the candidate starts after `startAt` of them.
+  void run(uint32_t n,uint32_t startAt,const PipelineConfig &cc){
+    for(uint32_t closed=0;closed<n;){
+      float acc[3],gyro[3];
+      synth.next(FS,acc,gyro);
+      SampleOut o,so; WindowOut w,sw;
+      bool c=live.push(acc[0],acc[1],acc[2],o,w);
+      bool sc=on && cand.push(acc[0],acc[1],acc[2],so,sw);
+      if(!c){
+        CHECK(!sc,"candidate closed a window without live");
+        continue;
+      }
+      CHECK(sc==on,"candidate out of step with live at window %u",closed);
+      if(sc && st.warm==SHADOW_WARMUP){
+        firstN++; firstAgree+=ShadowStats::agrees(w,sw);
+        firstType=sw.gated?"Gated":sw.type;
+      }
+      if(sc && st.window(w,sw)){ sent++; bothGated+=w.gated && sw.gated; }
+      if(++closed==startAt){ cand.init(cc); st.start(); on=true; }
+    }
+  }
+};
+
+static void warmup(){
+  const float amps[4]={0.05f,0.2f,0.5f,0.02f};
+  const float freqs[4]={6.0f,5.0f,9.0f,4.5f};
+  for(int k=0;k<4;k++){
+    static Run r;
+    r=Run();
+    PipelineConfig cfg;
+    r.live.init(cfg);
+    r.synth.amp=amps[k]; r.synth.freq=freqs[k]; r.synth.rng+=k*7919;
+    r.run(20,6,cfg);
+    printf("warmup    amp %.2f g %.1f Hz: first window %s (%s), counted %u agree %u\n",amps[k],freqs[k],
+           r.firstAgree?"agrees":"differs",r.firstType,(unsigned)r.st.windows,(unsigned)r.st.agree);
+    CHECK(r.firstN==1,"first candidate window not seen");
+    if(amps[k]<0.1f) CHECK(!r.firstAgree && !strcmp(r.firstType,"Gated"),"small tremor: first window %s",r.firstType);
+    CHECK(r.st.windows==20-6-SHADOW_WARMUP && r.sent==r.st.windows,"counted %u",(unsigned)r.st.windows);
+    CHECK(r.st.agree==r.st.windows && r.st.rate()==1.0,"agree %u of %u",(unsigned)r.st.agree,(unsigned)r.st.windows);
+  }
+}
+
+static void disagree(){
+  static Run r;
+  r=Run();
+  PipelineConfig cfg;
+  r.live.init(cfg);
+  r.synth.amp=0.3f;
+  PipelineConfig cc=cfg;
+  cc.noiseFloor=cc.baseForScore=1e12;
+  r.run(16,4,cc);
+  printf("disagree  counted %u agree %u rate %.2f\n",(unsigned)r.st.windows,(unsigned)r.st.agree,r.st.rate());
+  CHECK(r.st.windows==16-4-SHADOW_WARMUP,"counted %u",(unsigned)r.st.windows);
+  CHECK(r.st.agree==0 && r.st.rate()==0.0,"agree %u",(unsigned)r.st.agree);
+}
+
+static void gated(){
+  WindowOut a{},b{};
+  a.gated=b.gated=true;
+  a.type="Voluntary Movement"; b.type="No Tremor";
+  CHECK(ShadowStats::agrees(a,b),"both gated must agree");
+  b.gated=false;
+  CHECK(!ShadowStats::agrees(a,b),"gated vs not gated must disagree");
+
+  static Run r;
+  r=Run();
+  PipelineConfig cfg;
+  r.live.init(cfg);
+  r.synth.amp=0.01f; r.synth.swayAmp=0.5f;
+  r.run(14,4,cfg);
+  printf("gated     counted %u agree %u, both gated %u\n",(unsigned)r.st.windows,(unsigned)r.st.agree,
+         (unsigned)r.bothGated);
+  CHECK(r.bothGated==r.st.windows,"both gated in %u of %u",(unsigned)r.bothGated,(unsigned)r.st.windows);
+  CHECK(r.st.windows==14-4-SHADOW_WARMUP && r.st.agree==r.st.windows,"agree %u of %u",
+        (unsigned)r.st.agree,(unsigned)r.st.windows);
+}
+
+static void restart(){
+  static Run r;
+  r=Run();
+  PipelineConfig cfg;
+  r.live.init(cfg);
+  PipelineConfig cc=cfg;
+  cc.noiseFloor=cc.baseForScore=1e12;
+  r.run(10,3,cc);                        // 5 counted, all disagree
+  uint32_t before=r.st.windows;
+  r.run(5,1,cfg);                        // restart on the live config after 1 window
+  printf("restart   counted %u before, %u after\n",(unsigned)before,(unsigned)r.st.windows);
+  CHECK(before==5 && r.st.windows==5-1-SHADOW_WARMUP && r.st.agree==r.st.windows,
+        "after restart %u agree %u",(unsigned)r.st.windows,(unsigned)r.st.agree);
+}
+
+int main(){
+  warmup();
+  disagree();
+  gated();
+  restart();
+  return testExit("test_shadow");
+}